@@ -27,15 +27,106 @@
 
 // How many connections do we let queue up before turning them away?
 // If the socket domain is AF_INET and the backlog argument is greater
-// than the constant SOMAXCONN (128 in Linux kernel 2.[02]), it is silently
-// (and non-portably) truncated to SOMAXCONN.
-#define SOCKET_CONNECTION_BACKLOG		5
+// than the constant SOMAXCONN (net.core.somaxconn on Linux), it is silently
+// (and non-portably) truncated to SOMAXCONN. The ListenBacklog config integer
+// overrides this for the game port
+#define SOCKET_CONNECTION_BACKLOG		128
+
+// The most connections accepted per wakeup of the driver thread, so a reconnect storm
+// can't keep it from reading the players already connected
+#define SOCKET_ACCEPT_BATCH				64
+
+// Connection admission (see SocketDriver::new_connection()). Override with the
+// MaxConnections, MaxConnectionsPerIP, ConnectionRate, ConnectionBurst,
+// ConnectionRatePerIP and ConnectionBurstPerIP config integers; 0 turns a limit off.
+// MAX_CONNECTIONS must stay under FD_SETSIZE (1024), since the driver uses select().
+// Rates are new connections per second for the whole server and per minute for each
+// address. Loopback addresses only count against MAX_CONNECTIONS, so local bots and
+// benchmarks aren't throttled
+#define MAX_CONNECTIONS					900
+#define MAX_CONNECTIONS_PER_IP			10
+#define CONNECTION_RATE					20
+#define CONNECTION_BURST				100
+#define CONNECTION_RATE_PER_IP			6
+#define CONNECTION_BURST_PER_IP			5
+
+// Once admission tracks 4 * MAX_CONNECTIONS addresses, each new address looks at this
+// many old records and forgets the ones that are idle, rather than walking all of them
+#define ADDRESS_EVICTION_BATCH			8
+
+// What a turned away connection is sent before it is closed, unless the RejectMessage
+// config string says otherwise
+#define REJECT_MESSAGE					"The server is busy right now. Please try again in a minute."
+
+// Idle timeouts by connection state, in seconds (see IdleReaper). Override with the
+// IdleTimeoutLogin, IdleTimeoutPassword, IdleTimeoutCreate and IdleTimeoutPlaying config
+// integers; 0 turns a timeout off. A connection's idle time runs from the later of the
+// last line it sent and the moment it entered its state
+#define IDLE_TIMEOUT_LOGIN				120
+#define IDLE_TIMEOUT_PASSWORD			120
+#define IDLE_TIMEOUT_CREATE				600
+#define IDLE_TIMEOUT_PLAYING			7200
+
+// Seconds in one turn of the IdleReaper's timer wheel; longer timeouts just go round again
+#define IDLE_REAPER_SLOTS				1024
+
+// TCP keepalive for client connections: seconds of quiet before the first probe, seconds
+// between probes, and unanswered probes before the kernel drops the connection
+// (TcpKeepAliveIdle, TcpKeepAliveInterval and TcpKeepAliveCount config integers; an idle
+// time of 0 turns keepalive off). TCP_USER_TIMEOUT_SECONDS is how long sent data may go
+// unacknowledged before the connection is dropped (TcpUserTimeout); 0 leaves the system
+// default of about 15 minutes
+#define TCP_KEEPALIVE_IDLE				300
+#define TCP_KEEPALIVE_INTERVAL			60
+#define TCP_KEEPALIVE_COUNT				4
+#define TCP_USER_TIMEOUT_SECONDS		0
 
 #define MAX_PROCESS_OPEN_DESCRIPTORS	10
 
 // These two defines are used in class ClientSocket
 #define kMaxSocketBufferWriteSize		4096
 #define kMaxSocketInputBufferLength		1024
+// Output a client hasn't read yet is kept and sent as its socket drains; a client this
+// many bytes behind is dropped
+#define kMaxSocketPendingLength			262144
+
+// Per-connection input limits (see Connection::Read()). Override with the InputByteRate,
+// InputByteBurst, InputLineRate, InputLineBurst, MaxQueuedCommands and MaxInputLineLength
+// config integers; 0 turns a limit off. A connection past its byte or line rate isn't read
+// from until its bucket refills, so the flood waits in the kernel and then the client.
+// Lines longer than MAX_INPUT_LINE_LENGTH are cut short. Commands that find
+// MAX_QUEUED_COMMANDS already waiting are handled by the CommandOverflowPolicy config
+// string: "drop" them, "warn" the player once and drop them, or "disconnect"
+#define INPUT_BYTE_RATE					4096
+#define INPUT_BYTE_BURST				32768
+#define INPUT_LINE_RATE					10
+#define INPUT_LINE_BURST				40
+#define MAX_QUEUED_COMMANDS				50
+#define MAX_INPUT_LINE_LENGTH			1024
+#define COMMAND_OVERFLOW_POLICY			"warn"
+
+// The longest telnet subnegotiation (IAC SB ... IAC SE) a client may send; longer ones
+// are dropped. Used in class TelnetParser
+#define kMaxTelnetSubnegotiationLength	8192
+
+// MCCP2 output compression (telnet option 86, not in arpa/telnet.h). The window bits and
+// memory level decide how much each compressed connection costs: about
+// (1 << (MCCP_WINDOW_BITS + 2)) + (1 << (MCCP_MEMORY_LEVEL + 9)) bytes, 64k with these values.
+// MCCP_MEMORY_LIMIT caps all compressors together, in kilobytes, unless the
+// CompressionMemoryLimit config integer says otherwise; 0 turns compression off
+#define TELOPT_COMPRESS2			86
+#define MCCP_COMPRESSION_LEVEL		6
+#define MCCP_WINDOW_BITS			13
+#define MCCP_MEMORY_LEVEL			6
+#define MCCP_STREAM_MEMORY			((1 << (MCCP_WINDOW_BITS + 2)) + (1 << (MCCP_MEMORY_LEVEL + 9)) + 8192)
+#define MCCP_MEMORY_LIMIT			65536
+
+// Clients that wrap text to their own window, by the start of the name they give in their
+// first TTYPE answer. The SelfWrappingClients config string overrides this list
+#define SELF_WRAPPING_CLIENTS		"MUDLET MUSHCLIENT CMUD ZMUD TINTIN++ BLOWTORCH MUDRAMMER BEIP"
+
+// GMCP, JSON messages for client side maps and gauges (telnet option 201, not in arpa/telnet.h)
+#define TELOPT_GMCP					201
 
 //
 // Exit codes
@@ -57,12 +148,35 @@
 // the default value is 3000000, or 3.0 seconds
 #define HEARTBEAT_RESOLUTION 3000000
 
-// how big the host database entry should be in the lookup thread. 256 bytes is usually
-// safe, so 2k ought to be plenty
-#define HOST_BUFFER_LENGTH 2048
-
-// how long of a buffer to use for IP addresses
-#define HOST_IP_LENGTH 32
+// reverse DNS lookups (see Resolver): worker threads, the most lookups that may wait
+// for a worker, and the most addresses cached. Override at run-time with the
+// ResolverThreads, ResolverQueueLength and ResolverCacheSize config integers;
+// 0 threads turns lookups off
+#define RESOLVER_THREADS		2
+#define RESOLVER_QUEUE_LENGTH	256
+#define RESOLVER_CACHE_SIZE		4096
+
+// how long (in seconds) a hostname, and an address without one, stay cached, and how long
+// a lookup may take before the connection gives up on it (ResolverCacheTTL,
+// ResolverNegativeTTL and ResolverTimeout config integers)
+#define RESOLVER_CACHE_TTL		3600
+#define RESOLVER_NEGATIVE_TTL	300
+#define RESOLVER_TIMEOUT		5
+
+// the ban list (see BanMap) is saved once it has gone BAN_SAVE_DELAY seconds without a
+// change, and at most BAN_SAVE_MAX_DELAY seconds after the first unsaved change
+#define BAN_SAVE_DELAY			5
+#define BAN_SAVE_MAX_DELAY		60
+
+// a hot reboot (the hotboot command, see HotReboot) shows players HOT_REBOOT_MESSAGE
+// (HotRebootMessage config string) before the restart and HOT_REBOOT_DONE_MESSAGE
+// (HotRebootDoneMessage) once they are back in their rooms. The program run is the one
+// the server was started as, unless the HotRebootProgram config string names another.
+// The driver thread is given HOT_REBOOT_DRIVER_WAIT seconds to stop reading before the
+// reboot gives up
+#define HOT_REBOOT_DRIVER_WAIT	5
+#define HOT_REBOOT_MESSAGE		"~by0The world holds still for a moment: hot reboot in progress.~res"
+#define HOT_REBOOT_DONE_MESSAGE	"~by0The world moves again. Hot reboot complete.~res"
 
 // separator to use between a listing of conditions or events. This character must not appear
 // in any condition or event name, and should never be ':' either (it's used internally).
@@ -90,6 +204,39 @@
 // do we timestamp log entries?
 #define LOG_STAMP	true
 
+// how many messages a single rate-limited call site may log per interval before the rest
+// are collapsed into a "message repeated N times" summary (see Log::throttle()).
+// Override at run-time with the LogThrottleBurst and LogThrottleInterval config integers.
+#define LOG_THROTTLE_BURST		10
+
+// length of a log throttling interval, in seconds
+#define LOG_THROTTLE_INTERVAL	60
+
+// how long (in milliseconds) the driver or process thread may go without finishing a loop
+// before the Watchdog reports it as stalled. Override at run-time with the WatchdogTimeout
+// config integer; 0 disables the watchdog.
+#define WATCHDOG_TIMEOUT		10000
+
+// how much of the detail (command or zone name) a watched thread gives setActivity() is kept
+#define WATCHDOG_DETAIL_LENGTH	64
+
+// the flight recorder (see TraceRecorder) keeps this many of the most recent spans and
+// events in memory; at roughly 90 bytes each, 32768 events is about 3 MB
+#define TRACE_BUFFER_EVENTS		32768
+
+// how much of each event's detail text (command, file or player name) is kept
+#define TRACE_DETAIL_LENGTH		48
+
+// is the flight recorder on when the MUD starts? Admins can toggle it with the trace command
+#define TRACE_ENABLED			true
+
+// how many seconds of trace a dump covers when no length is given
+#define TRACE_DUMP_SECONDS		30
+
+// count the memory used by rooms, objects, players and messages (see MemoryAccount)?
+// This adds two atomic operations to each of their allocations; false compiles it out.
+#define MEMORY_ACCOUNTING		true
+
 //
 // IO System Settings
 //
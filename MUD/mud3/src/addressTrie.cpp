@@ -0,0 +1,387 @@
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <arpa/inet.h>	// for inet_pton and inet_ntop
+
+#include "addressTrie.h"
+
+/// the first 12 bytes of an IPv4-mapped IPv6 address
+static const unsigned char kMappedPrefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+
+/// Constructor
+/** Creates an empty trie
+*/
+AddressTrie::AddressTrie() {
+	mRoot = -1;
+	mSize = 0;
+}
+
+/// stores a value for a prefix
+/** @param address the network; bits past \a length are ignored
+	@param length the prefix length, 0 to 128
+	@param value what to store, 0 or more
+	\return false if the prefix already has a value, which is left alone
+*/
+bool AddressTrie::insert(const NetworkAddress &address, const unsigned int length, const int value) {
+	if(length > 128 || value < 0) {
+		return false;
+	}
+
+	NetworkAddress key = address;
+	mask(key, length);
+
+	if(mRoot == -1) {
+		mRoot = newNode(key, length, value);
+		++mSize;
+		return true;
+	}
+
+	int node = mRoot;
+	int parent = -1;
+	int side = 0;
+
+	while(true) {
+		// newNode() may move the nodes, so nothing below holds a reference across it
+		unsigned int nodeLength = mNodes[node].length;
+		unsigned int common = commonLength(mNodes[node].prefix, key, nodeLength < length ? nodeLength : length);
+
+		if(common < nodeLength) {
+			// the new prefix parts ways with this node, or sits above it
+			int joined;
+
+			if(common == length) {
+				joined = newNode(key, length, value);
+				mNodes[joined].child[bitAt(mNodes[node].prefix, length)] = node;
+			} else {
+				NetworkAddress split = key;
+				mask(split, common);
+
+				joined = newNode(split, common, -1);
+				int leaf = newNode(key, length, value);
+				mNodes[joined].child[bitAt(key, common)] = leaf;
+				mNodes[joined].child[bitAt(mNodes[node].prefix, common)] = node;
+			}
+
+			if(parent == -1) {
+				mRoot = joined;
+			} else {
+				mNodes[parent].child[side] = joined;
+			}
+
+			++mSize;
+			return true;
+		}
+
+		if(nodeLength == length) {
+			if(mNodes[node].value != -1) {
+				return false;
+			}
+
+			mNodes[node].value = value;
+			++mSize;
+			return true;
+		}
+
+		int bit = bitAt(key, nodeLength);
+		int next = mNodes[node].child[bit];
+
+		if(next == -1) {
+			int leaf = newNode(key, length, value);
+			mNodes[node].child[bit] = leaf;
+			++mSize;
+			return true;
+		}
+
+		parent = node;
+		side = bit;
+		node = next;
+	}
+}
+
+/// removes a prefix's value
+/** Nodes left with no value and fewer than two subtrees are spliced out, so the trie
+	stays as small as if the prefix had never been added.
+	@param address the network
+	@param length the prefix length
+	\return false if the prefix had no value
+*/
+bool AddressTrie::remove(const NetworkAddress &address, const unsigned int length) {
+	if(length > 128) {
+		return false;
+	}
+
+	NetworkAddress key = address;
+	mask(key, length);
+
+	int path[130];
+	int depth = 0;
+	int node = mRoot;
+
+	while(node != -1) {
+		const Node &n = mNodes[node];
+
+		if(n.length > length || !matches(n.prefix, n.length, key)) {
+			return false;
+		}
+
+		if(n.length == length) {
+			break;
+		}
+
+		path[depth++] = node;
+		node = n.child[bitAt(key, n.length)];
+	}
+
+	if(node == -1 || mNodes[node].value == -1) {
+		return false;
+	}
+
+	mNodes[node].value = -1;
+	--mSize;
+
+	// splice out the node, then its parent if that only joined it to one other subtree
+	for(int i = 0; i < 2 && node != -1; ++i) {
+		Node &n = mNodes[node];
+
+		if(n.value != -1 || (n.child[0] != -1 && n.child[1] != -1)) {
+			break;
+		}
+
+		int replacement = n.child[0] != -1 ? n.child[0] : n.child[1];
+		int parent = depth > 0 ? path[--depth] : -1;
+
+		if(parent == -1) {
+			mRoot = replacement;
+		} else {
+			Node &p = mNodes[parent];
+			p.child[p.child[0] == node ? 0 : 1] = replacement;
+		}
+
+		freeNode(node);
+		node = parent;
+	}
+
+	return true;
+}
+
+/// gets the value stored for exactly a prefix
+/** @param address the network
+	@param length the prefix length
+	\return the value, or -1 if there is none
+*/
+int AddressTrie::find(const NetworkAddress &address, const unsigned int length) const {
+	int node = mRoot;
+
+	while(node != -1) {
+		const Node &n = mNodes[node];
+
+		if(n.length > length || !matches(n.prefix, n.length, address)) {
+			return -1;
+		}
+
+		if(n.length == length) {
+			return n.value;
+		}
+
+		node = n.child[bitAt(address, n.length)];
+	}
+
+	return -1;
+}
+
+/// finds the value for the longest stored prefix containing an address
+/** @param address the address to look up
+	@param filter if given, values it turns down are passed over
+	\return the value, or -1 if no prefix contains the address
+*/
+int AddressTrie::longestMatch(const NetworkAddress &address, const Filter *filter) const {
+	int best = -1;
+	int node = mRoot;
+
+	while(node != -1) {
+		const Node &n = mNodes[node];
+
+		if(!matches(n.prefix, n.length, address)) {
+			break;
+		}
+
+		if(n.value != -1 && (filter == NULL || filter->accept(n.value))) {
+			best = n.value;
+		}
+
+		if(n.length == 128) {
+			break;
+		}
+
+		node = n.child[bitAt(address, n.length)];
+	}
+
+	return best;
+}
+
+/// removes every prefix
+void AddressTrie::clear() {
+	mNodes.clear();
+	mFreeNodes.clear();
+	mRoot = -1;
+	mSize = 0;
+}
+
+/// reads an address or network in text form
+/** Accepts "a.b.c.d", "a.b.c.d/n", IPv6 in any form inet_pton() takes, and IPv6 with
+	"/n". An address without a length is a single host.
+	@param text the address
+	@param[out] address the address, IPv4 mapped into IPv6
+	@param[out] length the prefix length, in IPv6 terms
+	\return false if \a text isn't an address
+*/
+bool AddressTrie::parse(const std::string &text, NetworkAddress &address, unsigned int &length) {
+	std::string::size_type slash = text.find('/');
+	std::string host = text.substr(0, slash);
+	long bits = -1;
+
+	if(slash != std::string::npos) {
+		std::string lengthText = text.substr(slash + 1);
+
+		if(lengthText.empty() || lengthText.size() > 3 || lengthText.find_first_not_of("0123456789") != std::string::npos) {
+			return false;
+		}
+
+		bits = atol(lengthText.c_str());
+	}
+
+	unsigned char v4[4];
+
+	if(inet_pton(AF_INET, host.c_str(), v4) == 1) {
+		if(bits > 32) {
+			return false;
+		}
+
+		memcpy(address.bytes, kMappedPrefix, sizeof(kMappedPrefix));
+		memcpy(address.bytes + 12, v4, 4);
+		length = 96 + (bits < 0 ? 32 : bits);
+		return true;
+	}
+
+	if(inet_pton(AF_INET6, host.c_str(), address.bytes) == 1) {
+		if(bits > 128) {
+			return false;
+		}
+
+		length = bits < 0 ? 128 : bits;
+		return true;
+	}
+
+	return false;
+}
+
+/// writes a network in its usual text form
+/** IPv4 networks are written as IPv4, and single hosts without a length, so an
+	IPv4 host comes out exactly as the old ban list wrote it.
+	@param address the network
+	@param length the prefix length, in IPv6 terms
+	\return the text
+*/
+std::string AddressTrie::format(const NetworkAddress &address, const unsigned int length) {
+	char text[INET6_ADDRSTRLEN];
+	std::ostringstream s;
+
+	if(length >= 96 && memcmp(address.bytes, kMappedPrefix, sizeof(kMappedPrefix)) == 0) {
+		inet_ntop(AF_INET, address.bytes + 12, text, sizeof(text));
+		s << text;
+
+		if(length < 128) {
+			s << "/" << length - 96;
+		}
+	} else {
+		inet_ntop(AF_INET6, address.bytes, text, sizeof(text));
+		s << text;
+
+		if(length < 128) {
+			s << "/" << length;
+		}
+	}
+
+	return s.str();
+}
+
+/// clears the bits of an address past a prefix length
+void AddressTrie::mask(NetworkAddress &address, const unsigned int length) {
+	for(unsigned int byte = 0; byte < 16; ++byte) {
+		unsigned int start = byte * 8;
+
+		if(start >= length) {
+			address.bytes[byte] = 0;
+		} else if(start + 8 > length) {
+			address.bytes[byte] &= static_cast<unsigned char>(0xff << (8 - (length - start)));
+		}
+	}
+}
+
+/// takes a node from the free list, or adds one
+int AddressTrie::newNode(const NetworkAddress &prefix, const unsigned int length, const int value) {
+	int index;
+
+	if(mFreeNodes.empty()) {
+		index = mNodes.size();
+		mNodes.push_back(Node());
+	} else {
+		index = mFreeNodes.back();
+		mFreeNodes.pop_back();
+	}
+
+	Node &node = mNodes[index];
+	node.prefix = prefix;
+	node.length = length;
+	node.child[0] = -1;
+	node.child[1] = -1;
+	node.value = value;
+	return index;
+}
+
+/// puts a node on the free list
+void AddressTrie::freeNode(const int node) {
+	mFreeNodes.push_back(node);
+}
+
+/// counts the leading bits two addresses share
+/** @param a one address
+	@param b the other
+	@param limit the most bits to compare
+	\return the shared bits, at most \a limit
+*/
+unsigned int AddressTrie::commonLength(const NetworkAddress &a, const NetworkAddress &b, const unsigned int limit) {
+	unsigned int bits = 0;
+
+	for(unsigned int byte = 0; byte < 16 && bits < limit; ++byte, bits += 8) {
+		unsigned int difference = a.bytes[byte] ^ b.bytes[byte];
+
+		if(difference != 0) {
+			// the leading zeros of the byte are the bits that still match
+			bits += __builtin_clz(difference) - (sizeof(unsigned int) * 8 - 8);
+			break;
+		}
+	}
+
+	return bits < limit ? bits : limit;
+}
+
+/// checks whether an address lies inside a prefix
+bool AddressTrie::matches(const NetworkAddress &prefix, const unsigned int length, const NetworkAddress &address) {
+	unsigned int whole = length >> 3;
+
+	if(memcmp(prefix.bytes, address.bytes, whole) != 0) {
+		return false;
+	}
+
+	unsigned int rest = length & 7;
+
+	if(rest == 0) {
+		return true;
+	}
+
+	unsigned char bits = static_cast<unsigned char>(0xff << (8 - rest));
+	return (prefix.bytes[whole] & bits) == (address.bytes[whole] & bits);
+}
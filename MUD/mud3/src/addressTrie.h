@@ -0,0 +1,86 @@
+#ifndef MUD_ADDRESS_TRIE_H
+#define MUD_ADDRESS_TRIE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/// an IPv4 or IPv6 address as 128 bits
+/** IPv4 addresses are held IPv4-mapped (::ffff:a.b.c.d), so one trie covers both
+	families and an IPv4 /n is a /96+n.
+*/
+struct NetworkAddress {
+	unsigned char bytes[16];	///< the address, most significant byte first
+};
+
+/// Maps network prefixes to values and finds the longest prefix matching an address
+/** This is a path-compressed binary radix trie: every node holds a prefix, and only
+	nodes where two prefixes part ways or where a value is stored exist, so it holds N
+	prefixes in fewer than 2N nodes. A lookup visits at most one node per bit of the
+	longest stored prefix, and compares each node's prefix a byte at a time, so it costs
+	O(prefix length) whatever the number of prefixes.
+
+	Nodes live in one vector and refer to each other by index, and removed nodes are
+	reused, so a large list costs a few allocations rather than one per node.
+	\note Not thread safe; BanMap locks around it.
+*/
+class AddressTrie {
+public:
+	/// decides whether a stored value may answer a lookup
+	/** longestMatch() skips values the filter turns down and falls back to shorter
+		prefixes, which is how expired bans stop shadowing the ranges around them.
+	*/
+	class Filter {
+	public:
+		virtual ~Filter() {}
+
+		/// \return true if \a value counts as a match
+		virtual bool accept(const int value) const = 0;
+	};
+
+	AddressTrie();
+
+	bool insert(const NetworkAddress &address, const unsigned int length, const int value);
+	bool remove(const NetworkAddress &address, const unsigned int length);
+	int find(const NetworkAddress &address, const unsigned int length) const;
+	int longestMatch(const NetworkAddress &address, const Filter *filter = NULL) const;
+
+	void clear();
+
+	/// gets how many prefixes are stored
+	unsigned long size() const { return mSize; }
+
+	/// gets how many nodes are in use, for judging memory use
+	unsigned long getNodeCount() const { return mNodes.size() - mFreeNodes.size(); }
+
+	static bool parse(const std::string &text, NetworkAddress &address, unsigned int &length);
+	static std::string format(const NetworkAddress &address, const unsigned int length);
+	static void mask(NetworkAddress &address, const unsigned int length);
+
+private:
+	/// one node: a prefix, and a value if one is stored at exactly this prefix
+	struct Node {
+		NetworkAddress prefix;	///< the prefix, with the bits past length cleared
+		unsigned int length;	///< prefix length in bits, 0 to 128
+		int child[2];			///< the subtrees whose next bit is 0 and 1, or -1
+		int value;				///< the stored value, or -1 for a node that only joins two subtrees
+	};
+
+	std::vector<Node> mNodes;		///< every node, used or free
+	std::vector<int> mFreeNodes;	///< indexes of unused nodes
+	int mRoot;						///< the top node, or -1 when empty
+	unsigned long mSize;			///< prefixes stored
+
+	int newNode(const NetworkAddress &prefix, const unsigned int length, const int value);
+	void freeNode(const int node);
+
+	static unsigned int commonLength(const NetworkAddress &a, const NetworkAddress &b, const unsigned int limit);
+	static bool matches(const NetworkAddress &prefix, const unsigned int length, const NetworkAddress &address);
+
+	/// gets bit \a bit of an address, counting from the most significant
+	static int bitAt(const NetworkAddress &address, const unsigned int bit) {
+		return (address.bytes[bit >> 3] >> (7 - (bit & 7))) & 1;
+	}
+};
+
+#endif // MUD_ADDRESS_TRIE_H
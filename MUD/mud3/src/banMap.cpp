@@ -8,24 +8,51 @@
 #include "global.h"
 extern Global glob;
 
+/// lets only unexpired bans answer a lookup
+/** An expired ban is passed over rather than ending the search, so a lapsed /32 inside
+	a banned /16 doesn't let the address through before heartbeat() purges it.
+*/
+class UnexpiredBanFilter : public AddressTrie::Filter {
+public:
+	UnexpiredBanFilter(const std::vector<BanEntry> &entries, const time_t now) : mEntries(entries), mNow(now) {}
+
+	bool accept(const int value) const {
+		time_t expires = mEntries[value].expires;
+		return expires == 0 || expires > mNow;
+	}
+
+private:
+	const std::vector<BanEntry> &mEntries;	///< the bans the trie indexes
+	time_t mNow;							///< the time to judge expiry by
+};
+
 /// Constructor
 /** The constructor defines our banmap data resource and loads it into the class. */
-BanMap::BanMap() {
+BanMap::BanMap() : mBusy("BanMap") {
 	mResloc.type = DataObject;
 	mResloc.name = "banmap.yaml";
+	mDirtySince = 0;
+	mChangedAt = 0;
+	mChanges = 0;
 	load();
 }
 
 /// Destructor
-/** The destructor just saves the current ban list. */
+/** The destructor saves any changes heartbeat() hasn't saved yet. */
 BanMap::~BanMap() {
-	save();
+	if(mDirtySince != 0) {
+		save();
+	}
 }
 
 /// Function for retrieving stored data to populate the ban map with
 /** This function gets the banmap resource, discards comments, and adds
 	valid ban records to the internal data structure. It got a lot simpler after adding
 	the Utility namespace. Then it got manageable when I converted it to use YAML.
+
+	An entry's value is either the reason, for a permanent ban, or a map with a
+	\c Reason and an \c Expires time in seconds since the epoch. Bans that have
+	already expired are dropped.
 */
 void BanMap::load() {
 	std::string banData = glob.ioDaemon.getResource(mResloc);
@@ -35,6 +62,12 @@ void BanMap::load() {
 	}
 
 	std::istringstream is(banData);
+	time_t now = time(NULL);
+
+	if(!mBusy.lock()) {
+		glob.log.error("BanMap::load(): Could not lock the ban list");
+		return;
+	}
 
 	try {
 		YAML::Parser parser(is);
@@ -42,16 +75,42 @@ void BanMap::load() {
 		parser.GetNextDocument(doc);
 		const YAML::Node &node = doc["BannedIPs"];
 
-		std::string key, value;
-
 		for(YAML::Iterator it = node.begin(); it != node.end(); ++it) {
-			it.first() >> key;
-			it.second() >> value;
+			BanEntry entry;
+			entry.expires = 0;
+			it.first() >> entry.network;
+
+			if(it.second().GetType() == YAML::CT_MAP) {
+				long expires = 0;
+				it.second()["Reason"] >> entry.reason;
+
+				if(const YAML::Node *value = it.second().FindValue("Expires")) {
+					*value >> expires;
+				}
 
-			if(!mBannedList.insert(std::make_pair(key, value)).second) {
-				glob.log.error(boost::format("BanMap::load: Failed to add ban for %1% on %2%") % key % value);
+				entry.expires = expires;
 			} else {
-				glob.log.debug(boost::format("BanMap::load: Loaded ban for %1% on %2%") % key % value);
+				it.second() >> entry.reason;
+			}
+
+			if(entry.expires != 0 && entry.expires <= now) {
+				glob.log.info(boost::format("BanMap::load: Dropped expired ban on %1%") % entry.network);
+				markDirty();
+			} else if(!AddressTrie::parse(entry.network, entry.address, entry.length)) {
+				glob.log.error(boost::format("BanMap::load: %1% is not an IP address or network, ignoring its ban") % entry.network);
+			} else {
+				std::string written = entry.network;
+
+				if(!canonicalize(entry)) {
+					glob.log.info(boost::format("BanMap::load: Ban on %1% is stored as %2%") % written % entry.network);
+					markDirty();
+				}
+
+				if(mIndex.count(entry.network) != 0 || !add(entry)) {
+					glob.log.error(boost::format("BanMap::load: Failed to add ban for %1% on %2%") % entry.network % entry.reason);
+				} else {
+					glob.log.debug(boost::format("BanMap::load: Loaded ban for %1% on %2%") % entry.network % entry.reason);
+				}
 			}
 		}
 	} catch(YAML::ParserException &e) {
@@ -67,11 +126,17 @@ void BanMap::load() {
 	} catch(...) {
 		glob.log.error("Generic exception caught");
 	}
+
+	mBusy.unlock();
 }
 
 /// Function for storing data currently in memory to permanent storage location
-/** This function writes out the banned client information to preserve between reboots. */
-void BanMap::save() const {
+/** This function writes out the banned client information to preserve between reboots.
+	The list is copied out under the lock and written without it, so connections
+	aren't held up by the disk. The list stays marked as changed until the write
+	succeeds, so heartbeat() tries again after a failure.
+*/
+void BanMap::save() {
 	YAML::Emitter out;
 	out << YAML::BeginMap;
 
@@ -80,99 +145,192 @@ void BanMap::save() const {
 
 	out << "Any offline modifications you make to the banned list will be preserved,";
 	out << "but any additional comments will be deleted for your convenience.";
-	out << "Entries are IP address, ': ', and a reason. For example:";
+	out << "Entries are an IP address or CIDR network, ': ', and a reason. For example:";
 	out << "10.0.0.1: Banned for being stupid";
+	out << "192.168.0.0/16: Banned for being stupid from a whole ISP";
+	out << "A ban that lifts is written with a Reason and an Expires time in seconds since 1970.";
 
 	out << YAML::EndSeq;
 
 	out << YAML::Key << "BannedIPs" << YAML::Value;
-	out << YAML::BeginMap;
 
-	if(mBannedList.size() > 0) {
-		for(StringMap::const_iterator it = mBannedList.begin(); it != mBannedList.end(); ++it) {
-			out << YAML::Key << it->first << YAML::Value << it->second;
-		}
+	if(!mBusy.lock()) {
+		glob.log.error("BanMap::save(): Could not lock the ban list");
+		return;
+	}
+
+	if(mIndex.empty()) {
+		out << YAML::Null;
 	} else {
-		out << YAML::Value << YAML::Null;
+		out << YAML::BeginMap;
+
+		for(BanIndex::const_iterator it = mIndex.begin(); it != mIndex.end(); ++it) {
+			const BanEntry &entry = mEntries[it->second];
+			out << YAML::Key << entry.network << YAML::Value;
+
+			if(entry.expires == 0) {
+				out << entry.reason;
+			} else {
+				out << YAML::BeginMap;
+				out << YAML::Key << "Reason" << YAML::Value << entry.reason;
+				out << YAML::Key << "Expires" << YAML::Value << static_cast<long>(entry.expires);
+				out << YAML::EndMap;
+			}
+		}
+
+		out << YAML::EndMap; // BannedIPs
 	}
 
-	out << YAML::EndMap; // BannedIPs
+	// how many changes this copy includes
+	unsigned long copiedChanges = mChanges;
+	mBusy.unlock();
 
 	out << YAML::EndMap;
 
 	if(!out.good()) {
 		glob.log.error(boost::format("BanMap::save(): YAML Emitter is in a bad state: %1%") % out.GetLastError());
-	} else {
-		if(!glob.ioDaemon.saveResource(mResloc, out.c_str())) {
-			glob.log.error("BanMap::save: failed to save the ban map");
+		return;
+	}
+
+	if(!glob.ioDaemon.saveResource(mResloc, out.c_str())) {
+		glob.log.error("BanMap::save: failed to save the ban map");
+		return;
+	}
+
+	// a change made while the file was written still needs saving
+	if(mBusy.lock()) {
+		if(mChanges == copiedChanges) {
+			mDirtySince = 0;
 		}
+
+		mBusy.unlock();
 	}
 }
 
-/// Adds an IP and a reason to the banned IP list
-/** This function first checks to see if a ban already exists on the IP,
+/// Adds an address or network and a reason to the banned list
+/** This function first checks to see if a ban already exists on the network,
 	and if so sets the error message and returns false. If not, it adds an
-	entry for the IP and attempts to write the changed data.
-	@param ip The IP address to ban
-	@param reason An optional reason the IP address is banned
-	\return true if the IP address is banned
-	\note If a connection comes from a banned IP, the user will be shown the reason
+	entry for the network; heartbeat() saves it shortly after.
+	@param network The IP address or CIDR network to ban, IPv4 or IPv6
+	@param reason An optional reason the network is banned
+	@param expires when the ban lifts, or 0 for never
+	\return true if the network is banned
+	\note If a connection comes from a banned network, the user will be shown the reason
 			if there is one, and the server will disconnect the socket.
 */
-bool BanMap::ban(const std::string &ip, const std::string &reason) {
+bool BanMap::ban(const std::string &network, const std::string &reason, const time_t expires) {
+	BanEntry entry;
+
+	if(!AddressTrie::parse(network, entry.address, entry.length)) {
+		setErrorMessage(boost::str(boost::format("%1% is not an IP address or network") % network));
+		return false;
+	}
+
+	canonicalize(entry);
+	entry.reason = reason;
+	entry.expires = expires;
+
+	if(!mBusy.lock()) {
+		setErrorMessage("Could not lock the ban list");
+		return false;
+	}
+
 	bool status = false;
+	BanIndex::iterator pos = mIndex.find(entry.network);
 
-	StringMap::const_iterator pos = mBannedList.find(ip);
-	if(pos != mBannedList.end()) {
+	if(pos != mIndex.end() && (mEntries[pos->second].expires == 0 || mEntries[pos->second].expires > time(NULL))) {
 		// this is a duplicate ban!
-		setErrorMessage(boost::str(boost::format("Duplicate ban on %1% detected. Original reason is %2%") % ip % pos->second));
+		setErrorMessage(boost::str(boost::format("Duplicate ban on %1% detected. Original reason is %2%") % entry.network % mEntries[pos->second].reason));
 	} else {
-		mBannedList[ip] = reason;
-		save();
-		status = true;
+		// an expired ban that heartbeat() hasn't purged yet is simply replaced
+		if(pos != mIndex.end()) {
+			erase(pos);
+		}
+
+		status = add(entry);
+		markDirty();
 	}
 
+	mBusy.unlock();
 	return status;
 }
 
-/// Removes a ban from an IP address
-/** This function removes an IP address from the banned list and logs an error
-	message if unable to do so (probably because the IP address isn't really
-	in the list).
+/// Removes a ban from an address or network
+/** This function removes an address or network from the banned list and logs an error
+	message if unable to do so (probably because it isn't really in the list). Only
+	the ban on exactly that network is lifted; to let one address out of a banned
+	range, the range has to be lifted.
 
-	@param ip The IP address that should be removed from the ban list
+	@param network The IP address or network that should be removed from the ban list
 	\return true if the ban could be removed
-	\note This function should only return false if the IP was not in the ban list.
+	\note This function should only return false if the network was not in the ban list.
 */
-bool BanMap::removeBan(const std::string &ip) {
+bool BanMap::removeBan(const std::string &network) {
+	NetworkAddress address;
+	unsigned int length;
+	std::string key = network;
+
+	if(AddressTrie::parse(network, address, length)) {
+		AddressTrie::mask(address, length);
+		key = AddressTrie::format(address, length);
+	}
+
+	if(!mBusy.lock()) {
+		setErrorMessage("Could not lock the ban list");
+		return false;
+	}
+
 	bool status = false;
-	StringMap::iterator pos = mBannedList.find(ip);
-	if(pos != mBannedList.end()) {
+	BanIndex::iterator pos = mIndex.find(key);
+
+	if(pos != mIndex.end()) {
 		// found the match to remove
-		mBannedList.erase(pos);
-		save();
+		erase(pos);
+		markDirty();
 		status = true;
 	} else {
-		setErrorMessage(boost::str(boost::format("The specified IP address %1% is not on the banned clients list!") % ip));
+		setErrorMessage(boost::str(boost::format("The specified address %1% is not on the banned clients list!") % network));
 	}
 
+	mBusy.unlock();
 	return status;
 }
 
 /// Simple check to see if an IP address is banned
-/** This function checks the list in memory for a matching IP, returns true
-	if a ban is in place.
+/** This function checks the bans in memory for one covering the address.
 
 	@param ip an IP address to check against
-	\return true if the IP is in the ban list and should be blocked
+	\return true if the IP is in a banned network and should be blocked
 */
 bool BanMap::isBanned(const std::string &ip) const {
-	StringMap::const_iterator pos = mBannedList.find(ip);
-	if(pos != mBannedList.end()) {
-		return true;
-	} else {
+	std::string reason;
+	return isBanned(ip, reason);
+}
+
+/// Checks whether an IP address is banned, and why
+/** This is the check made for every accepted connection, so the address is looked up
+	once, and the narrowest unexpired ban covering it gives the reason.
+
+	@param ip an IPv4 or IPv6 address
+	@param[out] reason why the address is banned, if it is
+	\return true if the IP is in a banned network and should be blocked
+*/
+bool BanMap::isBanned(const std::string &ip, std::string &reason) const {
+	if(!mBusy.lock()) {
 		return false;
 	}
+
+	int index = match(ip);
+
+	if(index != -1) {
+		reason = mEntries[index].reason;
+		if(reason.empty()) {
+			reason = "Reason Not Specified";
+		}
+	}
+
+	mBusy.unlock();
+	return index != -1;
 }
 
 /// Returns the reason why an IP address is banned
@@ -185,29 +343,177 @@ bool BanMap::isBanned(const std::string &ip) const {
 	\return the reason the address was banned (\e not required)
 */
 std::string BanMap::getBannedReason(const std::string &ip) const {
-	StringMap::const_iterator pos = mBannedList.find(ip);
 	std::string reason;
-
-	if(pos != mBannedList.end()) {
-		reason = pos->second;
-		if(reason.empty()) {
-			reason = "Reason Not Specified";
-		}
-	}
-
+	isBanned(ip, reason);
 	return reason;
 }
 
 /// Generates a list of all banned users and why
-/** This function iterates through the banned list to show all banned IP addresses
-	and the reason they've been banned.
+/** This function iterates through the banned list to show all banned addresses
+	and networks, the reason they've been banned, and when temporary bans lift.
 
 	\return an END-delimited string of addresses and reasons
 */
 std::string BanMap::listBannedUsers() const {
 	std::stringstream s;
-	for(StringMap::const_iterator pos = mBannedList.begin(); pos != mBannedList.end(); ++pos) {
-		s << pos->first << " Reason: " << pos->second << END;
+	time_t now = time(NULL);
+
+	if(!mBusy.lock()) {
+		return s.str();
+	}
+
+	for(BanIndex::const_iterator pos = mIndex.begin(); pos != mIndex.end(); ++pos) {
+		const BanEntry &entry = mEntries[pos->second];
+
+		if(entry.expires != 0 && entry.expires <= now) {
+			continue;
+		}
+
+		s << entry.network << " Reason: " << entry.reason;
+
+		if(entry.expires != 0) {
+			long minutes = (entry.expires - now + 59) / 60;
+			s << boost::format(" (lifts in %1%h %2%m)") % (minutes / 60) % (minutes % 60);
+		}
+
+		s << END;
 	}
+
+	mBusy.unlock();
 	return s.str();
 }
+
+/// purges expired bans and saves the list once changes have settled
+/** This function is called from heartbeat() in thread_functions.cpp. Saving waits for
+	BAN_SAVE_DELAY quiet seconds, so a burst of bans is written once, but never more
+	than BAN_SAVE_MAX_DELAY seconds.
+*/
+void BanMap::heartbeat() {
+	time_t now = time(NULL);
+
+	if(!mBusy.lock()) {
+		return;
+	}
+
+	purgeExpired(now);
+
+	bool due = mDirtySince != 0 && (now - mChangedAt >= BAN_SAVE_DELAY || now - mDirtySince >= BAN_SAVE_MAX_DELAY);
+
+	mBusy.unlock();
+
+	if(due) {
+		save();
+	}
+}
+
+/// stores a ban; the caller holds mBusy and has checked for duplicates
+bool BanMap::add(const BanEntry &entry) {
+	int index;
+
+	if(mFreeEntries.empty()) {
+		index = mEntries.size();
+		mEntries.push_back(entry);
+	} else {
+		index = mFreeEntries.back();
+		mFreeEntries.pop_back();
+		mEntries[index] = entry;
+	}
+
+	if(!mTrie.insert(entry.address, entry.length, index)) {
+		// two spellings of one network, such as 10.0.0.1 and ::ffff:10.0.0.1
+		mFreeEntries.push_back(index);
+		return false;
+	}
+
+	mIndex[entry.network] = index;
+
+	if(entry.expires != 0) {
+		mExpiries.insert(ExpiryIndex::value_type(entry.expires, entry.network));
+	}
+
+	return true;
+}
+
+/// lifts a ban; the caller holds mBusy
+void BanMap::erase(BanIndex::iterator pos) {
+	BanEntry &entry = mEntries[pos->second];
+
+	if(entry.expires != 0) {
+		std::pair<ExpiryIndex::iterator, ExpiryIndex::iterator> range = mExpiries.equal_range(entry.expires);
+
+		for(ExpiryIndex::iterator it = range.first; it != range.second; ++it) {
+			if(it->second == entry.network) {
+				mExpiries.erase(it);
+				break;
+			}
+		}
+	}
+
+	mTrie.remove(entry.address, entry.length);
+	entry.network.clear();
+	entry.reason.clear();
+	mFreeEntries.push_back(pos->second);
+	mIndex.erase(pos);
+}
+
+/// rewrites a ban's network in the form the list is indexed by
+/** Host bits past the prefix are cleared, so 10.1.2.3/16 is stored as 10.1.0.0/16.
+	\return false if that changed how the network is written
+*/
+bool BanMap::canonicalize(BanEntry &entry) {
+	AddressTrie::mask(entry.address, entry.length);
+	std::string network = AddressTrie::format(entry.address, entry.length);
+
+	if(network == entry.network) {
+		return true;
+	}
+
+	entry.network = network;
+	return false;
+}
+
+/// notes an unsaved change; the caller holds mBusy
+void BanMap::markDirty() {
+	++mChanges;
+	mChangedAt = time(NULL);
+
+	if(mDirtySince == 0) {
+		mDirtySince = mChangedAt;
+	}
+}
+
+/// lifts every ban that has expired; the caller holds mBusy
+/** Only the bans at the front of mExpiries are looked at, so a heartbeat with nothing
+	due costs the same however long the list is.
+*/
+void BanMap::purgeExpired(const time_t now) {
+	while(!mExpiries.empty() && mExpiries.begin()->first <= now) {
+		BanIndex::iterator pos = mIndex.find(mExpiries.begin()->second);
+
+		if(pos == mIndex.end() || mEntries[pos->second].expires != mExpiries.begin()->first) {
+			// stale, which erase() and add() shouldn't allow
+			mExpiries.erase(mExpiries.begin());
+			continue;
+		}
+
+		glob.log.info(boost::format("BanMap: Ban on %1% expired") % pos->first);
+
+		// erase() takes the ban out of mExpiries as well
+		erase(pos);
+		markDirty();
+	}
+}
+
+/// finds the narrowest unexpired ban covering an address; the caller holds mBusy
+/** \return the ban's index, or -1 if the address isn't banned or isn't an address */
+int BanMap::match(const std::string &ip) const {
+	NetworkAddress address;
+	unsigned int length;
+
+	if(mTrie.size() == 0 || !AddressTrie::parse(ip, address, length)) {
+		return -1;
+	}
+
+	UnexpiredBanFilter filter(mEntries, time(NULL));
+	return mTrie.longestMatch(address, &filter);
+}
@@ -3,13 +3,33 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <ctime>
 
 #include "mudconfig.h"
+#include "mutex.h"
+#include "addressTrie.h"
+
+/// one ban: an address or network, why, and until when
+struct BanEntry {
+	std::string network;		///< the address or network as the ban list writes it, e.g. 10.0.0.0/8
+	std::string reason;			///< what a banned client is told
+	time_t expires;				///< when the ban lifts, or 0 if it never does
+	NetworkAddress address;		///< the network, for removing it from the trie
+	unsigned int length;		///< the prefix length, in IPv6 terms
+};
 
 /// A class for handling banned IP addresses
-/** This class does all the work regarding banning IP addresses
-	from connecting to the mud. It also loads and saves its state
-	every time a change is made.
+/** This class does all the work regarding banning IP addresses and networks from
+	connecting to the mud. Bans may name a single IPv4 or IPv6 address or a CIDR
+	network (10.1.0.0/16, 2001:db8::/32), and may expire.
+
+	Checks are answered from an AddressTrie held in memory, so isBanned() costs the
+	same for a list of ten entries or a hundred thousand. Changes are saved by
+	heartbeat() once the list has been quiet for BAN_SAVE_DELAY seconds, or at most
+	BAN_SAVE_MAX_DELAY seconds after the first unsaved change, rather than rewriting
+	the file for every ban; the destructor saves anything still pending. Bans that lift
+	are also kept in order of expiry, so heartbeat() only looks at the ones that are due.
 */
 class BanMap {
 public:
@@ -20,24 +40,49 @@ public:
 	std::string getErrorMessage() { return mErrorMessage; }
 
 	void load();
-	void save() const;
+	void save();
 
-	bool ban(const std::string &ip, const std::string &reason);
-	bool removeBan(const std::string &ip);
+	bool ban(const std::string &network, const std::string &reason, const time_t expires = 0);
+	bool removeBan(const std::string &network);
 
 	bool isBanned(const std::string &ip) const;
+	bool isBanned(const std::string &ip, std::string &reason) const;
 	std::string getBannedReason(const std::string &ip) const;
 
 	std::string listBannedUsers() const;
 
+	void heartbeat();
+
+	/// gets how many bans are in force or waiting to be purged
+	unsigned long size() const { return mTrie.size(); }
+
 private:
+	typedef std::map<std::string, int> BanIndex;
+	typedef std::multimap<time_t, std::string> ExpiryIndex;
+
 	IOResourceLocator mResloc;	///< A struct that holds the resource type and name for file I/O
 	std::string mErrorMessage;	///< Stores a description of what went wrong
 
 	/// A private function to store an error message locally
 	void setErrorMessage(const std::string &msg) { mErrorMessage = msg; }
 
-	StringMap mBannedList;	///< Mapping of Banned IPs to Reasons
+	mutable Mutex mBusy;			///< guards everything below; bans are checked on the driver thread
+	std::vector<BanEntry> mEntries;	///< every ban, by the index the trie stores
+	std::vector<int> mFreeEntries;	///< indexes of lifted bans, for reuse
+	BanIndex mIndex;				///< the index of each ban, by its network text
+	AddressTrie mTrie;				///< finds the longest banned network holding an address
+	ExpiryIndex mExpiries;			///< the network of each ban that lifts, by when it lifts
+
+	time_t mDirtySince;		///< when the first unsaved change was made, or 0 if there is none
+	time_t mChangedAt;		///< when the last unsaved change was made
+	unsigned long mChanges;	///< counts changes, so save() can tell if one came in while it wrote
+
+	bool add(const BanEntry &entry);
+	void erase(BanIndex::iterator pos);
+	static bool canonicalize(BanEntry &entry);
+	void markDirty();
+	void purgeExpired(const time_t now);
+	int match(const std::string &ip) const;
 };
 
 #endif // MUD_BANMAP_H
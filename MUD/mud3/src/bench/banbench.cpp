@@ -0,0 +1,315 @@
+/** @file
+	banbench: lookup benchmarks for the ban list.
+
+	Every accepted connection is checked against the ban list before anything else is
+	done with it, so a long list must not slow the accept path. BanMap answers from an
+	AddressTrie; this program fills a trie with a list like a large public blocklist
+	(IPv4 hosts, /24s and /16s, and IPv6 /64s and /48s) and times lookups that hit a ban
+	and lookups that don't, for each family, plus the text parse that BanMap::isBanned()
+	does first. For comparison it also times an exact match on address strings in a
+	std::map, which is how bans used to be stored and which can't match a network at all.
+
+	The trie is used directly rather than through a BanMap, since a BanMap saves itself
+	to data/banmap.yaml and the benchmark must not touch the real ban list.
+
+	Every result is printed as \c key \c value lines, for example
+	\c v4_hit_ns_per_op, along with \c trie_entries, \c trie_nodes and
+	\c trie_insert_ns_per_entry for the list itself. Run <tt>banbench -?</tt> for options.
+*/
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "addressTrie.h"
+#include "benchmark.h"
+#include "timer.h"
+
+/// how many addresses each lookup case cycles through
+static const unsigned int kQueries = 4096;
+
+/// a random byte
+static unsigned char randomByte() {
+	return static_cast<unsigned char>(rand() % 256);
+}
+
+/// a random IPv4 address with a first octet from \a low to \a high, IPv4-mapped
+static NetworkAddress randomV4(const int low, const int high) {
+	NetworkAddress address;
+	unsigned int length;
+	AddressTrie::parse("0.0.0.0", address, length);
+
+	address.bytes[12] = static_cast<unsigned char>(low + rand() % (high - low + 1));
+	for(int i = 13; i < 16; ++i) {
+		address.bytes[i] = randomByte();
+	}
+
+	return address;
+}
+
+/// a random IPv6 address under the two bytes \a first and \a second
+static NetworkAddress randomV6(const unsigned char first, const unsigned char second) {
+	NetworkAddress address;
+	address.bytes[0] = first;
+	address.bytes[1] = second;
+
+	for(int i = 2; i < 16; ++i) {
+		address.bytes[i] = randomByte();
+	}
+
+	return address;
+}
+
+/// a random address inside a network
+static NetworkAddress randomInside(const NetworkAddress &network, const unsigned int length) {
+	NetworkAddress address = network;
+
+	for(unsigned int bit = length; bit < 128; ++bit) {
+		if(rand() % 2) {
+			address.bytes[bit >> 3] |= static_cast<unsigned char>(0x80 >> (bit & 7));
+		}
+	}
+
+	return address;
+}
+
+/// the ban list under test
+typedef struct {
+	AddressTrie trie;							///< every network
+	std::vector<NetworkAddress> v4Networks;		///< the IPv4 networks, for picking hits
+	std::vector<unsigned int> v4Lengths;		///< their prefix lengths
+	std::vector<NetworkAddress> v6Networks;		///< the IPv6 networks
+	std::vector<unsigned int> v6Lengths;		///< their prefix lengths
+	std::map<std::string, std::string> hosts;	///< the IPv4 hosts as text, as the old BanMap stored them
+} BanList;
+
+/// fills \a list with \a entries networks: 40% IPv4 hosts, 25% /24s, 5% /16s, 20% IPv6 /64s and 10% /48s
+/** IPv4 bans all start 1 to 100, and IPv6 bans 2001:db8, so misses can be drawn
+	from ranges no ban covers.
+	\return the seconds spent inserting
+*/
+static double buildList(BanList &list, const unsigned int entries) {
+	std::vector<NetworkAddress> networks;
+	std::vector<unsigned int> lengths;
+
+	for(unsigned int i = 0; i < entries; ++i) {
+		int kind = rand() % 20;
+		unsigned int length;
+		NetworkAddress network;
+
+		if(kind < 8) {
+			network = randomV4(1, 100);
+			length = 128;
+		} else if(kind < 13) {
+			network = randomV4(1, 100);
+			length = 120;
+		} else if(kind < 14) {
+			network = randomV4(1, 100);
+			length = 112;
+		} else if(kind < 18) {
+			network = randomV6(0x20, 0x01);
+			network.bytes[2] = 0x0d;
+			network.bytes[3] = 0xb8;
+			length = 64;
+		} else {
+			network = randomV6(0x20, 0x01);
+			network.bytes[2] = 0x0d;
+			network.bytes[3] = 0xb8;
+			length = 48;
+		}
+
+		AddressTrie::mask(network, length);
+		networks.push_back(network);
+		lengths.push_back(length);
+	}
+
+	Timer timer;
+
+	for(unsigned int i = 0; i < networks.size(); ++i) {
+		list.trie.insert(networks[i], lengths[i], i);
+	}
+
+	double seconds = timer.elapsed() / 1000000.0;
+
+	for(unsigned int i = 0; i < networks.size(); ++i) {
+		if(lengths[i] >= 96 && networks[i].bytes[0] == 0 && networks[i].bytes[10] == 0xff) {
+			list.v4Networks.push_back(networks[i]);
+			list.v4Lengths.push_back(lengths[i]);
+
+			if(lengths[i] == 128) {
+				list.hosts[AddressTrie::format(networks[i], 128)] = "benchmark";
+			}
+		} else {
+			list.v6Networks.push_back(networks[i]);
+			list.v6Lengths.push_back(lengths[i]);
+		}
+	}
+
+	return seconds;
+}
+
+/// times AddressTrie::longestMatch() over a set of addresses
+class MatchCase : public BenchmarkCase {
+public:
+	MatchCase(const std::string &name, const AddressTrie &trie, const std::vector<NetworkAddress> &queries, const bool hit) :
+		BenchmarkCase(name), mTrie(trie), mQueries(queries), mHit(hit), mNext(0) {}
+
+	unsigned long run() {
+		const NetworkAddress &address = mQueries[mNext++ % mQueries.size()];
+
+		if((mTrie.longestMatch(address) != -1) != mHit) {
+			std::cerr << getName() << ": " << AddressTrie::format(address, 128) << (mHit ? " should" : " should not") << " be banned\n";
+			exit(1);
+		}
+
+		return sizeof(address.bytes);
+	}
+
+private:
+	const AddressTrie &mTrie;						///< the ban list
+	const std::vector<NetworkAddress> &mQueries;	///< the addresses to look up
+	bool mHit;										///< whether every lookup should find a ban
+	unsigned long mNext;							///< the next query
+};
+
+/// times parsing an address and looking it up, as BanMap::isBanned() does
+class TextCase : public BenchmarkCase {
+public:
+	TextCase(const std::string &name, const AddressTrie &trie, const std::vector<std::string> &queries) :
+		BenchmarkCase(name), mTrie(trie), mQueries(queries), mNext(0) {}
+
+	unsigned long run() {
+		const std::string &text = mQueries[mNext++ % mQueries.size()];
+		NetworkAddress address;
+		unsigned int length;
+
+		if(!AddressTrie::parse(text, address, length) || mTrie.longestMatch(address) == -1) {
+			std::cerr << getName() << ": " << text << " should be banned\n";
+			exit(1);
+		}
+
+		return text.size();
+	}
+
+private:
+	const AddressTrie &mTrie;					///< the ban list
+	const std::vector<std::string> &mQueries;	///< the addresses to look up
+	unsigned long mNext;						///< the next query
+};
+
+/// times an exact match on address strings, the old BanMap lookup
+class ExactCase : public BenchmarkCase {
+public:
+	ExactCase(const std::string &name, const std::map<std::string, std::string> &hosts, const std::vector<std::string> &queries) :
+		BenchmarkCase(name), mHosts(hosts), mQueries(queries), mNext(0) {}
+
+	unsigned long run() {
+		const std::string &text = mQueries[mNext++ % mQueries.size()];
+
+		if(mHosts.find(text) == mHosts.end()) {
+			std::cerr << getName() << ": " << text << " should be banned\n";
+			exit(1);
+		}
+
+		return text.size();
+	}
+
+private:
+	const std::map<std::string, std::string> &mHosts;	///< the banned hosts
+	const std::vector<std::string> &mQueries;			///< the addresses to look up
+	unsigned long mNext;								///< the next query
+};
+
+/// picks addresses inside random networks of a list
+static std::vector<NetworkAddress> makeHits(const std::vector<NetworkAddress> &networks, const std::vector<unsigned int> &lengths) {
+	std::vector<NetworkAddress> queries;
+
+	for(unsigned int i = 0; i < kQueries && !networks.empty(); ++i) {
+		unsigned int pick = rand() % networks.size();
+		queries.push_back(randomInside(networks[pick], lengths[pick]));
+	}
+
+	return queries;
+}
+
+/// prints usage information
+static void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+		<< "  -t seconds    shortest timed batch per case (0.5)\n"
+		<< "  -n entries    bans in the list (100000)\n"
+		<< "  -s seed       random seed (1)\n";
+}
+
+int main(int argc, char *argv[]) {
+	double seconds = 0.5;
+	unsigned int entries = 100000;
+	unsigned int seed = 1;
+
+	int c;
+	while((c = getopt(argc, argv, "t:n:s:?")) != -1) {
+		switch(c) {
+			case 't': seconds = atof(optarg); break;
+			case 'n': entries = atoi(optarg); break;
+			case 's': seed = atoi(optarg); break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(seconds <= 0 || entries < 20) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	srand(seed);
+
+	BanList list;
+	double insertSeconds = buildList(list, entries);
+
+	std::cout << "trie_entries " << list.trie.size() << "\n";
+	std::cout << "trie_nodes " << list.trie.getNodeCount() << "\n";
+	std::cout << "trie_insert_ns_per_entry " << insertSeconds * 1e9 / entries << "\n";
+
+	std::vector<NetworkAddress> v4Hits = makeHits(list.v4Networks, list.v4Lengths);
+	std::vector<NetworkAddress> v6Hits = makeHits(list.v6Networks, list.v6Lengths);
+	std::vector<NetworkAddress> v4Misses;
+	std::vector<NetworkAddress> v6Misses;
+	std::vector<std::string> v4Text;
+	std::vector<std::string> hostText;
+
+	for(unsigned int i = 0; i < kQueries; ++i) {
+		v4Misses.push_back(randomV4(200, 223));
+		v6Misses.push_back(randomV6(0x2a, 0x00));
+		v4Text.push_back(AddressTrie::format(v4Hits[i], 128));
+	}
+
+	for(std::map<std::string, std::string>::const_iterator it = list.hosts.begin(); it != list.hosts.end() && hostText.size() < kQueries; ++it) {
+		hostText.push_back(it->first);
+	}
+
+	MatchCase v4Hit("v4_hit", list.trie, v4Hits, true);
+	printBenchmarkResult(v4Hit.getName(), runBenchmark(v4Hit, seconds));
+
+	MatchCase v4Miss("v4_miss", list.trie, v4Misses, false);
+	printBenchmarkResult(v4Miss.getName(), runBenchmark(v4Miss, seconds));
+
+	MatchCase v6Hit("v6_hit", list.trie, v6Hits, true);
+	printBenchmarkResult(v6Hit.getName(), runBenchmark(v6Hit, seconds));
+
+	MatchCase v6Miss("v6_miss", list.trie, v6Misses, false);
+	printBenchmarkResult(v6Miss.getName(), runBenchmark(v6Miss, seconds));
+
+	TextCase text("v4_text_hit", list.trie, v4Text);
+	printBenchmarkResult(text.getName(), runBenchmark(text, seconds));
+
+	if(!hostText.empty()) {
+		ExactCase exact("map_exact_hit", list.hosts, hostText);
+		printBenchmarkResult(exact.getName(), runBenchmark(exact, seconds));
+	}
+
+	return 0;
+}
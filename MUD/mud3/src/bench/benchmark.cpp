@@ -0,0 +1,100 @@
+#include <iostream>
+#include <new>
+#include <cstdlib>
+
+#include "benchmark.h"
+#include "timer.h"
+
+/// how many times operator new has been called by this process
+static volatile unsigned long gAllocations = 0;
+
+/// counting replacement for the global operator new
+/** Every benchmark program links this file, so all heap allocations made by the
+	engine code under test pass through here and can be reported per operation.
+*/
+void *operator new(std::size_t size) throw(std::bad_alloc) {
+	__sync_fetch_and_add(&gAllocations, 1);
+
+	void *p = std::malloc(size ? size : 1);
+
+	if(!p) {
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+/// counting replacement for the global array operator new
+void *operator new[](std::size_t size) throw(std::bad_alloc) {
+	return operator new(size);
+}
+
+/// releases memory from the counting operator new
+void operator delete(void *p) throw() {
+	std::free(p);
+}
+
+/// releases memory from the counting array operator new
+void operator delete[](void *p) throw() {
+	std::free(p);
+}
+
+/// gets how many heap allocations the process has made so far
+unsigned long getAllocationCount() {
+	return __sync_fetch_and_add(&gAllocations, 0);
+}
+
+/// times a benchmark case
+/** This function calls the case once to warm caches, then runs it in batches that
+	double in size until a batch takes at least \a minSeconds. Only the final batch
+	is reported, so the per-call overhead of the loop and the clock are amortized.
+	@param bench the case to run
+	@param minSeconds the shortest batch that will be accepted
+	\return the figures for the final batch
+*/
+BenchmarkResult runBenchmark(BenchmarkCase &bench, const double minSeconds) {
+	BenchmarkResult result;
+	const unsigned long minMicroseconds = static_cast<unsigned long>(minSeconds * 1000000.0);
+
+	bench.run();
+
+	unsigned long iterations = 1;
+
+	while(true) {
+		unsigned long long bytes = 0;
+		unsigned long allocations = getAllocationCount();
+		Timer timer;
+
+		for(unsigned long i = 0; i < iterations; ++i) {
+			bytes += bench.run();
+		}
+
+		unsigned long elapsed = timer.elapsed();
+		allocations = getAllocationCount() - allocations;
+
+		if(elapsed >= minMicroseconds || iterations >= (1UL << 30)) {
+			result.iterations = iterations;
+			result.nsPerOp = elapsed * 1000.0 / iterations;
+			result.bytesPerOp = static_cast<double>(bytes) / iterations;
+			result.allocationsPerOp = static_cast<double>(allocations) / iterations;
+			result.megabytesPerSecond = elapsed ? bytes / static_cast<double>(elapsed) : 0.0;
+			break;
+		}
+
+		iterations *= 2;
+	}
+
+	return result;
+}
+
+/// prints a result as \c key \c value lines
+/** @param name prefix for each key, normally the case name
+	@param result what runBenchmark() returned
+*/
+void printBenchmarkResult(const std::string &name, const BenchmarkResult &result) {
+	std::cout << name << "_iterations " << result.iterations << "\n";
+	std::cout << name << "_ns_per_op " << result.nsPerOp << "\n";
+	std::cout << name << "_bytes_per_op " << result.bytesPerOp << "\n";
+	std::cout << name << "_allocations_per_op " << result.allocationsPerOp << "\n";
+	std::cout << name << "_mb_per_second " << result.megabytesPerSecond << "\n";
+}
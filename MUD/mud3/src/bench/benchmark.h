@@ -0,0 +1,44 @@
+#ifndef MUD_BENCHMARK_H
+#define MUD_BENCHMARK_H
+
+#include <string>
+
+/// one operation to be measured by runBenchmark()
+/** Derive from this class and implement run() to perform a single operation, such
+	as saving one object. Anything that should not be timed, like building the object
+	in the first place, belongs in the constructor.
+*/
+class BenchmarkCase {
+public:
+	/// creates a case that will be reported under \a name
+	BenchmarkCase(const std::string &name) : mName(name) {}
+	virtual ~BenchmarkCase() {}
+
+	/// performs the operation once
+	/** \return the number of bytes the operation produced or consumed, used for
+		the bytes-per-operation and throughput figures */
+	virtual unsigned long run() = 0;
+
+	/// gets the name the results are reported under
+	std::string getName() const { return mName; }
+
+private:
+	std::string mName;	///< prefix for every reported key
+};
+
+/// what runBenchmark() measured for one case
+typedef struct {
+	unsigned long iterations;	///< how many times run() was called while timing
+	double nsPerOp;				///< wall clock nanoseconds per call
+	double bytesPerOp;			///< average value returned by run()
+	double allocationsPerOp;	///< calls to operator new per call
+	double megabytesPerSecond;	///< bytesPerOp expressed as throughput
+} BenchmarkResult;
+
+BenchmarkResult runBenchmark(BenchmarkCase &bench, const double minSeconds);
+
+void printBenchmarkResult(const std::string &name, const BenchmarkResult &result);
+
+unsigned long getAllocationCount();
+
+#endif // MUD_BENCHMARK_H
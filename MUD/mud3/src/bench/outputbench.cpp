@@ -0,0 +1,183 @@
+/** @file
+	outputbench: microbenchmarks for the text output path.
+
+	Every line sent to a player goes through ClientSocket::to_client(), which runs
+	parseColor() to turn \c ~xyz tokens into ANSI sequences and then formatWidth() to
+	wrap the result to the client's screen. This program times both steps on their own
+	and the whole path, including the flush to a descriptor, on a short chat line, a
+	long room description and text with a color token on every word, at narrow,
+	normal and wide screen widths.
+
+	Every result is printed as \c key \c value lines, for example
+	\c room_to_client80_mb_per_second and \c room_to_client80_allocations_per_op, where
+	one operation is one line of output. Run <tt>outputbench -?</tt> for options.
+*/
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "global.h"
+#include "client_socket.h"
+#include "benchmark.h"
+
+Global glob;
+
+/// the screen widths every text is wrapped to
+static const int kWidths[] = { 40, 80, 200 };
+
+/// a chat channel line, the most common output under load
+static std::string makeChat() {
+	return "[~nc0chat~res: Aldric] anyone want to group up for the crypt tonight? bring torches" END;
+}
+
+/// a room as 'look' shows it: title, a long description, contents and exits
+static std::string makeRoom() {
+	static const std::string sentence = "Ancient oaks lean over the road here, their roots cracking the old flagstones "
+		"and their branches knitting a roof that lets only a green half-light through. ";
+	std::ostringstream s;
+
+	s << "~bw0The Old Forest Road~res" << END;
+
+	for(int i = 0; i < 8; ++i) {
+		s << sentence;
+	}
+
+	s << END << "~b00Contents~res: a tattered book, 12 silver coins, a milestone, a rusty lantern" << END;
+	s << "~bg0Exits~res: north, northeast, east, south, west, up" << END;
+	return s.str();
+}
+
+/// text with a color token around every word, the worst case for parseColor()
+static std::string makeDense() {
+	static const char *tokens[] = { "~br0", "~ng0", "~by0", "~nb0", "~bm0", "~nc0", "~bwr", "~nkw" };
+	std::ostringstream s;
+
+	for(int i = 0; i < 160; ++i) {
+		s << tokens[i % 8] << "word" << i << "~res ";
+	}
+
+	s << END;
+	return s.str();
+}
+
+/// times parseColor() on one line
+class ColorCase : public BenchmarkCase {
+public:
+	ColorCase(const std::string &name, ClientSocket &socket, const std::string &text) : BenchmarkCase(name), mSocket(socket), mText(text) {}
+
+	unsigned long run() {
+		mSocket.parseColor(mText);
+		return mText.size();
+	}
+
+private:
+	ClientSocket &mSocket;	///< the socket whose color settings are used
+	std::string mText;		///< the line to colorize
+};
+
+/// times formatWidth() on one already colorized line
+class WrapCase : public BenchmarkCase {
+public:
+	WrapCase(const std::string &name, ClientSocket &socket, const std::string &text, int width) : BenchmarkCase(name), mSocket(socket), mText(socket.parseColor(text)), mWidth(width) {}
+
+	unsigned long run() {
+		mSocket.formatWidth(mText, mWidth);
+		return mText.size();
+	}
+
+private:
+	ClientSocket &mSocket;	///< the socket doing the wrapping
+	std::string mText;		///< the colorized line to wrap
+	int mWidth;				///< screen width to wrap to
+};
+
+/// times to_client() and the flush that follows it
+class ToClientCase : public BenchmarkCase {
+public:
+	ToClientCase(const std::string &name, ClientSocket &socket, const std::string &text, int width) : BenchmarkCase(name), mSocket(socket), mText(text), mWidth(width) {}
+
+	unsigned long run() {
+		mSocket.to_client(mText, mWidth);
+		mSocket.flush();
+		return mText.size();
+	}
+
+private:
+	ClientSocket &mSocket;	///< the socket being written to
+	std::string mText;		///< the line to send
+	int mWidth;				///< screen width to wrap to
+};
+
+/// runs one case and prints its results
+static void bench(BenchmarkCase &bench, const double seconds) {
+	printBenchmarkResult(bench.getName(), runBenchmark(bench, seconds));
+}
+
+/// times every step of the output path for one text
+static void benchText(const std::string &name, const std::string &text, ClientSocket &socket, const double seconds) {
+	ColorCase color(name + "_color", socket, text);
+	bench(color, seconds);
+
+	for(unsigned int i = 0; i < sizeof(kWidths) / sizeof(kWidths[0]); ++i) {
+		std::ostringstream suffix;
+		suffix << kWidths[i];
+
+		WrapCase wrap(name + "_wrap" + suffix.str(), socket, text, kWidths[i]);
+		bench(wrap, seconds);
+
+		ToClientCase toClient(name + "_to_client" + suffix.str(), socket, text, kWidths[i]);
+		bench(toClient, seconds);
+	}
+}
+
+/// prints usage information
+static void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+		<< "  -t seconds    shortest timed batch per case (0.5)\n";
+}
+
+int main(int argc, char *argv[]) {
+	double seconds = 0.5;
+
+	int c;
+	while((c = getopt(argc, argv, "t:?")) != -1) {
+		switch(c) {
+			case 't': seconds = atof(optarg); break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(seconds <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	glob.log.setDebugType(None);
+
+	// flushes go to /dev/null so the write() is real but never blocks
+	int fd = open("/dev/null", O_WRONLY);
+	if(fd < 0) {
+		std::cerr << "Cannot open /dev/null\n";
+		return 1;
+	}
+
+	ClientSocket socket;
+	socket.set_fd(fd);
+
+	benchText("chat", makeChat(), socket, seconds);
+	benchText("room", makeRoom(), socket, seconds);
+	benchText("dense", makeDense(), socket, seconds);
+
+	// colorblind clients have every token stripped instead of expanded
+	socket.setColorblind(true);
+	ColorCase blind("room_colorblind_color", socket, makeRoom());
+	bench(blind, seconds);
+
+	close(fd);
+	return 0;
+}
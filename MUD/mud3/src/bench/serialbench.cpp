@@ -0,0 +1,254 @@
+/** @file
+	serialbench: microbenchmarks for saving and loading game objects.
+
+	This program builds representative books, coins, milestones, players and rooms in
+	memory, then times how long it takes to write each one to YAML and to parse it back
+	into a fresh object. It also times a few pathological objects that stress the
+	serializers: a book with thousands of pages, a coin made of a hundred alloys and a
+	room crowded with objects. Nothing touches the disk, so the figures are the cost of
+	the serialization code alone.
+
+	Every result is printed as \c key \c value lines, for example
+	\c book_save_ns_per_op and \c book_save_bytes_per_op, so runs can be compared by
+	scripts. Run <tt>serialbench -?</tt> for options.
+	\note None of the loadable object types is a container, so objects only ever sit
+		one level deep inside a room and there is no deep nesting case.
+*/
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "global.h"
+#include "book.h"
+#include "coin.h"
+#include "milestone.h"
+#include "player.h"
+#include "room.h"
+#include "exit.h"
+#include "benchmark.h"
+
+Global glob;
+
+/// knobs for the pathological cases
+typedef struct {
+	double seconds;			///< shortest timed batch per case
+	unsigned int pages;		///< pages in the huge book
+	unsigned int alloys;	///< alloys in the mixed coin
+	unsigned int objects;	///< objects in the crowded room
+} BenchOptions;
+
+/// builds a page of roughly \a length characters of filler text
+static std::string makeText(const unsigned int length) {
+	static const std::string words = "the old road winds past the mill and into the dark wood ";
+	std::string text;
+
+	while(text.size() < length) {
+		text += words;
+	}
+
+	text.resize(length);
+	return text;
+}
+
+/// builds a book with \a pages pages
+static Physical::PhysicalPointer makeBook(const unsigned int pages) {
+	boost::shared_ptr<Book> book(new Book);
+	book->setTitle("A History of the Valley");
+	book->setAuthor("Anonymous");
+	book->setLanguage("common");
+
+	for(unsigned int i = 0; i < pages; ++i) {
+		book->addPage(makeText(400));
+	}
+
+	return book;
+}
+
+/// builds a pile of coins made of \a alloys metals
+static Physical::PhysicalPointer makeCoin(const unsigned int alloys, const std::string &name = "coin") {
+	boost::shared_ptr<Coin> coin(new Coin);
+	coin->setName(name);
+	coin->setQuantity(50);
+
+	for(unsigned int i = 0; i < alloys; ++i) {
+		std::ostringstream metal;
+		metal << "metal" << i;
+		coin->addAlloy(metal.str(), 100 / alloys);
+	}
+
+	return coin;
+}
+
+/// builds a milestone
+static Physical::PhysicalPointer makeMilestone() {
+	boost::shared_ptr<Milestone> milestone(new Milestone);
+	milestone->addPage("Riverton, 3 miles");
+	return milestone;
+}
+
+/// builds a room with every direction linked and \a objects things lying around
+static Physical::PhysicalPointer makeRoom(const unsigned int objects) {
+	static const char *directions[] = { "north", "northeast", "east", "southeast", "south", "southwest", "west", "northwest" };
+
+	boost::shared_ptr<Room> room(new Room);
+	room->setZoneName("bench");
+	room->setFileName("room000000");
+	room->addItemOfInterest("fountain", makeText(120));
+	room->addItemOfInterest("statue", makeText(200));
+
+	for(unsigned int i = 0; i < sizeof(directions) / sizeof(directions[0]); ++i) {
+		Exit::ExitPointer exit(new Exit);
+		exit->setName(directions[i]);
+		exit->setDestination("room000001");
+		exit->setDestinationZone("bench");
+		room->addExit(exit);
+	}
+
+	room->containerSetCapacity(objects);
+
+	for(unsigned int i = 0; i < objects; ++i) {
+		switch(i % 3) {
+			case 0:
+				room->containerAdd(makeBook(4));
+				break;
+			case 1: {
+				// collections with the same name merge, so give every pile its own
+				std::ostringstream name;
+				name << "coin" << i;
+				room->containerAdd(makeCoin(3, name.str()));
+				break;
+			}
+			default:
+				room->containerAdd(makeMilestone());
+		}
+	}
+
+	return room;
+}
+
+/// builds a player with a typical set of attributes
+static Physical::PhysicalPointer makePlayer() {
+	boost::shared_ptr<Player> player(new Player);
+	player->setName("Benchmark");
+	return player;
+}
+
+/// creates an empty object of the same kind as \a type for loading into
+static Physical::PhysicalPointer makeEmpty(const ObjectType type) {
+	switch(type) {
+		case PlayerObject:
+			return Physical::PhysicalPointer(new Player);
+		case RoomObject:
+			return Physical::PhysicalPointer(new Room);
+		case MilestoneObject:
+			return Physical::PhysicalPointer(new Milestone);
+		default:
+			return glob.Factory.create(type);
+	}
+}
+
+/// times writing an object to YAML
+class SaveCase : public BenchmarkCase {
+public:
+	SaveCase(const std::string &name, Physical::PhysicalPointer object) : BenchmarkCase(name), mObject(object) {}
+
+	unsigned long run() {
+		YAML::Emitter out;
+		mObject->Save(out);
+		return out.size();
+	}
+
+private:
+	Physical::PhysicalPointer mObject;	///< the object being saved
+};
+
+/// times parsing YAML back into a fresh object
+class LoadCase : public BenchmarkCase {
+public:
+	LoadCase(const std::string &name, Physical::PhysicalPointer object) : BenchmarkCase(name), mType(object->getObjectType()) {
+		YAML::Emitter out;
+		object->Save(out);
+		mText = out.c_str();
+	}
+
+	unsigned long run() {
+		std::istringstream is(mText);
+		YAML::Parser parser(is);
+		YAML::Node doc;
+		parser.GetNextDocument(doc);
+
+		Physical::PhysicalPointer object = makeEmpty(mType);
+
+		if(!object || !object->Load(doc)) {
+			std::cerr << getName() << ": load failed\n";
+			exit(1);
+		}
+
+		return mText.size();
+	}
+
+private:
+	ObjectType mType;	///< what kind of object to load into
+	std::string mText;	///< the saved object
+};
+
+/// times saving and loading one object and prints both results
+static void benchObject(const std::string &name, Physical::PhysicalPointer object, const BenchOptions &options) {
+	SaveCase save(name + "_save", object);
+	printBenchmarkResult(save.getName(), runBenchmark(save, options.seconds));
+
+	LoadCase load(name + "_load", object);
+	printBenchmarkResult(load.getName(), runBenchmark(load, options.seconds));
+}
+
+/// prints usage information
+static void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+		<< "  -t seconds    shortest timed batch per case (0.5)\n"
+		<< "  -p pages      pages in the huge book (5000)\n"
+		<< "  -a alloys     alloys in the mixed coin, up to 100 (100)\n"
+		<< "  -o objects    objects in the crowded room (2000)\n";
+}
+
+int main(int argc, char *argv[]) {
+	BenchOptions options;
+	options.seconds = 0.5;
+	options.pages = 5000;
+	options.alloys = 100;
+	options.objects = 2000;
+
+	int c;
+	while((c = getopt(argc, argv, "t:p:a:o:?")) != -1) {
+		switch(c) {
+			case 't': options.seconds = atof(optarg); break;
+			case 'p': options.pages = atoi(optarg); break;
+			case 'a': options.alloys = atoi(optarg); break;
+			case 'o': options.objects = atoi(optarg); break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(options.seconds <= 0 || options.alloys < 1 || options.alloys > 100) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// the serializers log every object at debug level, which would swamp the timings
+	glob.log.setDebugType(None);
+
+	benchObject("book", makeBook(4), options);
+	benchObject("coin", makeCoin(3), options);
+	benchObject("milestone", makeMilestone(), options);
+	benchObject("player", makePlayer(), options);
+	benchObject("room", makeRoom(10), options);
+
+	benchObject("book_huge", makeBook(options.pages), options);
+	benchObject("coin_alloys", makeCoin(options.alloys), options);
+	benchObject("room_crowded", makeRoom(options.objects), options);
+
+	return 0;
+}
@@ -0,0 +1,311 @@
+/** @file
+	telnetbench: fuzzing and throughput benchmarks for the telnet parser.
+
+	Every byte a client sends goes through TelnetParser::parse(), so it has to keep up
+	with the network and must never be confused by what a client sends. This program
+	checks both.
+
+	The fuzzer builds random streams that are mostly telnet commands, option numbers and
+	subnegotiation markers, then parses each one twice: in one piece, and split into
+	random pieces as the network might deliver it. The text, the replies, the Handler
+	calls and the error count must be identical, and no subnegotiation may be longer
+	than kMaxTelnetSubnegotiationLength. Any difference is printed and the exit status
+	is 1.
+
+	The benchmarks time plain text, text full of escaped 255 bytes, heavy option
+	negotiation and subnegotiations, each fed whole, in kMaxSocketInputBufferLength reads
+	and one byte at a time. Results are \c key \c value lines, for example
+	\c text_read_mb_per_second. Run <tt>telnetbench -?</tt> for options.
+*/
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+#include <arpa/telnet.h>
+
+#include "global.h"
+#include "telnetParser.h"
+#include "benchmark.h"
+#include "timer.h"
+
+Global glob;
+
+/// a Handler that agrees to even options and can write down everything it hears
+class RecordingHandler : public TelnetParser::Handler {
+public:
+	RecordingHandler(const bool record) : mRecord(record), mLongest(0) {}
+
+	bool telnetAcceptLocal(const unsigned char option) {
+		note('L', option, "");
+		return option % 2 == 0;
+	}
+
+	bool telnetAcceptRemote(const unsigned char option) {
+		note('R', option, "");
+		return option % 2 == 0;
+	}
+
+	void telnetOptionChanged(const unsigned char option, const bool local, const bool enabled, std::string &) {
+		note(enabled ? '+' : '-', option, local ? "l" : "r");
+	}
+
+	void telnetSubnegotiation(const unsigned char option, const std::string &data, std::string &) {
+		if(data.length() > mLongest) {
+			mLongest = data.length();
+		}
+
+		note('S', option, data);
+	}
+
+	/// everything heard so far
+	const std::string &getLog() const { return mLog; }
+
+	/// the longest subnegotiation heard so far
+	std::string::size_type getLongest() const { return mLongest; }
+
+private:
+	bool mRecord;					///< whether to keep a log at all
+	std::string mLog;				///< one entry per call
+	std::string::size_type mLongest;	///< longest subnegotiation payload
+
+	void note(const char kind, const unsigned char option, const std::string &data) {
+		if(mRecord) {
+			mLog += kind;
+			mLog += static_cast<char>(option);
+			mLog += data;
+			mLog += '\n';
+		}
+	}
+};
+
+/// times parsing a stream delivered in pieces of a fixed size
+class ParseCase : public BenchmarkCase {
+public:
+	ParseCase(const std::string &name, const std::string &stream, const unsigned long piece) : BenchmarkCase(name), mStream(stream), mPiece(piece) {}
+
+	unsigned long run() {
+		TelnetParser parser;
+		RecordingHandler handler(false);
+		std::string text;
+		std::string reply;
+
+		text.reserve(mStream.length());
+
+		for(unsigned long i = 0; i < mStream.length(); i += mPiece) {
+			unsigned long length = mStream.length() - i < mPiece ? mStream.length() - i : mPiece;
+			parser.parse(mStream.data() + i, length, text, reply, handler);
+		}
+
+		return mStream.length();
+	}
+
+private:
+	std::string mStream;	///< what the client sent
+	unsigned long mPiece;	///< bytes per parse() call
+};
+
+/// appends IAC command option
+static void command(std::string &out, const unsigned char what, const unsigned char option) {
+	out += static_cast<char>(IAC);
+	out += static_cast<char>(what);
+	out += static_cast<char>(option);
+}
+
+/// typical typed commands, about 64k of them
+static std::string makeText() {
+	static const char *lines[] = { "look\r\n", "say anyone want to group up for the crypt?\r\n", "north\r\n", "get all from corpse\r\n", "channel chat lag check\r\n" };
+	std::string out;
+
+	for(int i = 0; out.length() < 65536; ++i) {
+		out += lines[i % 5];
+	}
+
+	return out;
+}
+
+/// typed text with an escaped 255 every few words
+static std::string makeEscaped() {
+	std::string out;
+
+	while(out.length() < 65536) {
+		out += "say caf";
+		out += static_cast<char>(IAC);
+		out += static_cast<char>(IAC);
+		out += " au lait\r\n";
+	}
+
+	return out;
+}
+
+/// a client that never stops negotiating, with a command between each request
+static std::string makeNegotiation() {
+	static const unsigned char commands[] = { WILL, WONT, DO, DONT };
+	std::string out;
+
+	for(int i = 0; out.length() < 65536; ++i) {
+		command(out, commands[i % 4], static_cast<unsigned char>(i % 64));
+		out += "look\r\n";
+	}
+
+	return out;
+}
+
+/// window sizes and long structured payloads, as NAWS and GMCP send them
+static std::string makeSubnegotiation() {
+	std::string out;
+
+	for(int i = 0; out.length() < 65536; ++i) {
+		std::string naws;
+		naws += static_cast<char>(0);
+		naws += static_cast<char>(80 + i % 40);
+		naws += static_cast<char>(0);
+		naws += static_cast<char>(24);
+		TelnetParser::appendSubnegotiation(out, 31, naws);
+
+		TelnetParser::appendSubnegotiation(out, 201, "Core.Supports.Set [ \"Room 1\", \"Char 1\", \"Comm.Channel 1\", \"Char.Vitals 1\" ]");
+		out += "look\r\n";
+	}
+
+	return out;
+}
+
+/// times one stream whole, in read-sized pieces and a byte at a time
+static void benchStream(const std::string &name, const std::string &stream, const double seconds) {
+	ParseCase whole(name + "_whole", stream, stream.length());
+	printBenchmarkResult(whole.getName(), runBenchmark(whole, seconds));
+
+	ParseCase read(name + "_read", stream, kMaxSocketInputBufferLength);
+	printBenchmarkResult(read.getName(), runBenchmark(read, seconds));
+
+	ParseCase byte(name + "_byte", stream, 1);
+	printBenchmarkResult(byte.getName(), runBenchmark(byte, seconds));
+}
+
+/// builds a random stream that is mostly telnet syntax
+static std::string makeFuzz() {
+	static const unsigned char syntax[] = { IAC, IAC, IAC, WILL, WONT, DO, DONT, SB, SE, NOP, GA, 0, '\r', '\n', 1, 24, 31, 86, 201 };
+	const int length = 1 + rand() % 2048;
+	std::string out;
+
+	// now and then, a subnegotiation long enough to hit the limit
+	if(rand() % 50 == 0) {
+		out += static_cast<char>(IAC);
+		out += static_cast<char>(SB);
+		out += static_cast<char>(rand() % 256);
+		out.append(kMaxTelnetSubnegotiationLength + rand() % 16, 'x');
+	}
+
+	for(int i = 0; i < length; ++i) {
+		if(rand() % 3 == 0) {
+			out += static_cast<char>(rand() % 256);
+		} else {
+			out += static_cast<char>(syntax[rand() % sizeof(syntax)]);
+		}
+	}
+
+	return out;
+}
+
+/// parses a stream in random pieces
+static void parseSplit(const std::string &stream, std::string &text, std::string &reply, RecordingHandler &handler, TelnetParser &parser) {
+	unsigned long i = 0;
+
+	while(i < stream.length()) {
+		unsigned long length = 1 + rand() % 16;
+
+		if(length > stream.length() - i) {
+			length = stream.length() - i;
+		}
+
+		parser.parse(stream.data() + i, length, text, reply, handler);
+		i += length;
+	}
+}
+
+/// runs the fuzzer
+/** \return the number of streams that parsed differently when split
+*/
+static unsigned long fuzz(const unsigned long cases) {
+	unsigned long mismatches = 0;
+	unsigned long long bytes = 0;
+	Timer timer;
+
+	for(unsigned long n = 0; n < cases; ++n) {
+		std::string stream = makeFuzz();
+		bytes += stream.length();
+
+		TelnetParser whole;
+		RecordingHandler wholeHandler(true);
+		std::string wholeText;
+		std::string wholeReply;
+		whole.parse(stream.data(), stream.length(), wholeText, wholeReply, wholeHandler);
+
+		TelnetParser split;
+		RecordingHandler splitHandler(true);
+		std::string splitText;
+		std::string splitReply;
+		parseSplit(stream, splitText, splitReply, splitHandler, split);
+
+		bool same = wholeText == splitText && wholeReply == splitReply && wholeHandler.getLog() == splitHandler.getLog()
+			&& whole.getProtocolErrors() == split.getProtocolErrors();
+		bool bounded = wholeHandler.getLongest() <= kMaxTelnetSubnegotiationLength && wholeText.length() <= stream.length();
+
+		if(!same || !bounded) {
+			++mismatches;
+			std::cerr << "fuzz case " << n << ": " << (same ? "subnegotiation or text too long" : "split parse differs") << "\n";
+		}
+	}
+
+	unsigned long elapsed = timer.elapsed();
+
+	std::cout << "fuzz_cases " << cases << "\n";
+	std::cout << "fuzz_bytes " << bytes << "\n";
+	std::cout << "fuzz_mismatches " << mismatches << "\n";
+	std::cout << "fuzz_seconds " << elapsed / 1000000.0 << "\n";
+
+	return mismatches;
+}
+
+/// prints usage information
+static void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+		<< "  -t seconds    shortest timed batch per case (0.5)\n"
+		<< "  -f cases      random streams to fuzz with, 0 to skip (20000)\n"
+		<< "  -s seed       random seed for the fuzzer (1)\n";
+}
+
+int main(int argc, char *argv[]) {
+	double seconds = 0.5;
+	unsigned long cases = 20000;
+	unsigned int seed = 1;
+
+	int c;
+	while((c = getopt(argc, argv, "t:f:s:?")) != -1) {
+		switch(c) {
+			case 't': seconds = atof(optarg); break;
+			case 'f': cases = strtoul(optarg, NULL, 10); break;
+			case 's': seed = strtoul(optarg, NULL, 10); break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(seconds <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	glob.log.setDebugType(None);
+	srand(seed);
+
+	unsigned long mismatches = fuzz(cases);
+
+	benchStream("text", makeText(), seconds);
+	benchStream("escaped", makeEscaped(), seconds);
+	benchStream("negotiation", makeNegotiation(), seconds);
+	benchStream("subnegotiation", makeSubnegotiation(), seconds);
+
+	return mismatches ? 1 : 0;
+}
@@ -1,224 +1,698 @@
 #include <iomanip>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <sys/socket.h>
 #include <arpa/telnet.h>
 
 #include "client_socket.h"
 #include "utility.h"
+#include "timer.h"
 
 #include "global.h"
 extern Global glob;
 
+volatile unsigned long ClientSocket::sCompressors = 0;
+volatile unsigned long ClientSocket::sCompressorMemory = 0;
+
+/// the MTTS bit for clients that use a screen reader, which must never be wrapped for
+static const unsigned int kMttsScreenReader = 64;
+
+/// checks whether another MCCP2 compressor fits under the memory limit
+/** \return true if compression is enabled and one more stream fits in CompressionMemoryLimit
+*/
+static bool compressorMemoryAvailable() {
+	long limit = glob.Config.getIntValue("CompressionMemoryLimit");
+
+	if(limit < 0) {
+		limit = MCCP_MEMORY_LIMIT;
+	}
+
+	return ClientSocket::getCompressorMemory() + MCCP_STREAM_MEMORY <= static_cast<unsigned long>(limit) * 1024;
+}
+
 /// Constructor
 /** Initializes default values. We assume any connection can handle ANSI color.
 	If not, they'll get weird characters on their screen until they turn color off.
 	The mutex for this socket is also initialized so we don't have write collisions
 	between different threads.
 */
-ClientSocket::ClientSocket() {
+ClientSocket::ClientSocket() : mBusy("ClientSocket") {
 	mFd = -1;
 	mColorblind = false;
 	mIn_buffer = "";
 	mOut_buffer = "";
-
-	if(pthread_mutex_init(&mBusy, NULL) != 0) {
-		perror("ClientSocket::ClientSocket(): mutex initialization error");
-		exit(MUTEX_ERROR);
-	}
+	mPending = "";
+	mWriteFailed = false;
+	mCompressor = NULL;
+	mCompressorMemory = 0;
+	mWindowWidth = 0;
+	mWindowHeight = 0;
+	mWindowChanged = false;
+	mTerminalTypeRequests = 0;
+	mMtts = 0;
+	mSelfWrapping = false;
+	mGmcpEnabled = false;
 }
 
 /// Destructor
-/** Resets the file descriptor to a bad value
+/** Resets the file descriptor to a bad value and frees the compressor, if any
 */
 ClientSocket::~ClientSocket() {
+	endCompressor();
 	mFd = -1;
-	pthread_mutex_destroy(&mBusy);
 }
 
 /// SocketDriver calls this function to read from this connection
-/** This function reads input from its connection, which is then parsed
-	by the SocketDriver and placed back in this object's in_buffer.
+/** This function reads whatever the client has sent and runs it through the telnet
+	parser. The text goes into this object's in_buffer, where the Connection splits it
+	into commands, and answers to telnet option requests go into the out_buffer. The
+	parser keeps its place between reads, so commands split across reads still work.
+	@param maxBytes the most to read, up to kMaxSocketInputBufferLength; the Connection
+		passes less when its input rate limit is nearly used up
+	@param[out] bytesRead how many bytes were read, before telnet parsing
 	\return true if the socket can be read from
-	\note Due to the nature of C-style sockets, we have to use a char buffer to
-			read the data, and because of that we have to assign it a size. It \e is
-			possible that this size will be exceeded, but extremely unlikely.
+	\note The driver's select() loop calls again while there is more to read, so one
+		read of kMaxSocketInputBufferLength bytes per call is enough.
 	\note kMaxSocketInputBufferLength is defined in mudconfig.h
 */
-bool ClientSocket::read_socket() {
-	unsigned char buffer[kMaxSocketInputBufferLength] = {0};
+bool ClientSocket::read_socket(const unsigned int maxBytes, unsigned int &bytesRead) {
+	char buffer[kMaxSocketInputBufferLength];
 
-	int bytes_read = 0,
-		total_read = 0;
+	TraceSpan span(glob.trace, "net", "ClientSocket::read_socket");
 
-	bool ret = false;
+	bytesRead = 0;
+	int bytes_read = read(mFd, buffer, maxBytes < kMaxSocketInputBufferLength ? maxBytes : kMaxSocketInputBufferLength);
 
-	bytes_read = read(mFd, buffer, kMaxSocketInputBufferLength);
+	if(bytes_read == 0) {
+		glob.log.warn(boost::format("ClientSocket::read_socket(): read EOF from client %1%") % mFd);
+		return false;
+	} else if(bytes_read < 0) {
+		if(errno == EAGAIN || errno == EINTR) {
+			return true;
+		}
 
-	total_read += bytes_read;
+		// this happens sometimes when telnet window is closed
+		glob.log.error(boost::format("ClientSocket::read_socket(): Error reading from client %1%") % mFd);
+		return false;
+	}
 
-	glob.log.debug(boost::format("Read %1% bytes of data from descriptor %2%") % bytes_read % mFd);
+	bytesRead = bytes_read;
+	glob.capture.input(mFd, buffer, bytes_read);
+	glob.statEngine.addBytesIn(bytes_read);
 
-	if(buffer[0] == IAC) {
-		if(bytes_read == kMaxSocketInputBufferLength) {
-			glob.log.error("Client sent telnet options, but they filled the buffer!");
-			return true;
-		}
-		processTelnetOptions(buffer);
-		glob.statEngine.addBytesIn(total_read);
+	if(glob.log.throttle("ClientSocket::read_socket(): bytes read")) {
+		glob.log.debug(boost::format("Read %1% bytes of data from descriptor %2%") % bytes_read % mFd);
+	}
+
+	std::string text;
+	std::string reply;
+	unsigned long errors = mTelnet.getProtocolErrors();
+
+	mTelnet.parse(buffer, bytes_read, text, reply, *this);
+
+	if(mTelnet.getProtocolErrors() != errors && glob.log.throttle("ClientSocket::read_socket(): telnet errors")) {
+		glob.log.debug(boost::format("ClientSocket::read_socket(): Dropped a malformed telnet sequence from client %1%") % mFd);
+	}
+
+	if(text.empty() && reply.empty()) {
 		return true;
 	}
 
-	while(bytes_read == kMaxSocketInputBufferLength) {
-		glob.log.warn("ClientSocket::read_socket(): reading full buffer size");
+	if(!this->lock()) {
+		// couldn't lock?
+		return false;
+	}
+
+	mIn_buffer += text;
+	mOut_buffer += reply;
+	this->unlock();
+
+	return true;
+}
+
+/// starts telnet negotiation with a new client
+/** This function offers MCCP2 and GMCP and asks the client to report its window size
+	(NAWS) and terminal type (TTYPE). Clients answer while the player is logging in.
+*/
+void ClientSocket::negotiate() {
+	offerCompression();
+
+	if(this->lock()) {
+		mTelnet.enableLocal(TELOPT_GMCP, mOut_buffer);
+		mTelnet.enableRemote(TELOPT_NAWS, mOut_buffer);
+		mTelnet.enableRemote(TELOPT_TTYPE, mOut_buffer);
+		this->unlock();
+	}
+}
+
+/// decides whether to turn on one of our telnet options
+/** We suppress go-ahead and speak GMCP, and turn on MCCP2 if there is memory for
+	another compressor. We never echo; the client does that.
+	@param option the option the client asked for with DO
+	\return true to answer WILL, false to answer WONT
+*/
+bool ClientSocket::telnetAcceptLocal(const unsigned char option) {
+	switch(option) {
+		case TELOPT_SGA:
+		case TELOPT_GMCP:
+			return true;
+		case TELOPT_COMPRESS2:
+			return compressorMemoryAvailable();
+		default:
+			glob.log.debug(boost::format("Responding WONT to client request for option %1%") % (int)option);
+			return false;
+	}
+}
+
+/// decides whether to let the client turn on one of its telnet options
+/** @param option the option the client offered with WILL
+	\return true to answer DO, false to answer DONT
+*/
+bool ClientSocket::telnetAcceptRemote(const unsigned char option) {
+	switch(option) {
+		case TELOPT_SGA:
+			// client is willing to suppress go-ahead
+		case TELOPT_NAWS:
+		case TELOPT_TTYPE:
+			return true;
+		default:
+			glob.log.debug(boost::format("Responding DONT to client request for option %1%") % (int)option);
+			return false;
+	}
+}
+
+/// reacts to a telnet option being turned on or off
+/** @param option the option
+	@param local true for our side of the connection, false for the client's
+	@param enabled whether it is now on
+	@param[out] reply anything to send the client is appended here
+*/
+void ClientSocket::telnetOptionChanged(const unsigned char option, const bool local, const bool enabled, std::string &reply) {
+	if(local && option == TELOPT_COMPRESS2) {
+		if(enabled) {
+			// an unasked-for DO has its WILL in reply; it, and any answer before it, must
+			// reach the client ahead of IAC SB COMPRESS2 and the compressed stream
+			if(!reply.empty() && this->lock()) {
+				mOut_buffer += reply;
+				reply.clear();
+				this->unlock();
+			}
+
+			startCompression();
+		} else {
+			stopCompression();
+		}
+	} else if(local && option == TELOPT_GMCP) {
 		if(this->lock()) {
-			mIn_buffer += (char *)buffer;
+			mGmcp.reset();
+			mGmcpEnabled = enabled;
 			this->unlock();
 		}
+	} else if(!local && option == TELOPT_TTYPE && enabled) {
+		mTerminalTypeRequests = 0;
+		mLastTerminalType.clear();
 
-		bytes_read = read(mFd, buffer, kMaxSocketInputBufferLength);
-		total_read += bytes_read;
+		const char send[] = { static_cast<char>(TELQUAL_SEND), 0 };
+		TelnetParser::appendSubnegotiation(reply, TELOPT_TTYPE, send);
+		++mTerminalTypeRequests;
 	}
+}
 
-	if(total_read > 0) {
-		if(this->lock()) {
-			mIn_buffer += (char *)buffer;
+/// handles a telnet subnegotiation from the client
+/** @param option the option it is about
+	@param data the payload
+	@param[out] reply anything to send the client is appended here
+*/
+void ClientSocket::telnetSubnegotiation(const unsigned char option, const std::string &data, std::string &reply) {
+	switch(option) {
+		case TELOPT_NAWS:
+			receivedWindowSize(data);
+			break;
+		case TELOPT_TTYPE:
+			receivedTerminalType(data, reply);
+			break;
+		case TELOPT_GMCP:
+			receivedGmcp(data);
+			break;
+		default:
+			glob.log.debug(boost::format("Ignoring %1% byte subnegotiation for option %2% from client %3%") % data.length() % (int)option % mFd);
+	}
+}
+
+/// records the window size from a NAWS subnegotiation
+/** NAWS (RFC 1073) sends the width and height as two 16-bit numbers, at login and
+	whenever the window is resized. A zero means the client doesn't know.
+	@param data the four byte payload
+*/
+void ClientSocket::receivedWindowSize(const std::string &data) {
+	if(data.length() != 4) {
+		return;
+	}
+
+	int x = (static_cast<unsigned char>(data[0]) << 8) | static_cast<unsigned char>(data[1]);
+	int y = (static_cast<unsigned char>(data[2]) << 8) | static_cast<unsigned char>(data[3]);
+
+	if(x == 0 || y == 0) {
+		return;
+	}
+
+	mWindowWidth = x;
+	mWindowHeight = y;
+	mWindowChanged = true;
+}
+
+/// records a TTYPE answer and asks for the next one
+/** MTTS clients answer successive TTYPE SENDs with their name, their terminal type and
+	then "MTTS <bits>". Other clients repeat a single answer. We ask until we have seen
+	the MTTS answer or the same answer twice, and at most three times.
+	@param data IS followed by the terminal type
+	@param[out] reply the next TTYPE SEND is appended here
+*/
+void ClientSocket::receivedTerminalType(const std::string &data, std::string &reply) {
+	if(data.empty() || data[0] != TELQUAL_IS) {
+		return;
+	}
+
+	std::string type = Utility::toUpper(data.substr(1));
+
+	if(type.compare(0, 5, "MTTS ") == 0) {
+		mMtts = strtoul(type.c_str() + 5, NULL, 10);
+	} else if(type != mLastTerminalType) {
+		if(mTerminalTypeRequests == 1 && this->lock()) {
+			mClientName = type;
 			this->unlock();
-			ret = true;
-		} else {
-			// couldn't lock?
-			ret = false;
 		}
-	} else if(total_read == 0) {
-		glob.log.warn(boost::format("ClientSocket::read_socket(): read EOF from client %1%") % mFd);
-		ret = false;
-	} else {
-		// this happens sometimes when telnet window is closed
-		glob.log.error(boost::format("ClientSocket::read_socket(): Error reading from client %1%") % mFd);
-		ret = false;
+
+		mLastTerminalType = type;
+
+		if(mTerminalTypeRequests < 3) {
+			const char send[] = { static_cast<char>(TELQUAL_SEND), 0 };
+			TelnetParser::appendSubnegotiation(reply, TELOPT_TTYPE, send);
+			++mTerminalTypeRequests;
+		}
 	}
 
-	glob.statEngine.addBytesIn(total_read);
+	mSelfWrapping = (mMtts & kMttsScreenReader) || isSelfWrappingClient(mClientName);
 
-	return ret;
+	glob.log.debug(boost::format("Client %1% is %2% (MTTS %3%)%4%") % mFd % mClientName % mMtts % (mSelfWrapping ? ", wraps itself" : ""));
 }
 
-///	Processes and responds to telnet option requests
-/** This function looks for recognized telnet options (cf. RFC854, RFC855, and
-	http://www.iana.org/assignments/telnet-options) and responds to them. It will also
-	generate debug information for unrecognized options
-	\note Telnet options are somewhat complicated. Typically options are received as a control sequence
-		starting with the IAC (decimal 255) character. Following it may be any of several options, most
-		commonly \c WILL \c WONT \c DO or \c DONT followed by the thing to do/not do. We respond to \c WILL
-		with \c DONT, and \c DO with \c WONT. Additionally, MCCP is not currently supported (\c COMPRESS is
-		85 and \c COMPRESS2 is 86)
+/// checks whether a client is known to wrap text to its own window
+/** The names come from the SelfWrappingClients config string, or SELF_WRAPPING_CLIENTS
+	in mudconfig.h if it isn't set.
+	@param name the client name from TTYPE, in upper case
+	\return true if the client is on the list
 */
-void ClientSocket::processTelnetOptions(unsigned char *options) {
-	std::stringstream s;
-	unsigned char response[3] = {0};
-	int len = 0;
-	response[len++] = IAC;
-
-	for(size_t i=1; i<strlen((char *)options); ++i) {
-		if(options[i] == IAC) {
-			switch(options[i+1]) {
-			case WILL:
-				switch(options[i+2]) {
-				case TELOPT_SGA:	// 3
-					// client is willing to suppress go-ahead
-					response[len++] = DO;
-					response[len++] = TELOPT_SGA;
-					glob.log.debug("Responding to IAC,WILL,TELOPT_SGA with IAC,DO,TELOPT_SGA");
-					break;
-				case TELOPT_NAWS:	// 31
-				case TELOPT_TSPEED: // 32
-				case TELOPT_TTYPE:	// 24
-				case TELOPT_NEW_ENVIRON:	// 39
-				default:
-					response[len++] = DONT;
-					response[len++] = options[i+2];
-					glob.log.debug(boost::format("Responding DONT to client request for option %1%") % (int)options[i+2]);
-				}
-				i += 3;
-				break; // case WILL
-			case DO:
-				switch(options[i+2]) {
-				case TELOPT_ECHO:
-					response[len++] = WONT;
-					response[len++] = TELOPT_ECHO;
-					glob.log.debug("Responding to IAC,DO,ECHO with IAC,WONT,ECHO");
-					break;
-				case TELOPT_SGA:
-					response[len++] = WILL;
-					response[len++] = TELOPT_SGA;
-					glob.log.debug("Responding to IAC,DO,TELOPT_SGA");
-					break;
-				default:
-					response[len++] = WONT;
-					response[len++] = options[i+2];
-					glob.log.debug(boost::format("Responding WONT to client request for option %2%") % (int)options[i+2]);
-				}
-				i += 3;
-				break; // case DO
-			case SB:
-				s << "Client is attempting to negotiate suboptions: ";
-				while(options[i++] != SE) {
-					s << i << ":" << (int)options[i] << " ";
-				}
-				glob.log.debug(s.str());
-				s.str("");
-				break;
-			default:
-				glob.log.error(boost::format("ClientSocket(): Client sent unsupported request for option %1%") % (int)options[i+1]);
-				break;
-			} // options[i+1] (WILL|DO)
-		} // options[i] == IAC
-	} // for()
+bool ClientSocket::isSelfWrappingClient(const std::string &name) const {
+	if(name.empty()) {
+		return false;
+	}
 
-	if(len > 1) {
-		// we have option responses to send to the client
-		if(this->lock()) {
-			int written = write(mFd, response, len);
+	std::string clients = glob.Config.getStringValue("SelfWrappingClients");
 
-			glob.statEngine.addBytesOut(written);
+	if(clients.empty()) {
+		clients = SELF_WRAPPING_CLIENTS;
+	}
 
-			this->unlock();
+	std::vector<std::string> list = Utility::stringToVector(Utility::toUpper(clients), " ");
+
+	for(std::vector<std::string>::const_iterator it = list.begin(); it != list.end(); ++it) {
+		if(!it->empty() && name.compare(0, it->length(), *it) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/// collects a window size the client reported since the last call
+/** @param[out] x the width in columns
+	@param[out] y the height in rows
+	\return true if there was a new size
+*/
+bool ClientSocket::takeWindowSize(int &x, int &y) {
+	if(!mWindowChanged) {
+		return false;
+	}
+
+	mWindowChanged = false;
+	return getWindowSize(x, y);
+}
+
+/// gets the window size the client reported with NAWS
+/** @param[out] x the width in columns
+	@param[out] y the height in rows
+	\return false if the client hasn't reported one
+*/
+bool ClientSocket::getWindowSize(int &x, int &y) const {
+	if(mWindowWidth == 0) {
+		return false;
+	}
+
+	x = mWindowWidth;
+	y = mWindowHeight;
+	return true;
+}
+
+/// gets the client's name, as its first TTYPE answer gave it
+/** \return the name, or an empty string if the client didn't say
+*/
+std::string ClientSocket::getClientName() {
+	std::string name;
+
+	if(this->lock()) {
+		name = mClientName;
+		this->unlock();
+	}
+
+	return name;
+}
+
+/// handles a GMCP message from the client
+/** @param data <tt>Package.Message json</tt>
+*/
+void ClientSocket::receivedGmcp(const std::string &data) {
+	if(!mGmcpEnabled || !this->lock()) {
+		return;
+	}
+
+	bool understood = mGmcp.receive(data);
+	this->unlock();
+
+	if(!understood && glob.log.throttle("ClientSocket::receivedGmcp(): unknown message")) {
+		glob.log.debug(boost::format("Ignoring GMCP message '%1%' from client %2%") % data.substr(0, data.find(' ')) % mFd);
+	}
+}
+
+/// checks whether the client wants a GMCP message
+/** Callers use this to skip building messages nobody will get.
+	@param message the full message name, such as Char.Vitals
+	\return true if GMCP is on and the client asked for the message's package
+*/
+bool ClientSocket::gmcpSupports(const std::string &message) {
+	if(!mGmcpEnabled || !this->lock()) {
+		return false;
+	}
+
+	bool supported = mGmcp.supports(message);
+	this->unlock();
+	return supported;
+}
+
+/// queues a GMCP message for the client
+/** The message goes out with the next flush, in order with the text around it.
+	@param message the full message name
+	@param object the message body
+	@param mode whether to send always, only on change, or only the changed fields
+	\return true if anything was queued
+*/
+bool ClientSocket::gmcpSend(const std::string &message, const GmcpObject &object, const GmcpSession::SendMode mode) {
+	if(!mGmcpEnabled || !this->lock()) {
+		return false;
+	}
+
+	std::string payload;
+	bool send = mGmcp.encode(message, object, mode, payload);
+
+	if(send) {
+		TelnetParser::appendSubnegotiation(mOut_buffer, TELOPT_GMCP, payload);
+		glob.statEngine.addGmcpMessage();
+	}
+
+	this->unlock();
+	return send;
+}
+
+/// offers MCCP2 compression to the client
+/** This function queues IAC WILL COMPRESS2 unless compression is turned off or the
+	compressors already hold all the memory CompressionMemoryLimit allows. A client that
+	supports MCCP2 answers DO COMPRESS2, and the telnet parser starts compressing.
+*/
+void ClientSocket::offerCompression() {
+	if(!compressorMemoryAvailable()) {
+		return;
+	}
+
+	if(this->lock()) {
+		mTelnet.enableLocal(TELOPT_COMPRESS2, mOut_buffer);
+		this->unlock();
+	}
+}
+
+/// turns on MCCP2 compression after the client accepts it
+/** This function creates the deflate stream, then writes out everything queued so far
+	followed by IAC SB COMPRESS2 IAC SE, uncompressed. Every byte after that goes through
+	the compressor. If the memory limit has been reached since the offer, compression is
+	turned back off with WONT COMPRESS2 instead.
+*/
+void ClientSocket::startCompression() {
+	if(mCompressor) {
+		return;
+	}
+
+	if(!this->lock()) {
+		return;
+	}
+
+	z_stream *stream = NULL;
+
+	if(compressorMemoryAvailable()) {
+		stream = new z_stream;
+		memset(stream, 0, sizeof(z_stream));
+		stream->zalloc = &ClientSocket::compressorAlloc;
+		stream->zfree = &ClientSocket::compressorFree;
+		stream->opaque = this;
+
+		if(deflateInit2(stream, MCCP_COMPRESSION_LEVEL, Z_DEFLATED, MCCP_WINDOW_BITS, MCCP_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+			glob.log.error(boost::format("ClientSocket::startCompression(): Could not create a compressor for client %1%") % mFd);
+			delete stream;
+			stream = NULL;
 		}
 	}
+
+	if(!stream) {
+		mTelnet.disableLocal(TELOPT_COMPRESS2, mOut_buffer);
+		this->unlock();
+		return;
+	}
+
+	TelnetParser::appendSubnegotiation(mOut_buffer, TELOPT_COMPRESS2, "");
+
+	glob.capture.output(mFd, mOut_buffer.data(), mOut_buffer.length());
+	writeLocked(mOut_buffer.data(), mOut_buffer.length());
+	mOut_buffer.clear();
+
+	mCompressor = stream;
+	__sync_fetch_and_add(&sCompressors, 1UL);
+
+	this->unlock();
+
+	glob.log.debug(boost::format("ClientSocket::startCompression(): Compressing output for client %1%") % mFd);
+}
+
+/// turns MCCP2 compression off at the client's request
+/** This function compresses whatever is queued, finishes the deflate stream so the
+	client knows compression has ended, and frees the compressor. Output after this is
+	sent uncompressed.
+*/
+void ClientSocket::stopCompression() {
+	if(!mCompressor) {
+		return;
+	}
+
+	if(this->lock()) {
+		glob.capture.output(mFd, mOut_buffer.data(), mOut_buffer.length());
+		compressLocked(mOut_buffer.data(), mOut_buffer.length(), Z_FINISH);
+		mOut_buffer.clear();
+		endCompressor();
+		this->unlock();
+	}
+}
+
+/// sends everything queued and records what the client negotiated, ahead of a hot reboot
+/** A compressed stream is finished, so the client reads what follows as plain text
+	until attach() starts a new one. MCCP2 itself stays on, as the client expects.
+	Whatever the socket won't take yet is handed over in \a state rather than waited for.
+	@param[out] state the options and unsent output to hand to attach()
+	\return false if the socket could not be written to
+*/
+bool ClientSocket::detach(SocketState &state) {
+	if(!this->lock()) {
+		return false;
+	}
+
+	state.localOptions.clear();
+	state.remoteOptions.clear();
+
+	for(int option = 0; option < 256; ++option) {
+		if(mTelnet.isLocalEnabled(option)) {
+			state.localOptions.push_back(option);
+		}
+
+		if(mTelnet.isRemoteEnabled(option)) {
+			state.remoteOptions.push_back(option);
+		}
+	}
+
+	state.windowWidth = mWindowWidth;
+	state.windowHeight = mWindowHeight;
+	state.clientName = mClientName;
+	state.mtts = mMtts;
+	state.selfWrapping = mSelfWrapping;
+	state.gmcpClient = mGmcp.getClientName();
+	state.gmcpSupports = mGmcpEnabled ? mGmcp.getSupports() : "";
+	state.colorblind = mColorblind;
+
+	glob.capture.output(mFd, mOut_buffer.data(), mOut_buffer.length());
+
+	bool success;
+
+	if(mCompressor) {
+		success = compressLocked(mOut_buffer.data(), mOut_buffer.length(), Z_FINISH);
+		endCompressor();
+	} else {
+		success = writeLocked(mOut_buffer.data(), mOut_buffer.length());
+	}
+
+	mOut_buffer.clear();
+	state.pending = mPending;
+	mPending.clear();
+	this->unlock();
+
+	return success;
+}
+
+/// takes up a client's options from before a hot reboot, or after one failed
+/** The telnet options are marked on without asking again, output that hadn't been sent
+	goes out first, and if MCCP2 was on, a new compressed stream is started.
+	@param state the options detach() recorded
+*/
+void ClientSocket::attach(const SocketState &state) {
+	if(!this->lock()) {
+		return;
+	}
+
+	for(std::vector<int>::const_iterator it = state.localOptions.begin(); it != state.localOptions.end(); ++it) {
+		mTelnet.restoreLocal(*it);
+	}
+
+	for(std::vector<int>::const_iterator it = state.remoteOptions.begin(); it != state.remoteOptions.end(); ++it) {
+		mTelnet.restoreRemote(*it);
+	}
+
+	mWindowWidth = state.windowWidth;
+	mWindowHeight = state.windowHeight;
+	mWindowChanged = state.windowWidth != 0;
+	mClientName = state.clientName;
+	mLastTerminalType = state.clientName;
+	mMtts = state.mtts;
+	mSelfWrapping = state.selfWrapping;
+	mColorblind = state.colorblind;
+	mGmcpEnabled = mTelnet.isLocalEnabled(TELOPT_GMCP);
+	mGmcp.restore(state.gmcpClient, state.gmcpSupports);
+	mPending = state.pending + mPending;
+
+	this->unlock();
+
+	if(mTelnet.isLocalEnabled(TELOPT_COMPRESS2)) {
+		startCompression();
+	}
+}
+
+/// frees the deflate stream without sending anything
+void ClientSocket::endCompressor() {
+	if(!mCompressor) {
+		return;
+	}
+
+	deflateEnd(mCompressor);
+	delete mCompressor;
+	mCompressor = NULL;
+	__sync_fetch_and_sub(&sCompressors, 1UL);
+}
+
+/// zlib allocator that counts compressor memory
+/** zlib calls this for every block a deflate stream needs. The size is kept in front of
+	the block so compressorFree() can take it off the totals again.
+	@param opaque the ClientSocket that owns the stream
+	@param items how many items to allocate
+	@param size the size of each item
+	\return the new block, or Z_NULL if out of memory
+*/
+voidpf ClientSocket::compressorAlloc(voidpf opaque, uInt items, uInt size) {
+	unsigned long bytes = static_cast<unsigned long>(items) * size;
+
+	// two header words keep the block 16-byte aligned
+	unsigned long *block = static_cast<unsigned long *>(malloc(bytes + 2 * sizeof(unsigned long)));
+
+	if(!block) {
+		return Z_NULL;
+	}
+
+	block[0] = bytes;
+
+	ClientSocket *socket = static_cast<ClientSocket *>(opaque);
+	__sync_fetch_and_add(&socket->mCompressorMemory, bytes);
+	__sync_fetch_and_add(&sCompressorMemory, bytes);
+
+	return block + 2;
+}
+
+/// zlib deallocator matching compressorAlloc()
+/** @param opaque the ClientSocket that owns the stream
+	@param address a block from compressorAlloc()
+*/
+void ClientSocket::compressorFree(voidpf opaque, voidpf address) {
+	unsigned long *block = static_cast<unsigned long *>(address) - 2;
+
+	ClientSocket *socket = static_cast<ClientSocket *>(opaque);
+	__sync_fetch_and_sub(&socket->mCompressorMemory, block[0]);
+	__sync_fetch_and_sub(&sCompressorMemory, block[0]);
+
+	free(block);
 }
 
 /// Writes data to client
 /** This function takes the current out_buffer and writes it out to the client in
 	predefined chunk sizes. It also updates the StatEngine with the number of bytes
-	written out.
+	written out. Whatever the socket won't take yet is kept and retried on the next
+	flush, which PlayerDatabase::flushOutput() makes at least once a tick.
 	\see StatEngine
-	\return true if able to write the output buffer to the client socket
+	\return true if the output was written or kept for later
 	\note kMaxSocketBufferWriteSize is defined in mudconfig.h
-	\note This function only returns false if unable to lock the mutex.
+	\note This function returns false if unable to lock the mutex, the socket has
+		failed, or the client is too far behind. Once a write has failed it keeps
+		returning false, so whoever flushes next closes the connection.
 */
 bool ClientSocket::flush() {
-	if(mOut_buffer.empty()) {
+	if(mWriteFailed) {
+		return false;
+	}
+
+	if(mOut_buffer.empty() && mPending.empty()) {
 		return true;
 	}
 
-	int write_size = 0;
-	int written = 0;
+	bool success = false;
 
-	if(this->lock()) {
-		// write data to socket
-		for(unsigned int i = 0; i<mOut_buffer.length(); i += written) {
-			write_size = ((mOut_buffer.length() - i) < kMaxSocketBufferWriteSize) ? mOut_buffer.length() - i : kMaxSocketBufferWriteSize;
+	Timer flushTimer;
+	TraceSpan span(glob.trace, "net", "ClientSocket::flush");
 
-			written = write(mFd, mOut_buffer.substr(i, write_size).c_str(), write_size);
+	if(this->lock()) {
+		if(mOut_buffer.empty()) {
+			success = sendPendingLocked();
+		} else {
+			glob.capture.output(mFd, mOut_buffer.data(), mOut_buffer.length());
 
-			if(written < 0) {
-				glob.log.error(boost::format("ClientSocket::write_socket(): Problem writing to client %1%") % mFd);
-				return false;
+			if(mCompressor) {
+				success = compressLocked(mOut_buffer.data(), mOut_buffer.length(), Z_SYNC_FLUSH);
+			} else {
+				success = writeLocked(mOut_buffer.data(), mOut_buffer.length());
 			}
 
-			// wipe out contents of buffer after writing
+			// wipe out contents of buffer after writing; anything unsent is in mPending
 			mOut_buffer.clear();
-			glob.statEngine.addBytesOut(written);
 		}
 
 		this->unlock();
@@ -228,6 +702,147 @@ bool ClientSocket::flush() {
 		return false;
 	}
 
+	glob.statEngine.recordTime(StatEngine::FlushTimer, flushTimer.elapsed());
+
+	return success;
+}
+
+/// writes bytes to the socket in kMaxSocketBufferWriteSize pieces, until it would block
+/** The caller must hold the lock.
+	@param data what to write
+	@param length how many bytes
+	\return how many bytes were written, or -1 if the socket could not be written to
+*/
+long ClientSocket::sendLocked(const char *data, unsigned long length) {
+	unsigned long i = 0;
+
+	while(i < length) {
+		unsigned long size = (length - i < kMaxSocketBufferWriteSize) ? length - i : kMaxSocketBufferWriteSize;
+
+		int written = write(mFd, data + i, size);
+
+		if(written < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+
+			glob.log.error(boost::format("ClientSocket::write_socket(): Problem writing to client %1%") % mFd);
+			return -1;
+		}
+
+		glob.statEngine.addBytesOut(written);
+		i += written;
+	}
+
+	return static_cast<long>(i);
+}
+
+/// sends as much of mPending as the socket will take
+/** The caller must hold the lock.
+	\return false if the socket could not be written to
+*/
+bool ClientSocket::sendPendingLocked() {
+	if(mPending.empty()) {
+		return true;
+	}
+
+	long written = sendLocked(mPending.data(), mPending.length());
+
+	if(written < 0) {
+		return false;
+	}
+
+	mPending.erase(0, written);
+
+	return true;
+}
+
+/// writes bytes to the socket after anything already pending
+/** Bytes the socket won't take yet are appended to mPending, so they go out in order
+	on a later flush, as long as that leaves no more than kMaxSocketPendingLength bytes
+	waiting. A failure marks the socket (see hasWriteFailed()) and nothing more is
+	written or kept. The caller must hold the lock.
+	@param data what to write
+	@param length how many bytes
+	\return false if the socket could not be written to, or the client would fall
+		more than kMaxSocketPendingLength bytes behind
+*/
+bool ClientSocket::writeLocked(const char *data, unsigned long length) {
+	if(mWriteFailed) {
+		return false;
+	}
+
+	if(!sendPendingLocked()) {
+		mWriteFailed = true;
+		return false;
+	}
+
+	unsigned long written = 0;
+
+	if(mPending.empty()) {
+		long result = sendLocked(data, length);
+
+		if(result < 0) {
+			mWriteFailed = true;
+			return false;
+		}
+
+		written = result;
+	}
+
+	if(written < length) {
+		if(mPending.length() + (length - written) > kMaxSocketPendingLength) {
+			glob.log.error(boost::format("ClientSocket::writeLocked(): Client %1% is %2% bytes behind, giving up on it") % mFd % (mPending.length() + length - written));
+			mWriteFailed = true;
+			return false;
+		}
+
+		mPending.append(data + written, length - written);
+	}
+
+	return true;
+}
+
+/// runs bytes through the MCCP2 compressor and writes the result
+/** The caller must hold the lock and have a compressor. Compressed bytes the socket
+	won't take yet are kept in mPending, since the compressor has already moved past them.
+	@param data the uncompressed bytes
+	@param length how many bytes
+	@param mode Z_SYNC_FLUSH so the client can show everything at once, or Z_FINISH to end the stream
+	\return false if the compressor failed or the socket could not be written to
+*/
+bool ClientSocket::compressLocked(const char *data, unsigned long length, int mode) {
+	char chunk[kMaxSocketBufferWriteSize];
+	unsigned long compressed = 0;
+
+	mCompressor->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+	mCompressor->avail_in = length;
+
+	do {
+		mCompressor->next_out = reinterpret_cast<Bytef *>(chunk);
+		mCompressor->avail_out = sizeof(chunk);
+
+		if(deflate(mCompressor, mode) == Z_STREAM_ERROR) {
+			glob.log.error(boost::format("ClientSocket::compressLocked(): Compressor failed for client %1%") % mFd);
+			mWriteFailed = true;
+			return false;
+		}
+
+		unsigned long have = sizeof(chunk) - mCompressor->avail_out;
+
+		if(have > 0 && !writeLocked(chunk, have)) {
+			return false;
+		}
+
+		compressed += have;
+	} while(mCompressor->avail_out == 0);
+
+	glob.statEngine.addCompression(length, compressed);
+
 	return true;
 }
 
@@ -241,6 +856,20 @@ void ClientSocket::get_in_buffer(std::string &buffer) {
 	mIn_buffer.clear();
 }
 
+/// gets the memory held by this socket's buffers
+/** \return the capacity of the input, output and pending buffers plus the compressor, in bytes
+*/
+unsigned long ClientSocket::getBufferedBytes() {
+	unsigned long bytes = 0;
+
+	if(lock()) {
+		bytes = mIn_buffer.capacity() + mOut_buffer.capacity() + mPending.capacity() + mCompressorMemory;
+		unlock();
+	}
+
+	return bytes;
+}
+
 /// Locks this resource so threads don't fight over it
 /** A simple function to limit access to the socket one thread at a time
 	\return true if able to lock the mutex
@@ -248,7 +877,7 @@ void ClientSocket::get_in_buffer(std::string &buffer) {
 bool ClientSocket::lock() {
 	bool success;
 
-	if(pthread_mutex_lock(&mBusy) != 0) {
+	if(!mBusy.lock()) {
 		success = false;
 		glob.log.error("ClientSocket::lock(): Could not lock mutex");
 	} else {
@@ -267,7 +896,7 @@ bool ClientSocket::lock() {
 bool ClientSocket::unlock() {
 	bool success;
 
-	if(pthread_mutex_unlock(&mBusy) != 0) {
+	if(!mBusy.unlock()) {
 		success = false;
 		glob.log.error("ClientSocket::unlock(): Coudl not unlock mutex");
 	} else {
@@ -281,11 +910,16 @@ bool ClientSocket::unlock() {
 /** This function adds text to the socket's output buffer, parsing ANSI color
 	if necessary and formatting the text to the client's X-resolution
 	@param text The text to write to the client
-	@param width the width of the client's screen
+	@param width the width of the client's screen, or 0 for clients that wrap text themselves
 */
 void ClientSocket::to_client(const std::string &text, int width) {
 	std::string outText = parseColor(text);
-	outText = formatWidth(outText, width);
+
+	if(width > 0) {
+		outText = formatWidth(outText, width);
+	}
+
+	TelnetParser::escape(outText);
 
 	if(this->lock()) {
 		// lock ok
@@ -323,8 +957,11 @@ void ClientSocket::to_client(const StringVector &list, int width) {
 			i = 0;	// we are immediately incremented to 1, so this is okay!
 		}
 	}
+	std::string outText = s.str();
+	TelnetParser::escape(outText);
+
 	if(this->lock()) {
-		mOut_buffer += s.str();
+		mOut_buffer += outText;
 		this->unlock();
 	}
 }
@@ -4,13 +4,33 @@
 #include <pthread.h>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <zlib.h>
 
 #include "mudconfig.h"
+#include "mutex.h"
+#include "telnetParser.h"
+#include "gmcp.h"
+
+/// what a client negotiated, carried across a hot reboot so it isn't asked again
+typedef struct {
+	std::vector<int> localOptions;	///< telnet options on at our end
+	std::vector<int> remoteOptions;	///< telnet options on at the client's end
+	int windowWidth;				///< columns from NAWS, or 0
+	int windowHeight;				///< rows from NAWS, or 0
+	std::string clientName;			///< the first TTYPE answer
+	unsigned int mtts;				///< MTTS capability bits
+	bool selfWrapping;				///< true if the client wraps text itself
+	std::string gmcpClient;			///< the name from GMCP Core.Hello
+	std::string gmcpSupports;		///< the GMCP packages asked for, as a Core.Supports.Set list
+	bool colorblind;				///< true if color is stripped rather than sent
+	std::string pending;			///< output the socket hadn't taken yet, compressed if it went through MCCP2
+} SocketState;
 
 /// Takes care of low-level connection needs for a player.
 /** This class handles all input and output for a single, connected
 	client. */
-class ClientSocket {
+class ClientSocket : private TelnetParser::Handler {
 
 public:
 	ClientSocket();
@@ -22,7 +42,7 @@ public:
 	/// Returns the file descriptor
 	int get_fd() const { return mFd; }
 
-	bool read_socket();
+	bool read_socket(const unsigned int maxBytes, unsigned int &bytesRead);
 	bool flush();
 
 	/// Fetches the socket's in buffer
@@ -41,23 +61,102 @@ public:
 	bool lock();
 	bool unlock();
 
+	unsigned long getBufferedBytes();
+
 	std::string parseColor(const std::string &txt);
+	std::string formatWidth(const std::string &text, int width);
+
+	void negotiate();
+
+	bool takeWindowSize(int &x, int &y);
+	bool getWindowSize(int &x, int &y) const;
+
+	/// true if the client wraps text to its own window, so we shouldn't
+	bool wrapsItself() const { return mSelfWrapping; }
+
+	std::string getClientName();
+
+	/// gets the MTTS capability bits the client reported, or 0 if it didn't
+	unsigned int getMtts() const { return mMtts; }
+
+	/// true once the client has agreed to GMCP
+	bool isGmcpEnabled() const { return mGmcpEnabled; }
+
+	bool gmcpSupports(const std::string &message);
+	bool gmcpSend(const std::string &message, const GmcpObject &object, const GmcpSession::SendMode mode);
+
+	/// true once output can't be delivered any more, so the connection should be closed
+	bool hasWriteFailed() const { return mWriteFailed; }
+
+	/// true once the client has agreed to MCCP2 and output is being compressed
+	bool isCompressing() const { return mCompressor != NULL; }
+
+	bool detach(SocketState &state);
+	void attach(const SocketState &state);
+
+	/// gets how many connections currently have a compressor
+	static unsigned long getCompressors() { return sCompressors; }
+
+	/// gets how much memory all the compressors hold, in bytes
+	static unsigned long getCompressorMemory() { return sCompressorMemory; }
 
 private:
 	int mFd;	///< This connection's socket descriptor
 
 	std::string mIn_buffer;	///< Holds text received from this object
 	std::string mOut_buffer;	///< Holds text waiting to be written out to this object
+	std::string mPending;		///< bytes the socket wouldn't take yet, already compressed if MCCP2 was on
+	volatile bool mWriteFailed;	///< see hasWriteFailed()
 
-	pthread_mutex_t mBusy;	///< mutex to lock so threads don't fight over this resource
+	Mutex mBusy;	///< mutex to lock so threads don't fight over this resource
 
 	bool mColorblind;	///< Whether the client can view ANSI color or not
 
-	std::string formatWidth(const std::string &text, int width);
+	TelnetParser mTelnet;		///< decodes telnet commands in the input and tracks option state
+	z_stream *mCompressor;		///< the MCCP2 deflate stream, or NULL while output is uncompressed
+	volatile unsigned long mCompressorMemory;	///< bytes zlib has allocated for mCompressor
+
+	volatile int mWindowWidth;		///< columns the client reported with NAWS, or 0
+	volatile int mWindowHeight;		///< rows the client reported with NAWS, or 0
+	volatile bool mWindowChanged;	///< true until takeWindowSize() collects a new size
+
+	std::string mClientName;		///< the first terminal type, which MTTS clients use for their name
+	std::string mLastTerminalType;	///< the previous TTYPE answer, to spot a client that doesn't cycle
+	int mTerminalTypeRequests;		///< TTYPE SENDs so far
+	volatile unsigned int mMtts;	///< MTTS capability bits
+	volatile bool mSelfWrapping;	///< true if the client wraps text itself
+
+	GmcpSession mGmcp;				///< what the client wants over GMCP and what it was last sent
+	volatile bool mGmcpEnabled;		///< true while GMCP is on
+
+	static volatile unsigned long sCompressors;			///< connections with a compressor
+	static volatile unsigned long sCompressorMemory;	///< bytes held by every compressor together
 
 	std::string::size_type convertToken(const char *txt, std::stringstream &out);
 
-	void processTelnetOptions(unsigned char *options);
+	bool telnetAcceptLocal(const unsigned char option);
+	bool telnetAcceptRemote(const unsigned char option);
+	void telnetOptionChanged(const unsigned char option, const bool local, const bool enabled, std::string &reply);
+	void telnetSubnegotiation(const unsigned char option, const std::string &data, std::string &reply);
+
+	void offerCompression();
+
+	void receivedWindowSize(const std::string &data);
+	void receivedTerminalType(const std::string &data, std::string &reply);
+	void receivedGmcp(const std::string &data);
+	bool isSelfWrappingClient(const std::string &name) const;
+
+	long sendLocked(const char *data, unsigned long length);
+	bool sendPendingLocked();
+	bool writeLocked(const char *data, unsigned long length);
+	bool compressLocked(const char *data, unsigned long length, int mode);
+
+	void startCompression();
+	void stopCompression();
+	void endCompressor();
+
+	static voidpf compressorAlloc(voidpf opaque, uInt items, uInt size);
+	static void compressorFree(voidpf opaque, voidpf address);
 };
 
 #endif // MUD_CLIENT_SOCKET_H
@@ -2,6 +2,7 @@
 #include "mudconfig.h"
 #include "command.h"
 #include "utility.h"
+#include "timer.h"
 
 #include "global.h"
 extern Global glob;
@@ -27,13 +28,51 @@ CommandHandler::~CommandHandler() {
 	the command with the specified arguments. If it can't, it calls the command's
 	help() function. If it can, then the process() function is called.
 
+	Every call is timed and recorded in the StatEngine under the command's name. If
+	the \c SlowCommandThreshold config integer is set (in microseconds), any call that
+	takes at least that long is logged along with the player and the arguments.
+
 	@param player A copy of the player's object
 	@param txt The command the player object sent to the driver
 	\return true if able to call a command
 */
 bool CommandHandler::call(Player::PlayerPointer player, const std::string &txt) {
-	std::stringstream s;
+	std::string name;
 	std::string arguments;
+
+	Timer timer;
+	TraceSpan span(glob.trace, "command", "CommandHandler::call");
+
+	bool result = dispatch(player, txt, name, arguments);
+
+	if(span.isActive()) {
+		span.setDetail(name.c_str());
+	}
+
+	unsigned long elapsed = timer.elapsed();
+
+	glob.statEngine.recordCommand(name, elapsed);
+
+	int threshold = glob.Config.getIntValue("SlowCommandThreshold");
+
+	if(threshold > 0 && elapsed >= static_cast<unsigned long>(threshold)) {
+		glob.log.warn(boost::format("CommandHandler::call(): Slow command '%1%' took %2% microseconds for player %3% with arguments '%4%'") % name % elapsed % player->getName() % arguments);
+	}
+
+	return result;
+}
+
+/// Looks up and runs a command
+/** This function does the real work for call(): it resolves aliases, then tries
+	commands, Items of Interest and special exits in that order.
+	@param player A copy of the player's object
+	@param txt The command the player object sent to the driver
+	@param[out] name the name the call is profiled under
+	@param[out] arguments the arguments that were passed to the command
+	\return true if able to call a command
+*/
+bool CommandHandler::dispatch(Player::PlayerPointer player, const std::string &txt, std::string &name, std::string &arguments) {
+	std::stringstream s;
 	std::string command = Utility::stringGetFirst(txt, " ", arguments);
 
 	std::string alias = player->getAlias(command);
@@ -51,10 +90,14 @@ bool CommandHandler::call(Player::PlayerPointer player, const std::string &txt)
 
 	CommandMap::iterator pos = mCommandList.find(Utility::toLower(command));
 
+	name = "(bad command)";
+
 	bool result = false;
 
 	// if we find a matching command, call it and return
 	if(pos != mCommandList.end()) {
+		name = pos->first;
+
 		if(pos->second->canProcess(player, arguments)) {
 			result = pos->second->process(player, arguments);
 		} else {
@@ -85,6 +128,7 @@ bool CommandHandler::call(Player::PlayerPointer player, const std::string &txt)
 
 		// ItemsOfInterest matching ala Richard Bartle: http://www.mud.co.uk/richard/vv.htm
 		if(command[command.length() - 1] == '?') {
+			name = "(item of interest)";
 			command = command.substr(0, command.length() - 1);
 			std::string itemdesc = room->getItemOfInterest(command);
 			if(!itemdesc.empty()) {
@@ -104,6 +148,8 @@ bool CommandHandler::call(Player::PlayerPointer player, const std::string &txt)
 		// received as a command, nothing extra on the end.
 		Exit::ExitPointer exit = room->getExit(command);
 		if(exit) {
+			name = "(exit)";
+
 			// found a matching exit name, move the player if possible
 			if(exit->canPass()) {
 				Zone::ZonePointer destinationZone = glob.zoneDaemon.getZone(exit->getDestinationZone());
@@ -26,6 +26,8 @@ public:
 private:
 	void loadCommands();
 
+	bool dispatch(Player::PlayerPointer player, const std::string &txt, std::string &name, std::string &arguments);
+
 	CommandMap mCommandList;	///< a std::map of all available commands
 };
 
@@ -1,9 +1,11 @@
 #include <string>
 #include <sstream>
-#include <boost/regex.hpp>
+#include <cstdlib>
+#include <ctime>
 
 #include "ban.h"
 #include "utility.h"
+#include "addressTrie.h"
 
 #include "global.h"
 extern Global glob;
@@ -45,16 +47,38 @@ bool Ban::help(Player::PlayerPointer player) {
 	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
 		s << glob.Config.getStringValue("AdminRequired");
 	} else {
-		s << "~br0Usage: ban <command> [ip] [reason]~res" << END;
-		s << "  ~br0Ban~res disallows an IP address from being able to log in to the MUD, showing ";
+		s << "~br0Usage: ban <command> [address] [duration] [reason]~res" << END;
+		s << "  ~br0Ban~res disallows an IP address or network from being able to log in to the MUD, showing ";
 		s << "them an optional reason (flame, taunt, etc), if provided. Valid commands are: ";
-		s << "~b00list~res, ~b00add~res, ~b00remove~res.";
+		s << "~b00list~res, ~b00add~res <address> [reason], ~b00temp~res <address> <duration> [reason], ";
+		s << "~b00remove~res <address>." << END;
+		s << "  An address may be an IPv4 or IPv6 address, a CIDR network such as 10.1.0.0/16, or the ";
+		s << "name of a connected player. A duration is a number followed by m, h or d, such as 30m or 7d.";
 	}
 	player->Write(s.str());
 	player->Prompt();
 	return true;
 }
 
+/// turns a duration such as 30m, 12h or 7d into seconds
+/** @param text the duration
+	\return the seconds, or 0 if \a text isn't a duration
+*/
+static long parseDuration(const std::string &text) {
+	if(text.size() < 2 || text.find_first_not_of("0123456789") != text.size() - 1) {
+		return 0;
+	}
+
+	long count = atol(text.substr(0, text.size() - 1).c_str());
+
+	switch(text[text.size() - 1]) {
+		case 'm': return count * 60;
+		case 'h': return count * 3600;
+		case 'd': return count * 86400;
+		default: return 0;
+	}
+}
+
 /// checks to see if the command works with the arguments provided
 /** This command evaluates the arguments and decides whether or not the command
 	can be called correctly. If not, the CommandHandler calls the help() function.
@@ -74,22 +98,16 @@ bool Ban::canProcess(Player::PlayerPointer player, const std::string &txt) {
 		return true;
 	}
 	if(args[0] == "remove") {
-		if(args.size() == 2) {
-			// to remove a ban, we need the "remove" command, and the ip
-			return true;
-		}
-		return false;
+		// to remove a ban, we need the "remove" command, and the address
+		return args.size() == 2;
 	}
 	if(args[0] == "add") {
-		switch(args.size()) {
-			case 2:
-			case 3:
-				// to add a ban, we need the "add" command, the ip, and accept an optional reason
-				return true;
-				break;
-			default:
-				return false;
-		}
+		// to add a ban, we need the "add" command, the address, and accept an optional reason
+		return args.size() >= 2;
+	}
+	if(args[0] == "temp") {
+		// a temporary ban also needs how long it lasts
+		return args.size() >= 3 && parseDuration(args[2]) > 0;
 	}
 	return false;
 }
@@ -97,7 +115,8 @@ bool Ban::canProcess(Player::PlayerPointer player, const std::string &txt) {
 /// runs the command
 /** This function processes the command with the arguments provided. It only allows
 	players with Admin Permissions to add or remove a ban. If no reason is provided
-	to ban an IP, a default (\c nobody \c likes \c you) is sent to the BanMap object.
+	to ban an address, a default (\c nobody \c likes \c you) is sent to the BanMap object.
+	Everything after the address (or, for \c temp, the duration) is the reason.
 	@param player the player sending the command
 	@param txt the arguments to the command
 	\return true if the command executed properly
@@ -128,22 +147,44 @@ bool Ban::process(Player::PlayerPointer player, const std::string &txt) {
 			result = true;
 		} else if(args[0] == "remove") {
 			if(args.size() == 2) {
-				// second argument is IP address
+				// second argument is the address or network
 				if(glob.banMap.removeBan(args[1])) {
 					s << "Ban on " << args[1] << " lifted.";
 					player->Write(s.str());
-					player->Prompt();
-					result = true;
+				} else {
+					player->Write(glob.banMap.getErrorMessage());
 				}
+				player->Prompt();
+				result = true;
+			}
+		} else if((args[0] == "add" && args.size() >= 2) || (args[0] == "temp" && args.size() >= 3)) {
+			time_t expires = 0;
+			StringVector::size_type first = 2;
+
+			if(args[0] == "temp") {
+				long duration = parseDuration(args[2]);
+				if(duration <= 0) {
+					return false;
+				}
+				expires = time(NULL) + duration;
+				first = 3;
+			}
+
+			// everything after the address and any duration is the reason
+			std::string reason;
+			for(StringVector::size_type i = first; i < args.size(); ++i) {
+				if(!reason.empty()) {
+					reason += " ";
+				}
+				reason += args[i];
 			}
-		} else if(args[0] == "add") {
-			// decide if we received an IP address as our argument, or a player name
-			std::string badIP;
 
-			boost::regex e("^([0-9]{1,3}\\.){3}[0-9]{1,3}$");
-			boost::cmatch match;
+			// decide if we received an address or network as our argument, or a player name
+			std::string badIP;
+			NetworkAddress address;
+			unsigned int length;
 
-			if(boost::regex_match(args[1].c_str(), match, e)) {
+			if(AddressTrie::parse(args[1], address, length)) {
 				badIP = args[1];
 			} else {
 				// ban by player name
@@ -158,36 +199,24 @@ bool Ban::process(Player::PlayerPointer player, const std::string &txt) {
 				badIP = args[1];
 			}
 
-			switch(args.size()) {
-				case 2:
-					// no reason provided, use the default
-					if(glob.banMap.ban(badIP, "nobody likes you")) {
-						s << "Banned " << badIP << ", reason: ~b00nobody likes you~res.";
-						player->Write(s.str());
-						player->Prompt();
-					} else {
-						// ban had a problem
-						player->Write(glob.banMap.getErrorMessage());
-						player->Prompt();
-					}
-					result = true;
-					break;
-
-				case 3:
-					if(glob.banMap.ban(badIP, args[2])) {
-						s << "Banned " << badIP << ", reason: ~b00" << args[2] << "~res.";
-						player->Write(s.str());
-						player->Prompt();
-					} else {
-						player->Write(glob.banMap.getErrorMessage());
-						player->Prompt();
-					}
-					result = true;
-					break;
-
-				default:
-					result = false;
+			if(reason.empty()) {
+				// no reason provided, use the default
+				reason = "nobody likes you";
 			}
+
+			if(glob.banMap.ban(badIP, reason, expires)) {
+				s << "Banned " << badIP;
+				if(expires != 0) {
+					s << " for " << args[2];
+				}
+				s << ", reason: ~b00" << reason << "~res.";
+				player->Write(s.str());
+			} else {
+				// ban had a problem
+				player->Write(glob.banMap.getErrorMessage());
+			}
+			player->Prompt();
+			result = true;
 		}
 		return result;
 	} else {
@@ -189,6 +189,15 @@ bool Config::process(Player::PlayerPointer player, const std::string &txt) {
 			s << "is typically 80x24, or ~b00config resolution 80 24~res." << END;
 			s << "  Your current resolution is ~b00" << player->getResolutionX() << " x ";
 			s << player->getResolutionY() << "~res.";
+
+			if(player->reportsWindowSize()) {
+				s << " Your client reports its window size, so this follows it automatically.";
+			}
+
+			if(player->wrapsItself()) {
+				std::string client = Utility::stringReplace(player->getClientName(), "~", "~~");
+				s << " Your client" << (client.empty() ? "" : " (" + client + ")") << " wraps text itself, so the server doesn't.";
+			}
 			player->Write(s.str());
 			player->Prompt();
 			return true;
@@ -212,7 +221,8 @@ bool Config::process(Player::PlayerPointer player, const std::string &txt) {
 		if(setting.empty()) {
 			s << "~br0Usage: config prompt <text>~res" << END;
 			s << "  Use ~b00config prompt~res to change your game prompt, or use ";
-			s << "~b00config prompt default~res to reset your prompt to the default value." << END << END;
+			s << "~b00config prompt default~res to reset your prompt to the default value." << END;
+			s << "  If your client shows your vitals from GMCP, ~b00config prompt off~res turns the text prompt off." << END << END;
 			s << "  Prompt tokens that will be expanded are:" << END;
 			s << "    ~b00%n~res = CRLF" << END;
 			s << "    ~b00%r~res = Current Room" << END;
@@ -229,6 +239,19 @@ bool Config::process(Player::PlayerPointer player, const std::string &txt) {
 			return true;
 		}
 
+		if(setting == "off") {
+			if(!player->gmcpSupports("Char.Vitals")) {
+				player->Write("Your client isn't receiving your vitals over GMCP, so it still needs a prompt.");
+				player->Prompt();
+				return false;
+			}
+
+			player->setPrompt("");
+			player->Write("Prompt turned off. Your client will show your vitals from GMCP.");
+			player->Prompt();
+			return true;
+		}
+
 		if(setting == "default") {
 			setting = glob.Config.getStringValue("DefaultPrompt");
 
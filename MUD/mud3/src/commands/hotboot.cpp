@@ -0,0 +1,101 @@
+#include <string>
+#include <sstream>
+
+#include "hotboot.h"
+
+#include "global.h"
+extern Global glob;
+
+/// Constructor
+/** sets the required permission level to execute this command
+*/
+Hotboot::Hotboot() {
+	mMinimumPermissionLevel = Player::AdminPermissions;
+}
+
+/// Destructor
+/** Does nothing
+*/
+Hotboot::~Hotboot() {
+}
+
+/// Singleton getter
+Hotboot & Hotboot::Instance() {
+	static Hotboot instance;
+	return instance;
+}
+
+/// tells you the name of this command
+/** This function tells you the name of this command
+	\return the name of this command
+*/
+std::string Hotboot::getName() {
+	return "hotboot";
+}
+
+/// returns help info
+/** This function explains how to use this command
+	@param player the player sending the command
+	\return always true
+*/
+bool Hotboot::help(Player::PlayerPointer player) {
+	std::stringstream s;
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		s << glob.Config.getStringValue("AdminRequired");
+	} else {
+		s << "~br0Usage: hotboot~res" << END;
+		s << "  ~br0Hotboot~res saves the world and every player, then restarts the game engine ";
+		s << "from its program file, so a new build can be put in place first. Nobody is ";
+		s << "disconnected: players are put back where they were once the world has loaded, ";
+		s << "and anyone still logging in is asked to start again.";
+	}
+	player->Write(s.str());
+	player->Prompt();
+	return true;
+}
+
+/// checks to see if the command works with the arguments provided
+/** This command evaluates the arguments and decides whether or not process()
+	can be called correctly. If not, the CommandHandler calls the help() function.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command will run properly
+*/
+bool Hotboot::canProcess(Player::PlayerPointer player, const std::string &txt) {
+	bool allowed = false;
+
+	if(player->getPermissionLevel() >= mMinimumPermissionLevel) {
+		allowed = true;
+	}
+
+	return allowed;
+}
+
+/// runs the command
+/** This function processes the command with the arguments provided. The reboot
+	itself happens at the end of the tick.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command executed properly
+*/
+bool Hotboot::process(Player::PlayerPointer player, const std::string &txt) {
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		player->Write(glob.Config.getStringValue("AdminRequired"));
+		player->Prompt();
+		return true;
+	}
+
+	if(!txt.empty()) {
+		return help(player);
+	}
+
+	if(!glob.hotReboot.request(player->getName())) {
+		player->Write("A hot reboot is already under way.");
+		player->Prompt();
+		return false;
+	}
+
+	player->Write("Hot rebooting..");
+
+	return true;
+}
@@ -0,0 +1,28 @@
+#ifndef MUD_HOTBOOT_H
+#define MUD_HOTBOOT_H
+
+#include "command.h"
+#include "player.h"
+
+/// restarts the game without dropping connections
+/** This class allows a player with the proper permissions to hot reboot the game
+	\see HotReboot
+*/
+class Hotboot: public Command {
+public:
+	static Hotboot & Instance();
+	virtual ~Hotboot();
+
+	bool help(Player::PlayerPointer player);
+
+	virtual std::string getName();
+
+	bool canProcess(Player::PlayerPointer player, const std::string &txt);
+	bool process(Player::PlayerPointer player, const std::string &txt);
+
+private:
+	Hotboot();
+	Hotboot(const Hotboot &);
+	Hotboot & operator=(const Hotboot &);
+};
+#endif // MUD_HOTBOOT_H
@@ -0,0 +1,110 @@
+#include <string>
+#include <sstream>
+
+#include "memoryReport.h"
+#include "memoryAccount.h"
+
+#include "global.h"
+extern Global glob;
+
+/// Constructor
+/** sets the required permission level to execute this command
+*/
+MemoryReport::MemoryReport() {
+	mMinimumPermissionLevel = Player::AdminPermissions;
+}
+
+/// Destructor
+/** Does nothing
+*/
+MemoryReport::~MemoryReport() {
+}
+
+/// Singleton getter
+MemoryReport & MemoryReport::Instance() {
+	static MemoryReport instance;
+	return instance;
+}
+
+/// tells you the name of this command
+/** This function tells you the name of this command
+	\return the name of this command
+*/
+std::string MemoryReport::getName() {
+	return "memory";
+}
+
+/// returns help info
+/** This function explains how to use this command
+	@param player the player sending the command
+	\return always true
+*/
+bool MemoryReport::help(Player::PlayerPointer player) {
+	std::stringstream s;
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		s << glob.Config.getStringValue("AdminRequired");
+	} else {
+		s << "~br0Usage: memory~res" << END;
+		s << "  ~br0Memory~res shows how many bytes and objects each part of the engine is using now, and the ";
+		s << "most it has ever used. Rooms, objects, players and messages are counted exactly; network buffers, ";
+		s << "events, the log and the zone map caches are estimated once per heartbeat.";
+	}
+	player->Write(s.str());
+	player->Prompt();
+	return true;
+}
+
+/// checks to see if the command works with the arguments provided
+/** This command evaluates the arguments and decides whether or not process()
+	can be called correctly. If not, the CommandHandler calls the help() function.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command will run properly
+*/
+bool MemoryReport::canProcess(Player::PlayerPointer player, const std::string &txt) {
+	return true;
+}
+
+/// runs the command
+/** This function processes the command with the arguments provided.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command executed properly
+*/
+bool MemoryReport::process(Player::PlayerPointer player, const std::string &txt) {
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		player->Write(glob.Config.getStringValue("AdminRequired"));
+		player->Prompt();
+		return true;
+	}
+
+	if(txt.length() > 1 && txt.substr(0,2) == "-h") {
+		return help(player);
+	}
+
+	unsigned long totalLive = 0;
+	unsigned long totalObjects = 0;
+
+	std::stringstream s;
+
+	if(!MEMORY_ACCOUNTING) {
+		s << "~b00Memory accounting is compiled out (MEMORY_ACCOUNTING in mudconfig.h); only estimates are shown.~res" << END;
+	}
+
+	s << boost::format("%-10s %14s %14s %10s") % "subsystem" % "live bytes" % "peak bytes" % "objects";
+
+	for(int i = 0; i < MemoryAccount::NumberOfMemoryTags; ++i) {
+		MemoryAccount::MemoryTag tag = static_cast<MemoryAccount::MemoryTag>(i);
+
+		totalLive += MemoryAccount::getLiveBytes(tag);
+		totalObjects += MemoryAccount::getObjects(tag);
+
+		s << END << boost::format("%-10s %14u %14u %10u") % MemoryAccount::getTagName(tag) % MemoryAccount::getLiveBytes(tag) % MemoryAccount::getPeakBytes(tag) % MemoryAccount::getObjects(tag);
+	}
+
+	s << END << boost::format("%-10s %14u %14s %10u") % "total" % totalLive % "" % totalObjects;
+
+	player->Write(s.str());
+	player->Prompt();
+	return true;
+}
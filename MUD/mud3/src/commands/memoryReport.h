@@ -0,0 +1,28 @@
+#ifndef MUD_MEMORY_REPORT_H
+#define MUD_MEMORY_REPORT_H
+
+#include "command.h"
+#include "player.h"
+
+/// displays memory use by subsystem
+/** This class shows how many bytes and objects each subsystem is using, and the most
+	it has ever used, as counted by MemoryAccount.
+*/
+class MemoryReport : public Command {
+public:
+	static MemoryReport & Instance();
+	virtual ~MemoryReport();
+
+	bool help(Player::PlayerPointer player);
+
+	virtual std::string getName();
+
+	bool canProcess(Player::PlayerPointer player, const std::string &txt);
+	bool process(Player::PlayerPointer player, const std::string &txt);
+
+private:
+	MemoryReport();
+	MemoryReport(const MemoryReport &);
+	MemoryReport & operator=(const MemoryReport &);
+};
+#endif // MUD_MEMORY_REPORT_H
@@ -0,0 +1,124 @@
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+#include "profile.h"
+#include "utility.h"
+
+#include "global.h"
+extern Global glob;
+
+/// orders command histograms by total time spent, largest first
+static bool compareTotalTime(const std::pair<std::string, Histogram *> &a, const std::pair<std::string, Histogram *> &b) {
+	return a.second->getTotal() > b.second->getTotal();
+}
+
+/// Constructor
+/** sets the required permission level to execute this command
+*/
+Profile::Profile() {
+	mMinimumPermissionLevel = Player::AdminPermissions;
+}
+
+/// Destructor
+/** Does nothing
+*/
+Profile::~Profile() {
+}
+
+/// Singleton getter
+Profile & Profile::Instance() {
+	static Profile instance;
+	return instance;
+}
+
+/// tells you the name of this command
+/** This function tells you the name of this command
+	\return the name of this command
+*/
+std::string Profile::getName() {
+	return "profile";
+}
+
+/// returns help info
+/** This function explains how to use this command
+	@param player the player sending the command
+	\return always true
+*/
+bool Profile::help(Player::PlayerPointer player) {
+	std::stringstream s;
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		s << glob.Config.getStringValue("AdminRequired");
+	} else {
+		s << "~br0Usage: profile [zones|reset]~res" << END;
+		s << "  ~br0Profile~res lists every command that has been called, how many times, and how long ";
+		s << "it took in microseconds, sorted by total time. ~br0Profile zones~res does the same for each ";
+		s << "zone's heartbeat. ~br0Profile reset~res clears both, along with the lock statistics shown by ~br0stats~res. ";
+		s << "Set the ~b00SlowCommandThreshold~res config integer to log any command slower than that many microseconds.";
+	}
+	player->Write(s.str());
+	player->Prompt();
+	return true;
+}
+
+/// checks to see if the command works with the arguments provided
+/** This command evaluates the arguments and decides whether or not process()
+	can be called correctly. If not, the CommandHandler calls the help() function.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command will run properly
+*/
+bool Profile::canProcess(Player::PlayerPointer player, const std::string &txt) {
+	return txt.empty() || Utility::iCompare(txt, "reset") || Utility::iCompare(txt, "zones");
+}
+
+/// runs the command
+/** This function processes the command with the arguments provided.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command executed properly
+*/
+bool Profile::process(Player::PlayerPointer player, const std::string &txt) {
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		player->Write(glob.Config.getStringValue("AdminRequired"));
+		player->Prompt();
+		return true;
+	}
+
+	if(txt.length() > 1 && txt.substr(0,2) == "-h") {
+		return help(player);
+	}
+
+	if(Utility::iCompare(txt, "reset")) {
+		glob.statEngine.resetCommandHistograms();
+		glob.statEngine.resetZoneHistograms();
+		Mutex::resetStatistics();
+		player->Write("Command, zone and lock profiles cleared.");
+		player->Prompt();
+		return true;
+	}
+
+	bool zones = Utility::iCompare(txt, "zones");
+
+	StatEngine::HistogramMap timers = zones ? glob.statEngine.getZoneHistograms() : glob.statEngine.getCommandHistograms();
+	std::vector<std::pair<std::string, Histogram *> > sorted(timers.begin(), timers.end());
+	std::sort(sorted.begin(), sorted.end(), compareTotalTime);
+
+	std::stringstream s;
+	s << boost::format("%-20s %8s %12s %8s %8s %8s %8s %8s") % (zones ? "zone" : "command") % "calls" % "total" % "mean" % "p50" % "p95" % "p99" % "max";
+
+	for(std::vector<std::pair<std::string, Histogram *> >::const_iterator it = sorted.begin(); it != sorted.end(); ++it) {
+		const Histogram *h = it->second;
+
+		if(h->getCount() == 0) {
+			continue;
+		}
+
+		s << END << boost::format("%-20s %8u %12u %8u %8u %8u %8u %8u") % it->first % h->getCount() % h->getTotal() % h->getMean() % h->getPercentile(50.0) % h->getPercentile(95.0) % h->getPercentile(99.0) % h->getMax();
+	}
+
+	player->Write(s.str());
+	player->Prompt();
+	return true;
+}
@@ -0,0 +1,28 @@
+#ifndef MUD_PROFILE_H
+#define MUD_PROFILE_H
+
+#include "command.h"
+#include "player.h"
+
+/// displays per-command timing information
+/** This class shows how often each command has been called and how long it takes,
+	so an admin can find the commands that are eating into the tick.
+*/
+class Profile : public Command {
+public:
+	static Profile & Instance();
+	virtual ~Profile();
+
+	bool help(Player::PlayerPointer player);
+
+	virtual std::string getName();
+
+	bool canProcess(Player::PlayerPointer player, const std::string &txt);
+	bool process(Player::PlayerPointer player, const std::string &txt);
+
+private:
+	Profile();
+	Profile(const Profile &);
+	Profile & operator=(const Profile &);
+};
+#endif // MUD_PROFILE_H
@@ -5,6 +5,7 @@
 extern Global glob;
 
 #include "save.h"
+#include "timer.h"
 
 /// Constructor
 /** sets the required permission level to execute this command
@@ -47,6 +48,11 @@ bool Save::help(Player::PlayerPointer player) {
 		s << "wish, to be restored at a later date. The ForeverMUD engine will periodically save ";
 		s << "your character data as well.";
 		/// \todo make characters save periodically
+
+		if(player->getPermissionLevel() >= Player::AdminPermissions) {
+			s << END << "~br0Usage: save world~res" << END;
+			s << "  Saves every room in every zone now and reports how long it took.";
+		}
 	}
 
 	player->Write(s.str());
@@ -82,6 +88,17 @@ bool Save::process(Player::PlayerPointer player, const std::string &txt) {
 		return help(player);
 	}
 
+	if(txt == "world" && player->getPermissionLevel() >= Player::AdminPermissions) {
+		Timer saveTimer;
+		glob.zoneDaemon.saveAllZones();
+		unsigned long elapsed = saveTimer.elapsed();
+
+		glob.statEngine.recordTime(StatEngine::SaveTimer, elapsed);
+		player->Write(boost::format("Saved %1% rooms in %2% microseconds.") % glob.zoneDaemon.getTotalNumberOfRooms() % elapsed);
+		player->Prompt();
+		return true;
+	}
+
 	player->Save();
 	player->Write("You have been ~b00saved~res. Go forth and sin no more.");
 	player->Prompt();
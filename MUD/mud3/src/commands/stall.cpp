@@ -0,0 +1,100 @@
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <unistd.h>	// for sleep
+
+#include "stall.h"
+#include "utility.h"
+
+#include "global.h"
+extern Global glob;
+
+/// the longest an admin may stall the engine for, in seconds
+static const int kMaxStallSeconds = 300;
+
+/// Constructor
+/** sets the required permission level to execute this command
+*/
+Stall::Stall() {
+	mMinimumPermissionLevel = Player::AdminPermissions;
+}
+
+/// Destructor
+/** Does nothing
+*/
+Stall::~Stall() {
+}
+
+/// Singleton getter
+Stall & Stall::Instance() {
+	static Stall instance;
+	return instance;
+}
+
+/// tells you the name of this command
+/** This function tells you the name of this command
+	\return the name of this command
+*/
+std::string Stall::getName() {
+	return "stall";
+}
+
+/// returns help info
+/** This function explains how to use this command
+	@param player the player sending the command
+	\return always true
+*/
+bool Stall::help(Player::PlayerPointer player) {
+	std::stringstream s;
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		s << glob.Config.getStringValue("AdminRequired");
+	} else {
+		s << "~br0Usage: stall <seconds>~res" << END;
+		s << "  ~br0Stall~res puts the process thread to sleep for up to " << kMaxStallSeconds << " seconds. Nobody's ";
+		s << "commands will run and no heartbeats will fire while it sleeps. It is for testing the ";
+		s << "watchdog (see the ~b00WatchdogTimeout~res and ~b00WatchdogAbort~res config values); don't use it on a live game!";
+	}
+	player->Write(s.str());
+	player->Prompt();
+	return true;
+}
+
+/// checks to see if the command works with the arguments provided
+/** This command evaluates the arguments and decides whether or not process()
+	can be called correctly. If not, the CommandHandler calls the help() function.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command will run properly
+*/
+bool Stall::canProcess(Player::PlayerPointer player, const std::string &txt) {
+	int seconds = atoi(txt.c_str());
+	return seconds > 0 && seconds <= kMaxStallSeconds;
+}
+
+/// runs the command
+/** This function processes the command with the arguments provided.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command executed properly
+*/
+bool Stall::process(Player::PlayerPointer player, const std::string &txt) {
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		player->Write(glob.Config.getStringValue("AdminRequired"));
+		player->Prompt();
+		return true;
+	}
+
+	if(txt.length() > 1 && txt.substr(0,2) == "-h") {
+		return help(player);
+	}
+
+	int seconds = atoi(txt.c_str());
+
+	glob.log.warn(boost::format("Stall::process(): %1% is stalling the process thread for %2% seconds") % player->getName() % seconds);
+
+	sleep(seconds);
+
+	player->Write(boost::str(boost::format("The process thread slept for %1% seconds.") % seconds));
+	player->Prompt();
+	return true;
+}
@@ -0,0 +1,28 @@
+#ifndef MUD_STALL_H
+#define MUD_STALL_H
+
+#include "command.h"
+#include "player.h"
+
+/// deliberately stalls the process thread
+/** This class puts the process thread to sleep for a number of seconds, so an admin
+	can check that the Watchdog notices and reports a hung tick.
+*/
+class Stall : public Command {
+public:
+	static Stall & Instance();
+	virtual ~Stall();
+
+	bool help(Player::PlayerPointer player);
+
+	virtual std::string getName();
+
+	bool canProcess(Player::PlayerPointer player, const std::string &txt);
+	bool process(Player::PlayerPointer player, const std::string &txt);
+
+private:
+	Stall();
+	Stall(const Stall &);
+	Stall & operator=(const Stall &);
+};
+#endif // MUD_STALL_H
@@ -1,5 +1,6 @@
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include "stats.h"
 
@@ -44,7 +45,12 @@ bool Stats::help(Player::PlayerPointer player) {
 		s << glob.Config.getStringValue("AdminRequired");
 	} else {
 		s << "~br0Usage: stats~res" << END;
-		s << "  ~br0Stats~res displays statistics about the ForeverMUD engine.";
+		s << "  ~br0Stats~res displays statistics about the ForeverMUD engine, including" << END;
+		s << "  p50/p95/p99/max latencies for ticks, heartbeats, commands, flushes and saves," << END;
+		s << "  and for each phase of a tick and heartbeat. ~br0Recent~res is a moving average" << END;
+		s << "  of the last few dozen samples. See ~br0profile zones~res for each zone's heartbeat." << END;
+		s << "  The lock table shows how often each kind of mutex was taken, how often a thread" << END;
+		s << "  had to wait for it, and how long threads waited for and held it.";
 	}
 	player->Write(s.str());
 	player->Prompt();
@@ -81,15 +87,49 @@ bool Stats::process(Player::PlayerPointer player, const std::string &txt) {
 
 	time_t seconds = glob.statEngine.getEngineUptimeSeconds();
 
+	if(seconds < 1) {
+		seconds = 1;
+	}
+
 	unsigned long bytesIn = glob.statEngine.getBytesIn();
 	unsigned long bytesOut = glob.statEngine.getBytesOut();
 
 	std::stringstream s;
 	s << "Writing " << bytesOut / seconds << " bytes per second." << END;
 	s << "Reading " << bytesIn / seconds << " bytes per second." << END;
+
+	unsigned long compressed = glob.statEngine.getCompressionCompressedBytes();
+
+	if(compressed > 0) {
+		s << boost::format("Compressing %1% connections using %2% kB, at %3$.1f:1.") % glob.statEngine.getGauge(StatEngine::CompressedConnectionsGauge) % (glob.statEngine.getGauge(StatEngine::CompressorMemoryGauge) / 1024) % (glob.statEngine.getCompressionRawBytes() / static_cast<double>(compressed)) << END;
+	}
 	s << "Average loop processing time is " << glob.statEngine.getAverageLoopProcessTime() << " microseconds." << END;
 	s << "There are " << glob.zoneDaemon.getNumberOfZones() << " zones loaded." << END;
-	s << "There are " << glob.zoneDaemon.getTotalNumberOfRooms() << " rooms in all the zones.";
+	s << "There are " << glob.zoneDaemon.getTotalNumberOfRooms() << " rooms in all the zones." << END;
+	s << glob.statEngine.getTickOverruns() << " ticks have taken longer than " << TIME_RESOLUTION << " microseconds." << END << END;
+
+	s << "~b00Latency (microseconds)~res" << END;
+	s << boost::format("%-18s %10s %10s %10s %10s %10s %10s") % "" % "count" % "recent" % "p50" % "p95" % "p99" % "max" << END;
+
+	for(int i = 0; i < StatEngine::NumberOfTimers; ++i) {
+		StatEngine::TimerType timer = static_cast<StatEngine::TimerType>(i);
+		const Histogram &h = glob.statEngine.getHistogram(timer);
+
+		s << boost::format("%-18s %10u %10u %10u %10u %10u %10u") % glob.statEngine.getTimerName(timer) % h.getCount() % glob.statEngine.getRecentTime(timer) % h.getPercentile(50.0) % h.getPercentile(95.0) % h.getPercentile(99.0) % h.getMax();
+
+		if(i + 1 < StatEngine::NumberOfTimers) {
+			s << END;
+		}
+	}
+
+	std::vector<LockStatistics> locks = Mutex::getStatistics();
+
+	s << END << END << "~b00Locks (microseconds)~res" << END;
+	s << boost::format("%-18s %10s %10s %12s %10s %12s %10s") % "" % "acquired" % "contended" % "wait total" % "wait max" % "hold total" % "hold max";
+
+	for(std::vector<LockStatistics>::const_iterator it = locks.begin(); it != locks.end(); ++it) {
+		s << END << boost::format("%-18s %10u %10u %12u %10u %12u %10u") % it->name % it->acquisitions % it->contended % it->waitTotal % it->waitMax % it->holdTotal % it->holdMax;
+	}
 
 	player->Write(s.str());
 	player->Prompt();
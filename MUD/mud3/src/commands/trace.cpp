@@ -0,0 +1,119 @@
+#include <string>
+#include <sstream>
+#include <cstdlib>
+
+#include "trace.h"
+#include "utility.h"
+
+#include "global.h"
+extern Global glob;
+
+/// Constructor
+/** sets the required permission level to execute this command
+*/
+Trace::Trace() {
+	mMinimumPermissionLevel = Player::AdminPermissions;
+}
+
+/// Destructor
+/** Does nothing
+*/
+Trace::~Trace() {
+}
+
+/// Singleton getter
+Trace & Trace::Instance() {
+	static Trace instance;
+	return instance;
+}
+
+/// tells you the name of this command
+/** This function tells you the name of this command
+	\return the name of this command
+*/
+std::string Trace::getName() {
+	return "trace";
+}
+
+/// returns help info
+/** This function explains how to use this command
+	@param player the player sending the command
+	\return always true
+*/
+bool Trace::help(Player::PlayerPointer player) {
+	std::stringstream s;
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		s << glob.Config.getStringValue("AdminRequired");
+	} else {
+		s << "~br0Usage: trace [on|off|dump [seconds]]~res" << END;
+		s << "  The flight recorder keeps the last " << TRACE_BUFFER_EVENTS << " socket reads and flushes, commands, ";
+		s << "heartbeat phases, events and file operations in memory. ~br0Trace dump~res writes the last ";
+		s << TRACE_DUMP_SECONDS << " seconds (or as many as you ask for) to a JSON file you can open in ";
+		s << "chrome://tracing or ui.perfetto.dev. Sending the MUD a SIGUSR1 does the same. ";
+		s << "~br0Trace on~res and ~br0trace off~res start and stop recording.";
+	}
+	player->Write(s.str());
+	player->Prompt();
+	return true;
+}
+
+/// checks to see if the command works with the arguments provided
+/** This command evaluates the arguments and decides whether or not process()
+	can be called correctly. If not, the CommandHandler calls the help() function.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command will run properly
+*/
+bool Trace::canProcess(Player::PlayerPointer player, const std::string &txt) {
+	return txt.empty() || Utility::iCompare(txt, "on") || Utility::iCompare(txt, "off") || Utility::iCompare(txt.substr(0, 4), "dump");
+}
+
+/// runs the command
+/** This function processes the command with the arguments provided.
+	@param player the player sending the command
+	@param txt the arguments to the command
+	\return true if the command executed properly
+*/
+bool Trace::process(Player::PlayerPointer player, const std::string &txt) {
+	if(player->getPermissionLevel() < mMinimumPermissionLevel) {
+		player->Write(glob.Config.getStringValue("AdminRequired"));
+		player->Prompt();
+		return true;
+	}
+
+	if(txt.length() > 1 && txt.substr(0,2) == "-h") {
+		return help(player);
+	}
+
+	std::stringstream s;
+
+	if(Utility::iCompare(txt, "on")) {
+		glob.trace.setEnabled(true);
+		s << "The flight recorder is on.";
+	} else if(Utility::iCompare(txt, "off")) {
+		glob.trace.setEnabled(false);
+		s << "The flight recorder is off.";
+	} else if(Utility::iCompare(txt.substr(0, 4), "dump")) {
+		int seconds = txt.length() > 4 ? atoi(txt.substr(4).c_str()) : 0;
+
+		if(seconds < 1) {
+			seconds = TRACE_DUMP_SECONDS;
+		}
+
+		std::string file = glob.trace.dumpRecent(seconds);
+
+		if(file.empty()) {
+			s << "The flight recorder could not be dumped, check the log.";
+			glob.log.error("Trace::process(): Could not dump the flight recorder");
+		} else {
+			s << "The last " << seconds << " seconds were written to " << file << ".";
+			glob.log.info(boost::format("Trace::process(): %1% dumped the flight recorder to %2%") % player->getName() % file);
+		}
+	} else {
+		s << "The flight recorder is " << (glob.trace.isEnabled() ? "on" : "off") << ".";
+	}
+
+	player->Write(s.str());
+	player->Prompt();
+	return true;
+}
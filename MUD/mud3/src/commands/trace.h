@@ -0,0 +1,28 @@
+#ifndef MUD_TRACE_H
+#define MUD_TRACE_H
+
+#include "command.h"
+#include "player.h"
+
+/// controls the flight recorder
+/** This class turns the TraceRecorder on and off, and dumps its recent contents to a
+	Chrome trace-event JSON file for offline viewing.
+*/
+class Trace : public Command {
+public:
+	static Trace & Instance();
+	virtual ~Trace();
+
+	bool help(Player::PlayerPointer player);
+
+	virtual std::string getName();
+
+	bool canProcess(Player::PlayerPointer player, const std::string &txt);
+	bool process(Player::PlayerPointer player, const std::string &txt);
+
+private:
+	Trace();
+	Trace(const Trace &);
+	Trace & operator=(const Trace &);
+};
+#endif // MUD_TRACE_H
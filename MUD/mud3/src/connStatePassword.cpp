@@ -39,75 +39,92 @@ void ConnectionState_Password::process(const std::string &command) {
 		message->setBody(boost::format("%1% has entered the world") % Utility::toProper(mPlayer->getName()));
 		glob.playerDatabase.broadcast(message);
 
-		// add the player to the room
-		ObjectLocation loc = mPlayer->getLocation();
-		Room::RoomPointer room;
-		Zone::ZonePointer zone;
+		enterWorld(mPlayer);
+		mPlayer->Prompt();
 
-		std::string startRoom, startZone;
-		startRoom = glob.Config.getStringValue("StartingRoom");
-		startZone = glob.Config.getStringValue("StartingZone");
+		// it's important to do this last, otherwise we lose the mPlayer pointer for this object!
+		mPlayer->setConnectionState(Connection::ConnState_Play);
+	}
+}
 
-		if(startRoom.empty() || startZone.empty()) {
-			glob.log.error("ConnStatePassword: No Starting Room or Zone configured. This is very, very bad.");
-		}
+/// puts a player who has just logged in into their room and shows it to them
+/** Players whose room or zone is gone are moved to the starting room. This is shared
+	with HotReboot, which puts players back after a restart.
+	@param player the player
+	\return false if the player could not be put in a room, in which case they were disconnected
+*/
+bool ConnectionState_Password::enterWorld(Player::PlayerPointer player) {
+	// add the player to the room
+	ObjectLocation loc = player->getLocation();
+	Room::RoomPointer room;
+	Zone::ZonePointer zone;
+
+	std::string startRoom, startZone;
+	startRoom = glob.Config.getStringValue("StartingRoom");
+	startZone = glob.Config.getStringValue("StartingZone");
+
+	if(startRoom.empty() || startZone.empty()) {
+		glob.log.error("ConnStatePassword: No Starting Room or Zone configured. This is very, very bad.");
+	}
 
-		switch(loc.type) {
-		case RoomObject:
-			zone = glob.zoneDaemon.getZone(loc.zone);
-
-			if(!zone) {
-				glob.log.error(boost::format("ConnStatePassword: Zone %1% (player %2%) does not exist! Moving to starting room") % loc.zone % mPlayer->getName());
-				zone = glob.zoneDaemon.getZone(startZone);
-				room = zone->getRoom(startRoom);
-				loc.zone = startZone;
-				loc.location = startRoom;
-				mPlayer->setLocation(loc);
-			}
+	switch(loc.type) {
+	case RoomObject:
+		zone = glob.zoneDaemon.getZone(loc.zone);
 
-			room = zone->getRoom(loc.location);
+		if(!zone) {
+			glob.log.error(boost::format("ConnStatePassword: Zone %1% (player %2%) does not exist! Moving to starting room") % loc.zone % player->getName());
+			zone = glob.zoneDaemon.getZone(startZone);
+			room = zone->getRoom(startRoom);
+			loc.zone = startZone;
+			loc.location = startRoom;
+			player->setLocation(loc);
+		}
 
-			if(!room) {
-				glob.log.warn(boost::format("ConnStatePassword: Room %1% does not exist in zone %2%") % loc.location % loc.zone);
+		room = zone->getRoom(loc.location);
 
-				zone = glob.zoneDaemon.getZone(startZone);
-				room = zone->getRoom(startRoom);
+		if(!room) {
+			glob.log.warn(boost::format("ConnStatePassword: Room %1% does not exist in zone %2%") % loc.location % loc.zone);
 
-				if(!room) {
-					glob.log.error(boost::format("ConnStatePassword: The default room %1% in zone %2% is not valid!") % startRoom % startZone);
-					assert(0);
-				}
+			zone = glob.zoneDaemon.getZone(startZone);
+			room = zone->getRoom(startRoom);
 
-				loc.zone = startZone;
-				loc.location = startRoom;
-				mPlayer->setLocation(loc);
-				glob.log.warn(boost::format("ConnStatePassword: Setting player location to zone %1% room %2%") % loc.zone % loc.location);
+			if(!room) {
+				glob.log.error(boost::format("ConnStatePassword: The default room %1% in zone %2% is not valid!") % startRoom % startZone);
+				assert(0);
 			}
 
-			if(!room->containerAdd(mPlayer)) {
-				glob.log.warn(boost::format("ConnStatePassword: Could not add player %1% object to room %2% in zone %3%") % mPlayer->getName() % loc.location % loc.zone);
-				glob.playerDatabase.remove(mPlayer);
-			}
-			break;
-		default:
-			glob.log.error("ConnStatePassword: Player is not in a RoomObject");
-			mPlayer->Write("Cannot restore your location!");
-			zone = glob.zoneDaemon.getZone(startZone);
-			room = zone->getRoom(startRoom);
 			loc.zone = startZone;
 			loc.location = startRoom;
-			mPlayer->setLocation(loc);
-			if(!room->containerAdd(mPlayer)) {
-				glob.log.error("ConnStatePassword: Default case, can't add player to starting room!");
-				glob.playerDatabase.remove(mPlayer);
-			}
-			break;
+			player->setLocation(loc);
+			glob.log.warn(boost::format("ConnStatePassword: Setting player location to zone %1% room %2%") % loc.zone % loc.location);
 		}
 
-		mPlayer->Write(room->getFullDescription(mPlayer->getName()));
-		mPlayer->Prompt();
+		if(!room->containerAdd(player)) {
+			glob.log.warn(boost::format("ConnStatePassword: Could not add player %1% object to room %2% in zone %3%") % player->getName() % loc.location % loc.zone);
+			glob.playerDatabase.remove(player);
+			return false;
+		}
+		break;
+	default:
+		glob.log.error("ConnStatePassword: Player is not in a RoomObject");
+		player->Write("Cannot restore your location!");
+		zone = glob.zoneDaemon.getZone(startZone);
+		room = zone->getRoom(startRoom);
+		loc.zone = startZone;
+		loc.location = startRoom;
+		player->setLocation(loc);
+		if(!room->containerAdd(player)) {
+			glob.log.error("ConnStatePassword: Default case, can't add player to starting room!");
+			glob.playerDatabase.remove(player);
+			return false;
+		}
+		break;
+	}
 
-		// it's important to do this last, otherwise we lose the mPlayer pointer for this object!
-		mPlayer->setConnectionState(Connection::ConnState_Play);
+	if(!room) {
+		return false;
 	}
+
+	player->Write(room->getFullDescription(player->getName()));
+	return true;
 }
@@ -12,6 +12,8 @@ public:
 
 	bool inPlayState() const { return false; }
 
+	static bool enterWorld(boost::shared_ptr<Player> player);
+
 private:
 	unsigned int mNumberOfAttempts;
 };
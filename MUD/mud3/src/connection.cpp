@@ -1,9 +1,6 @@
-#include <pthread.h>	// for reverseDNSLookup()
-#include <netdb.h>		// for gethostbyaddr_r
-#include <arpa/inet.h>	// for inet_pton
-
 #include "connection.h"
 #include "utility.h"
+#include "timer.h"
 #include "connStateClosed.h"
 #include "connStateLogin.h"
 #include "connStatePassword.h"
@@ -15,16 +12,61 @@ extern Global glob;
 
 class Player;
 
+/// reads an input limit from the config
+/** @param key the config integer
+	@param fallback the value from mudconfig.h, used when the key isn't set
+	\return the limit; 0 means none
+*/
+static unsigned int inputSetting(const std::string &key, const unsigned int fallback) {
+	int value = glob.Config.getIntValue(key);
+	return value < 0 ? fallback : static_cast<unsigned int>(value);
+}
+
+/// reads the CommandOverflowPolicy config string
+static Connection::OverflowPolicy overflowSetting() {
+	std::string policy = glob.Config.getStringValue("CommandOverflowPolicy");
+
+	if(policy.empty()) {
+		policy = COMMAND_OVERFLOW_POLICY;
+	}
+
+	if(Utility::iCompare(policy, "drop")) {
+		return Connection::OverflowDrop;
+	} else if(Utility::iCompare(policy, "disconnect")) {
+		return Connection::OverflowDisconnect;
+	}
+
+	return Connection::OverflowWarn;
+}
+
 /// Constructor
 /** The constructor sets up some default values that should be overwritten when
-	the Player is loaded
+	the Player is loaded, and reads the input limits from the config
 */
-Connection::Connection() {
+Connection::Connection() : mCommandBusy("Connection") {
 	mLogonTime = time(NULL);
 	mLastCommandTime = time(NULL);
+	mLastInputTime = 0;
+	mStateEnteredAt = time(NULL);
+	mReapSerial = 0;
 	mResolutionX = glob.Config.getIntValue("DefaultClientScreenX");
 	mResolutionY = glob.Config.getIntValue("DefaultClientScreenY");
 	mConnectionState = boost::shared_ptr<ConnectionState>(new ConnectionState_Closed());
+	mConnectionStateType = ConnState_Closed;
+	mUsingPublicIPAddress = false;
+	mHostnamePending = false;
+	mHostnameDeadline = 0;
+
+	mDiscardingLine = false;
+	mLinesWaiting = false;
+	mBytesThrottled = false;
+	mLinesThrottled = false;
+	mOverflowWarned = false;
+	mInputBytes.configure(inputSetting("InputByteRate", INPUT_BYTE_RATE), inputSetting("InputByteBurst", INPUT_BYTE_BURST));
+	mInputLines.configure(inputSetting("InputLineRate", INPUT_LINE_RATE), inputSetting("InputLineBurst", INPUT_LINE_BURST));
+	mMaxQueuedCommands = inputSetting("MaxQueuedCommands", MAX_QUEUED_COMMANDS);
+	mMaxLineLength = inputSetting("MaxInputLineLength", MAX_INPUT_LINE_LENGTH);
+	mOverflowPolicy = overflowSetting();
 }
 
 /// Destructor
@@ -37,6 +79,7 @@ Connection::~Connection() {
 /** This function records the IP address the connection is coming from, and
 	determines whether it is from a public or private IP address, which decides
 	whether a reverse-DNS lookup should be performed to get the real hostname.
+	Public addresses use the IP as their hostname until the Resolver answers.
 	@param ip the IP address the connection is coming from
 */
 void Connection::setHostIP(const std::string &ip) {
@@ -113,35 +156,62 @@ void Connection::setHostIP(const std::string &ip) {
 		mUsingPublicIPAddress = true;
 	}
 
-	pthread_attr_t attr;
-	pthread_t thread_lookup;
-
-	// spawn a thread to handle the reverse DNS lookup
+	// queue a reverse DNS lookup; Read() collects the answer
 	if(mUsingPublicIPAddress) {
-		glob.log.debug("Spawning a DNS lookup thread");
-		// initialize and create lookup thread
-		pthread_attr_init(&attr);
-		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-		pthread_create(&thread_lookup, &attr, reverseDNSLookup, (void *)this);
+		setHostname(mIp);
+		mHostnamePending = glob.resolver.request(mIp);
+		mHostnameDeadline = time(NULL) + glob.resolver.getTimeout();
+
+		if(mHostnamePending) {
+			checkHostname();
+		}
 	} else {
 		glob.log.info(boost::format("Client descriptor %1% has a private IP address") % getFd());
 		setHostname("Private");
 	}
 }
 
+/// collects the connection's hostname from the Resolver
+/** The Resolver never touches the connection, so this function polls its cache until
+	there is an answer or the lookup timeout passes. If the address has no name, the IP
+	stays as the hostname.
+*/
+void Connection::checkHostname() {
+	std::string hostname;
+
+	switch(glob.resolver.lookup(mIp, hostname)) {
+	case Resolver::Resolved:
+		setHostname(hostname);
+		mHostnamePending = false;
+		glob.log.debug(boost::format("Client descriptor %1% is %2% (%3%)") % getFd() % hostname % mIp);
+		break;
+	case Resolver::Unresolvable:
+		mHostnamePending = false;
+		break;
+	default:
+		if(time(NULL) > mHostnameDeadline) {
+			mHostnamePending = false;
+		}
+	}
+}
+
 /// gets the next command
 /** This function returns the next command the player sent to the driver.
 	\return the text of the player's next command or a blank string if none
 */
 std::string Connection::getNextCommand() {
-	if(mCommandQueue.size() == 0) {
-		return "";
+	std::string cmd;
+
+	if(!mCommandBusy.lock()) {
+		return cmd;
 	}
 
-	StringVector::iterator it = mCommandQueue.begin();
-	std::string cmd = *it;
-	mCommandQueue.erase(it);
+	if(!mCommandQueue.empty()) {
+		cmd = mCommandQueue.front();
+		mCommandQueue.pop_front();
+	}
 
+	mCommandBusy.unlock();
 	return cmd;
 }
 
@@ -179,11 +249,91 @@ bool Connection::setResolution(const int x, const int y) {
 
 /// read's from the player's socket
 /** This function asks the ClientSocket object to read its input buffer, then
-	pushes control over to parseBuffer() to process the results.
+	pushes control over to parseBuffer() to process the results. No more is read than
+	the connection's InputByteRate allows; once that runs out, isInputPaused() tells the
+	driver to stop watching the socket until it refills.
+	\return false if the connection should be closed
 */
 bool Connection::Read() {
-	bool result = mSocket.read_socket();
-	parseBuffer();
+	unsigned long long now = Timer::now();
+	unsigned int allowance = kMaxSocketInputBufferLength;
+
+	if(mInputBytes.isLimited()) {
+		double tokens = mInputBytes.getTokens(now);
+
+		if(tokens < allowance) {
+			allowance = static_cast<unsigned int>(tokens);
+		}
+
+		if(mBytesThrottled && mInputBytes.isFull(now)) {
+			mBytesThrottled = false;
+		}
+	}
+
+	bool result = true;
+
+	if(allowance > 0) {
+		unsigned int bytesRead = 0;
+		result = mSocket.read_socket(allowance, bytesRead);
+		mInputBytes.take(now, bytesRead);
+
+		if(mInputBytes.isLimited() && mInputBytes.getTokens(now) < 1 && !mBytesThrottled) {
+			mBytesThrottled = true;
+			glob.statEngine.addInputLimit(StatEngine::InputBytesThrottled);
+
+			if(glob.log.throttle("Connection::Read(): bytes throttled")) {
+				glob.log.info(boost::format("Client descriptor %1% (%2%) sent more than its InputByteRate, pausing reads") % getFd() % mIp);
+			}
+		}
+	}
+
+	if(mHostnamePending) {
+		checkHostname();
+	}
+
+	int x, y;
+	if(mSocket.takeWindowSize(x, y)) {
+		// NAWS, at login or after the window was resized
+		setResolution(x, y);
+	}
+
+	if(!parseBuffer(now)) {
+		return false;
+	}
+
+	return result;
+}
+
+/// checks whether the driver should stop reading this connection for now
+/** @param now the time, from Timer::now()
+	\return true while the connection is over its byte rate, or has whole lines waiting
+		for its line rate
+*/
+bool Connection::isInputPaused(const unsigned long long now) {
+	if(mLinesWaiting) {
+		return true;
+	}
+
+	return mInputBytes.isLimited() && mInputBytes.getTokens(now) < 1;
+}
+
+/// queues lines that were held back by the line rate, if it allows them now
+/** The driver calls this for paused connections, since a paused socket isn't read
+	and so wouldn't get to parseBuffer() otherwise.
+	@param now the time, from Timer::now()
+	\return false if the connection should be closed
+*/
+bool Connection::resumeInput(const unsigned long long now) {
+	if(!mLinesWaiting) {
+		return true;
+	}
+
+	bool result = parseBuffer(now);
+
+	if(result) {
+		mSocket.flush();
+	}
+
 	return result;
 }
 
@@ -191,10 +341,19 @@ bool Connection::Read() {
 /** This is the only way to send players text. Use it wisely.
 	@param txt the text you are sending to the client.
 	\note The ClientSocket handles the actual ANSI color parsing
+	\note Compressed output waits for PlayerDatabase::flushOutput() at the end of the tick
+	\note Clients that wrap text themselves get it unwrapped
+	\note A connection that can't be written to isn't closed here, since the caller may be
+		walking the player list; its socket stays marked and flushOutput() closes it
 */
 void Connection::Write(const std::string &txt) {
-	mSocket.to_client(txt, mResolutionX);
-	mSocket.flush();
+	mSocket.to_client(txt, mSocket.wrapsItself() ? 0 : mResolutionX);
+
+	if(!mSocket.isCompressing() && !mSocket.flush()) {
+		if(glob.log.throttle("Connection::Write()")) {
+			glob.log.warn(boost::format("Connection::Write(): Can't write to descriptor %1%, closing it at the end of the tick") % getFd());
+		}
+	}
 }
 
 /// Overrides the normal Write to accept a boost::format instead
@@ -215,75 +374,150 @@ void Connection::Write(const boost::format &txt) {
 */
 void Connection::Write(const StringVector &list) {
 	mSocket.to_client(list, mResolutionX);
-	mSocket.flush();
+
+	if(!mSocket.isCompressing() && !mSocket.flush()) {
+		if(glob.log.throttle("Connection::Write()")) {
+			glob.log.warn(boost::format("Connection::Write(): Can't write to descriptor %1%, closing it at the end of the tick") % getFd());
+		}
+	}
 }
 
 /// goes through the input buffer, extracts commands, adds them to the queue
 /** This function takes the raw socket input, extracts multiple commands (if there
-	are any) and adds them all to the command queue for later execution.
+	are any) and adds them all to the command queue for later execution. Text after the
+	last newline waits for the rest of its line.
+
+	Each line takes a token from the connection's InputLineRate bucket, and lines that
+	find it empty wait in mPendingInput until it refills. Lines longer than
+	MaxInputLineLength are cut short and the rest of the line is thrown away.
+	@param now the time, from Timer::now()
+	\return false if the connection should be closed for flooding its command queue
 */
-void Connection::parseBuffer() {
+bool Connection::parseBuffer(const unsigned long long now) {
 	std::string buffer;
 	mSocket.get_in_buffer(buffer);
 
 	// remove any errant carriage-return characters (who hates Windows? Anyone?)
 	buffer = Utility::stringReplace(buffer, "\r", "");
 
-	StringVector clist = Utility::stringToVector(buffer, "\n");
-	for(StringVector::iterator it = clist.begin(); it != clist.end(); ++it) {
-		if((*it).length() > 0) {
-			mCommandQueue.push_back(Utility::stringClean(*it));
+	if(mDiscardingLine) {
+		// the rest of a line that was already cut short
+		std::string::size_type end = buffer.find('\n');
+
+		if(end == std::string::npos) {
+			buffer.clear();
+		} else {
+			buffer.erase(0, end);
+			mDiscardingLine = false;
 		}
 	}
 
-	glob.log.debug(boost::format("CommandQueue has %1% commands queued up") % mCommandQueue.size());
-}
+	mPendingInput += buffer;
 
+	if(mLinesThrottled && mInputLines.isFull(now)) {
+		mLinesThrottled = false;
+	}
 
-/// private function for reverse DNS lookup functionality
-/** This function runs as its own thread and looks up an IP address, attempting
-	to resolve it to a friendly hostname. If successful, it populates a Player
-	object with the proper hostname. Buffer sizes are defined in mudconfig.h.
-*/
-void *reverseDNSLookup(void *arg) {
-	if(arg == NULL) {
-		perror("NULL argument sent to lookup thread!");
-		pthread_exit(0);
+	std::string::size_type start = 0;
+	std::string::size_type end;
+	mLinesWaiting = false;
+
+	while((end = mPendingInput.find('\n', start)) != std::string::npos) {
+		std::string command = Utility::stringClean(mPendingInput.substr(start, end - start));
+
+		if(!command.empty()) {
+			if(!mInputLines.take(now)) {
+				mLinesWaiting = true;
+
+				if(!mLinesThrottled) {
+					mLinesThrottled = true;
+					glob.statEngine.addInputLimit(StatEngine::InputLinesThrottled);
+
+					if(glob.log.throttle("Connection::parseBuffer(): lines throttled")) {
+						glob.log.info(boost::format("Client descriptor %1% (%2%) sent more than its InputLineRate, holding lines back") % getFd() % mIp);
+					}
+				}
+				break;
+			}
+
+			if(mMaxLineLength > 0 && command.length() > mMaxLineLength) {
+				command.resize(mMaxLineLength);
+				glob.statEngine.addInputLimit(StatEngine::InputLinesTruncated);
+			}
+
+			if(!queueCommand(command)) {
+				return false;
+			}
+		}
+
+		start = end + 1;
 	}
 
-	Connection *connection = (Connection *)arg;
+	mPendingInput.erase(0, start);
 
-	int error;
-	char buffer[HOST_BUFFER_LENGTH] = {0}; // host database entries are stored here, 256 bytes is usually safe, 2k should be more than enough
-	char ip[HOST_IP_LENGTH] = {0}; // should be 16 at most
+	if(!mLinesWaiting && mMaxLineLength > 0 && mPendingInput.length() > mMaxLineLength) {
+		// no end of line in sight: keep the start, and drop everything up to the newline
+		mPendingInput.resize(mMaxLineLength);
+		mDiscardingLine = true;
+		glob.statEngine.addInputLimit(StatEngine::InputLinesTruncated);
 
-	assert(connection->getHostIP().length() < HOST_IP_LENGTH);
+		if(glob.log.throttle("Connection::parseBuffer(): long line")) {
+			glob.log.info(boost::format("Client descriptor %1% (%2%) sent a line longer than %3% characters") % getFd() % mIp % mMaxLineLength);
+		}
+	}
 
-	strcpy(ip, connection->getHostIP().c_str());
+	if(glob.log.throttle("Connection::parseBuffer()")) {
+		glob.log.debug(boost::format("CommandQueue has %1% commands queued up") % mCommandQueue.size());
+	}
 
-	struct hostent	fromHost,
-					*from = &fromHost,
-					ent;
+	return true;
+}
 
-	struct in_addr host;
-	void *addr = &host;
+/// adds a command to the queue, unless MaxQueuedCommands are already waiting
+/** A command that finds the queue full is handled by the CommandOverflowPolicy.
+	@param command the command
+	\return false if the policy is to disconnect and the queue was full
+*/
+bool Connection::queueCommand(const std::string &command) {
+	mLastInputTime = time(NULL);
 
-	// initialize host structure
-	memset(addr, 0, sizeof(struct in_addr));
+	if(!mCommandBusy.lock()) {
+		return true;
+	}
 
-	// convert dotted quad ip to network address structure in AF_INET (IPv4) family
-	inet_pton(SOCKET_DOMAIN, ip, addr);
+	bool queued = false;
 
-	// do the lookup and store the result at &from
-	gethostbyaddr_r(addr, sizeof(struct in_addr), SOCKET_DOMAIN, &ent, buffer, sizeof(buffer), &from, &error);
+	if(mMaxQueuedCommands == 0 || mCommandQueue.size() < mMaxQueuedCommands) {
+		mCommandQueue.push_back(command);
+		queued = true;
+	}
 
-	if(from != NULL && strlen(from->h_name) > 0) {
-		connection->setHostname(from->h_name);
+	mCommandBusy.unlock();
+
+	if(queued) {
+		mOverflowWarned = false;
+		return true;
+	}
+
+	if(mOverflowPolicy == OverflowDisconnect) {
+		glob.statEngine.addInputLimit(StatEngine::CommandFloodDisconnects);
+		glob.log.warn(boost::format("Client descriptor %1% (%2%) has %3% commands waiting, disconnecting it") % getFd() % mIp % mMaxQueuedCommands);
+		mSocket.to_client("You are sending commands faster than they can be run. Goodbye." END, mResolutionX);
+		mSocket.flush();
+		return false;
+	}
+
+	glob.statEngine.addInputLimit(StatEngine::CommandsDropped);
+
+	if(mOverflowPolicy == OverflowWarn && !mOverflowWarned) {
+		mOverflowWarned = true;
+		mSocket.to_client("~br0You have too many commands waiting; new ones are ignored until they catch up.~res" END, mResolutionX);
 	}
 
-	pthread_exit(0);
+	return true;
 }
 
+
 /// generates a string representation of the object
 /** This function saves the text information for this object so
 	it may be reloaded later.
@@ -318,6 +552,12 @@ bool Connection::connectionLoad(const YAML::Node &node) {
 		node["colorblind"] >> colorblind;
 		setColorBlindness(colorblind);
 
+		// a size the client reported beats the saved one
+		int x, y;
+		if(mSocket.getWindowSize(x, y)) {
+			setResolution(x, y);
+		}
+
 		success = true;
 	} catch(YAML::ParserException &e) {
 		glob.log.error(boost::format("Player::playerLoad: YAML parser exception caught: %1%") % e.what());
@@ -362,7 +602,11 @@ void Connection::setConnectionState(ConnStateEnum state) {
 		glob.log.error(boost::format("Connection::setConnectionState(): Unrecognized connection state %1%") % state);
 	}
 
+	mConnectionStateType = state;
+	mStateEnteredAt = time(NULL);
+
 	if(success) {
 		mConnectionState->mPlayer = glob.playerDatabase.getPlayer(getFd());
+		mReapSerial = glob.reaper.watch(getFd(), state, mStateEnteredAt);
 	}
 }
@@ -1,16 +1,18 @@
 #ifndef MUD_CONNECTION_H
 #define MUD_CONNECTION_H
 
+#include <string>
+#include <deque>
 #include <yaml-cpp/yaml.h>
 #include <boost/format.hpp>
 
 #include "mudconfig.h"
 #include "client_socket.h"
+#include "tokenBucket.h"
+#include "mutex.h"
 
 #include "connectionState.h"
 
-void *reverseDNSLookup(void *arg);
-
 /// a class to handle lower-level connection stuff
 /** This class handles some of the connection functions for a Player, which
 	should inherit form this class.
@@ -25,6 +27,13 @@ public:
 		ConnState_Play
 	} ConnStateEnum;
 
+	/// what happens to a command that finds MaxQueuedCommands already waiting
+	typedef enum {
+		OverflowDrop = 0,		///< throw it away
+		OverflowWarn,			///< throw it away, and tell the player the first time
+		OverflowDisconnect		///< close the connection
+	} OverflowPolicy;
+
 	Connection();
 	virtual ~Connection();
 
@@ -49,6 +58,28 @@ public:
 	/// flush the outgoing stream down the player's socket
 	bool Flush() { return mSocket.flush(); }
 
+	/// starts telnet negotiation: MCCP2, GMCP, window size and terminal type
+	void negotiate() { mSocket.negotiate(); }
+	/// gets the client's name, if it sent one with TTYPE
+	std::string getClientName() { return mSocket.getClientName(); }
+	/// true if the client wraps text itself
+	bool wrapsItself() const { return mSocket.wrapsItself(); }
+	/// true if the client reports its window size with NAWS
+	bool reportsWindowSize() const { int x, y; return mSocket.getWindowSize(x, y); }
+	/// true if output to this player is being compressed
+	bool isCompressing() const { return mSocket.isCompressing(); }
+	/// true if the client has turned on GMCP
+	bool isGmcpEnabled() const { return mSocket.isGmcpEnabled(); }
+	/// true if the client asked for a GMCP message's package
+	bool gmcpSupports(const std::string &message) { return mSocket.gmcpSupports(message); }
+	/// queues a GMCP message; see ClientSocket::gmcpSend()
+	bool gmcpSend(const std::string &message, const GmcpObject &object, const GmcpSession::SendMode mode = GmcpSession::SendAlways) { return mSocket.gmcpSend(message, object, mode); }
+
+	/// sends what is queued and records the client's options, ahead of a hot reboot
+	bool detachSocket(SocketState &state) { return mSocket.detach(state); }
+	/// takes up the client's options from before a hot reboot
+	void attachSocket(const SocketState &state) { mSocket.attach(state); }
+
 	/// sets the player's next command
 	std::string getNextCommand();
 
@@ -58,6 +89,11 @@ public:
 	/// gets the time the player logged on
 	time_t getLogonTime() const { return mLogonTime; }
 
+	/// gets when the client last sent a line, or entered its connection state if that was later
+	time_t getLastActive() const { return mLastInputTime > mStateEnteredAt ? mLastInputTime : mStateEnteredAt; }
+	/// gets the serial of this connection's current IdleReaper deadline
+	unsigned long getReapSerial() const { return mReapSerial; }
+
 	/// resets the time the player last sent a command
 	void resetLastCommandTime() { mLastCommandTime = time(NULL); }
 	/// gets the time the player last sent a command
@@ -81,11 +117,16 @@ public:
 	int getResolutionY() const { return mResolutionY; }
 
 	bool Read();
+	bool isInputPaused(const unsigned long long now);
+	bool resumeInput(const unsigned long long now);
 
 	void Write(const std::string &txt);
 	void Write(const boost::format &txt);
 	void Write(const StringVector &list);
 
+	/// gets the memory held by this connection's socket buffers
+	unsigned long getBufferedBytes() { return mSocket.getBufferedBytes(); }
+
 	/// passes ANSI color parsing on to ClientSocket::parseColor()
 	std::string parseColor(const std::string &txt) { return mSocket.parseColor(txt); }
 
@@ -99,24 +140,48 @@ public:
 
 	bool inPlayState() const { return mConnectionState->inPlayState(); }
 
+	/// gets which connection state the player is in
+	ConnStateEnum getConnectionState() const { return mConnectionStateType; }
+
 private:
 	std::string mIp;	///< Source of connected IP
 	std::string mHostname;	///< Resolved name of connected IP, if public
 	bool mUsingPublicIPAddress;	///< Whether or not the connection is from a public IP address
+	bool mHostnamePending;	///< true while waiting for the Resolver
+	time_t mHostnameDeadline;	///< when to stop waiting for the Resolver
 
 	ClientSocket mSocket;	///< Basic communication functionality
 
 	boost::shared_ptr<ConnectionState> mConnectionState;	///< What state is the player in?
-
-	StringVector mCommandQueue;	///< holds upcoming commands from the client
+	ConnStateEnum mConnectionStateType;	///< Which of the ConnStateEnum states mConnectionState is
+
+	Mutex mCommandBusy;	///< guards mCommandQueue, which the driver fills and the process thread empties
+	std::deque<std::string> mCommandQueue;	///< holds upcoming commands from the client
+	std::string mPendingInput;	///< text after the last whole line, and lines held back by mInputLines
+	bool mDiscardingLine;	///< true while throwing away the rest of a line past mMaxLineLength
+	bool mLinesWaiting;	///< true while mPendingInput holds whole lines mInputLines held back
+
+	TokenBucket mInputBytes;	///< limits bytes read, InputByteRate per second
+	TokenBucket mInputLines;	///< limits lines queued, InputLineRate per second
+	bool mBytesThrottled;	///< true from the read that emptied mInputBytes until it refills
+	bool mLinesThrottled;	///< true from the line that emptied mInputLines until it refills
+	bool mOverflowWarned;	///< true once the player has been told their commands are being dropped
+	unsigned int mMaxQueuedCommands;	///< the most commands that may wait; 0 for no limit
+	unsigned int mMaxLineLength;	///< the longest line kept whole; 0 for no limit
+	OverflowPolicy mOverflowPolicy;	///< what to do with a command when the queue is full
 
 	time_t mLogonTime;	///< Used to determine how long a connection has been open
 	time_t mLastCommandTime;	///< Used to generate idle time
+	volatile time_t mLastInputTime;	///< when the client last sent a line, for the IdleReaper
+	time_t mStateEnteredAt;	///< when the current connection state began
+	unsigned long mReapSerial;	///< tells the IdleReaper which of its deadlines is current
 
 	int mResolutionX;	///< The player's terminal x resolution
 	int mResolutionY;	///< The player's terminal y resolution
 
-	void parseBuffer();
+	bool parseBuffer(const unsigned long long now);
+	bool queueCommand(const std::string &command);
+	void checkHostname();
 };
 
 #endif // MUD_CONNECTION_H
@@ -89,7 +89,17 @@ void EventDaemon::processEvents() {
 
 			glob.log.debug(boost::format("EventDaemon::processEvents(): Event triggered for %1%") % pos->getTarget());
 
-			eventPos->second->process(pos->getTarget(), type, pos->getArguments());
+			{
+				std::string detail;
+				TraceSpan span(glob.trace, "event", "EventDaemon::fire");
+
+				if(span.isActive()) {
+					detail = pos->getEventName() + " for " + pos->getTarget();
+					span.setDetail(detail.c_str());
+				}
+
+				eventPos->second->process(pos->getTarget(), type, pos->getArguments());
+			}
 
 			mEventList.erase(pos);
 		}
@@ -26,6 +26,12 @@ public:
 	void addEvent(const Event &event) { mEventList.push_back(event); }
 	void processEvents();
 
+	/// how many events are waiting to fire
+	unsigned int getNumberOfEvents() const { return mEventList.size(); }
+
+	/// roughly how much memory the event queue holds, in bytes
+	unsigned long getMemoryUsage() const { return mEventList.capacity() * sizeof(Event); }
+
 	std::vector<Event> getEventsForTarget(const std::string &name) const;
 	void clearEventsForTarget(const std::string &name);
 
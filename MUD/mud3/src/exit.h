@@ -3,6 +3,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include "mudconfig.h"
+#include "memoryAccount.h"
 #include "player.h"
 
 /// handles all exits from a room
@@ -10,6 +11,8 @@
 	they lead. It also controls whether doors are present, closed, or locked.
 */
 class Exit {
+	MEMORY_ACCOUNTED(MemoryAccount::RoomsTag)
+
 public:
 	/// shortcut to make shared pointers easier to write
 	typedef boost::shared_ptr<Exit> ExitPointer;
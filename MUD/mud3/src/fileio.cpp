@@ -9,18 +9,9 @@ extern Global glob;
 namespace bf = boost::filesystem;
 
 /// Constructor
-/** This constructor initializes the read and write mutexes (mutices?)
+/** This constructor names the read and write mutexes (mutices?)
 */
-FileIO::FileIO() {
-	if(pthread_mutex_init(&mReadLock, NULL) != 0) {
-		perror("FileIO: read lock mutex initialization error");
-		exit(MUTEX_ERROR);
-	}
-
-	if(pthread_mutex_init(&mWriteLock, NULL) != 0) {
-		perror("FileIO: write lock mutex initialization error");
-		exit(MUTEX_ERROR);
-	}
+FileIO::FileIO() : mReadLock("FileIO read"), mWriteLock("FileIO write") {
 }
 
 /// Destructor
@@ -41,7 +32,13 @@ bool FileIO::write(const std::string &file, const std::string &data) {
 	bool result = false;
 	std::ofstream fout;
 
-	if(pthread_mutex_lock(&mWriteLock) == 0) {
+	TraceSpan span(glob.trace, "io", "FileIO::write");
+
+	if(span.isActive()) {
+		span.setDetail(file.c_str());
+	}
+
+	if(mWriteLock.lock()) {
 		fout.open(file.c_str(), std::ios::out | std::ios::trunc);
 		if(fout.is_open()) {
 			fout << data;
@@ -50,7 +47,7 @@ bool FileIO::write(const std::string &file, const std::string &data) {
 		} else {
 			glob.log.error(boost::format("FileIO::write(): Error opening file %1% for writing") % file);
 		}
-		pthread_mutex_unlock(&mWriteLock);
+		mWriteLock.unlock();
 	} else {
 		glob.log.error(boost::format("FileIO::write(): Error locking mutex for writing file %1%") % file);
 	}
@@ -67,7 +64,13 @@ bool FileIO::append(const std::string &file, const std::string &data) {
 	bool result = false;
 	std::ofstream fout;
 
-	if(pthread_mutex_lock(&mWriteLock) == 0) {
+	TraceSpan span(glob.trace, "io", "FileIO::append");
+
+	if(span.isActive()) {
+		span.setDetail(file.c_str());
+	}
+
+	if(mWriteLock.lock()) {
 		fout.open(file.c_str(), std::ios::out | std::ios::app);
 		if(fout.is_open()) {
 			fout << data;
@@ -76,7 +79,7 @@ bool FileIO::append(const std::string &file, const std::string &data) {
 		} else {
 			glob.log.error(boost::format("FileIO::append(): Error appending to file %1%") % file);
 		}
-		pthread_mutex_unlock(&mWriteLock);
+		mWriteLock.unlock();
 	} else {
 		glob.log.error(boost::format("FileIO::append(): Error locking mutex for appending file %1%") %  file);
 	}
@@ -92,7 +95,13 @@ bool FileIO::append(const std::string &file, const std::string &data) {
 std::string FileIO::read(const std::string &file) {
 	std::stringstream s;
 
-	if(pthread_mutex_lock(&mReadLock) == 0) {
+	TraceSpan span(glob.trace, "io", "FileIO::read");
+
+	if(span.isActive()) {
+		span.setDetail(file.c_str());
+	}
+
+	if(mReadLock.lock()) {
 		std::ifstream fin;
 		fin.open(file.c_str(), std::ios::in);
 		if(fin.is_open()) {
@@ -102,7 +111,7 @@ std::string FileIO::read(const std::string &file) {
 			s << IO_RESOURCE_NOT_FOUND;
 			glob.log.warn(boost::format("FileIO::read(): Error opening file %1% for reading") % file);
 		}
-		pthread_mutex_unlock(&mReadLock);
+		mReadLock.unlock();
 	} else {
 		glob.log.error(boost::format("FileIO::read(): Could not lock mutex for reading file %1%") % file);
 	}
@@ -7,6 +7,7 @@
 #include <pthread.h>
 
 #include "mudconfig.h"
+#include "mutex.h"
 
 /// class for reading files from the disk
 /** This class is used by the abstraction layer to read and write files from and to
@@ -27,8 +28,8 @@ public:
 	StringVector getDirectoriesIn(const std::string &path) const;
 
 private:
-	pthread_mutex_t mReadLock;
-	pthread_mutex_t mWriteLock;
+	Mutex mReadLock;	///< serializes reads
+	Mutex mWriteLock;	///< serializes writes and appends
 
 	bool write(const std::string &file, const std::string &data);
 
@@ -3,6 +3,7 @@
 Global::Global() {
 	shutdownMUD = false;
 	saveRooms = false;
+	dumpTrace = false;
 }
 
 Global::~Global() {
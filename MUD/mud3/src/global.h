@@ -11,10 +11,17 @@
 #include "eventDaemon.h"
 #include "io.h"
 #include "log.h"
+#include "traceRecorder.h"
 #include "objectFactory.h"
 #include "random.h"
 #include "zoneDaemon.h"
 #include "runtimeConfig.h"
+#include "metricsServer.h"
+#include "watchdog.h"
+#include "trafficCapture.h"
+#include "resolver.h"
+#include "idleReaper.h"
+#include "hotReboot.h"
 
 /// Holds all global data
 /** This class manages all the global data used by the game.
@@ -24,6 +31,7 @@ public:
 	Global();
 	~Global();
 
+	TraceRecorder trace;			///< records recent engine activity for latency investigations
 	IO ioDaemon;					///< handles file i/o
 	Log log;						///< does all logging
 	RuntimeConfig Config;			///< manages the run-time configuration
@@ -37,9 +45,16 @@ public:
 	ObjectFactory Factory;			///< creates new objects
 	Random RNG;						///< generates random numbers
 	ZoneDaemon zoneDaemon;			///< holds all zone information
+	MetricsServer metricsServer;	///< serves engine statistics to monitoring systems
+	Watchdog watchdog;				///< reports threads that stop looping
+	TrafficCapture capture;			///< records client traffic for replay
+	Resolver resolver;				///< looks up hostnames for connecting addresses
+	IdleReaper reaper;				///< closes idle connections
+	HotReboot hotReboot;			///< restarts the server without dropping connections
 
 	bool shutdownMUD;	///< Set to true when it's time to shut down
 	bool saveRooms;		///< Set to true when it's time to autosave all rooms and their items
+	volatile bool dumpTrace;	///< Set by SIGUSR1 when an admin wants the flight recorder dumped
 
 private:
 
@@ -0,0 +1,345 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+
+#include "gmcp.h"
+
+/// a package the server can send, and the version it speaks
+typedef struct {
+	const char *name;	///< package name, as clients write it in Core.Supports
+	int version;		///< the version this server implements
+} GmcpPackage;
+
+/// every package the server knows
+/** Core is always on; clients opt in to the rest with Core.Supports. Sub-packages such as
+	Char.Vitals ride on their parent, so only top level packages and Comm.Channel, which
+	clients name on its own, need to be here.
+*/
+static const GmcpPackage kPackages[] = {
+	{ "Core", 1 },
+	{ "Char", 1 },
+	{ "Room", 1 },
+	{ "Comm.Channel", 1 }
+};
+
+/// reads one JSON string starting at or after \a pos
+/** Escapes are decoded, except \\u, which is kept as a '?' since package and client
+	names never need it.
+	@param text the JSON text
+	@param[in,out] pos where to start looking; left just past the closing quote
+	@param[out] out the decoded string
+	\return true if a whole string was read
+*/
+static bool readString(const std::string &text, std::string::size_type &pos, std::string &out) {
+	pos = text.find('"', pos);
+
+	if(pos == std::string::npos) {
+		return false;
+	}
+
+	out.clear();
+
+	for(++pos; pos < text.size(); ++pos) {
+		char c = text[pos];
+
+		if(c == '"') {
+			++pos;
+			return true;
+		}
+
+		if(c == '\\' && pos + 1 < text.size()) {
+			c = text[++pos];
+
+			switch(c) {
+				case 'n': out += '\n'; break;
+				case 't': out += '\t'; break;
+				case 'r': out += '\r'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'u':
+					out += '?';
+					pos += 4;
+					break;
+				default: out += c;
+			}
+
+			continue;
+		}
+
+		out += c;
+	}
+
+	return false;
+}
+
+/// adds a string field
+/** @param key the field name
+	@param value the value, which will be quoted
+	\return this object, so calls can be chained
+*/
+GmcpObject &GmcpObject::add(const std::string &key, const std::string &value) {
+	mFields.push_back(Field(key, quote(value)));
+	return *this;
+}
+
+/// adds a number field
+GmcpObject &GmcpObject::add(const std::string &key, const long value) {
+	std::ostringstream s;
+	s << value;
+	mFields.push_back(Field(key, s.str()));
+	return *this;
+}
+
+/// adds a field whose value is already JSON, such as a nested object
+GmcpObject &GmcpObject::addJson(const std::string &key, const std::string &json) {
+	mFields.push_back(Field(key, json));
+	return *this;
+}
+
+/// encodes the object as compact JSON
+std::string GmcpObject::toJson() const {
+	std::string out = "{";
+
+	for(FieldList::const_iterator i = mFields.begin(); i != mFields.end(); ++i) {
+		if(i != mFields.begin()) {
+			out += ',';
+		}
+
+		out += quote(i->first);
+		out += ':';
+		out += i->second;
+	}
+
+	out += '}';
+	return out;
+}
+
+/// encodes text as a JSON string, quotes included
+/** Quotes, backslashes and control characters are escaped. Bytes above 127 are passed
+	through, since the game's text is already UTF-8 or plain ASCII.
+*/
+std::string GmcpObject::quote(const std::string &text) {
+	std::string out;
+	out.reserve(text.size() + 2);
+	out += '"';
+
+	for(std::string::size_type i = 0; i < text.size(); ++i) {
+		unsigned char c = text[i];
+
+		switch(c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if(c < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					out += buf;
+				} else {
+					out += c;
+				}
+		}
+	}
+
+	out += '"';
+	return out;
+}
+
+/// Constructor
+/** Only Core is supported until the client says otherwise
+*/
+GmcpSession::GmcpSession() {
+	reset();
+}
+
+/// forgets everything the client asked for and everything sent to it
+/** Called when GMCP is turned on or off, so a client that reconnects the option starts
+	from full messages again.
+*/
+void GmcpSession::reset() {
+	mSupports.clear();
+	mSent.clear();
+	mClientName.clear();
+	mSupports["Core"] = 1;
+}
+
+/// gets the packages the client asked for, as a Core.Supports.Set list
+/** \return a JSON array of "Package version" strings
+*/
+std::string GmcpSession::getSupports() const {
+	std::ostringstream list;
+	list << "[";
+
+	for(std::map<std::string, int>::const_iterator it = mSupports.begin(); it != mSupports.end(); ++it) {
+		list << (it == mSupports.begin() ? "" : ", ") << "\"" << it->first << " " << it->second << "\"";
+	}
+
+	list << "]";
+	return list.str();
+}
+
+/// puts back what a client had asked for before a hot reboot
+/** Nothing counts as sent, so every message's next update goes out whole.
+	@param clientName the name from Core.Hello
+	@param supports a list from getSupports()
+*/
+void GmcpSession::restore(const std::string &clientName, const std::string &supports) {
+	reset();
+	mClientName = clientName;
+	changeSupports(supports, true);
+}
+
+/// handles a GMCP message from the client
+/** Core.Hello records the client's name. Core.Supports.Set, Add and Remove change which
+	packages are sent; any change also forgets what was sent before, so the next update
+	of every message goes out whole.
+	@param data the subnegotiation, <tt>Package.Message json</tt>
+	\return true if the message was understood
+*/
+bool GmcpSession::receive(const std::string &data) {
+	std::string::size_type space = data.find(' ');
+	std::string message = data.substr(0, space);
+	std::string json = space == std::string::npos ? "" : data.substr(space + 1);
+
+	if(message == "Core.Hello") {
+		std::string::size_type pos = json.find("\"client\"");
+
+		if(pos != std::string::npos) {
+			pos += 8;
+			readString(json, pos, mClientName);
+		}
+
+		return true;
+	}
+
+	if(message == "Core.Supports.Set") {
+		mSupports.clear();
+		mSupports["Core"] = 1;
+		changeSupports(json, true);
+		return true;
+	}
+
+	if(message == "Core.Supports.Add") {
+		changeSupports(json, true);
+		return true;
+	}
+
+	if(message == "Core.Supports.Remove") {
+		changeSupports(json, false);
+		return true;
+	}
+
+	// Core.Ping and anything else needs no answer
+	return message == "Core.Ping";
+}
+
+/// adds or removes every registered package in a Core.Supports list
+/** @param list a JSON array of strings, each "Package version" (the version may be left off)
+	@param add true to add the packages, false to remove them
+*/
+void GmcpSession::changeSupports(const std::string &list, const bool add) {
+	std::string::size_type pos = 0;
+	std::string entry;
+
+	while(readString(list, pos, entry)) {
+		std::string::size_type space = entry.find(' ');
+		std::string package = entry.substr(0, space);
+
+		if(!isRegistered(package)) {
+			continue;
+		}
+
+		if(add) {
+			mSupports[package] = space == std::string::npos ? 1 : atoi(entry.c_str() + space + 1);
+		} else if(package != "Core") {
+			mSupports.erase(package);
+		}
+	}
+
+	mSent.clear();
+}
+
+/// checks whether the client wants a message
+/** @param message the full message name, such as Char.Vitals
+	\return true if the client supports the message's package or one of its parents
+*/
+bool GmcpSession::supports(const std::string &message) const {
+	std::string::size_type dot = message.size();
+
+	while(dot != std::string::npos && dot > 0) {
+		if(mSupports.count(message.substr(0, dot))) {
+			return true;
+		}
+
+		dot = message.rfind('.', dot - 1);
+	}
+
+	return false;
+}
+
+/// builds the payload for a message, if it should be sent
+/** @param message the full message name
+	@param object the message's current value
+	@param mode whether to send always, only on change, or only the changed fields
+	@param[out] payload <tt>Package.Message json</tt>, ready for a subnegotiation
+	\return true if the message should be sent; false if the client doesn't want it or
+		nothing changed since the last one
+*/
+bool GmcpSession::encode(const std::string &message, const GmcpObject &object, const SendMode mode, std::string &payload) {
+	if(!supports(message)) {
+		return false;
+	}
+
+	if(mode == SendAlways) {
+		payload = message + " " + object.toJson();
+		return true;
+	}
+
+	const GmcpObject::FieldList &fields = object.getFields();
+	std::map<std::string, GmcpObject::FieldList>::iterator last = mSent.find(message);
+
+	if(last == mSent.end()) {
+		// nothing sent yet, so everything is news
+		mSent[message] = fields;
+		payload = message + " " + object.toJson();
+		return true;
+	}
+
+	GmcpObject changed;
+
+	for(GmcpObject::FieldList::const_iterator i = fields.begin(); i != fields.end(); ++i) {
+		GmcpObject::FieldList::const_iterator j = last->second.begin();
+
+		while(j != last->second.end() && j->first != i->first) {
+			++j;
+		}
+
+		if(j == last->second.end() || j->second != i->second) {
+			changed.addJson(i->first, i->second);
+		}
+	}
+
+	if(changed.getFields().empty()) {
+		return false;
+	}
+
+	last->second = fields;
+	payload = message + " " + (mode == SendChangedFields ? changed.toJson() : object.toJson());
+	return true;
+}
+
+/// checks whether a package is one the server can send
+bool GmcpSession::isRegistered(const std::string &package) {
+	for(unsigned int i = 0; i < sizeof(kPackages) / sizeof(kPackages[0]); ++i) {
+		if(package == kPackages[i].name) {
+			return true;
+		}
+	}
+
+	return false;
+}
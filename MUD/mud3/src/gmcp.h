@@ -0,0 +1,79 @@
+#ifndef MUD_GMCP_H
+#define MUD_GMCP_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+/// one GMCP message body, built field by field
+/** Values are stored already JSON encoded, so comparing two objects for deltas is a
+	string compare and nothing is encoded twice.
+*/
+class GmcpObject {
+public:
+	/// a field name and its JSON encoded value
+	typedef std::pair<std::string, std::string> Field;
+	typedef std::vector<Field> FieldList;
+
+	GmcpObject &add(const std::string &key, const std::string &value);
+	GmcpObject &add(const std::string &key, const long value);
+	GmcpObject &addJson(const std::string &key, const std::string &json);
+
+	/// gets every field, in the order they were added
+	const FieldList &getFields() const { return mFields; }
+
+	std::string toJson() const;
+
+	static std::string quote(const std::string &text);
+
+private:
+	FieldList mFields;	///< the fields, in order
+};
+
+/// the GMCP state of one connection
+/** GMCP (telnet option 201) carries <tt>Package.Message json</tt> in subnegotiations.
+	Clients say which packages they want with Core.Supports.Set, Add and Remove; only
+	packages in the server's registry are recorded, and a message is sent only if the
+	client asked for its package or a parent of it.
+
+	Besides events, which are always sent, a session remembers the last value sent for
+	every field of every message, so a message can be sent whole only when something in
+	it changed, or as just the fields that changed.
+*/
+class GmcpSession {
+public:
+	/// how encode() decides what to send
+	typedef enum {
+		SendAlways = 0,		///< events: send every time
+		SendWhenChanged,	///< send the whole object if any field changed
+		SendChangedFields	///< send only the fields that changed
+	} SendMode;
+
+	GmcpSession();
+
+	bool receive(const std::string &data);
+
+	bool supports(const std::string &message) const;
+
+	bool encode(const std::string &message, const GmcpObject &object, const SendMode mode, std::string &payload);
+
+	void reset();
+
+	std::string getSupports() const;
+	void restore(const std::string &clientName, const std::string &supports);
+
+	/// gets the client's name from Core.Hello, if it sent one
+	std::string getClientName() const { return mClientName; }
+
+	static bool isRegistered(const std::string &package);
+
+private:
+	std::map<std::string, int> mSupports;		///< package names the client wants, and their versions
+	std::map<std::string, GmcpObject::FieldList> mSent;	///< the last fields sent, by message name
+	std::string mClientName;					///< from Core.Hello
+
+	void changeSupports(const std::string &list, const bool add);
+};
+
+#endif // MUD_GMCP_H
@@ -0,0 +1,558 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <sstream>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <yaml-cpp/yaml.h>
+#include <boost/format.hpp>
+
+#include "hotReboot.h"
+#include "connStatePassword.h"
+#include "timer.h"
+
+#include "global.h"
+extern Global glob;
+
+/// reads a string from the config
+/** @param key the config string
+	@param fallback the value used when the key isn't set
+	\return the setting
+*/
+static std::string hotRebootString(const std::string &key, const std::string &fallback) {
+	std::string value = glob.Config.getStringValue(key);
+	return value.empty() ? fallback : value;
+}
+
+/// writes a list of telnet options as a flow sequence
+static void emitOptions(YAML::Emitter &out, const std::string &key, const std::vector<int> &options) {
+	out << YAML::Key << key << YAML::Value << YAML::Flow << YAML::BeginSeq;
+
+	for(std::vector<int>::const_iterator it = options.begin(); it != options.end(); ++it) {
+		out << *it;
+	}
+
+	out << YAML::EndSeq;
+}
+
+/// reads a list of telnet options written by emitOptions()
+static void readOptions(const YAML::Node &node, std::vector<int> &options) {
+	options.clear();
+
+	for(YAML::Iterator it = node.begin(); it != node.end(); ++it) {
+		int option;
+		*it >> option;
+		options.push_back(option);
+	}
+}
+
+/// writes bytes as hex, so unsent (possibly compressed) output fits in the YAML file
+static std::string toHex(const std::string &data) {
+	static const char digits[] = "0123456789abcdef";
+	std::string hex;
+	hex.reserve(data.length() * 2);
+
+	for(std::string::size_type i = 0; i < data.length(); ++i) {
+		unsigned char c = data[i];
+		hex += digits[c >> 4];
+		hex += digits[c & 0x0f];
+	}
+
+	return hex;
+}
+
+/// reads bytes written by toHex()
+static std::string fromHex(const std::string &hex) {
+	std::string data;
+	data.reserve(hex.length() / 2);
+
+	for(std::string::size_type i = 0; i + 1 < hex.length(); i += 2) {
+		data += static_cast<char>(strtol(hex.substr(i, 2).c_str(), NULL, 16));
+	}
+
+	return data;
+}
+
+/// closes descriptors the new program couldn't take up, so their clients see the connection end
+static void closeDescriptors(const std::set<int> &descriptors) {
+	for(std::set<int>::const_iterator it = descriptors.begin(); it != descriptors.end(); ++it) {
+		close(*it);
+	}
+}
+
+/// Constructor
+/** Defines where the sessions are written
+*/
+HotReboot::HotReboot() {
+	mRequested = false;
+	mHoldDriver = false;
+	mDriverWaiting = false;
+	mHoldingSaves = false;
+	mResloc.type = DataObject;
+	mResloc.name = "hotreboot.yaml";
+}
+
+/// records the program to run again
+/** main() passes argv[0]. It is resolved to a full path now, in case the working
+	directory changes; the HotRebootProgram config string overrides it.
+	@param program the program, as it was started
+*/
+void HotReboot::setProgram(const std::string &program) {
+	char resolved[PATH_MAX];
+
+	if(realpath(program.c_str(), resolved)) {
+		mProgram = resolved;
+	} else {
+		mProgram = program;
+	}
+}
+
+/// asks for a hot reboot at the end of the current tick
+/** @param requestedBy the name of whoever asked, who is told if it fails
+	\return false if one has already been asked for
+*/
+bool HotReboot::request(const std::string &requestedBy) {
+	if(mRequested) {
+		return false;
+	}
+
+	mRequestedBy = requestedBy;
+	mRequested = true;
+
+	return true;
+}
+
+/// saves everything, hands the connections over and runs the program again
+/** Every connection that isn't closing is told what is happening, has its output
+	flushed and its options recorded, and its descriptor left open across the exec.
+	\return false if the reboot failed, in which case everyone is told and the game
+		carries on; on success this function doesn't return
+*/
+bool HotReboot::execute() {
+	mRequested = false;
+
+	unsigned long long started = Timer::now();
+	std::string program = hotRebootString("HotRebootProgram", mProgram);
+	std::vector<Session> sessions;
+
+	if(program.empty() || access(program.c_str(), X_OK) != 0) {
+		fail("cannot run " + program, sessions);
+		return false;
+	}
+
+	glob.log.info(boost::format("HotReboot: %1% asked for a hot reboot into %2%") % mRequestedBy % program);
+
+	// input read from here on would be lost, and a connection accepted would be closed on exec
+	if(!holdDriver()) {
+		fail("the driver thread didn't stop", sessions);
+		return false;
+	}
+
+	// the new program loads all of this again, so it has to be on disk first, and no
+	// save on the save thread may still be writing when exec() stops it
+	glob.saveRooms = false;
+
+	if(!glob.zoneDaemon.saveAllZonesAndHold()) {
+		fail("could not save the zones", sessions);
+		return false;
+	}
+
+	mHoldingSaves = true;
+	glob.banMap.save();
+
+	std::string message = hotRebootString("HotRebootMessage", HOT_REBOOT_MESSAGE);
+	std::set<int> keep;
+	std::ostringstream descriptors;
+	keep.insert(glob.driver.get_socket_fd());
+
+	for(int fd = 0; fd <= glob.playerDatabase.getHighestFd(); ++fd) {
+		Player::PlayerPointer player = glob.playerDatabase.getPlayer(fd);
+
+		if(!player || player->getConnectionState() == Connection::ConnState_Closed) {
+			continue;
+		}
+
+		Session session;
+		session.fd = fd;
+		session.name = player->getName();
+		session.state = player->getConnectionState();
+		session.ip = player->getHostIP();
+		session.hostname = player->getHostname();
+
+		if(session.state == Connection::ConnState_Play && !player->Save()) {
+			glob.log.error(boost::format("HotReboot: Could not save %1%") % session.name);
+		}
+
+		player->Write(message);
+
+		if(!player->detachSocket(session.socket)) {
+			glob.log.warn(boost::format("HotReboot: Could not write to descriptor %1%") % fd);
+		}
+
+		sessions.push_back(session);
+		keep.insert(fd);
+		descriptors << (sessions.size() > 1 ? "," : "") << fd;
+	}
+
+	if(!save(sessions, started)) {
+		fail("could not write the connections down", sessions);
+		return false;
+	}
+
+	setCloseOnExec(keep);
+
+	std::ostringstream listenFd;
+	listenFd << glob.driver.get_socket_fd();
+
+	std::string option = "--hot-reboot";
+	std::string listenArg = listenFd.str();
+	std::string descriptorArg = descriptors.str();
+	char *args[] = { const_cast<char *>(program.c_str()), const_cast<char *>(option.c_str()), const_cast<char *>(listenArg.c_str()), const_cast<char *>(descriptorArg.c_str()), NULL };
+
+	glob.log.info(boost::format("HotReboot: Handing %1% connections to %2%") % sessions.size() % program);
+
+	execv(program.c_str(), args);
+
+	// execv() only returns if it failed
+	fail(strerror(errno), sessions);
+	return false;
+}
+
+/// takes up the listening socket and the connections after a hot reboot
+/** main() calls this instead of SocketDriver::initialize() when the program is run
+	with <tt>--hot-reboot</tt>, once the world is loaded and before the game threads start.
+	The descriptors on the command line are read before anything else, so that every one
+	of them is either taken up or closed, whatever goes wrong.
+	@param listenFd the listening socket the old program left open
+	@param descriptors the connections' descriptors, comma separated; if empty, the ones
+		in data/hotreboot.yaml are trusted
+	\return false if \a listenFd can't be used, in which case the caller should listen afresh
+*/
+bool HotReboot::restore(const int listenFd, const std::string &descriptors) {
+	std::set<int> handed;
+	std::istringstream list(descriptors);
+	std::string item;
+
+	while(std::getline(list, item, ',')) {
+		int fd = atoi(item.c_str());
+
+		if(fd > STDERR_FILENO && fd != listenFd) {
+			handed.insert(fd);
+		}
+	}
+
+	std::vector<Session> sessions;
+	unsigned long long started = 0;
+	bool loaded = load(sessions, started);
+
+	if(loaded && descriptors.empty()) {
+		for(std::vector<Session>::const_iterator it = sessions.begin(); it != sessions.end(); ++it) {
+			if(it->fd > STDERR_FILENO && it->fd != listenFd) {
+				handed.insert(it->fd);
+			}
+		}
+	}
+
+	if(!glob.driver.adopt_listener(listenFd)) {
+		glob.log.error(boost::format("HotReboot: Could not take up the listening socket, closing %1% connections") % handed.size());
+		closeDescriptors(handed);
+		return false;
+	}
+
+	if(!loaded) {
+		glob.log.error(boost::format("HotReboot: Could not read the connections the old program left, closing %1% of them") % handed.size());
+		closeDescriptors(handed);
+		return true;
+	}
+
+	unsigned int restored = 0;
+
+	for(std::vector<Session>::const_iterator it = sessions.begin(); it != sessions.end(); ++it) {
+		if(!handed.erase(it->fd)) {
+			glob.log.error(boost::format("HotReboot: Descriptor %1% wasn't handed over, skipping %2%") % it->fd % it->name);
+			continue;
+		}
+
+		// a connection that can't be kept is closed by restoreSession()
+		if(restoreSession(*it)) {
+			++restored;
+		}
+	}
+
+	if(!handed.empty()) {
+		glob.log.error(boost::format("HotReboot: Closing %1% connections the old program didn't write down") % handed.size());
+		closeDescriptors(handed);
+	}
+
+	// an old list must never be taken up twice
+	save(std::vector<Session>(), 0);
+
+	glob.log.info(boost::format("HotReboot: Took up %1% of %2% connections, %3% ms after the reboot began") % restored % sessions.size() % ((Timer::now() - started) / 1000));
+
+	return true;
+}
+
+/// puts one connection back
+/** Characters that were playing are loaded and put back in their rooms; everyone
+	else is sent back to the login prompt.
+	@param session the connection as it was written down
+	\return false if the connection couldn't be kept
+*/
+bool HotReboot::restoreSession(const Session &session) {
+	Player::PlayerPointer player = glob.driver.adoptSession(session.fd, session.ip);
+
+	if(!player) {
+		close(session.fd);
+		return false;
+	}
+
+	if(!session.hostname.empty()) {
+		player->setHostname(session.hostname);
+	}
+
+	player->attachSocket(session.socket);
+
+	if(session.state == Connection::ConnState_Play) {
+		player->setName(session.name);
+
+		if(player->Load()) {
+			player->Write(hotRebootString("HotRebootDoneMessage", HOT_REBOOT_DONE_MESSAGE));
+
+			if(!ConnectionState_Password::enterWorld(player)) {
+				return false;
+			}
+
+			player->Prompt();
+			player->setConnectionState(Connection::ConnState_Play);
+			return true;
+		}
+
+		glob.log.error(boost::format("HotReboot: Could not load %1% on descriptor %2%, sending them back to the login prompt") % session.name % session.fd);
+		player->setName("");
+	}
+
+	player->Write("The game restarted while you were logging in. Please start again.");
+	player->setConnectionState(Connection::ConnState_Login);
+	player->Write(hotRebootString("LoginPrompt", "Login: "));
+
+	return true;
+}
+
+/// tells everyone a reboot failed and carries on
+/** Connections get their close-on-exec flag and their compression back.
+	@param reason what went wrong, for the log and whoever asked
+	@param sessions the connections that had been handed over
+*/
+void HotReboot::fail(const std::string &reason, const std::vector<Session> &sessions) {
+	glob.log.error(boost::format("HotReboot: Hot reboot failed: %1%") % reason);
+
+	releaseDriver();
+
+	if(mHoldingSaves) {
+		glob.zoneDaemon.releaseSaves();
+		mHoldingSaves = false;
+	}
+
+	for(std::vector<Session>::const_iterator it = sessions.begin(); it != sessions.end(); ++it) {
+		fcntl(it->fd, F_SETFD, fcntl(it->fd, F_GETFD) | FD_CLOEXEC);
+
+		Player::PlayerPointer player = glob.playerDatabase.getPlayer(it->fd);
+
+		if(player) {
+			player->attachSocket(it->socket);
+			player->Write("The hot reboot didn't happen; carry on.");
+
+			if(it->state == Connection::ConnState_Play) {
+				player->Prompt();
+			}
+		}
+	}
+
+	Player::PlayerPointer requester = glob.playerDatabase.getPlayer(mRequestedBy);
+
+	if(requester) {
+		requester->Write("Hot reboot failed: " + reason);
+		requester->Prompt();
+	}
+}
+
+/// stops the driver thread between passes of its loop
+/** The driver checks isDriverHeld() at the top of every pass, before it selects, reads
+	or accepts anything, so once it says it is waiting the sockets are ours.
+	\return false if it didn't stop within HOT_REBOOT_DRIVER_WAIT seconds, in which case
+		it is let go again
+*/
+bool HotReboot::holdDriver() {
+	mDriverWaiting = false;
+	__sync_synchronize();
+	mHoldDriver = true;
+
+	for(unsigned long waited = 0; !mDriverWaiting; waited += SOCKET_TIME_RESOLUTION) {
+		if(waited >= HOT_REBOOT_DRIVER_WAIT * 1000000UL) {
+			releaseDriver();
+			return false;
+		}
+
+		usleep(SOCKET_TIME_RESOLUTION);
+	}
+
+	return true;
+}
+
+/// lets the driver thread carry on after holdDriver()
+void HotReboot::releaseDriver() {
+	mHoldDriver = false;
+	__sync_synchronize();
+	mDriverWaiting = false;
+}
+
+/// writes the connections down for the new program
+/** @param sessions the connections
+	@param started when the reboot began, from Timer::now(), so the new program can
+		report how long it took
+	\return true if the file was written
+*/
+bool HotReboot::save(const std::vector<Session> &sessions, const unsigned long long started) {
+	YAML::Emitter out;
+	std::ostringstream startedText;
+	startedText << started;
+
+	out << YAML::BeginMap;
+	out << YAML::Key << "Started" << YAML::Value << startedText.str();
+	out << YAML::Key << "Sessions" << YAML::Value << YAML::BeginSeq;
+
+	for(std::vector<Session>::const_iterator it = sessions.begin(); it != sessions.end(); ++it) {
+		out << YAML::BeginMap;
+		out << YAML::Key << "Fd" << YAML::Value << it->fd;
+		out << YAML::Key << "Name" << YAML::Value << it->name;
+		out << YAML::Key << "State" << YAML::Value << it->state;
+		out << YAML::Key << "IP" << YAML::Value << it->ip;
+		out << YAML::Key << "Hostname" << YAML::Value << it->hostname;
+		emitOptions(out, "LocalOptions", it->socket.localOptions);
+		emitOptions(out, "RemoteOptions", it->socket.remoteOptions);
+		out << YAML::Key << "WindowWidth" << YAML::Value << it->socket.windowWidth;
+		out << YAML::Key << "WindowHeight" << YAML::Value << it->socket.windowHeight;
+		out << YAML::Key << "ClientName" << YAML::Value << it->socket.clientName;
+		out << YAML::Key << "Mtts" << YAML::Value << it->socket.mtts;
+		out << YAML::Key << "SelfWrapping" << YAML::Value << it->socket.selfWrapping;
+		out << YAML::Key << "GmcpClient" << YAML::Value << it->socket.gmcpClient;
+		out << YAML::Key << "GmcpSupports" << YAML::Value << it->socket.gmcpSupports;
+		out << YAML::Key << "Colorblind" << YAML::Value << it->socket.colorblind;
+		out << YAML::Key << "Pending" << YAML::Value << toHex(it->socket.pending);
+		out << YAML::EndMap;
+	}
+
+	out << YAML::EndSeq;
+	out << YAML::EndMap;
+
+	if(!out.good()) {
+		glob.log.error(boost::format("HotReboot::save(): YAML Emitter is in a bad state: %1%") % out.GetLastError());
+		return false;
+	}
+
+	return glob.ioDaemon.saveResource(mResloc, out.c_str());
+}
+
+/// reads the connections the old program wrote down
+/** @param[out] sessions the connections
+	@param[out] started when the reboot began, from Timer::now()
+	\return false if the file is missing or can't be read
+*/
+bool HotReboot::load(std::vector<Session> &sessions, unsigned long long &started) {
+	std::string data = glob.ioDaemon.getResource(mResloc);
+
+	if(data == IO_RESOURCE_NOT_FOUND) {
+		return false;
+	}
+
+	std::istringstream is(data);
+
+	try {
+		YAML::Parser parser(is);
+		YAML::Node doc;
+		parser.GetNextDocument(doc);
+
+		std::string startedText;
+		doc["Started"] >> startedText;
+		std::istringstream(startedText) >> started;
+
+		const YAML::Node &list = doc["Sessions"];
+
+		for(YAML::Iterator it = list.begin(); it != list.end(); ++it) {
+			const YAML::Node &node = *it;
+			Session session;
+
+			node["Fd"] >> session.fd;
+			node["Name"] >> session.name;
+			node["State"] >> session.state;
+			node["IP"] >> session.ip;
+			node["Hostname"] >> session.hostname;
+			readOptions(node["LocalOptions"], session.socket.localOptions);
+			readOptions(node["RemoteOptions"], session.socket.remoteOptions);
+			node["WindowWidth"] >> session.socket.windowWidth;
+			node["WindowHeight"] >> session.socket.windowHeight;
+			node["ClientName"] >> session.socket.clientName;
+			node["Mtts"] >> session.socket.mtts;
+			node["SelfWrapping"] >> session.socket.selfWrapping;
+			node["GmcpClient"] >> session.socket.gmcpClient;
+			node["GmcpSupports"] >> session.socket.gmcpSupports;
+			node["Colorblind"] >> session.socket.colorblind;
+
+			if(const YAML::Node *pending = node.FindValue("Pending")) {
+				std::string hex;
+				*pending >> hex;
+				session.socket.pending = fromHex(hex);
+			}
+
+			sessions.push_back(session);
+		}
+	} catch(YAML::Exception &e) {
+		glob.log.error(boost::format("HotReboot::load(): YAML exception: %1%") % e.what());
+		return false;
+	}
+
+	return true;
+}
+
+/// marks every descriptor but the ones being handed over to close on exec
+/** The open descriptors are listed from /proc/self/fd, or if that can't be read, every
+	possible descriptor is tried. Standard input, output and error are left alone.
+	@param keep the descriptors the new program takes up
+*/
+void HotReboot::setCloseOnExec(const std::set<int> &keep) {
+	std::vector<int> open;
+	DIR *dir = opendir("/proc/self/fd");
+
+	if(dir) {
+		struct dirent *entry;
+
+		while((entry = readdir(dir)) != NULL) {
+			if(isdigit(entry->d_name[0])) {
+				open.push_back(atoi(entry->d_name));
+			}
+		}
+
+		closedir(dir);
+	} else {
+		for(int fd = 0; fd < glob.driver.get_fdmax(); ++fd) {
+			open.push_back(fd);
+		}
+	}
+
+	for(std::vector<int>::const_iterator it = open.begin(); it != open.end(); ++it) {
+		int flags = fcntl(*it, F_GETFD);
+
+		// the directory's own descriptor is already closed
+		if(*it <= STDERR_FILENO || flags == -1) {
+			continue;
+		}
+
+		fcntl(*it, F_SETFD, keep.count(*it) ? flags & ~FD_CLOEXEC : flags | FD_CLOEXEC);
+	}
+}
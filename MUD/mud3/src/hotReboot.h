@@ -0,0 +1,83 @@
+#ifndef MUD_HOT_REBOOT_H
+#define MUD_HOT_REBOOT_H
+
+#include <string>
+#include <vector>
+#include <set>
+
+#include "mudconfig.h"
+#include "client_socket.h"
+#include "player.h"
+
+/// Restarts the server, possibly as a new build, without dropping a connection
+/** A hot reboot saves the world and every playing character, writes down each
+	connection (descriptor, character, connection state, address and what its client
+	negotiated) to data/hotreboot.yaml, and exec()s the program again with
+	<tt>--hot-reboot</tt>, the listening socket's descriptor and a comma separated list of
+	the connections' descriptors. Those descriptors are the only ones left open across the
+	exec; everything else is closed on exec.
+
+	The new program loads the world as usual, takes up the listening socket instead of
+	binding a new one, and restore()s every connection: characters that were playing
+	are loaded and put back in their rooms, and anyone still logging in starts again at
+	the login prompt. Clients see a pause as long as the world takes to load. Telnet
+	options are carried over rather than negotiated again; a compressed stream is
+	finished before the exec and a new one started after it. Output a slow client hadn't
+	read yet is written down with its connection and sent first afterwards.
+
+	The reboot itself runs on the process thread between ticks, after the command that
+	asked for it has had its output flushed. The driver thread is held first, so no
+	input is read, no option changes and no connection is accepted while the
+	connections are written down; a failed reboot lets it go again.
+*/
+class HotReboot {
+public:
+	HotReboot();
+
+	void setProgram(const std::string &program);
+
+	bool request(const std::string &requestedBy);
+
+	/// true once a reboot has been asked for and not yet tried
+	bool isRequested() const { return mRequested; }
+
+	bool execute();
+	bool restore(const int listenFd, const std::string &descriptors);
+
+	/// true while a reboot wants the driver thread to leave the sockets alone
+	bool isDriverHeld() const { return mHoldDriver; }
+
+	/// called by the driver thread each time round its loop while isDriverHeld()
+	void driverWaiting() { mDriverWaiting = true; }
+
+private:
+	/// one connection, as it is handed to the new program
+	struct Session {
+		int fd;					///< the connection's descriptor
+		std::string name;		///< the character, if one is playing
+		int state;				///< the Connection::ConnStateEnum it was in
+		std::string ip;			///< the client's address
+		std::string hostname;	///< the address's name, if it had been looked up
+		SocketState socket;		///< what the client negotiated
+	};
+
+	std::string mProgram;			///< the program to run, as the server was started
+	volatile bool mRequested;		///< see isRequested()
+	volatile bool mHoldDriver;		///< see isDriverHeld()
+	volatile bool mDriverWaiting;	///< set by the driver thread once it has stopped for mHoldDriver
+	bool mHoldingSaves;				///< true while zone saves are kept out, see ZoneDaemon::saveAllZonesAndHold()
+	std::string mRequestedBy;		///< who asked, to tell them if it fails
+	IOResourceLocator mResloc;		///< where the sessions are written
+
+	bool save(const std::vector<Session> &sessions, const unsigned long long started);
+	bool load(std::vector<Session> &sessions, unsigned long long &started);
+	bool restoreSession(const Session &session);
+	void fail(const std::string &reason, const std::vector<Session> &sessions);
+
+	bool holdDriver();
+	void releaseDriver();
+
+	static void setCloseOnExec(const std::set<int> &keep);
+};
+
+#endif // MUD_HOT_REBOOT_H
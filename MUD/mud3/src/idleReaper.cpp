@@ -0,0 +1,213 @@
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>	// for TCP_KEEPIDLE and TCP_USER_TIMEOUT
+#include <boost/format.hpp>
+
+#include "idleReaper.h"
+#include "message.h"
+#include "utility.h"
+
+#include "global.h"
+extern Global glob;
+
+/// reads a setting from the config
+/** @param key the config integer
+	@param fallback the value from mudconfig.h, used when the key isn't set
+	\return the setting; 0 means off
+*/
+static unsigned int reaperSetting(const std::string &key, const unsigned int fallback) {
+	int value = glob.Config.getIntValue(key);
+	return value < 0 ? fallback : static_cast<unsigned int>(value);
+}
+
+/// Constructor
+/** Reads the timeouts from the config
+*/
+IdleReaper::IdleReaper() : mBusy("IdleReaper"), mWheel(IDLE_REAPER_SLOTS) {
+	for(int i = 0; i < NUMBER_OF_CONNECTION_STATES; ++i) {
+		mReaped[i] = 0;
+	}
+
+	loadSettings();
+}
+
+/// reads the idle timeouts and TCP settings from the config
+/** \see mudconfig.h for the defaults
+*/
+void IdleReaper::loadSettings() {
+	mTimeouts[Connection::ConnState_Closed] = 0;
+	mTimeouts[Connection::ConnState_Login] = reaperSetting("IdleTimeoutLogin", IDLE_TIMEOUT_LOGIN);
+	mTimeouts[Connection::ConnState_Password] = reaperSetting("IdleTimeoutPassword", IDLE_TIMEOUT_PASSWORD);
+	mTimeouts[Connection::ConnState_Create] = reaperSetting("IdleTimeoutCreate", IDLE_TIMEOUT_CREATE);
+	mTimeouts[Connection::ConnState_Play] = reaperSetting("IdleTimeoutPlaying", IDLE_TIMEOUT_PLAYING);
+
+	mKeepAliveIdle = reaperSetting("TcpKeepAliveIdle", TCP_KEEPALIVE_IDLE);
+	mKeepAliveInterval = reaperSetting("TcpKeepAliveInterval", TCP_KEEPALIVE_INTERVAL);
+	mKeepAliveCount = reaperSetting("TcpKeepAliveCount", TCP_KEEPALIVE_COUNT);
+	mUserTimeout = reaperSetting("TcpUserTimeout", TCP_USER_TIMEOUT_SECONDS);
+}
+
+/// gets a printable name for a connection state, as used in the metrics
+std::string IdleReaper::getStateName(const Connection::ConnStateEnum state) {
+	switch(state) {
+		case Connection::ConnState_Closed:
+			return "closed";
+		case Connection::ConnState_Login:
+			return "login";
+		case Connection::ConnState_Password:
+			return "password";
+		case Connection::ConnState_Create:
+			return "create";
+		case Connection::ConnState_Play:
+			return "playing";
+		default:
+			return "unknown";
+	}
+}
+
+/// starts the idle clock for a connection that has entered a state
+/** Connection::setConnectionState() calls this, and keeps the serial it returns; an
+	older deadline for the same connection is ignored when it comes up.
+	@param fd the connection's descriptor
+	@param state the state it has entered
+	@param since when it entered it
+	\return the deadline's serial, or 0 if the state has no timeout
+*/
+unsigned long IdleReaper::watch(const int fd, const Connection::ConnStateEnum state, const time_t since) {
+	unsigned int timeout = getTimeout(state);
+
+	if(timeout == 0 || !mBusy.lock()) {
+		return 0;
+	}
+
+	unsigned long serial = mWheel.schedule(since + timeout, fd);
+	mBusy.unlock();
+
+	return serial;
+}
+
+/// closes the connections whose deadlines have passed
+/** This function is called from heartbeat() in thread_functions.cpp. Deadlines for
+	connections that have closed, or that have moved on to another state, are dropped;
+	connections that have sent something since are put back at their new deadline.
+*/
+void IdleReaper::heartbeat() {
+	time_t now = time(NULL);
+	std::vector<TimerWheel::Entry> expired;
+
+	if(!mBusy.lock()) {
+		return;
+	}
+
+	mWheel.advance(now, expired);
+	mBusy.unlock();
+
+	unsigned int reaped = 0;
+
+	for(std::vector<TimerWheel::Entry>::iterator it = expired.begin(); it != expired.end(); ++it) {
+		Player::PlayerPointer player = glob.playerDatabase.getPlayer(it->id);
+
+		if(!player || player->getReapSerial() != it->serial) {
+			// closed, or watched again under a newer serial
+			continue;
+		}
+
+		Connection::ConnStateEnum state = player->getConnectionState();
+		unsigned int timeout = getTimeout(state);
+
+		if(timeout == 0) {
+			continue;
+		}
+
+		time_t deadline = player->getLastActive() + timeout;
+
+		if(deadline > now) {
+			if(mBusy.lock()) {
+				mWheel.schedule(deadline, it->id, it->serial);
+				mBusy.unlock();
+			}
+			continue;
+		}
+
+		reap(player, state, now - player->getLastActive());
+		++reaped;
+	}
+
+	if(reaped > 0) {
+		glob.log.info(boost::format("IdleReaper: Closed %1% idle connections, %2% still watched") % reaped % getWatched());
+	}
+}
+
+/// closes one idle connection
+/** Players in the game leave the way 'quit' makes them leave, so the room and the
+	other players hear about it.
+	@param player the connection
+	@param state the state it idled in
+	@param idle how long it has been idle, in seconds
+*/
+void IdleReaper::reap(Player::PlayerPointer player, const Connection::ConnStateEnum state, const time_t idle) {
+	__sync_fetch_and_add(&mReaped[state], 1UL);
+
+	glob.log.info(boost::format("IdleReaper: Closing descriptor %1% (%2%, %3%), idle %4% seconds in the %5% state")
+		% player->getFd() % player->getName() % player->getHostIP() % idle % getStateName(state));
+
+	player->Write("~br0You have been idle too long. Goodbye.~res" END);
+
+	if(state == Connection::ConnState_Play) {
+		Message::MessagePointer message = Message::MessagePointer(new Message);
+		message->setType(Message::Quit);
+		message->setFrom(player->getName());
+		message->setBody(boost::format("%1% has been disconnected for idling") % Utility::toProper(player->getName()));
+		glob.playerDatabase.broadcast(message);
+	}
+
+	glob.playerDatabase.remove(player);
+}
+
+/// turns on TCP keepalive and TCP_USER_TIMEOUT for a new connection, as configured
+/** Failures are logged and otherwise ignored; the idle timeouts still apply.
+	@param fd the new connection's descriptor
+*/
+void IdleReaper::configureSocket(const int fd) const {
+	if(mKeepAliveIdle > 0) {
+		int on = 1;
+		int idle = mKeepAliveIdle;
+		int interval = mKeepAliveInterval > 0 ? mKeepAliveInterval : 1;
+		int count = mKeepAliveCount > 0 ? mKeepAliveCount : 1;
+
+		if(setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) != 0
+			|| setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) != 0
+			|| setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) != 0
+			|| setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) != 0) {
+			if(glob.log.throttle("IdleReaper::configureSocket(): keepalive")) {
+				glob.log.warn(boost::format("IdleReaper::configureSocket(): Could not turn on keepalive for descriptor %1%: %2%") % fd % strerror(errno));
+			}
+		}
+	}
+
+#ifdef TCP_USER_TIMEOUT
+	if(mUserTimeout > 0) {
+		unsigned int milliseconds = mUserTimeout * 1000;
+
+		if(setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &milliseconds, sizeof(milliseconds)) != 0 && glob.log.throttle("IdleReaper::configureSocket(): user timeout")) {
+			glob.log.warn(boost::format("IdleReaper::configureSocket(): Could not set TCP_USER_TIMEOUT for descriptor %1%: %2%") % fd % strerror(errno));
+		}
+	}
+#endif
+}
+
+/// gets how many deadlines are in the wheel, stale ones included
+unsigned long IdleReaper::getWatched() {
+	unsigned long watched = 0;
+
+	if(mBusy.lock()) {
+		watched = mWheel.size();
+		mBusy.unlock();
+	}
+
+	return watched;
+}
@@ -0,0 +1,63 @@
+#ifndef MUD_IDLE_REAPER_H
+#define MUD_IDLE_REAPER_H
+
+#include <string>
+#include <vector>
+#include <ctime>
+
+#include "mudconfig.h"
+#include "mutex.h"
+#include "timerWheel.h"
+#include "player.h"
+
+/// the number of Connection::ConnStateEnum values
+#define NUMBER_OF_CONNECTION_STATES	(Connection::ConnState_Play + 1)
+
+/// Closes connections that have sat idle too long, and tunes TCP to notice dead peers
+/** Every connection has one deadline in a TimerWheel: the last line it sent (or the
+	moment it entered its current state, if later) plus that state's idle timeout.
+	Sending a line doesn't touch the wheel. When a deadline comes up, heartbeat() looks
+	at the connection again and either closes it or puts it back in the wheel at its
+	new deadline, so the work done is proportional to the deadlines that come up, not
+	to the number of players.
+
+	Peers that vanish without a FIN never send anything, so they are caught by the
+	same timeouts, and sooner by TCP keepalive and TCP_USER_TIMEOUT when those are
+	turned on; either makes the next read fail and the driver drops the connection.
+*/
+class IdleReaper {
+public:
+	IdleReaper();
+
+	void loadSettings();
+
+	unsigned long watch(const int fd, const Connection::ConnStateEnum state, const time_t since);
+	void heartbeat();
+
+	void configureSocket(const int fd) const;
+
+	/// gets the idle timeout for a connection state, in seconds; 0 for none
+	unsigned int getTimeout(const Connection::ConnStateEnum state) const { return state < NUMBER_OF_CONNECTION_STATES ? mTimeouts[state] : 0; }
+	/// gets how many connections have been closed for idling in a state
+	unsigned long getReaped(const Connection::ConnStateEnum state) const { return state < NUMBER_OF_CONNECTION_STATES ? mReaped[state] : 0; }
+
+	unsigned long getWatched();
+
+	static std::string getStateName(const Connection::ConnStateEnum state);
+
+private:
+	Mutex mBusy;			///< guards mWheel; connections are watched from the driver and process threads
+	TimerWheel mWheel;		///< every connection's next deadline
+
+	unsigned int mTimeouts[NUMBER_OF_CONNECTION_STATES];	///< idle timeouts by state, in seconds
+	unsigned int mKeepAliveIdle;		///< seconds of quiet before TCP keepalive probes start; 0 for no keepalive
+	unsigned int mKeepAliveInterval;	///< seconds between keepalive probes
+	unsigned int mKeepAliveCount;		///< unanswered probes before the connection is dropped
+	unsigned int mUserTimeout;			///< seconds sent data may go unacknowledged; 0 for the system default
+
+	volatile unsigned long mReaped[NUMBER_OF_CONNECTION_STATES];	///< see getReaped()
+
+	void reap(Player::PlayerPointer player, const Connection::ConnStateEnum state, const time_t idle);
+};
+
+#endif // MUD_IDLE_REAPER_H
@@ -26,6 +26,11 @@
 #include "create.h"
 #include "get.h"
 #include "shutdown.h"
+#include "profile.h"
+#include "stall.h"
+#include "trace.h"
+#include "memoryReport.h"
+#include "hotboot.h"
 
 /// loads all commands into the CommandHandler
 /** This function sets up the list of commands that the CommandHandler can call.
@@ -58,5 +63,10 @@ void CommandHandler::loadCommands(void) {
 	mCommandList["create"] = &Create::Instance();
 	mCommandList["get"] = &Get::Instance();
 	mCommandList["shutdown"] = &Shutdown::Instance();
+	mCommandList["profile"] = &Profile::Instance();
+	mCommandList["stall"] = &Stall::Instance();
+	mCommandList["trace"] = &Trace::Instance();
+	mCommandList["memory"] = &MemoryReport::Instance();
+	mCommandList["hotboot"] = &Hotboot::Instance();
 
 }
@@ -0,0 +1,151 @@
+#include "histogram.h"
+
+/// Constructor
+/** Zeros all buckets
+*/
+Histogram::Histogram() {
+	reset();
+}
+
+/// clears all samples
+/** This function sets every bucket and summary value back to zero
+	\note This is not atomic as a whole; a sample recorded during a reset may be lost.
+*/
+void Histogram::reset() {
+	for(unsigned int i = 0; i < kNumberOfBuckets; ++i) {
+		mBuckets[i] = 0;
+	}
+	mCount = 0;
+	mTotal = 0;
+	mMax = 0;
+}
+
+/// adds a sample to the histogram
+/** This function counts a sample in its bucket and updates the summary values.
+	@param value the sample to record
+*/
+void Histogram::record(unsigned long value) {
+	__sync_fetch_and_add(&mBuckets[bucketFor(value)], 1UL);
+	__sync_fetch_and_add(&mCount, 1UL);
+	__sync_fetch_and_add(&mTotal, static_cast<unsigned long long>(value));
+
+	unsigned long max = mMax;
+	while(value > max) {
+		if(__sync_bool_compare_and_swap(&mMax, max, value)) {
+			break;
+		}
+		max = mMax;
+	}
+}
+
+/// how many samples have been recorded
+/** \return the number of samples
+*/
+unsigned long Histogram::getCount() const {
+	return mCount;
+}
+
+/// the sum of all samples
+/** \return the total of every recorded sample
+*/
+unsigned long long Histogram::getTotal() const {
+	return mTotal;
+}
+
+/// the largest sample recorded
+/** \return the exact maximum sample value
+*/
+unsigned long Histogram::getMax() const {
+	return mMax;
+}
+
+/// the average sample value
+/** \return the mean of all samples, or 0 if there are none
+*/
+unsigned long Histogram::getMean() const {
+	unsigned long count = mCount;
+
+	if(count == 0) {
+		return 0;
+	}
+	return static_cast<unsigned long>(mTotal / count);
+}
+
+/// estimates a percentile
+/** This function walks the buckets until it has seen the requested fraction of
+	samples and returns the upper bound of that bucket (never more than the real
+	maximum).
+	@param percentile the percentile to find, between 0.0 and 100.0
+	\return the estimated value at that percentile, or 0 if there are no samples
+*/
+unsigned long Histogram::getPercentile(double percentile) const {
+	unsigned long count = mCount;
+
+	if(count == 0) {
+		return 0;
+	}
+
+	unsigned long target = static_cast<unsigned long>(count * (percentile / 100.0) + 0.5);
+
+	if(target < 1) {
+		target = 1;
+	}
+
+	unsigned long seen = 0;
+	unsigned long max = mMax;
+
+	for(unsigned int i = 0; i < kNumberOfBuckets; ++i) {
+		seen += mBuckets[i];
+		if(seen >= target) {
+			unsigned long upper = bucketUpperBound(i);
+			return upper < max ? upper : max;
+		}
+	}
+
+	return max;
+}
+
+/// finds the bucket a value belongs in
+/** Values below 16 map straight to their own bucket. Above that, the bucket is
+	chosen by the position of the highest set bit plus the next three bits.
+	@param value the sample value
+	\return the index of the bucket
+*/
+unsigned int Histogram::bucketFor(unsigned long value) {
+	if(value < 16) {
+		return static_cast<unsigned int>(value);
+	}
+
+	unsigned int msb = 0;
+	for(unsigned long v = value; v > 1; v >>= 1) {
+		++msb;
+	}
+
+	return (msb - 2) * 8 + static_cast<unsigned int>((value >> (msb - 3)) & 7);
+}
+
+/// the smallest value counted in a bucket
+/** @param bucket the index of the bucket
+	\return the lowest value that lands in the bucket
+*/
+unsigned long Histogram::bucketLowerBound(unsigned int bucket) {
+	if(bucket < 16) {
+		return bucket;
+	}
+
+	unsigned int msb = bucket / 8 + 2;
+	unsigned long sub = bucket % 8;
+
+	return (8 + sub) << (msb - 3);
+}
+
+/// the largest value counted in a bucket
+/** @param bucket the index of the bucket
+	\return the highest value that lands in the bucket
+*/
+unsigned long Histogram::bucketUpperBound(unsigned int bucket) {
+	if(bucket + 1 >= kNumberOfBuckets) {
+		return static_cast<unsigned long>(-1);
+	}
+	return bucketLowerBound(bucket + 1) - 1;
+}
@@ -0,0 +1,42 @@
+#ifndef MUD_HISTOGRAM_H
+#define MUD_HISTOGRAM_H
+
+/// A fixed-size, thread-safe latency histogram
+/** This class counts samples in log-linear buckets: values below 16 get a bucket
+	each, and every power of two above that is split into 8 equal buckets. That keeps
+	the relative error under 12.5% for any value while using a fixed amount of memory
+	no matter how many samples are recorded. All updates are atomic, so any thread
+	may record into the same histogram without a lock.
+	\note Samples are unitless; the StatEngine records everything in microseconds.
+*/
+class Histogram {
+public:
+	Histogram();
+
+	void record(unsigned long value);
+	void reset();
+
+	unsigned long getCount() const;
+	unsigned long long getTotal() const;
+	unsigned long getMax() const;
+	unsigned long getMean() const;
+	unsigned long getPercentile(double percentile) const;
+
+	/// number of buckets used to cover the full range of an unsigned long
+	static const unsigned int kNumberOfBuckets = 8 * (sizeof(unsigned long) * 8 - 2);
+
+	static unsigned int bucketFor(unsigned long value);
+	static unsigned long bucketLowerBound(unsigned int bucket);
+	static unsigned long bucketUpperBound(unsigned int bucket);
+
+	/// gets the raw number of samples in a bucket
+	unsigned long getBucketCount(unsigned int bucket) const { return mBuckets[bucket]; }
+
+private:
+	volatile unsigned long mBuckets[kNumberOfBuckets];	///< sample counts for each bucket
+	volatile unsigned long mCount;	///< total number of samples
+	volatile unsigned long long mTotal;	///< sum of all samples, for the mean
+	volatile unsigned long mMax;	///< the largest sample seen
+};
+
+#endif // MUD_HISTOGRAM_H
@@ -1,6 +1,7 @@
 #include <ctime>
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
 #include "mudconfig.h"
 #include "log.h"
@@ -13,7 +14,7 @@
 /// Constructor
 /** The constructor initializes default values, setting all log output to std::err
 */
-Log::Log() {
+Log::Log() : mBusy("Log") {
 	// set default log destinations
 	mInfoType = Stderr;
 	mWarnType = Stderr;
@@ -29,10 +30,9 @@ Log::Log() {
 	// set default log file name
 	mLogName = LOG_NAME;
 
-	if(pthread_mutex_init(&mBusy, NULL) != 0) {
-		perror("ClientScoket::ClientSocket(): mutex initialization error");
-		exit(MUTEX_ERROR);
-	}
+	// set default rate limits
+	mThrottleBurst = LOG_THROTTLE_BURST;
+	mThrottleInterval = LOG_THROTTLE_INTERVAL;
 }
 
 /// Destructor
@@ -60,7 +60,7 @@ void Log::close() {
 bool Log::lock() {
 	bool success = false;
 
-	if(pthread_mutex_lock(&mBusy) != 0) {
+	if(!mBusy.lock()) {
 		success = false;
 	} else {
 		success = true;
@@ -75,7 +75,7 @@ bool Log::lock() {
 bool Log::unlock() {
 	bool success = false;
 
-	if(pthread_mutex_unlock(&mBusy) != 0) {
+	if(!mBusy.unlock()) {
 		success = false;
 	} else {
 		success = true;
@@ -408,6 +408,114 @@ void Log::debug(const boost::format &f) {
 	debug(boost::str(f));
 }
 
+/// decides whether a rate-limited call site may log right now
+/** This function should wrap any log call that can fire from inside a loop (per map
+	cell, per tick, per read). Each call site gets mThrottleBurst messages every
+	mThrottleInterval seconds; anything past that is counted instead of written. When
+	the interval rolls over, a single "message repeated N times" summary replaces all
+	the suppressed lines. Check it \e before building the message so suppressed calls
+	don't pay for boost::format either:
+	\code
+	if(glob.log.throttle("ZoneMap::getLocation()")) {
+		glob.log.warn(boost::format("...") % x);
+	}
+	\endcode
+	@param site a string literal naming the call site; its address is the map key
+	\return true if the caller should go ahead and log its message
+*/
+bool Log::throttle(const char *site) {
+	time_t now = time(NULL);
+	unsigned int suppressed = 0;
+	time_t elapsed = 0;
+	bool allowed = true;
+
+	if(!lock()) {
+		return true;
+	}
+
+	ThrottleMap::iterator it = mThrottleMap.find(site);
+
+	if(it == mThrottleMap.end()) {
+		ThrottleState state;
+		state.windowStart = now;
+		state.count = 1;
+		mThrottleMap.insert(std::make_pair(site, state));
+	} else if(now - it->second.windowStart >= static_cast<time_t>(mThrottleInterval)) {
+		if(it->second.count > mThrottleBurst) {
+			suppressed = it->second.count - mThrottleBurst;
+			elapsed = now - it->second.windowStart;
+		}
+		it->second.windowStart = now;
+		it->second.count = 1;
+	} else {
+		++it->second.count;
+		allowed = it->second.count <= mThrottleBurst;
+	}
+
+	unlock();
+
+	if(suppressed > 0) {
+		warn(boost::format("%1%: message repeated %2% times in %3% seconds") % site % suppressed % elapsed);
+	}
+
+	return allowed;
+}
+
+/// changes the rate limits used by throttle()
+/** This function sets how many messages each call site may log per interval. Values
+	below 1 are ignored so a missing config key (RuntimeConfig returns -1) keeps the
+	defaults from mudconfig.h.
+	@param burst how many messages a call site may log per interval
+	@param interval the length of the interval, in seconds
+*/
+void Log::setThrottle(const int burst, const int interval) {
+	if(lock()) {
+		if(burst > 0) {
+			mThrottleBurst = static_cast<unsigned int>(burst);
+		}
+		if(interval > 0) {
+			mThrottleInterval = static_cast<unsigned int>(interval);
+		}
+		unlock();
+	}
+}
+
+/// writes summaries for call sites that have gone quiet
+/** throttle() only reports suppressed messages when the same site logs again, so a
+	site that floods once and then stops would never be summarized. This function is
+	called from the heartbeat and reports (and forgets) every site whose interval has
+	expired.
+*/
+void Log::flushThrottled() {
+	time_t now = time(NULL);
+	std::vector<std::string> summaries;
+
+	if(!lock()) {
+		return;
+	}
+
+	ThrottleMap::iterator it = mThrottleMap.begin();
+
+	while(it != mThrottleMap.end()) {
+		time_t elapsed = now - it->second.windowStart;
+
+		if(elapsed >= static_cast<time_t>(mThrottleInterval)) {
+			if(it->second.count > mThrottleBurst) {
+				summaries.push_back(boost::str(boost::format("%1%: message repeated %2% times in %3% seconds") % it->first % (it->second.count - mThrottleBurst) % elapsed));
+			}
+			mThrottleMap.erase(it++);
+		} else {
+			++it;
+		}
+	}
+
+	unlock();
+
+	for(std::vector<std::string>::const_iterator s = summaries.begin(); s != summaries.end(); ++s) {
+		warn(*s);
+	}
+}
+
 /// generates a human-readable timestamp
 /** This function generates a human-readable time stamp for use in logging
 */
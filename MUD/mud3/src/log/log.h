@@ -4,9 +4,13 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <map>
+#include <ctime>
 #include <pthread.h>
 #include <boost/format.hpp>
 
+#include "mutex.h"
+
 #if USE_MYSQL_LOGGING
 #include "mysql_db.h"
 #endif
@@ -64,7 +68,12 @@ public:
 	void setErrorStamp(bool b) { mErrorStamp = b; }
 	/// defines whether or not to timestamp 'Debug' level log messages
 	void setDebugStamp(bool b) { mDebugStamp = b; }
-	
+
+	// rate limiting for noisy call sites
+	bool throttle(const char *site);
+	void setThrottle(const int burst, const int interval);
+	void flushThrottled();
+
 private:
 	LogType mInfoType, mWarnType, mErrorType, mDebugType; ///< definitions for each log type
 	bool mInfoStamp, mWarnStamp, mErrorStamp, mDebugStamp; ///< whether each log type has a timestamp
@@ -75,7 +84,20 @@ private:
 
 	std::ofstream mLogStream;	///< a stream object for the log data
 
-	pthread_mutex_t mBusy;	/// mutext to keep threads from colliding
+	Mutex mBusy;	///< mutex to keep threads from colliding
+
+	/// bookkeeping for a single rate-limited call site
+	typedef struct {
+		time_t windowStart;	///< when the current interval started
+		unsigned int count;	///< how many messages the site tried to log this interval
+	} ThrottleState;
+
+	/// keyed by the address of the call site's string literal, so lookups never compare text
+	typedef std::map<const char *, ThrottleState> ThrottleMap;
+
+	ThrottleMap mThrottleMap;		///< state for every call site that has asked to be throttled
+	unsigned int mThrottleBurst;	///< messages allowed per site before suppressing
+	unsigned int mThrottleInterval;	///< length of a throttling interval, in seconds
 
 	bool lock();
 	bool unlock();
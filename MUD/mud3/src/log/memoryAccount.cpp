@@ -0,0 +1,119 @@
+#include <new>
+
+#include "memoryAccount.h"
+
+volatile unsigned long MemoryAccount::mLiveBytes[NumberOfMemoryTags];
+volatile unsigned long MemoryAccount::mPeakBytes[NumberOfMemoryTags];
+volatile unsigned long MemoryAccount::mObjects[NumberOfMemoryTags];
+
+/// allocates memory and counts it against a subsystem
+/** @param tag the subsystem to charge
+	@param size how many bytes to allocate
+	\return the new memory; throws std::bad_alloc like any operator new
+*/
+void *MemoryAccount::allocate(const MemoryTag tag, const size_t size) {
+	void *pointer = ::operator new(size);
+
+	unsigned long live = __sync_add_and_fetch(&mLiveBytes[tag], static_cast<unsigned long>(size));
+	__sync_fetch_and_add(&mObjects[tag], 1UL);
+	updatePeak(tag, live);
+
+	return pointer;
+}
+
+/// frees memory allocated with allocate()
+/** @param tag the subsystem that was charged
+	@param pointer the memory to free
+	@param size the size that was allocated
+*/
+void MemoryAccount::release(const MemoryTag tag, void *pointer, const size_t size) {
+	if(pointer == NULL) {
+		return;
+	}
+
+	__sync_fetch_and_sub(&mLiveBytes[tag], static_cast<unsigned long>(size));
+	__sync_fetch_and_sub(&mObjects[tag], 1UL);
+
+	::operator delete(pointer);
+}
+
+/// records an estimate for a subsystem that isn't counted allocation by allocation
+/** @param tag the subsystem
+	@param bytes about how many bytes it is using
+	@param objects how many things (buffers, events...) those bytes are spread over
+*/
+void MemoryAccount::setEstimate(const MemoryTag tag, const unsigned long bytes, const unsigned long objects) {
+	if(tag >= NumberOfMemoryTags) {
+		return;
+	}
+
+	__sync_lock_test_and_set(&mLiveBytes[tag], bytes);
+	__sync_lock_test_and_set(&mObjects[tag], objects);
+	updatePeak(tag, bytes);
+}
+
+/// gets the bytes a subsystem is using
+/** @param tag the subsystem
+	\return bytes in use
+*/
+unsigned long MemoryAccount::getLiveBytes(const MemoryTag tag) {
+	return tag < NumberOfMemoryTags ? mLiveBytes[tag] : 0;
+}
+
+/// gets the most bytes a subsystem has ever used
+/** @param tag the subsystem
+	\return the high-water mark, in bytes
+*/
+unsigned long MemoryAccount::getPeakBytes(const MemoryTag tag) {
+	return tag < NumberOfMemoryTags ? mPeakBytes[tag] : 0;
+}
+
+/// gets the number of objects a subsystem is using
+/** @param tag the subsystem
+	\return the object count
+*/
+unsigned long MemoryAccount::getObjects(const MemoryTag tag) {
+	return tag < NumberOfMemoryTags ? mObjects[tag] : 0;
+}
+
+/// gets a printable name for a subsystem
+/** @param tag the subsystem
+	\return a short lower-case name, suitable for the memory command or metric labels
+*/
+std::string MemoryAccount::getTagName(const MemoryTag tag) {
+	switch(tag) {
+		case RoomsTag:
+			return "rooms";
+		case ObjectsTag:
+			return "objects";
+		case PlayersTag:
+			return "players";
+		case NetworkTag:
+			return "network";
+		case MessagesTag:
+			return "messages";
+		case EventsTag:
+			return "events";
+		case LogTag:
+			return "log";
+		case CachesTag:
+			return "caches";
+		default:
+			return "unknown";
+	}
+}
+
+/// raises a subsystem's high-water mark
+/** @param tag the subsystem
+	@param live its current usage
+*/
+void MemoryAccount::updatePeak(const MemoryTag tag, const unsigned long live) {
+	unsigned long peak = mPeakBytes[tag];
+
+	while(live > peak) {
+		if(__sync_bool_compare_and_swap(&mPeakBytes[tag], peak, live)) {
+			break;
+		}
+		peak = mPeakBytes[tag];
+	}
+}
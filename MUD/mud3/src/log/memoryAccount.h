@@ -0,0 +1,66 @@
+#ifndef MUD_MEMORY_ACCOUNT_H
+#define MUD_MEMORY_ACCOUNT_H
+
+#include <string>
+#include <cstddef>
+
+#include "mudconfig.h"
+
+/// Attributes heap memory to the subsystems that use it
+/** This class keeps live bytes, peak bytes and object counts for each subsystem.
+	Classes that make up most of the heap (rooms, exits, objects, players, messages)
+	declare MEMORY_ACCOUNTED(tag), which gives them class-level operator new and
+	delete that count every instance. Memory held in containers that can't be
+	counted that way (socket buffers, the event queue, log buffers, zone maps) is
+	estimated by the process thread each heartbeat with setEstimate().
+	\note Everything here is atomic, so it is safe from any thread. Set
+		MEMORY_ACCOUNTING to false in mudconfig.h to compile the counting out.
+*/
+class MemoryAccount {
+public:
+	/// the subsystems memory is attributed to
+	typedef enum {
+		RoomsTag = 0,	///< zones, rooms and exits
+		ObjectsTag,		///< physical objects: items, books, coins, NPCs
+		PlayersTag,		///< Player objects
+		NetworkTag,		///< socket input and output buffers (estimated)
+		MessagesTag,	///< Message objects
+		EventsTag,		///< the EventDaemon's queue (estimated)
+		LogTag,			///< the flight recorder and statistics (estimated)
+		CachesTag,		///< zone terrain and weather maps (estimated)
+
+		NumberOfMemoryTags
+	} MemoryTag;
+
+	static void *allocate(const MemoryTag tag, const size_t size);
+	static void release(const MemoryTag tag, void *pointer, const size_t size);
+
+	static void setEstimate(const MemoryTag tag, const unsigned long bytes, const unsigned long objects);
+
+	static unsigned long getLiveBytes(const MemoryTag tag);
+	static unsigned long getPeakBytes(const MemoryTag tag);
+	static unsigned long getObjects(const MemoryTag tag);
+
+	static std::string getTagName(const MemoryTag tag);
+
+private:
+	static volatile unsigned long mLiveBytes[NumberOfMemoryTags];	///< bytes in use, indexed by MemoryTag
+	static volatile unsigned long mPeakBytes[NumberOfMemoryTags];	///< the most bytes ever in use, indexed by MemoryTag
+	static volatile unsigned long mObjects[NumberOfMemoryTags];		///< objects in use, indexed by MemoryTag
+
+	static void updatePeak(const MemoryTag tag, const unsigned long live);
+};
+
+#if MEMORY_ACCOUNTING
+/// gives a class operator new and delete that count its instances under \a tag
+/** Put this at the top of a class declaration. Subclasses are counted under the
+	same tag unless they declare their own. */
+#define MEMORY_ACCOUNTED(tag) \
+public: \
+	static void *operator new(size_t size) { return MemoryAccount::allocate(tag, size); } \
+	static void operator delete(void *pointer, size_t size) { MemoryAccount::release(tag, pointer, size); }
+#else
+#define MEMORY_ACCOUNTED(tag)
+#endif
+
+#endif // MUD_MEMORY_ACCOUNT_H
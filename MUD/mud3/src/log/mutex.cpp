@@ -0,0 +1,198 @@
+#include <string>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+
+#include "mudconfig.h"
+#include "mutex.h"
+#include "timer.h"
+
+/// maps a lock name to its counters
+typedef std::map<std::string, Mutex::Counters *> CounterMap;
+
+/// guards sRegistry; statically initialized so it is usable before any constructor runs
+static pthread_mutex_t sRegistryLock = PTHREAD_MUTEX_INITIALIZER;
+/// every lock name we have seen, created on first use and never freed
+static CounterMap *sRegistry = NULL;
+
+/// Constructor
+/** Creates the mutex and registers its name
+	@param name the name to report statistics under, usually the owning class
+*/
+Mutex::Mutex(const std::string &name) : mName(name) {
+	initialize();
+}
+
+/// Copy constructor
+/** Creates a new, unlocked mutex with the same name as \a other
+	@param other the mutex to take the name from
+*/
+Mutex::Mutex(const Mutex &other) : mName(other.mName) {
+	initialize();
+}
+
+/// Destructor
+/** Destroys the mutex. The statistics for its name are kept.
+*/
+Mutex::~Mutex() {
+	pthread_mutex_destroy(&mMutex);
+}
+
+/// Assignment operator
+/** Does nothing: each object keeps its own mutex and name
+	\return this mutex
+*/
+Mutex & Mutex::operator=(const Mutex &other) {
+	return *this;
+}
+
+/// creates the mutex and finds its counters
+void Mutex::initialize() {
+	mAcquiredAt = 0;
+	mCounters = registerName(mName);
+
+	if(pthread_mutex_init(&mMutex, NULL) != 0) {
+		fprintf(stderr, "Mutex::initialize(): %s mutex initialization error\n", mName.c_str());
+		exit(MUTEX_ERROR);
+	}
+}
+
+/// locks the mutex, recording whether and how long we had to wait
+/** \return true if the mutex was locked
+*/
+bool Mutex::lock() {
+	int result = pthread_mutex_trylock(&mMutex);
+
+	if(result == EBUSY) {
+		unsigned long long start = Timer::now();
+
+		if(pthread_mutex_lock(&mMutex) != 0) {
+			return false;
+		}
+
+		mAcquiredAt = Timer::now();
+
+		unsigned long waited = static_cast<unsigned long>(mAcquiredAt - start);
+		__sync_fetch_and_add(&mCounters->contended, 1UL);
+		__sync_fetch_and_add(&mCounters->waitTotal, static_cast<unsigned long long>(waited));
+		updateMax(&mCounters->waitMax, waited);
+	} else if(result == 0) {
+		mAcquiredAt = Timer::now();
+	} else {
+		return false;
+	}
+
+	__sync_fetch_and_add(&mCounters->acquisitions, 1UL);
+
+	return true;
+}
+
+/// unlocks the mutex, recording how long it was held
+/** \return true if the mutex was unlocked
+*/
+bool Mutex::unlock() {
+	unsigned long held = static_cast<unsigned long>(Timer::now() - mAcquiredAt);
+
+	if(pthread_mutex_unlock(&mMutex) != 0) {
+		return false;
+	}
+
+	__sync_fetch_and_add(&mCounters->holdTotal, static_cast<unsigned long long>(held));
+	updateMax(&mCounters->holdMax, held);
+
+	return true;
+}
+
+/// gets the statistics for every lock name
+/** \return a snapshot of each named lock's counters, sorted by name
+*/
+std::vector<LockStatistics> Mutex::getStatistics() {
+	std::vector<LockStatistics> statistics;
+
+	pthread_mutex_lock(&sRegistryLock);
+
+	if(sRegistry != NULL) {
+		for(CounterMap::const_iterator it = sRegistry->begin(); it != sRegistry->end(); ++it) {
+			LockStatistics s;
+			s.name = it->first;
+			s.acquisitions = it->second->acquisitions;
+			s.contended = it->second->contended;
+			s.waitTotal = it->second->waitTotal;
+			s.waitMax = it->second->waitMax;
+			s.holdTotal = it->second->holdTotal;
+			s.holdMax = it->second->holdMax;
+			statistics.push_back(s);
+		}
+	}
+
+	pthread_mutex_unlock(&sRegistryLock);
+
+	return statistics;
+}
+
+/// zeros the statistics for every lock name
+void Mutex::resetStatistics() {
+	pthread_mutex_lock(&sRegistryLock);
+
+	if(sRegistry != NULL) {
+		for(CounterMap::iterator it = sRegistry->begin(); it != sRegistry->end(); ++it) {
+			__sync_lock_test_and_set(&it->second->acquisitions, 0UL);
+			__sync_lock_test_and_set(&it->second->contended, 0UL);
+			__sync_lock_test_and_set(&it->second->waitTotal, 0ULL);
+			__sync_lock_test_and_set(&it->second->waitMax, 0UL);
+			__sync_lock_test_and_set(&it->second->holdTotal, 0ULL);
+			__sync_lock_test_and_set(&it->second->holdMax, 0UL);
+		}
+	}
+
+	pthread_mutex_unlock(&sRegistryLock);
+}
+
+/// finds or creates the counters for a lock name
+/** @param name the lock name
+	\return the counters shared by every mutex with this name
+*/
+Mutex::Counters *Mutex::registerName(const std::string &name) {
+	Counters *counters = NULL;
+
+	pthread_mutex_lock(&sRegistryLock);
+
+	if(sRegistry == NULL) {
+		sRegistry = new CounterMap;
+	}
+
+	CounterMap::iterator it = sRegistry->find(name);
+
+	if(it == sRegistry->end()) {
+		counters = new Counters;
+		counters->acquisitions = 0;
+		counters->contended = 0;
+		counters->waitTotal = 0;
+		counters->waitMax = 0;
+		counters->holdTotal = 0;
+		counters->holdMax = 0;
+		sRegistry->insert(std::make_pair(name, counters));
+	} else {
+		counters = it->second;
+	}
+
+	pthread_mutex_unlock(&sRegistryLock);
+
+	return counters;
+}
+
+/// raises a maximum, if the new value is larger
+/** @param max the maximum to update
+	@param value the new sample
+*/
+void Mutex::updateMax(volatile unsigned long *max, const unsigned long value) {
+	unsigned long current = *max;
+
+	while(value > current) {
+		if(__sync_bool_compare_and_swap(max, current, value)) {
+			break;
+		}
+		current = *max;
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef MUD_MUTEX_H
+#define MUD_MUTEX_H
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+/// a snapshot of the contention statistics for one named lock
+struct LockStatistics {
+	std::string name;				///< the name shared by every Mutex of this kind
+	unsigned long acquisitions;		///< how many times the lock was taken
+	unsigned long contended;		///< how many of those had to wait for another thread
+	unsigned long long waitTotal;	///< total time spent waiting, in microseconds
+	unsigned long waitMax;			///< longest single wait, in microseconds
+	unsigned long long holdTotal;	///< total time the lock was held, in microseconds
+	unsigned long holdMax;			///< longest single hold, in microseconds
+};
+
+/// A pthread mutex that keeps contention statistics
+/** This class wraps a \c pthread_mutex_t and records, for every lock() and unlock(),
+	whether the caller had to wait, how long it waited and how long it held the lock.
+	Statistics are kept per name rather than per object, so the hundreds of Room or
+	ClientSocket mutexes show up as one "Room" or "ClientSocket" line. An uncontended
+	lock costs one extra trylock and a monotonic clock read.
+	\note Copying a Mutex gives the copy a new, unlocked mutex with the same name; lock
+		state is never shared between objects.
+*/
+class Mutex {
+public:
+	explicit Mutex(const std::string &name);
+	Mutex(const Mutex &other);
+	~Mutex();
+
+	Mutex & operator=(const Mutex &other);
+
+	bool lock();
+	bool unlock();
+
+	/// get the name this mutex reports its statistics under
+	const std::string &getName() const { return mName; }
+
+	static std::vector<LockStatistics> getStatistics();
+	static void resetStatistics();
+
+	/// the shared, atomically-updated counters behind a LockStatistics
+	struct Counters {
+		volatile unsigned long acquisitions;	///< see LockStatistics
+		volatile unsigned long contended;		///< see LockStatistics
+		volatile unsigned long long waitTotal;	///< see LockStatistics
+		volatile unsigned long waitMax;			///< see LockStatistics
+		volatile unsigned long long holdTotal;	///< see LockStatistics
+		volatile unsigned long holdMax;			///< see LockStatistics
+	};
+
+private:
+	std::string mName;			///< the statistics name
+	pthread_mutex_t mMutex;		///< the real mutex
+	Counters *mCounters;		///< the statistics for mName, shared with other mutexes of the same name
+	unsigned long long mAcquiredAt;	///< when the current holder got the lock, in microseconds
+
+	void initialize();
+
+	static Counters *registerName(const std::string &name);
+	static void updateMax(volatile unsigned long *max, const unsigned long value);
+};
+
+#endif // MUD_MUTEX_H
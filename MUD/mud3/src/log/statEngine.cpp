@@ -1,5 +1,7 @@
 #include <string>
 #include <sstream>
+#include <cstdio>
+#include <cstdlib>
 #include <boost/cast.hpp>
 #include "mudconfig.h"
 #include "statEngine.h"
@@ -7,18 +9,44 @@
 /// Constructor
 /** Zeros all statistic variables
 */
-StatEngine::StatEngine() {
+StatEngine::StatEngine() : mHistogramLock("StatEngine") {
 	mEngineStartTime = time(NULL);
 	mBytesOut = 0;
 	mBytesIn = 0;
+	mCompressionRawBytes = 0;
+	mCompressionCompressedBytes = 0;
+	mGmcpMessages = 0;
 	mLoopTime = 0;
 	mNumberOfLoops = 0;
+	mTickOverruns = 0;
+
+	for(int i = 0; i < NumberOfTimers; ++i) {
+		mLastTimes[i] = 0;
+		mRecentTimes[i] = 0;
+	}
+
+	for(int i = 0; i < NumberOfGauges; ++i) {
+		mGauges[i] = 0;
+	}
+
+	for(int i = 0; i < NumberOfInputLimits; ++i) {
+		mInputLimits[i] = 0;
+	}
 }
 
 /// Destructor
-/** Does nothing
+/** Frees the per-command and per-zone histograms
 */
 StatEngine::~StatEngine() {
+	for(HistogramMap::iterator it = mCommandTimers.begin(); it != mCommandTimers.end(); ++it) {
+		delete it->second;
+	}
+	mCommandTimers.clear();
+
+	for(HistogramMap::iterator it = mZoneTimers.begin(); it != mZoneTimers.end(); ++it) {
+		delete it->second;
+	}
+	mZoneTimers.clear();
 }
 
 /// adds to the bytes-in count
@@ -26,7 +54,7 @@ StatEngine::~StatEngine() {
 	@param in number of bytes in this time
 */
 void StatEngine::addBytesIn(unsigned long in) {
-	mBytesIn += in;
+	__sync_fetch_and_add(&mBytesIn, in);
 }
 
 /// adds to the bytes-out count
@@ -34,7 +62,53 @@ void StatEngine::addBytesIn(unsigned long in) {
 	@param out the number of bytes out to add to the count
 */
 void StatEngine::addBytesOut(unsigned long out) {
-	mBytesOut += out;
+	__sync_fetch_and_add(&mBytesOut, out);
+}
+
+/// adds to the MCCP2 compression counts
+/** This function records one pass through a connection's compressor. The compressed
+	bytes are also counted by addBytesOut() when they are written.
+	@param raw the number of bytes before compression
+	@param compressed the number of bytes after compression
+*/
+void StatEngine::addCompression(unsigned long raw, unsigned long compressed) {
+	__sync_fetch_and_add(&mCompressionRawBytes, raw);
+	__sync_fetch_and_add(&mCompressionCompressedBytes, compressed);
+}
+
+/// counts a GMCP message sent to a client
+void StatEngine::addGmcpMessage() {
+	__sync_fetch_and_add(&mGmcpMessages, 1);
+}
+
+/// counts one action taken by a connection's input limits
+void StatEngine::addInputLimit(InputLimitType limit) {
+	if(limit < NumberOfInputLimits) {
+		__sync_fetch_and_add(&mInputLimits[limit], 1UL);
+	}
+}
+
+/// gets how many times an input limit acted
+unsigned long StatEngine::getInputLimit(InputLimitType limit) const {
+	return limit < NumberOfInputLimits ? mInputLimits[limit] : 0;
+}
+
+/// gets a printable name for an InputLimitType, as used in the metrics
+std::string StatEngine::getInputLimitName(InputLimitType limit) const {
+	switch(limit) {
+		case InputBytesThrottled:
+			return "bytes";
+		case InputLinesThrottled:
+			return "lines";
+		case InputLinesTruncated:
+			return "truncated";
+		case CommandsDropped:
+			return "dropped";
+		case CommandFloodDisconnects:
+			return "disconnected";
+		default:
+			return "unknown";
+	}
 }
 
 /// adds to the time the server has slept
@@ -43,8 +117,270 @@ void StatEngine::addBytesOut(unsigned long out) {
 	@param sleep the amount of time slept, in microseconds
 */
 void StatEngine::addSleepTime(unsigned long sleep) {
-	++mNumberOfLoops;
-	mLoopTime += sleep;
+	__sync_fetch_and_add(&mNumberOfLoops, 1U);
+	__sync_fetch_and_add(&mLoopTime, static_cast<unsigned long long>(sleep));
+}
+
+/// estimates the memory held by the latency histograms
+/** \return the size of every fixed, per-command and per-zone histogram, in bytes
+*/
+unsigned long StatEngine::getMemoryUsage() {
+	unsigned long histograms = NumberOfTimers;
+
+	if(mHistogramLock.lock()) {
+		histograms += mCommandTimers.size() + mZoneTimers.size();
+		mHistogramLock.unlock();
+	}
+
+	return histograms * sizeof(Histogram);
+}
+
+/// counts a tick that ran past its deadline
+void StatEngine::addTickOverrun() {
+	__sync_fetch_and_add(&mTickOverruns, 1UL);
+}
+
+/// records how long an engine operation took
+/** This function adds a sample to one of the latency histograms, and updates the
+	operation's last and recent (moving average, weighted 1/8 toward each new sample)
+	times. It is safe to call from any thread.
+	@param timer which operation was measured
+	@param usec how long it took, in microseconds
+*/
+void StatEngine::recordTime(TimerType timer, unsigned long usec) {
+	if(timer >= NumberOfTimers) {
+		return;
+	}
+
+	mTimers[timer].record(usec);
+	__sync_lock_test_and_set(&mLastTimes[timer], usec);
+
+	unsigned long recent = mRecentTimes[timer];
+	unsigned long updated;
+
+	do {
+		recent = mRecentTimes[timer];
+		// kept eight times too large, so samples under 8us aren't truncated away
+		updated = recent - (recent >> 3) + usec;
+	} while(!__sync_bool_compare_and_swap(&mRecentTimes[timer], recent, updated));
+}
+
+/// gets the most recent sample for an engine operation
+/** @param timer which operation to look up
+	\return how long the operation took the last time it ran, in microseconds
+*/
+unsigned long StatEngine::getLastTime(TimerType timer) const {
+	if(timer < NumberOfTimers) {
+		return mLastTimes[timer];
+	}
+	return 0;
+}
+
+/// gets the moving average for an engine operation
+/** Unlike the histograms, which cover the whole uptime, this tracks roughly the last
+	few dozen samples, so it shows what the engine is doing right now.
+	@param timer which operation to look up
+	\return the recent average time of the operation, in microseconds
+*/
+unsigned long StatEngine::getRecentTime(TimerType timer) const {
+	if(timer < NumberOfTimers) {
+		return (mRecentTimes[timer] + 4) >> 3;
+	}
+	return 0;
+}
+
+/// gets the latency histogram for an engine operation
+/** @param timer which operation to look up
+	\return a reference to the histogram for that operation
+*/
+const Histogram &StatEngine::getHistogram(TimerType timer) const {
+	if(timer >= NumberOfTimers) {
+		timer = TickTimer;
+	}
+	return mTimers[timer];
+}
+
+/// gets a printable name for an engine operation
+/** @param timer which operation to name
+	\return a short lower-case name, suitable for the stats command or metric names
+*/
+std::string StatEngine::getTimerName(TimerType timer) const {
+	switch(timer) {
+		case TickTimer:
+			return "tick";
+		case TickCommandsTimer:
+			return "tick_commands";
+		case HeartbeatTimer:
+			return "heartbeat";
+		case HeartbeatEventsTimer:
+			return "heartbeat_events";
+		case HeartbeatPlayersTimer:
+			return "heartbeat_players";
+		case HeartbeatZonesTimer:
+			return "heartbeat_zones";
+		case CommandTimer:
+			return "command";
+		case FlushTimer:
+			return "flush";
+		case SaveTimer:
+			return "save";
+		default:
+			return "unknown";
+	}
+}
+
+/// describes an engine operation in a sentence
+/** @param timer which operation to describe
+	\return what the operation covers, suitable for a metric's HELP line
+*/
+std::string StatEngine::getTimerDescription(TimerType timer) const {
+	switch(timer) {
+		case TickTimer:
+			return "One pass of the process thread loop";
+		case TickCommandsTimer:
+			return "The processCommands() phase of a tick";
+		case HeartbeatTimer:
+			return "One call to heartbeat()";
+		case HeartbeatEventsTimer:
+			return "The EventDaemon phase of a heartbeat";
+		case HeartbeatPlayersTimer:
+			return "The player heartbeat phase of a heartbeat";
+		case HeartbeatZonesTimer:
+			return "The zone heartbeat phase of a heartbeat";
+		case CommandTimer:
+			return "One player command, from dispatch to return";
+		case FlushTimer:
+			return "Writing a connection's output buffer to its socket";
+		case SaveTimer:
+			return "A full autosave pass over every zone";
+		default:
+			return "An unknown operation";
+	}
+}
+
+/// publishes a gauge value
+/** This function stores a point-in-time value (such as the number of connected
+	players) so that other threads can read it without touching game data.
+	@param gauge which gauge to set
+	@param value the current value
+*/
+void StatEngine::setGauge(GaugeType gauge, long value) {
+	if(gauge < NumberOfGauges) {
+		__sync_lock_test_and_set(&mGauges[gauge], value);
+	}
+}
+
+/// reads a gauge value
+/** @param gauge which gauge to read
+	\return the last value published for the gauge
+*/
+long StatEngine::getGauge(GaugeType gauge) const {
+	if(gauge < NumberOfGauges) {
+		return mGauges[gauge];
+	}
+	return 0;
+}
+
+/// records how long a player command took
+/** This function adds a sample to the named command's histogram, creating the
+	histogram the first time a command is seen. Histograms are never removed, so
+	pointers handed out by getCommandHistograms() stay valid for the life of the engine.
+	@param name the name of the command (or a pseudo-command such as an exit)
+	@param usec how long the command took, in microseconds
+*/
+void StatEngine::recordCommand(const std::string &name, unsigned long usec) {
+	recordKeyed(mCommandTimers, name, usec);
+}
+
+/// gets every per-command histogram
+/** This function makes a copy of the command name to histogram map, so callers on
+	other threads can walk it without holding the lock.
+	\return a map of command names to their histograms
+*/
+StatEngine::HistogramMap StatEngine::getCommandHistograms() {
+	return copyKeyed(mCommandTimers);
+}
+
+/// clears the per-command histograms
+/** This function zeros the samples of every command, keeping the histograms themselves.
+*/
+void StatEngine::resetCommandHistograms() {
+	resetKeyed(mCommandTimers);
+}
+
+/// records how long a zone's heartbeat took
+/** @param name the name of the zone
+	@param usec how long Zone::heartbeat() took, in microseconds
+*/
+void StatEngine::recordZone(const std::string &name, unsigned long usec) {
+	recordKeyed(mZoneTimers, name, usec);
+}
+
+/// gets every per-zone heartbeat histogram
+/** \return a copy of the map of zone names to their histograms
+*/
+StatEngine::HistogramMap StatEngine::getZoneHistograms() {
+	return copyKeyed(mZoneTimers);
+}
+
+/// clears the per-zone heartbeat histograms
+void StatEngine::resetZoneHistograms() {
+	resetKeyed(mZoneTimers);
+}
+
+/// adds a sample to a named histogram
+/** This function finds the histogram for \a name in \a timers, creating it if this is
+	the first sample. Histograms are never removed, so copies of the map stay valid.
+	@param timers the map to record into
+	@param name the key of the histogram
+	@param usec the sample, in microseconds
+*/
+void StatEngine::recordKeyed(HistogramMap &timers, const std::string &name, unsigned long usec) {
+	Histogram *h = NULL;
+
+	if(!mHistogramLock.lock()) {
+		return;
+	}
+
+	HistogramMap::iterator it = timers.find(name);
+
+	if(it == timers.end()) {
+		h = new Histogram;
+		timers.insert(std::make_pair(name, h));
+	} else {
+		h = it->second;
+	}
+
+	mHistogramLock.unlock();
+
+	h->record(usec);
+}
+
+/// copies a map of named histograms under the lock
+/** @param timers the map to copy
+	\return a copy of the map
+*/
+StatEngine::HistogramMap StatEngine::copyKeyed(const HistogramMap &timers) {
+	HistogramMap copy;
+
+	if(mHistogramLock.lock()) {
+		copy = timers;
+		mHistogramLock.unlock();
+	}
+
+	return copy;
+}
+
+/// zeros every histogram in a map of named histograms
+/** @param timers the map to reset
+*/
+void StatEngine::resetKeyed(HistogramMap &timers) {
+	if(mHistogramLock.lock()) {
+		for(HistogramMap::iterator it = timers.begin(); it != timers.end(); ++it) {
+			it->second->reset();
+		}
+		mHistogramLock.unlock();
+	}
 }
 
 /// How long the process thread stays awake on average
@@ -52,7 +388,13 @@ void StatEngine::addSleepTime(unsigned long sleep) {
 	\return the average loop processing time
 */
 float StatEngine::getAverageLoopProcessTime() {
-	float f = boost::numeric_cast<float>(TIME_RESOLUTION - (mLoopTime / mNumberOfLoops));
+	unsigned int loops = mNumberOfLoops;
+
+	if(loops == 0) {
+		return 0.0;
+	}
+
+	float f = boost::numeric_cast<float>(TIME_RESOLUTION - (mLoopTime / loops));
 
 	return f;
 }
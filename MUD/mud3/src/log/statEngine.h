@@ -1,13 +1,69 @@
 #ifndef STATENGINE_H
 #define STATENGINE_H
 
+#include <string>
+#include <map>
+#include <ctime>
+#include <pthread.h>
+
+#include "histogram.h"
+#include "mutex.h"
+
 /// A statistics-gathering engine
 /** This class gathers statistics for the MUD while it is running. Loop processing
 	times, bytes in and out, and other data are tracked here. Also contains
 	a few functions to retrieve information about these statistics.
+	\note The driver, process and save threads all report here, so every counter
+	is updated atomically and the latency histograms are lock-free.
 */
 class StatEngine {
 public:
+	/// the engine operations we keep latency histograms for
+	typedef enum {
+		TickTimer = 0,				///< one pass of the process thread loop
+		TickCommandsTimer,			///< the processCommands() phase of a tick
+		HeartbeatTimer,				///< one call to heartbeat()
+		HeartbeatEventsTimer,		///< the EventDaemon phase of a heartbeat
+		HeartbeatPlayersTimer,		///< the player heartbeat phase of a heartbeat
+		HeartbeatZonesTimer,		///< the zone heartbeat phase of a heartbeat
+		CommandTimer,				///< one player command, from dispatch to return
+		FlushTimer,		///< writing a connection's output buffer to its socket
+		SaveTimer,		///< a full autosave pass over every zone
+
+		NumberOfTimers
+	} TimerType;
+
+	/// point-in-time values published by the process thread for readers on other threads
+	typedef enum {
+		PlayersGauge = 0,			///< connections in the playing state
+		ConnectionsClosedGauge,		///< connections, by connection state
+		ConnectionsLoginGauge,
+		ConnectionsPasswordGauge,
+		ConnectionsCreateGauge,
+		ConnectionsPlayingGauge,
+		EventQueueGauge,			///< events waiting in the EventDaemon
+		DirtyRoomsGauge,			///< rooms changed since their last save
+		RoomsGauge,					///< rooms loaded in all zones
+		CompressedConnectionsGauge,	///< connections with MCCP2 turned on
+		CompressorMemoryGauge,		///< bytes held by MCCP2 compressors
+
+		NumberOfGauges
+	} GaugeType;
+
+	/// what per-connection input limits did, counted for the metrics
+	typedef enum {
+		InputBytesThrottled = 0,	///< reading paused because a connection used up its InputByteRate
+		InputLinesThrottled,		///< lines held back because a connection used up its InputLineRate
+		InputLinesTruncated,		///< lines cut to MaxInputLineLength
+		CommandsDropped,			///< commands thrown away because the queue was full
+		CommandFloodDisconnects,	///< connections closed because the queue was full
+
+		NumberOfInputLimits
+	} InputLimitType;
+
+	/// maps a command name to its latency histogram
+	typedef std::map<std::string, Histogram *> HistogramMap;
+
 	StatEngine();
 	~StatEngine();
 	
@@ -15,11 +71,52 @@ public:
 	void addBytesIn(unsigned long in);
 
 	/// get the number of bytes the server has written out
-	unsigned long getBytesOut() { return mBytesOut; }
+	unsigned long getBytesOut() const { return mBytesOut; }
 	/// get the number of bytes the server has read in
-	unsigned long getBytesIn() { return mBytesIn; }
+	unsigned long getBytesIn() const { return mBytesIn; }
+
+	void addCompression(unsigned long raw, unsigned long compressed);
+
+	/// get the number of bytes fed into MCCP2 compressors
+	unsigned long getCompressionRawBytes() const { return mCompressionRawBytes; }
+	/// get the number of bytes MCCP2 compressors produced
+	unsigned long getCompressionCompressedBytes() const { return mCompressionCompressedBytes; }
+
+	void addGmcpMessage();
+
+	/// get the number of GMCP messages sent to clients
+	unsigned long getGmcpMessages() const { return mGmcpMessages; }
 	
+	void addInputLimit(InputLimitType limit);
+	unsigned long getInputLimit(InputLimitType limit) const;
+	std::string getInputLimitName(InputLimitType limit) const;
+
 	void addSleepTime(unsigned long sleep);
+
+	void recordTime(TimerType timer, unsigned long usec);
+
+	const Histogram &getHistogram(TimerType timer) const;
+	unsigned long getLastTime(TimerType timer) const;
+	unsigned long getRecentTime(TimerType timer) const;
+	std::string getTimerName(TimerType timer) const;
+	std::string getTimerDescription(TimerType timer) const;
+
+	void setGauge(GaugeType gauge, long value);
+	long getGauge(GaugeType gauge) const;
+
+	void recordCommand(const std::string &name, unsigned long usec);
+	HistogramMap getCommandHistograms();
+	void resetCommandHistograms();
+
+	void recordZone(const std::string &name, unsigned long usec);
+	HistogramMap getZoneHistograms();
+	void resetZoneHistograms();
+
+	unsigned long getMemoryUsage();
+
+	void addTickOverrun();
+	/// get the number of ticks that took longer than TIME_RESOLUTION
+	unsigned long getTickOverruns() const { return mTickOverruns; }
 	
 	std::string getEngineUptime();
 	std::string getTimeDifference(const time_t later, const time_t earlier);
@@ -29,11 +126,31 @@ public:
 	float getAverageLoopProcessTime();
 	
 private:
-	unsigned long mBytesOut;	///< number of bytes out from the server
-	unsigned long mBytesIn;		///< number of bytes in to the server
+	volatile unsigned long mBytesOut;	///< number of bytes out from the server
+	volatile unsigned long mBytesIn;		///< number of bytes in to the server
+	volatile unsigned long mCompressionRawBytes;		///< bytes fed into MCCP2 compressors
+	volatile unsigned long mCompressionCompressedBytes;	///< bytes MCCP2 compressors wrote out
+	volatile unsigned long mGmcpMessages;	///< GMCP messages sent to clients
+	volatile unsigned long mInputLimits[NumberOfInputLimits];	///< see addInputLimit(), indexed by InputLimitType
 	time_t mEngineStartTime;	///< time when the server started
-	unsigned long long mLoopTime;	///< how much time is spent in loops
-	unsigned int mNumberOfLoops;	///< how many loops have happenend
+	volatile unsigned long long mLoopTime;	///< how much time is spent in loops
+	volatile unsigned int mNumberOfLoops;	///< how many loops have happenend
+
+	volatile unsigned long mTickOverruns;	///< how many ticks ran past TIME_RESOLUTION
+
+	Histogram mTimers[NumberOfTimers];	///< latency histograms, indexed by TimerType
+	volatile unsigned long mLastTimes[NumberOfTimers];	///< the most recent sample, indexed by TimerType
+	volatile unsigned long mRecentTimes[NumberOfTimers];	///< a moving average of recent samples, in 1/8 microseconds, indexed by TimerType
+
+	volatile long mGauges[NumberOfGauges];	///< published gauge values, indexed by GaugeType
+
+	HistogramMap mCommandTimers;	///< per-command latency histograms, created on first use
+	HistogramMap mZoneTimers;		///< per-zone heartbeat histograms, created on first use
+	Mutex mHistogramLock;	///< guards insertions into mCommandTimers and mZoneTimers
+
+	void recordKeyed(HistogramMap &timers, const std::string &name, unsigned long usec);
+	HistogramMap copyKeyed(const HistogramMap &timers);
+	void resetKeyed(HistogramMap &timers);
 };
 
 #endif // STATENGINE_H
@@ -0,0 +1,33 @@
+#include "timer.h"
+
+/// Constructor
+/** Starts the timer
+*/
+Timer::Timer() {
+	reset();
+}
+
+/// restarts the timer
+/** This function sets the timer's start point to the current time
+*/
+void Timer::reset() {
+	mStart = now();
+}
+
+/// how long the timer has been running
+/** This function calculates the time since the timer was started or last reset
+	\return the elapsed time in microseconds
+*/
+unsigned long Timer::elapsed() const {
+	return static_cast<unsigned long>(now() - mStart);
+}
+
+/// reads the monotonic clock
+/** This function gets the current value of the system's monotonic clock
+	\return the current monotonic time in microseconds
+*/
+unsigned long long Timer::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<unsigned long long>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+}
@@ -0,0 +1,25 @@
+#ifndef MUD_TIMER_H
+#define MUD_TIMER_H
+
+#include <ctime>
+
+/// A simple stopwatch for measuring short durations
+/** This class reads the monotonic clock when it is created (or reset) and reports
+	how many microseconds have passed since. It is unaffected by changes to the
+	system time, so it is safe to use for profiling the engine loops.
+*/
+class Timer {
+public:
+	Timer();
+
+	void reset();
+
+	unsigned long elapsed() const;
+
+	static unsigned long long now();
+
+private:
+	unsigned long long mStart;	///< monotonic timestamp when the timer was started, in microseconds
+};
+
+#endif // MUD_TIMER_H
@@ -0,0 +1,68 @@
+#include "timerWheel.h"
+
+/// Constructor
+/** Creates an empty wheel that starts at the current time
+	@param slots seconds in one turn of the wheel
+*/
+TimerWheel::TimerWheel(const unsigned int slots) : mSlots(slots > 0 ? slots : 1) {
+	mNow = time(NULL);
+	mSize = 0;
+	mNextSerial = 1;
+}
+
+/// adds a deadline
+/** A deadline that has already passed expires on the next advance().
+	@param deadline when it expires
+	@param id what it is for
+	@param serial the serial of the entry this one replaces, or 0 for a new one
+	\return the entry's serial
+*/
+unsigned long TimerWheel::schedule(const time_t deadline, const int id, const unsigned long serial) {
+	Entry entry;
+	entry.deadline = deadline;
+	entry.id = id;
+	entry.serial = serial != 0 ? serial : mNextSerial++;
+
+	time_t slot = deadline > mNow ? deadline : mNow + 1;
+	mSlots[slot % mSlots.size()].push_back(entry);
+	++mSize;
+
+	return entry.serial;
+}
+
+/// takes out every deadline up to now
+/** Only the slots for the seconds since the last call are looked at; if more than a
+	turn has passed, each slot is looked at once.
+	@param now the current time
+	@param[out] expired the deadlines that have passed are added here
+*/
+void TimerWheel::advance(const time_t now, std::vector<Entry> &expired) {
+	if(now <= mNow) {
+		return;
+	}
+
+	time_t first = mNow + 1;
+
+	if(now - first >= static_cast<time_t>(mSlots.size())) {
+		first = now - mSlots.size() + 1;
+	}
+
+	for(time_t second = first; second <= now; ++second) {
+		std::vector<Entry> &slot = mSlots[second % mSlots.size()];
+		std::vector<Entry>::size_type kept = 0;
+
+		for(std::vector<Entry>::size_type i = 0; i < slot.size(); ++i) {
+			if(slot[i].deadline <= now) {
+				expired.push_back(slot[i]);
+				--mSize;
+			} else {
+				// due on a later turn of the wheel
+				slot[kept++] = slot[i];
+			}
+		}
+
+		slot.resize(kept);
+	}
+
+	mNow = now;
+}
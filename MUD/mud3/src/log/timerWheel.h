@@ -0,0 +1,43 @@
+#ifndef MUD_TIMER_WHEEL_H
+#define MUD_TIMER_WHEEL_H
+
+#include <vector>
+#include <ctime>
+
+/// Holds deadlines in a ring of one-second slots, so they expire without a scan
+/** This is a hashed timing wheel: a deadline goes into slot (deadline % slots), and
+	advance() only looks at the slots for the seconds that have passed. Scheduling is
+	O(1), and each deadline is looked at once per turn of the wheel, so a deadline
+	further off than one turn costs one extra look per turn rather than a place in a
+	sorted structure.
+
+	Entries can't be cancelled. Owners tell live entries from stale ones by the
+	serial number they get back from schedule(), and simply ignore stale ones when
+	they expire.
+	\note Not thread safe; callers lock around it.
+*/
+class TimerWheel {
+public:
+	/// one deadline
+	struct Entry {
+		time_t deadline;		///< when it expires
+		int id;					///< what it is for, such as a descriptor
+		unsigned long serial;	///< tells this entry apart from earlier ones with the same id
+	};
+
+	explicit TimerWheel(const unsigned int slots = 1024);
+
+	unsigned long schedule(const time_t deadline, const int id, const unsigned long serial = 0);
+	void advance(const time_t now, std::vector<Entry> &expired);
+
+	/// gets how many deadlines are waiting
+	unsigned long size() const { return mSize; }
+
+private:
+	std::vector<std::vector<Entry> > mSlots;	///< the ring, one slot per second
+	time_t mNow;					///< the last second advance() looked at, or 0 before the first call
+	unsigned long mSize;			///< deadlines waiting
+	unsigned long mNextSerial;		///< the serial the next new entry gets
+};
+
+#endif // MUD_TIMER_WHEEL_H
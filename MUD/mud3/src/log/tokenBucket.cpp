@@ -0,0 +1,79 @@
+#include "tokenBucket.h"
+
+/// Constructor
+/** Creates an unlimited bucket
+*/
+TokenBucket::TokenBucket() {
+	configure(0, 0);
+}
+
+/// Constructor
+/** Creates a full bucket
+	@param rate tokens added per second
+	@param burst the most tokens the bucket holds
+*/
+TokenBucket::TokenBucket(const double rate, const double burst) {
+	configure(rate, burst);
+}
+
+/// changes the rate and size, and fills the bucket
+/** @param rate tokens added per second
+	@param burst the most tokens the bucket holds; 0 for no limit
+*/
+void TokenBucket::configure(const double rate, const double burst) {
+	mRate = rate > 0 ? rate : 0;
+	mBurst = burst > 0 ? burst : 0;
+	mTokens = mBurst;
+	mLast = 0;
+}
+
+/// takes tokens for an event, if there are enough
+/** @param now the time, from Timer::now()
+	@param tokens how many the event costs
+	\return true if the event is allowed; false if the bucket is too empty, in which
+		case nothing is taken
+*/
+bool TokenBucket::take(const unsigned long long now, const double tokens) {
+	if(!isLimited()) {
+		return true;
+	}
+
+	mTokens = getTokens(now);
+	mLast = now;
+
+	if(mTokens < tokens) {
+		return false;
+	}
+
+	mTokens -= tokens;
+	return true;
+}
+
+/// checks whether take() would allow an event, without taking anything
+/** This lets a caller that needs tokens from several buckets check them all first, so
+	one that refuses doesn't leave the others short.
+	@param now the time, from Timer::now()
+	@param tokens how many the event costs
+	\return true if the event would be allowed
+*/
+bool TokenBucket::canTake(const unsigned long long now, const double tokens) const {
+	return !isLimited() || getTokens(now) >= tokens;
+}
+
+/// gets how many tokens the bucket holds
+/** @param now the time, from Timer::now()
+	\return the tokens available, which is the burst size for an unlimited bucket
+*/
+double TokenBucket::getTokens(const unsigned long long now) const {
+	if(mLast == 0 || now <= mLast) {
+		return mTokens;
+	}
+
+	double tokens = mTokens + mRate * (now - mLast) / 1000000.0;
+	return tokens < mBurst ? tokens : mBurst;
+}
+
+/// true if the bucket has refilled completely, so forgetting it changes nothing
+bool TokenBucket::isFull(const unsigned long long now) const {
+	return getTokens(now) >= mBurst;
+}
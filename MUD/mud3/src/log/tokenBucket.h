@@ -0,0 +1,35 @@
+#ifndef MUD_TOKEN_BUCKET_H
+#define MUD_TOKEN_BUCKET_H
+
+/// Limits how often something may happen, while allowing short bursts
+/** A bucket holds up to \a burst tokens and refills at \a rate tokens per second. Each
+	event takes tokens, and an event that finds too few is refused until the bucket
+	refills. Callers pass in the time from Timer::now(), so one clock read can serve
+	many buckets.
+	\note A bucket with no burst never refuses anything, so a limit of 0 in the config
+		means no limit. Buckets are not thread safe; callers lock around them.
+*/
+class TokenBucket {
+public:
+	TokenBucket();
+	TokenBucket(const double rate, const double burst);
+
+	void configure(const double rate, const double burst);
+
+	bool take(const unsigned long long now, const double tokens = 1.0);
+	bool canTake(const unsigned long long now, const double tokens = 1.0) const;
+
+	double getTokens(const unsigned long long now) const;
+	bool isFull(const unsigned long long now) const;
+
+	/// true if the bucket refuses events at all
+	bool isLimited() const { return mBurst > 0; }
+
+private:
+	double mRate;		///< tokens added per second
+	double mBurst;		///< the most tokens the bucket holds
+	double mTokens;		///< tokens as of mLast
+	unsigned long long mLast;	///< when mTokens was last brought up to date, in microseconds
+};
+
+#endif // MUD_TOKEN_BUCKET_H
@@ -0,0 +1,235 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>	// for SYS_gettid
+
+#include <boost/format.hpp>
+
+#include "traceRecorder.h"
+#include "timer.h"
+
+/// orders copied events by start time
+static bool compareTimestamp(const std::pair<unsigned long long, std::string> &a, const std::pair<unsigned long long, std::string> &b) {
+	return a.first < b.first;
+}
+
+/// Constructor
+/** Allocates the ring buffer and starts recording if TRACE_ENABLED is set
+*/
+TraceRecorder::TraceRecorder() : mThreadNameLock("TraceRecorder") {
+	mEvents = new TraceEvent[TRACE_BUFFER_EVENTS];
+	memset(mEvents, 0, sizeof(TraceEvent) * TRACE_BUFFER_EVENTS);
+	mNext = 0;
+	mEnabled = TRACE_ENABLED ? 1 : 0;
+}
+
+/// Destructor
+/** Frees the ring buffer
+*/
+TraceRecorder::~TraceRecorder() {
+	mEnabled = 0;
+	delete [] mEvents;
+}
+
+/// turns recording on or off
+/** @param enabled true to start recording, false to stop
+*/
+void TraceRecorder::setEnabled(const bool enabled) {
+	__sync_lock_test_and_set(&mEnabled, enabled ? 1 : 0);
+}
+
+/// names the calling thread in dumped traces
+/** @param name the thread's name, eg. "driver"
+*/
+void TraceRecorder::nameThread(const std::string &name) {
+	int tid = currentThreadId();
+
+	if(mThreadNameLock.lock()) {
+		mThreadNames[tid] = name;
+		mThreadNameLock.unlock();
+	}
+}
+
+/// writes an event into the ring buffer
+/** The slot's sequence number is cleared while it is being written, so dump() can
+	skip events that are torn by a concurrent writer.
+	@param detail optional text, truncated to fit the slot; NULL records none
+*/
+void TraceRecorder::record(const char phase, const char *category, const char *name, const unsigned long long start, const unsigned long duration, const char *detail) {
+	unsigned long position = __sync_fetch_and_add(&mNext, 1UL);
+	TraceEvent &event = mEvents[position % TRACE_BUFFER_EVENTS];
+
+	event.sequence = 0;
+	__sync_synchronize();
+
+	event.timestamp = start;
+	event.duration = duration;
+	event.category = category;
+	event.name = name;
+	event.threadId = currentThreadId();
+	event.phase = phase;
+
+	size_t length = 0;
+
+	if(detail) {
+		while(length < TRACE_DETAIL_LENGTH - 1 && detail[length] != '\0') {
+			event.detail[length] = detail[length];
+			++length;
+		}
+	}
+
+	event.detail[length] = '\0';
+
+	__sync_synchronize();
+	event.sequence = position + 1;
+}
+
+/// writes recent events to a file as Chrome trace-event JSON
+/** This function copies every complete event that started in the last \a seconds
+	out of the ring buffer and writes them, oldest first, to \a file. Recording
+	carries on while the dump runs.
+	@param file the path of the JSON file to write
+	@param seconds how far back to go
+	\return true if the file was written
+*/
+bool TraceRecorder::dump(const std::string &file, const unsigned long seconds) {
+	unsigned long long now = Timer::now();
+	unsigned long long since = now > seconds * 1000000ULL ? now - seconds * 1000000ULL : 0;
+
+	std::vector<std::pair<unsigned long long, std::string> > lines;
+
+	for(unsigned long i = 0; i < TRACE_BUFFER_EVENTS; ++i) {
+		TraceEvent &slot = mEvents[i];
+
+		unsigned long before = slot.sequence;
+		__sync_synchronize();
+
+		TraceEvent event;
+		event.timestamp = slot.timestamp;
+		event.duration = slot.duration;
+		event.category = slot.category;
+		event.name = slot.name;
+		event.threadId = slot.threadId;
+		event.phase = slot.phase;
+		memcpy(event.detail, slot.detail, TRACE_DETAIL_LENGTH);
+		event.detail[TRACE_DETAIL_LENGTH - 1] = '\0';
+
+		__sync_synchronize();
+
+		if(before == 0 || before != slot.sequence || event.timestamp < since) {
+			continue;
+		}
+
+		std::string line = boost::str(boost::format("{\"name\":\"%1%\",\"cat\":\"%2%\",\"ph\":\"%3%\",\"ts\":%4%,\"pid\":1,\"tid\":%5%")
+			% escape(event.name) % escape(event.category) % event.phase % event.timestamp % event.threadId);
+
+		if(event.phase == 'X') {
+			line += boost::str(boost::format(",\"dur\":%1%") % event.duration);
+		} else {
+			line += ",\"s\":\"t\"";
+		}
+
+		if(event.detail[0] != '\0') {
+			line += ",\"args\":{\"detail\":\"" + escape(event.detail) + "\"}";
+		}
+
+		line += "}";
+		lines.push_back(std::make_pair(event.timestamp, line));
+	}
+
+	std::sort(lines.begin(), lines.end(), compareTimestamp);
+
+	std::ofstream out(file.c_str(), std::ios::out | std::ios::trunc);
+
+	if(!out.is_open()) {
+		return false;
+	}
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+
+	if(mThreadNameLock.lock()) {
+		for(std::map<int, std::string>::const_iterator it = mThreadNames.begin(); it != mThreadNames.end(); ++it) {
+			out << (first ? "\n" : ",\n");
+			out << boost::format("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%1%,\"args\":{\"name\":\"%2%\"}}") % it->first % escape(it->second);
+			first = false;
+		}
+		mThreadNameLock.unlock();
+	}
+
+	for(std::vector<std::pair<unsigned long long, std::string> >::const_iterator it = lines.begin(); it != lines.end(); ++it) {
+		out << (first ? "\n" : ",\n") << it->second;
+		first = false;
+	}
+
+	out << "\n]}\n";
+	out.close();
+
+	return true;
+}
+
+/// dumps recent events to a new, timestamped file
+/** This function picks a file name like \c trace-20100614-213000.json in the
+	current directory (next to the log) and calls dump().
+	@param seconds how far back to go
+	\return the name of the file written, or an empty string on error
+*/
+std::string TraceRecorder::dumpRecent(const unsigned long seconds) {
+	char stamp[32];
+	time_t now = time(NULL);
+	struct tm local;
+
+	localtime_r(&now, &local);
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+	std::string file = std::string("trace-") + stamp + ".json";
+
+	if(!dump(file, seconds)) {
+		return "";
+	}
+
+	return file;
+}
+
+/// gets the kernel id of the calling thread
+/** \return the thread id, as shown by top and gdb
+*/
+int TraceRecorder::currentThreadId() {
+	static __thread int tid = 0;
+
+	if(tid == 0) {
+		tid = static_cast<int>(syscall(SYS_gettid));
+	}
+
+	return tid;
+}
+
+/// escapes text for a JSON string
+/** @param text the raw text
+	\return the text with quotes, backslashes and control characters escaped
+*/
+std::string TraceRecorder::escape(const std::string &text) {
+	std::string escaped;
+
+	for(std::string::size_type i = 0; i < text.length(); ++i) {
+		unsigned char c = text[i];
+
+		if(c == '"' || c == '\\') {
+			escaped += '\\';
+			escaped += c;
+		} else if(c < 0x20) {
+			escaped += boost::str(boost::format("\\u%04x") % static_cast<int>(c));
+		} else {
+			escaped += c;
+		}
+	}
+
+	return escaped;
+}
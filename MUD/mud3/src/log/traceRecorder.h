@@ -0,0 +1,128 @@
+#ifndef MUD_TRACE_RECORDER_H
+#define MUD_TRACE_RECORDER_H
+
+#include <string>
+#include <map>
+#include <cstddef>
+#include <pthread.h>
+
+#include "mudconfig.h"
+#include "mutex.h"
+#include "timer.h"
+
+/// A flight recorder of recent engine activity
+/** This class keeps the last TRACE_BUFFER_EVENTS spans and instant events in a
+	fixed ring buffer, so a latency spike can be examined after the fact. Recording is
+	lock-free and never allocates; the oldest events are simply overwritten. dump()
+	writes the last few seconds out in the Chrome trace-event JSON format, which can be
+	opened in chrome://tracing or https://ui.perfetto.dev/
+	\note When the recorder is disabled each instrumentation point costs a single branch.
+*/
+class TraceRecorder {
+public:
+	TraceRecorder();
+	~TraceRecorder();
+
+	void setEnabled(const bool enabled);
+	/// is the recorder currently recording?
+	bool isEnabled() const { return mEnabled != 0; }
+
+	/// records a span, if the recorder is enabled
+	/** @param category a string literal naming the subsystem, eg. "io"
+		@param name a string literal naming the operation, eg. "FileIO::write"
+		@param start when the operation started, from Timer::now()
+		@param duration how long it took, in microseconds
+		@param detail optional text, such as a file or player name, or NULL
+	*/
+	void span(const char *category, const char *name, const unsigned long long start, const unsigned long duration, const char *detail = NULL) {
+		if(mEnabled) {
+			record('X', category, name, start, duration, detail);
+		}
+	}
+
+	/// records an instant event, if the recorder is enabled
+	/** @param category a string literal naming the subsystem
+		@param name a string literal naming what happened
+		@param detail optional text, or NULL
+	*/
+	void instant(const char *category, const char *name, const char *detail = NULL) {
+		if(mEnabled) {
+			record('i', category, name, Timer::now(), 0, detail);
+		}
+	}
+
+	void nameThread(const std::string &name);
+
+	bool dump(const std::string &file, const unsigned long seconds);
+	std::string dumpRecent(const unsigned long seconds);
+
+	/// how much memory the ring buffer holds, in bytes
+	unsigned long getMemoryUsage() const { return TRACE_BUFFER_EVENTS * sizeof(TraceEvent); }
+
+private:
+	/// one recorded event
+	struct TraceEvent {
+		volatile unsigned long sequence;	///< 0 while being written, otherwise the event's position plus one
+		unsigned long long timestamp;		///< monotonic start time, in microseconds
+		unsigned long duration;				///< length of a span, in microseconds
+		const char *category;				///< a string literal naming the subsystem
+		const char *name;					///< a string literal naming the operation
+		int threadId;						///< the kernel thread id of the recording thread
+		char phase;							///< 'X' for a span, 'i' for an instant event
+		char detail[TRACE_DETAIL_LENGTH];	///< a truncated copy of the event's detail text
+	};
+
+	TraceEvent *mEvents;		///< the ring buffer
+	volatile unsigned long mNext;	///< the position of the next event to write
+	volatile int mEnabled;		///< non-zero while recording
+
+	std::map<int, std::string> mThreadNames;	///< thread names for the trace viewer
+	Mutex mThreadNameLock;						///< guards mThreadNames
+
+	void record(const char phase, const char *category, const char *name, const unsigned long long start, const unsigned long duration, const char *detail);
+
+	static int currentThreadId();
+	static std::string escape(const std::string &text);
+};
+
+/// Records a span covering its own lifetime
+/** Create one of these at the top of a block to record how long the block took.
+	If the recorder is disabled when the span is created, nothing else happens: the
+	constructor and destructor are inline, so the span costs one branch on each.
+*/
+class TraceSpan {
+public:
+	/// starts the span, if the recorder is enabled
+	TraceSpan(TraceRecorder &recorder, const char *category, const char *name) : mRecorder(recorder), mCategory(category), mName(name), mStart(0), mActive(recorder.isEnabled()), mDetail(NULL) {
+		if(mActive) {
+			mStart = Timer::now();
+		}
+	}
+
+	/// ends the span and records it
+	~TraceSpan() {
+		if(mActive) {
+			mRecorder.span(mCategory, mName, mStart, static_cast<unsigned long>(Timer::now() - mStart), mDetail);
+		}
+	}
+
+	/// will this span be recorded? Check before building expensive detail strings
+	bool isActive() const { return mActive; }
+	/// sets the text shown in the trace viewer's args for this span
+	/** The text is copied when the span ends, so it must live at least as long as the span.
+	*/
+	void setDetail(const char *detail) { mDetail = detail; }
+
+private:
+	TraceRecorder &mRecorder;	///< where the span is recorded
+	const char *mCategory;		///< the span's category
+	const char *mName;			///< the span's name
+	unsigned long long mStart;	///< when the span started, in microseconds
+	bool mActive;				///< true if the recorder was enabled when the span started
+	const char *mDetail;		///< optional detail text, or NULL
+
+	TraceSpan(const TraceSpan &);
+	TraceSpan & operator=(const TraceSpan &);
+};
+
+#endif // MUD_TRACE_RECORDER_H
@@ -1,6 +1,10 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <iostream>
+#include <csignal>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
 
 #include "mudconfig.h"
 #include "thread_functions.h"
@@ -9,11 +13,13 @@
 Global glob;
 
 /// This is where everything starts
-/** This function ignores any arguments and starts the game up.
+/** This function starts the game up.
 	It created the driver and processing threads and does nothing else.
 	@param argc the number of command-line arguments
 	@param argv a \c char array of command-line arguments
-	\note There are no command-line arguments for this program
+	\note The only arguments are <tt>--hot-reboot fd [descriptors]</tt>, which HotReboot
+		passes when it runs the program again; \c fd is the listening socket to take up and
+		\c descriptors the comma separated client connections that come with it
 	\todo find a way to let either thread join and shut the other one down
 */
 int main(int argc, char *argv[]) {
@@ -24,11 +30,41 @@ int main(int argc, char *argv[]) {
 
 	glob.log.debug("Starting ForeverMUD...");
 
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &requestTraceDump;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGUSR1, &action, NULL);
+
 	pthread_attr_t attr;
 	pthread_t tProcess;
 	pthread_t tSaveRooms;
 
-	glob.driver.initialize(MUDPORT);
+	// a fixed RandomSeed makes a run repeatable, which traffic replay depends on
+	int seed = glob.Config.getIntValue("RandomSeed");
+
+	if(seed < 0) {
+		seed = static_cast<int>(time(NULL) & 0x7fffffff);
+	}
+
+	glob.RNG.seed(seed);
+	glob.log.info(boost::format("Random seed is %1%") % seed);
+
+	glob.capture.start(seed);
+
+	glob.metricsServer.start();
+	glob.watchdog.start();
+	glob.resolver.start();
+
+	// connections handed over by a hot reboot are taken up once everything they need is running
+	glob.hotReboot.setProgram(argv[0]);
+
+	bool hotReboot = argc >= 3 && strcmp(argv[1], "--hot-reboot") == 0;
+
+	if(!hotReboot || !glob.hotReboot.restore(atoi(argv[2]), argc > 3 ? argv[3] : "")) {
+		glob.driver.initialize(MUDPORT);
+	}
 
 	// initialize and start our threads
 	pthread_attr_init(&attr);
@@ -5,12 +5,16 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/format.hpp>
 
+#include "memoryAccount.h"
+
 /// a class that describes a message to be sent
 /** This class defines what a message is, including the type, destination, header,
 	who it's from, etc. It's similar to an SMTP message but without the spam.
 	\see MessageDaemon for delivery method
 */
 class Message {
+	MEMORY_ACCOUNTED(MemoryAccount::MessagesTag)
+
 public:
 	/// defines the different types of messages sent to containers
 	typedef enum {
@@ -0,0 +1,492 @@
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "metricsServer.h"
+#include "memoryAccount.h"
+
+#include "global.h"
+extern Global glob;
+
+/// Constructor
+/** Does nothing; the server is not started until start() is called
+*/
+MetricsServer::MetricsServer() {
+	mListenFd = -1;
+}
+
+/// Destructor
+/** Closes the listening socket if it is open
+*/
+MetricsServer::~MetricsServer() {
+	if(mListenFd != -1) {
+		close(mListenFd);
+		mListenFd = -1;
+	}
+}
+
+/// opens the metrics port and starts the server thread
+/** This function reads the \c MetricsPort and \c MetricsAddress config values, binds
+	a listening socket and spawns a detached thread to serve it. If no port is
+	configured the server stays off.
+	\return true if the server is running
+*/
+bool MetricsServer::start() {
+	int port = glob.Config.getIntValue("MetricsPort");
+
+	if(port < 1 || port > 65535) {
+		glob.log.info("MetricsServer::start(): MetricsPort is not set, metrics endpoint disabled");
+		return false;
+	}
+
+	std::string address = glob.Config.getStringValue("MetricsAddress");
+
+	if(address.empty()) {
+		address = "127.0.0.1";
+	}
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(static_cast<unsigned short>(port));
+
+	if(inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+		glob.log.error(boost::format("MetricsServer::start(): MetricsAddress %1% is not a valid IPv4 address") % address);
+		return false;
+	}
+
+	mListenFd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if(mListenFd == -1) {
+		glob.log.error(boost::format("MetricsServer::start(): socket() failed: %1%") % strerror(errno));
+		return false;
+	}
+
+	int optval = 1;
+	setsockopt(mListenFd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+
+	if(bind(mListenFd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(mListenFd, SOCKET_CONNECTION_BACKLOG) == -1) {
+		glob.log.error(boost::format("MetricsServer::start(): Cannot listen on %1%:%2%: %3%") % address % port % strerror(errno));
+		close(mListenFd);
+		mListenFd = -1;
+		return false;
+	}
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	if(pthread_create(&mThread, &attr, thread_metrics_func, this) != 0) {
+		glob.log.error("MetricsServer::start(): Cannot create metrics thread");
+		close(mListenFd);
+		mListenFd = -1;
+		return false;
+	}
+
+	glob.log.info(boost::format("Metrics endpoint listening on http://%1%:%2%/metrics") % address % port);
+
+	return true;
+}
+
+/// the metrics thread's main loop
+/** This function waits for scrapers to connect and serves them one at a time. It
+	wakes up every SOCKET_TIME_RESOLUTION microseconds to check for shutdown.
+*/
+void MetricsServer::run() {
+	while(!glob.shutdownMUD) {
+		fd_set fdset;
+		FD_ZERO(&fdset);
+		FD_SET(mListenFd, &fdset);
+
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = SOCKET_TIME_RESOLUTION;
+
+		if(select(mListenFd + 1, &fdset, NULL, NULL, &tv) < 1) {
+			continue;
+		}
+
+		int fd = accept(mListenFd, NULL, NULL);
+
+		if(fd == -1) {
+			continue;
+		}
+
+		serveClient(fd);
+		close(fd);
+	}
+
+	glob.log.debug("Metrics thread shutting down");
+}
+
+/// answers a single HTTP request
+/** This function reads one request (giving up after a second) and answers it.
+	Only \c GET \c /metrics is recognized; everything else gets a 404.
+	@param fd the connected scraper's socket
+*/
+void MetricsServer::serveClient(const int fd) {
+	struct timeval tv;
+	tv.tv_sec = 1;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	std::string request;
+	char buffer[1024];
+
+	while(request.find("\r\n\r\n") == std::string::npos && request.find("\n\n") == std::string::npos && request.length() < 8192) {
+		ssize_t bytes = read(fd, buffer, sizeof(buffer));
+
+		if(bytes <= 0) {
+			break;
+		}
+		request.append(buffer, bytes);
+	}
+
+	std::string status = "404 Not Found";
+	std::string body = "Try /metrics\n";
+
+	if(request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0) {
+		status = "200 OK";
+		body = render();
+	}
+
+	std::stringstream s;
+	s << "HTTP/1.0 " << status << "\r\n";
+	s << "Content-Type: text/plain; version=0.0.4\r\n";
+	s << "Content-Length: " << body.length() << "\r\n";
+	s << "Connection: close\r\n\r\n";
+	s << body;
+
+	std::string response = s.str();
+	std::string::size_type sent = 0;
+
+	while(sent < response.length()) {
+		ssize_t written = write(fd, response.data() + sent, response.length() - sent);
+
+		if(written <= 0) {
+			break;
+		}
+		sent += written;
+	}
+}
+
+/// generates the metrics page
+/** This function formats every StatEngine counter, gauge and histogram in the
+	Prometheus text format. Histograms are exported as summaries with p50, p95 and p99
+	quantiles, plus a separate \c _max gauge.
+	\return the body of the metrics page
+*/
+std::string MetricsServer::render() const {
+	std::string out;
+
+	out += "# HELP mud_uptime_seconds How long the engine has been running.\n";
+	out += "# TYPE mud_uptime_seconds gauge\n";
+	out += boost::str(boost::format("mud_uptime_seconds %1%\n") % glob.statEngine.getEngineUptimeSeconds());
+
+	out += "# HELP mud_bytes_in_total Bytes read from client sockets.\n";
+	out += "# TYPE mud_bytes_in_total counter\n";
+	out += boost::str(boost::format("mud_bytes_in_total %1%\n") % glob.statEngine.getBytesIn());
+
+	out += "# HELP mud_bytes_out_total Bytes written to client sockets.\n";
+	out += "# TYPE mud_bytes_out_total counter\n";
+	out += boost::str(boost::format("mud_bytes_out_total %1%\n") % glob.statEngine.getBytesOut());
+
+	out += "# HELP mud_mccp_raw_bytes_total Bytes fed into MCCP2 compressors.\n";
+	out += "# TYPE mud_mccp_raw_bytes_total counter\n";
+	out += boost::str(boost::format("mud_mccp_raw_bytes_total %1%\n") % glob.statEngine.getCompressionRawBytes());
+
+	out += "# HELP mud_mccp_compressed_bytes_total Bytes written by MCCP2 compressors.\n";
+	out += "# TYPE mud_mccp_compressed_bytes_total counter\n";
+	out += boost::str(boost::format("mud_mccp_compressed_bytes_total %1%\n") % glob.statEngine.getCompressionCompressedBytes());
+
+	out += "# HELP mud_mccp_connections Connections with MCCP2 compression turned on.\n";
+	out += "# TYPE mud_mccp_connections gauge\n";
+	out += boost::str(boost::format("mud_mccp_connections %1%\n") % glob.statEngine.getGauge(StatEngine::CompressedConnectionsGauge));
+
+	out += "# HELP mud_mccp_memory_bytes Memory held by MCCP2 compressors.\n";
+	out += "# TYPE mud_mccp_memory_bytes gauge\n";
+	out += boost::str(boost::format("mud_mccp_memory_bytes %1%\n") % glob.statEngine.getGauge(StatEngine::CompressorMemoryGauge));
+
+	out += "# HELP mud_gmcp_messages_total GMCP messages sent to clients.\n";
+	out += "# TYPE mud_gmcp_messages_total counter\n";
+	out += boost::str(boost::format("mud_gmcp_messages_total %1%\n") % glob.statEngine.getGmcpMessages());
+
+	out += "# HELP mud_connections_accepted_total Connections let in by admission control.\n";
+	out += "# TYPE mud_connections_accepted_total counter\n";
+	out += boost::str(boost::format("mud_connections_accepted_total %1%\n") % glob.driver.getAccepted());
+
+	out += "# HELP mud_connections_rejected_total Connections turned away, by reason.\n";
+	out += "# TYPE mud_connections_rejected_total counter\n";
+
+	for(int i = 0; i < SocketDriver::NumberOfRejections; ++i) {
+		SocketDriver::RejectReason reason = static_cast<SocketDriver::RejectReason>(i);
+		out += boost::str(boost::format("mud_connections_rejected_total{reason=\"%1%\"} %2%\n") % SocketDriver::getRejectName(reason) % glob.driver.getRejected(reason));
+	}
+
+	out += "# HELP mud_connections_reaped_total Connections closed for idling, by the state they idled in.\n";
+	out += "# TYPE mud_connections_reaped_total counter\n";
+
+	for(int i = Connection::ConnState_Login; i < NUMBER_OF_CONNECTION_STATES; ++i) {
+		Connection::ConnStateEnum state = static_cast<Connection::ConnStateEnum>(i);
+		out += boost::str(boost::format("mud_connections_reaped_total{state=\"%1%\"} %2%\n") % IdleReaper::getStateName(state) % glob.reaper.getReaped(state));
+	}
+
+	out += "# HELP mud_idle_deadlines Deadlines waiting in the idle reaper's timer wheel.\n";
+	out += "# TYPE mud_idle_deadlines gauge\n";
+	out += boost::str(boost::format("mud_idle_deadlines %1%\n") % glob.reaper.getWatched());
+
+	out += "# HELP mud_input_limited_total Actions taken by per-connection input limits, by kind.\n";
+	out += "# TYPE mud_input_limited_total counter\n";
+
+	for(int i = 0; i < StatEngine::NumberOfInputLimits; ++i) {
+		StatEngine::InputLimitType limit = static_cast<StatEngine::InputLimitType>(i);
+		out += boost::str(boost::format("mud_input_limited_total{action=\"%1%\"} %2%\n") % glob.statEngine.getInputLimitName(limit) % glob.statEngine.getInputLimit(limit));
+	}
+
+	out += "# HELP mud_resolver_lookups_total Reverse DNS lookups, by result.\n";
+	out += "# TYPE mud_resolver_lookups_total counter\n";
+	out += boost::str(boost::format("mud_resolver_lookups_total{result=\"resolved\"} %1%\n") % glob.resolver.getResolved());
+	out += boost::str(boost::format("mud_resolver_lookups_total{result=\"failed\"} %1%\n") % glob.resolver.getFailed());
+	out += boost::str(boost::format("mud_resolver_lookups_total{result=\"dropped\"} %1%\n") % glob.resolver.getDropped());
+
+	out += "# HELP mud_resolver_timeouts_total Reverse DNS lookups that ran past ResolverTimeout.\n";
+	out += "# TYPE mud_resolver_timeouts_total counter\n";
+	out += boost::str(boost::format("mud_resolver_timeouts_total %1%\n") % glob.resolver.getTimedOut());
+
+	out += "# HELP mud_resolver_cache_hits_total Reverse DNS requests answered from the cache.\n";
+	out += "# TYPE mud_resolver_cache_hits_total counter\n";
+	out += boost::str(boost::format("mud_resolver_cache_hits_total %1%\n") % glob.resolver.getCacheHits());
+
+	out += "# HELP mud_resolver_queue_length Reverse DNS lookups waiting for a worker.\n";
+	out += "# TYPE mud_resolver_queue_length gauge\n";
+	out += boost::str(boost::format("mud_resolver_queue_length %1%\n") % glob.resolver.getQueueLength());
+
+	out += "# HELP mud_resolver_cache_entries Addresses in the reverse DNS cache.\n";
+	out += "# TYPE mud_resolver_cache_entries gauge\n";
+	out += boost::str(boost::format("mud_resolver_cache_entries %1%\n") % glob.resolver.getCacheSize());
+
+	out += "# HELP mud_players Connections in the playing state.\n";
+	out += "# TYPE mud_players gauge\n";
+	out += boost::str(boost::format("mud_players %1%\n") % glob.statEngine.getGauge(StatEngine::PlayersGauge));
+
+	out += "# HELP mud_connections Connections by connection state.\n";
+	out += "# TYPE mud_connections gauge\n";
+	out += boost::str(boost::format("mud_connections{state=\"closed\"} %1%\n") % glob.statEngine.getGauge(StatEngine::ConnectionsClosedGauge));
+	out += boost::str(boost::format("mud_connections{state=\"login\"} %1%\n") % glob.statEngine.getGauge(StatEngine::ConnectionsLoginGauge));
+	out += boost::str(boost::format("mud_connections{state=\"password\"} %1%\n") % glob.statEngine.getGauge(StatEngine::ConnectionsPasswordGauge));
+	out += boost::str(boost::format("mud_connections{state=\"create\"} %1%\n") % glob.statEngine.getGauge(StatEngine::ConnectionsCreateGauge));
+	out += boost::str(boost::format("mud_connections{state=\"playing\"} %1%\n") % glob.statEngine.getGauge(StatEngine::ConnectionsPlayingGauge));
+
+	out += "# HELP mud_event_queue_depth Events waiting in the EventDaemon.\n";
+	out += "# TYPE mud_event_queue_depth gauge\n";
+	out += boost::str(boost::format("mud_event_queue_depth %1%\n") % glob.statEngine.getGauge(StatEngine::EventQueueGauge));
+
+	out += "# HELP mud_dirty_rooms Rooms changed since their last save.\n";
+	out += "# TYPE mud_dirty_rooms gauge\n";
+	out += boost::str(boost::format("mud_dirty_rooms %1%\n") % glob.statEngine.getGauge(StatEngine::DirtyRoomsGauge));
+
+	out += "# HELP mud_world_load_microseconds How long loading every zone took at startup.\n";
+	out += "# TYPE mud_world_load_microseconds gauge\n";
+	out += boost::str(boost::format("mud_world_load_microseconds %1%\n") % glob.zoneDaemon.getLoadTime());
+
+	out += "# HELP mud_rooms Rooms loaded in all zones.\n";
+	out += "# TYPE mud_rooms gauge\n";
+	out += boost::str(boost::format("mud_rooms %1%\n") % glob.statEngine.getGauge(StatEngine::RoomsGauge));
+
+	out += "# HELP mud_tick_overruns_total Ticks that took longer than TIME_RESOLUTION.\n";
+	out += "# TYPE mud_tick_overruns_total counter\n";
+	out += boost::str(boost::format("mud_tick_overruns_total %1%\n") % glob.statEngine.getTickOverruns());
+
+	for(int i = 0; i < StatEngine::NumberOfTimers; ++i) {
+		StatEngine::TimerType timer = static_cast<StatEngine::TimerType>(i);
+		std::string name = "mud_" + glob.statEngine.getTimerName(timer) + "_duration_microseconds";
+		std::string description = glob.statEngine.getTimerDescription(timer);
+
+		out += "# HELP " + name + " " + description + ".\n";
+		out += "# TYPE " + name + " summary\n";
+		appendHistogram(out, name, "", glob.statEngine.getHistogram(timer));
+		out += "# HELP " + name + "_max " + description + ", longest run.\n";
+		out += "# TYPE " + name + "_max gauge\n";
+		appendHistogramMax(out, name, "", glob.statEngine.getHistogram(timer));
+		out += "# HELP " + name + "_recent " + description + ", moving average.\n";
+		out += "# TYPE " + name + "_recent gauge\n";
+		out += boost::str(boost::format("%1%_recent %2%\n") % name % glob.statEngine.getRecentTime(timer));
+	}
+
+	StatEngine::HistogramMap commands = glob.statEngine.getCommandHistograms();
+
+	// the CommandTimer above is already mud_command_duration_microseconds
+	out += "# HELP mud_command_call_duration_microseconds Time spent in each player command.\n";
+	out += "# TYPE mud_command_call_duration_microseconds summary\n";
+
+	for(StatEngine::HistogramMap::const_iterator it = commands.begin(); it != commands.end(); ++it) {
+		appendHistogram(out, "mud_command_call_duration_microseconds", "command=\"" + escapeLabel(it->first) + "\"", *it->second);
+	}
+
+	out += "# HELP mud_command_call_duration_microseconds_max Longest run of each player command.\n";
+	out += "# TYPE mud_command_call_duration_microseconds_max gauge\n";
+
+	for(StatEngine::HistogramMap::const_iterator it = commands.begin(); it != commands.end(); ++it) {
+		appendHistogramMax(out, "mud_command_call_duration_microseconds", "command=\"" + escapeLabel(it->first) + "\"", *it->second);
+	}
+
+	out += "# HELP mud_memory_live_bytes Heap memory in use, by subsystem.\n";
+	out += "# TYPE mud_memory_live_bytes gauge\n";
+
+	for(int i = 0; i < MemoryAccount::NumberOfMemoryTags; ++i) {
+		MemoryAccount::MemoryTag tag = static_cast<MemoryAccount::MemoryTag>(i);
+		out += boost::str(boost::format("mud_memory_live_bytes{subsystem=\"%1%\"} %2%\n") % MemoryAccount::getTagName(tag) % MemoryAccount::getLiveBytes(tag));
+	}
+
+	out += "# HELP mud_memory_peak_bytes The most heap memory ever in use, by subsystem.\n";
+	out += "# TYPE mud_memory_peak_bytes gauge\n";
+
+	for(int i = 0; i < MemoryAccount::NumberOfMemoryTags; ++i) {
+		MemoryAccount::MemoryTag tag = static_cast<MemoryAccount::MemoryTag>(i);
+		out += boost::str(boost::format("mud_memory_peak_bytes{subsystem=\"%1%\"} %2%\n") % MemoryAccount::getTagName(tag) % MemoryAccount::getPeakBytes(tag));
+	}
+
+	out += "# HELP mud_memory_objects Live objects, by subsystem.\n";
+	out += "# TYPE mud_memory_objects gauge\n";
+
+	for(int i = 0; i < MemoryAccount::NumberOfMemoryTags; ++i) {
+		MemoryAccount::MemoryTag tag = static_cast<MemoryAccount::MemoryTag>(i);
+		out += boost::str(boost::format("mud_memory_objects{subsystem=\"%1%\"} %2%\n") % MemoryAccount::getTagName(tag) % MemoryAccount::getObjects(tag));
+	}
+
+	std::vector<LockStatistics> locks = Mutex::getStatistics();
+
+	out += "# HELP mud_lock_acquisitions_total Times each kind of mutex was locked.\n";
+	out += "# TYPE mud_lock_acquisitions_total counter\n";
+
+	for(std::vector<LockStatistics>::const_iterator it = locks.begin(); it != locks.end(); ++it) {
+		out += boost::str(boost::format("mud_lock_acquisitions_total{lock=\"%1%\"} %2%\n") % escapeLabel(it->name) % it->acquisitions);
+	}
+
+	out += "# HELP mud_lock_contended_total Locks that had to wait for another thread.\n";
+	out += "# TYPE mud_lock_contended_total counter\n";
+
+	for(std::vector<LockStatistics>::const_iterator it = locks.begin(); it != locks.end(); ++it) {
+		out += boost::str(boost::format("mud_lock_contended_total{lock=\"%1%\"} %2%\n") % escapeLabel(it->name) % it->contended);
+	}
+
+	out += "# HELP mud_lock_wait_microseconds_total Time spent waiting for each kind of mutex.\n";
+	out += "# TYPE mud_lock_wait_microseconds_total counter\n";
+
+	for(std::vector<LockStatistics>::const_iterator it = locks.begin(); it != locks.end(); ++it) {
+		out += boost::str(boost::format("mud_lock_wait_microseconds_total{lock=\"%1%\"} %2%\n") % escapeLabel(it->name) % it->waitTotal);
+	}
+
+	out += "# HELP mud_lock_wait_max_microseconds Longest wait for each kind of mutex.\n";
+	out += "# TYPE mud_lock_wait_max_microseconds gauge\n";
+
+	for(std::vector<LockStatistics>::const_iterator it = locks.begin(); it != locks.end(); ++it) {
+		out += boost::str(boost::format("mud_lock_wait_max_microseconds{lock=\"%1%\"} %2%\n") % escapeLabel(it->name) % it->waitMax);
+	}
+
+	out += "# HELP mud_lock_hold_microseconds_total Time each kind of mutex was held.\n";
+	out += "# TYPE mud_lock_hold_microseconds_total counter\n";
+
+	for(std::vector<LockStatistics>::const_iterator it = locks.begin(); it != locks.end(); ++it) {
+		out += boost::str(boost::format("mud_lock_hold_microseconds_total{lock=\"%1%\"} %2%\n") % escapeLabel(it->name) % it->holdTotal);
+	}
+
+	out += "# HELP mud_lock_hold_max_microseconds Longest hold of each kind of mutex.\n";
+	out += "# TYPE mud_lock_hold_max_microseconds gauge\n";
+
+	for(std::vector<LockStatistics>::const_iterator it = locks.begin(); it != locks.end(); ++it) {
+		out += boost::str(boost::format("mud_lock_hold_max_microseconds{lock=\"%1%\"} %2%\n") % escapeLabel(it->name) % it->holdMax);
+	}
+
+	StatEngine::HistogramMap zones = glob.statEngine.getZoneHistograms();
+
+	out += "# HELP mud_zone_heartbeat_duration_microseconds Time spent in each zone's heartbeat.\n";
+	out += "# TYPE mud_zone_heartbeat_duration_microseconds summary\n";
+
+	for(StatEngine::HistogramMap::const_iterator it = zones.begin(); it != zones.end(); ++it) {
+		appendHistogram(out, "mud_zone_heartbeat_duration_microseconds", "zone=\"" + escapeLabel(it->first) + "\"", *it->second);
+	}
+
+	out += "# HELP mud_zone_heartbeat_duration_microseconds_max Longest heartbeat of each zone.\n";
+	out += "# TYPE mud_zone_heartbeat_duration_microseconds_max gauge\n";
+
+	for(StatEngine::HistogramMap::const_iterator it = zones.begin(); it != zones.end(); ++it) {
+		appendHistogramMax(out, "mud_zone_heartbeat_duration_microseconds", "zone=\"" + escapeLabel(it->first) + "\"", *it->second);
+	}
+
+	return out;
+}
+
+/// formats a histogram as a Prometheus summary
+/** @param[out] out the string to append to
+	@param name the metric name
+	@param labels any extra labels, already formatted (eg. <tt>command="look"</tt>), or empty
+	@param h the histogram to export
+*/
+void MetricsServer::appendHistogram(std::string &out, const std::string &name, const std::string &labels, const Histogram &h) {
+	std::string sep = labels.empty() ? "" : ",";
+	std::string plain = labels.empty() ? "" : "{" + labels + "}";
+
+	out += boost::str(boost::format("%1%{%2%%3%quantile=\"0.5\"} %4%\n") % name % labels % sep % h.getPercentile(50.0));
+	out += boost::str(boost::format("%1%{%2%%3%quantile=\"0.95\"} %4%\n") % name % labels % sep % h.getPercentile(95.0));
+	out += boost::str(boost::format("%1%{%2%%3%quantile=\"0.99\"} %4%\n") % name % labels % sep % h.getPercentile(99.0));
+	out += boost::str(boost::format("%1%_sum%2% %3%\n") % name % plain % h.getTotal());
+	out += boost::str(boost::format("%1%_count%2% %3%\n") % name % plain % h.getCount());
+}
+
+/// formats a histogram's largest sample as a \c _max gauge
+/** A summary has no place for a maximum, so it is its own family; the caller writes
+	its TYPE line.
+	@param[out] out the string to append to
+	@param name the summary's metric name, which \c _max is added to
+	@param labels any extra labels, already formatted, or empty
+	@param h the histogram to export
+*/
+void MetricsServer::appendHistogramMax(std::string &out, const std::string &name, const std::string &labels, const Histogram &h) {
+	std::string plain = labels.empty() ? "" : "{" + labels + "}";
+
+	out += boost::str(boost::format("%1%_max%2% %3%\n") % name % plain % h.getMax());
+}
+
+/// escapes a Prometheus label value
+/** @param value the raw label value
+	\return the value with backslashes, quotes and newlines escaped
+*/
+std::string MetricsServer::escapeLabel(const std::string &value) {
+	std::string escaped;
+
+	for(std::string::size_type i = 0; i < value.length(); ++i) {
+		switch(value[i]) {
+			case '\\':
+				escaped += "\\\\";
+				break;
+			case '"':
+				escaped += "\\\"";
+				break;
+			case '\n':
+				escaped += "\\n";
+				break;
+			default:
+				escaped += value[i];
+		}
+	}
+
+	return escaped;
+}
+
+/// entry point for the metrics thread
+/** @param arg a pointer to the MetricsServer to run
+	\return nothing
+*/
+void *thread_metrics_func(void *arg) {
+	MetricsServer *server = static_cast<MetricsServer *>(arg);
+	server->run();
+	pthread_exit(0);
+}
@@ -0,0 +1,44 @@
+#ifndef MUD_METRICS_SERVER_H
+#define MUD_METRICS_SERVER_H
+
+#include <string>
+#include <pthread.h>
+
+#include "mudconfig.h"
+#include "histogram.h"
+
+void *thread_metrics_func(void *arg);
+
+/// Serves engine statistics over HTTP for monitoring systems
+/** This class runs a tiny HTTP/1.0 server on its own thread, bound to a local address,
+	that answers \c GET \c /metrics with the StatEngine's numbers in the Prometheus text
+	exposition format. It only ever reads the StatEngine (atomic counters, lock-free
+	histograms and gauges the process thread publishes each heartbeat), so a slow or
+	stuck scraper can never hold up the game loop.
+	\note Enable it by setting the \c MetricsPort config integer; \c MetricsAddress
+		(default 127.0.0.1) picks the interface. Try it with
+		<tt>curl http://127.0.0.1:9100/metrics</tt>
+*/
+class MetricsServer {
+public:
+	MetricsServer();
+	~MetricsServer();
+
+	bool start();
+
+	void run();
+
+	std::string render() const;
+
+private:
+	int mListenFd;	///< the listening socket, or -1 when not running
+	pthread_t mThread;	///< the thread that serves requests
+
+	void serveClient(const int fd);
+
+	static void appendHistogram(std::string &out, const std::string &name, const std::string &labels, const Histogram &h);
+	static void appendHistogramMax(std::string &out, const std::string &name, const std::string &labels, const Histogram &h);
+	static std::string escapeLabel(const std::string &value);
+};
+
+#endif // MUD_METRICS_SERVER_H
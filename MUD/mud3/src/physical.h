@@ -5,6 +5,7 @@
 #include <yaml-cpp/yaml.h>
 
 #include "mudconfig.h"
+#include "memoryAccount.h"
 #include "message.h"
 #include "utility.h"
 
@@ -13,6 +14,8 @@
 	objects, anyway) and their behavior.
 */
 class Physical {
+	MEMORY_ACCOUNTED(MemoryAccount::ObjectsTag)
+
 public:
 	typedef boost::shared_ptr<Physical> PhysicalPointer;
 
@@ -147,6 +147,14 @@ void Player::processMessage(Message::MessagePointer message) {
 
 		s << "] " << message->getBody();
 		Write(s.str());
+
+		if(gmcpSupports("Comm.Channel.Text")) {
+			GmcpObject text;
+			text.add("channel", message->getHeader());
+			text.add("talker", Utility::toProper(message->getFrom()));
+			text.add("text", parseColor(s.str().substr(std::string(END).length())));
+			gmcpSend("Comm.Channel.Text", text);
+		}
 		break;
 
 	case Message::Tell:
@@ -213,6 +221,23 @@ bool Player::Save() {
 	glob.log.debug("Entered Player::Save()");
 	YAML::Emitter out;
 
+	Save(out);
+
+	IOResourceLocator resloc;
+	resloc.type = getObjectType();
+	resloc.name = getName();
+
+	glob.log.debug("Finished with Player::Save()");
+	return glob.ioDaemon.saveResource(resloc, out.c_str());
+}
+
+/// writes the player document to an emitter
+/** This function emits every section of the player without touching storage.
+	Player::Save() wraps it to write the result to disk.
+	@param out a YAML::Emitter to write the player to
+	\return true if the emitter is still good afterwards
+*/
+bool Player::Save(YAML::Emitter &out) const {
 	out << YAML::BeginMap;
 	physicalSave(out);
 	glob.log.debug("Saved Physical data");
@@ -228,28 +253,58 @@ bool Player::Save() {
 	glob.log.debug("saved container data");
 	out << YAML::EndMap;
 
-	IOResourceLocator resloc;
-	resloc.type = getObjectType();
-	resloc.name = getName();
-
-	glob.log.debug("Finished with Player::Save()");
-	return glob.ioDaemon.saveResource(resloc, out.c_str());
+	return out.good();
 }
 
-/// overridden Save function does nothing
-/** This function only exists to satisfy virtual restrictions from the \b Physical class.
-	If called, it will log an error. Call the Player::Save() function instead.
-	@param out a YAML::Emitter
-	\return false all the time.
+/// loads the player from an already parsed document
+/** This function restores every section of the player from a parsed save
+	document. Player::Load() wraps it with the file access and exception handling.
+	@param node a YAML::Node holding the whole player document
+	\return true if every section loaded
 */
-bool Player::Save(YAML::Emitter &out) const {
-	glob.log.error("Player::Save(YAML::Emitter &): A function called me instead of Player::Save()");
-	return false;
-}
-
 bool Player::Load(const YAML::Node &node) {
-	glob.log.error("Player::Load(const YAML::Node &): Called instead of the normal Load() function!");
-	return false;
+	bool success = physicalLoad(node["Physical"]);
+
+	if(success) {
+		success = playerLoad(node["Player"]);
+		glob.log.debug("loaded player node");
+	} else {
+		glob.log.debug("failed to load physical node");
+	}
+
+	if(success) {
+		success = livingLoad(node["Living"]);
+		glob.log.debug("loaded living node");
+	} else {
+		glob.log.debug("failed to load player node");
+	}
+
+	if(success) {
+		success = connectionLoad(node["Connection"]);
+		glob.log.debug("loaded connection node");
+	} else {
+		glob.log.debug("failed to load living node");
+	}
+
+	if(success) {
+		success = sentientLoad(node["Sentient"]);
+		glob.log.debug("loaded sentient node");
+	} else {
+		glob.log.debug("failed to load connection node");
+	}
+
+	if(success) {
+		success = containerLoad(node["Container"]);
+		glob.log.debug("loaded container node");
+	} else {
+		glob.log.debug("failed to load sentient node");
+	}
+
+	if(!success) {
+		glob.log.debug("failed to load container node");
+	}
+
+	return success;
 }
 
 /// loads the player data
@@ -278,46 +333,7 @@ bool Player::Load() {
 
 		parser.GetNextDocument(doc);
 
-		success = physicalLoad(doc["Physical"]);
-
-		if(success) {
-			success = playerLoad(doc["Player"]);
-			glob.log.debug("loaded player node");
-		} else {
-			glob.log.debug("failed to load physical node");
-		}
-
-		if(success) {
-			success = livingLoad(doc["Living"]);
-			glob.log.debug("loaded living node");
-		} else {
-			glob.log.debug("failed to load player node");
-		}
-
-		if(success) {
-			success = connectionLoad(doc["Connection"]);
-			glob.log.debug("loaded connection node");
-		} else {
-			glob.log.debug("failed to load living node");
-		}
-
-		if(success) {
-			success = sentientLoad(doc["Sentient"]);
-			glob.log.debug("loaded sentient node");
-		} else {
-			glob.log.debug("failed to load connection node");
-		}
-
-		if(success) {
-			success = containerLoad(doc["Container"]);
-			glob.log.debug("loaded container node");
-		} else {
-			glob.log.debug("failed to load sentient node");
-		}
-
-		if(!success) {
-			glob.log.debug("failed to load container node");
-		}
+		success = Load(doc);
 
 	} catch(YAML::ParserException &e) {
 		std::cout << "YAML Parser exception: " << e.what() << '\n';
@@ -502,6 +518,13 @@ void Player::Prompt() {
 	std::stringstream s;
 	std::string::size_type pos;
 
+	updateGmcp();
+
+	// an empty prompt means the client shows vitals from GMCP instead
+	if(mPrompt.empty() && gmcpSupports("Char.Vitals")) {
+		return;
+	}
+
 	// we always want the prompt to start on a new line
 	s << END;
 
@@ -515,6 +538,46 @@ void Player::Prompt() {
 	Write(s.str());
 }
 
+/// sends GMCP clients whatever changed since the last prompt
+/** Every prompt follows a command or something happening to the player, so it is where
+	Char.Vitals and Room.Info are brought up to date. The session only sends the vitals
+	that changed, and the room only when it differs from the last one sent, so a prompt
+	where nothing changed costs nothing on the wire.
+*/
+void Player::updateGmcp() {
+	if(!isGmcpEnabled()) {
+		return;
+	}
+
+	if(gmcpSupports("Char.Vitals")) {
+		GmcpObject vitals;
+		vitals.add("hp", static_cast<long>(getLife()));
+		vitals.add("maxhp", static_cast<long>(getMaxLife()));
+		vitals.add("state", livingGetStateString());
+		vitals.add("posture", livingGetPostureString());
+		vitals.add("temperature", static_cast<long>(getTemperature()));
+		gmcpSend("Char.Vitals", vitals, GmcpSession::SendChangedFields);
+	}
+
+	ObjectLocation location = getLocation();
+
+	if(location.type != RoomObject || !gmcpSupports("Room.Info")) {
+		return;
+	}
+
+	Zone::ZonePointer zone = glob.zoneDaemon.getZone(location.zone);
+
+	if(!zone) {
+		return;
+	}
+
+	Room::RoomPointer room = zone->getRoom(location.location);
+
+	if(room) {
+		gmcpSend("Room.Info", room->getGmcpInfo(), GmcpSession::SendWhenChanged);
+	}
+}
+
 /// expands a prompt token to the proper text
 /** This function takes a prompt token and replaces it in the outgoing text stream with
 	the text that should be in its place
@@ -4,6 +4,7 @@
 #include <boost/shared_ptr.hpp>
 
 #include "mudconfig.h"
+#include "memoryAccount.h"
 #include "connection.h"
 #include "sentient.h"
 #include "container.h"
@@ -13,6 +14,8 @@
 /** This class has all the information you need for a player
 */
 class Player : public Connection, public Sentient, public Container {
+	MEMORY_ACCOUNTED(MemoryAccount::PlayersTag)
+
 public:
 	typedef boost::shared_ptr<Player> PlayerPointer;
 
@@ -85,6 +88,8 @@ private:
 
 	std::string::size_type convertPromptToken(const char *txt, std::stringstream &out);
 
+	void updateGmcp();
+
 	std::string getBrief() const;
 	std::string getVerbose() const;
 
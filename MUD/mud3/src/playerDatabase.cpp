@@ -3,6 +3,7 @@
 
 #include "playerDatabase.h"
 #include "utility.h"
+#include "timer.h"
 
 #include "global.h"
 extern Global glob;
@@ -98,6 +99,17 @@ bool PlayerDatabase::remove(Player::PlayerPointer player) {
 
 	mPlayerList.erase(std::remove(mPlayerList.begin(), mPlayerList.end(), player), mPlayerList.end());
 
+	if(playerFd == mHighestFd) {
+		// let the driver's polling loop shrink back once the highest descriptor goes
+		mHighestFd = 0;
+
+		for(PlayerList::const_iterator it = mPlayerList.begin(); it != mPlayerList.end(); ++it) {
+			if((*it)->getFd() > mHighestFd) {
+				mHighestFd = (*it)->getFd();
+			}
+		}
+	}
+
 	glob.driver.shutdown_connection(playerFd);
 
 	return success;
@@ -216,6 +228,36 @@ StringVector PlayerDatabase::getPlayerList(bool includeHost) const {
 	return list;
 }
 
+/// counts connections in a given state
+/** This function counts how many connections are currently in the specified state
+	@param state the connection state to look for
+	\return the number of connections in that state
+*/
+unsigned int PlayerDatabase::getNumberOfConnections(Connection::ConnStateEnum state) const {
+	unsigned int count = 0;
+
+	for(PlayerList::const_iterator it = mPlayerList.begin(); it != mPlayerList.end(); ++it) {
+		if((*it)->getConnectionState() == state) {
+			++count;
+		}
+	}
+
+	return count;
+}
+
+/// adds up the memory held by every connection's socket buffers
+/** \return the total capacity of all input and output buffers, in bytes
+*/
+unsigned long PlayerDatabase::getBufferedBytes() const {
+	unsigned long bytes = 0;
+
+	for(PlayerList::const_iterator it = mPlayerList.begin(); it != mPlayerList.end(); ++it) {
+		bytes += (*it)->getBufferedBytes();
+	}
+
+	return bytes;
+}
+
 /// calls all player heartbeat() functions
 /** This function makes sure it calls all heartbeat() functions for connected players.
 */
@@ -234,8 +276,46 @@ void PlayerDatabase::processCommands() {
 	for(PlayerList::iterator it = mPlayerList.begin(); it != mPlayerList.end(); ++it) {
 		std::string command = (*it)->getNextCommand();
 		if(!command.empty()) {
+			glob.watchdog.setActivity(Watchdog::ProcessThread, "command", command.c_str(), (*it)->getFd());
+
+			Timer commandTimer;
 			(*it)->process(command);
+			glob.statEngine.recordTime(StatEngine::CommandTimer, commandTimer.elapsed());
+
+			// so a stall after the command isn't blamed on it
+			glob.watchdog.setActivity(Watchdog::ProcessThread, "processing commands");
 		}
 	}
 }
 
+/// writes out whatever each player has waiting to be sent
+/** Compressed connections don't flush on every Write(), so that a tick's worth of
+	output goes through the compressor in one piece. This function is called at the end
+	of every tick to send it, along with any output a slow client's socket wouldn't take
+	last time. A connection that can't be written to, now or in an earlier Write(), or
+	whose client has fallen too far behind, is closed once the list has been walked.
+*/
+void PlayerDatabase::flushOutput() {
+	PlayerList failed;
+
+	for(PlayerList::iterator it = mPlayerList.begin(); it != mPlayerList.end(); ++it) {
+		if(!(*it)->Flush()) {
+			failed.push_back(*it);
+		}
+	}
+
+	for(PlayerList::iterator it = failed.begin(); it != failed.end(); ++it) {
+		glob.log.warn(boost::format("PlayerDatabase::flushOutput(): Can't write to %1% on descriptor %2%, closing the connection") % (*it)->getName() % (*it)->getFd());
+
+		if((*it)->getConnectionState() == Connection::ConnState_Play) {
+			Message::MessagePointer message = Message::MessagePointer(new Message);
+			message->setType(Message::Quit);
+			message->setFrom((*it)->getName());
+			message->setBody(boost::format("%1% has disconnected with extreme prejudice (connection lost)") % Utility::toProper((*it)->getName()));
+			broadcast(message);
+		}
+
+		remove(*it);
+	}
+}
+
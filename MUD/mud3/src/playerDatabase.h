@@ -25,9 +25,8 @@ public:
 
 	void closeAllConnections();
 
-	/// gets the highest file descriptor that has been connected
-	/** This function returns the highest file descriptor that has been connected
-		to the system.
+	/// gets the highest file descriptor that is connected
+	/** This function returns the highest file descriptor of any connected player.
 		\warning I've tracked down several bugs that I accidentally wrote because of this,
 		make sure when you call for highestFd that you ADD ONE to it before you
 		loop through all fd's when polling sockets, etc. You can also check for
@@ -47,14 +46,19 @@ public:
 
 	StringVector getPlayerList(bool includeHost = false) const;
 
+	unsigned int getNumberOfConnections(Connection::ConnStateEnum state) const;
+	unsigned long getBufferedBytes() const;
+
 	void callHeartbeats();
 	
 	void processCommands();
 
+	void flushOutput();
+
 private:
 	PlayerList mPlayerList;	///< a list of currently connected players
 	
-	int mHighestFd;	///< the highest file descriptor that has been seen so far
+	int mHighestFd;	///< the highest file descriptor of a connected player
 };
 
 #endif // MUD_PLAYER_DATABASE_H
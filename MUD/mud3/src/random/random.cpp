@@ -4,7 +4,8 @@
 /// initializes variate generators
 /** This constructor initializes each of the variate generators for the
 	random number functions.
-	\note Like most RNGs, this one seeds with the current time
+	\note Like most RNGs, this one seeds with the current time. main() reseeds it
+		with seed() once the config is loaded.
 */
 Random::Random() :	mTwo(0,1), mDie2(mRNG, mTwo),
 					mFour(1,4), mDie4(mRNG, mFour),
@@ -43,6 +43,9 @@ public:
 
 	int customInt(int low, int high);
 
+	/// restarts the sequence from a known seed, so a run can be repeated
+	void seed(const unsigned int value) { mRNG.seed(value); }
+
 private:
 	boost::mt19937 mRNG;
 
@@ -0,0 +1,455 @@
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <netdb.h>		// for getnameinfo
+#include <resolv.h>		// for _res
+#include <arpa/inet.h>	// for inet_pton
+#include <sys/socket.h>
+
+#include "resolver.h"
+
+#include "global.h"
+extern Global glob;
+
+/// reads a resolver setting from the config
+/** @param key the config integer
+	@param fallback the value from mudconfig.h, used when the key isn't set
+	\return the setting
+*/
+static unsigned int resolverSetting(const std::string &key, const unsigned int fallback) {
+	int value = glob.Config.getIntValue(key);
+	return value < 0 ? fallback : static_cast<unsigned int>(value);
+}
+
+/// asks the system resolver for an address's name
+/** The lookup goes through the name service switch, so /etc/hosts is tried before DNS.
+	Each worker thread has its own resolver state, which is set to wait \a timeout seconds
+	for each name server and not to retry, so one lookup can't hold a worker much longer
+	than the Resolver's timeout.
+*/
+bool SystemResolverBackend::reverse(const std::string &ip, const unsigned int timeout, std::string &hostname) {
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+
+	if(inet_pton(AF_INET, ip.c_str(), &address.sin_addr) != 1) {
+		return false;
+	}
+
+	if(res_init() == 0) {
+		_res.retrans = timeout > 0 ? timeout : 1;
+		_res.retry = 1;
+	}
+
+	char host[NI_MAXHOST];
+
+	if(getnameinfo(reinterpret_cast<struct sockaddr *>(&address), sizeof(address), host, sizeof(host), NULL, 0, NI_NAMEREQD) != 0) {
+		return false;
+	}
+
+	hostname = host;
+	return true;
+}
+
+/// Constructor
+/** Nothing is read until load() is called
+	@param path the hosts file
+*/
+HostsFileResolverBackend::HostsFileResolverBackend(const std::string &path) : mPath(path) {
+}
+
+/// reads the hosts file
+/** Each line is an address followed by one or more names; the first name is the one
+	reverse() gives. Blank lines and text after a '#' are ignored, and an address that
+	appears twice keeps its first name, as it would in /etc/hosts.
+	\return false if the file can't be read
+*/
+bool HostsFileResolverBackend::load() {
+	std::ifstream in(mPath.c_str());
+
+	if(!in) {
+		return false;
+	}
+
+	mNames.clear();
+
+	std::string line;
+
+	while(std::getline(in, line)) {
+		std::string::size_type comment = line.find('#');
+
+		if(comment != std::string::npos) {
+			line.erase(comment);
+		}
+
+		std::istringstream fields(line);
+		std::string ip;
+		std::string name;
+
+		if(fields >> ip >> name && mNames.find(ip) == mNames.end()) {
+			mNames[ip] = name;
+		}
+	}
+
+	return true;
+}
+
+/// looks an address up in the hosts file
+bool HostsFileResolverBackend::reverse(const std::string &ip, const unsigned int, std::string &hostname) {
+	StringMap::const_iterator it = mNames.find(ip);
+
+	if(it == mNames.end()) {
+		return false;
+	}
+
+	hostname = it->second;
+	return true;
+}
+
+/// Constructor
+/** Does nothing; no lookups happen until start() is called
+*/
+Resolver::Resolver() : mBusy("Resolver") {
+	mBackend = NULL;
+	mRunning = false;
+	mCacheHits = 0;
+	mResolved = 0;
+	mFailed = 0;
+	mTimedOut = 0;
+	mDropped = 0;
+
+	memset(&mSettings, 0, sizeof(mSettings));
+}
+
+/// Destructor
+/** The backend is only freed if the workers never started; running workers are
+	detached and may still be inside it while the process exits.
+*/
+Resolver::~Resolver() {
+	if(!mRunning) {
+		delete mBackend;
+	}
+}
+
+/// starts the worker threads with the settings from the config
+/** The ResolverThreads, ResolverQueueLength, ResolverCacheSize, ResolverCacheTTL,
+	ResolverNegativeTTL and ResolverTimeout config integers override the RESOLVER_*
+	defaults in mudconfig.h. If the ResolverHostsFile config string names a file,
+	addresses are looked up in it instead of through DNS.
+	\return true if the workers are running
+*/
+bool Resolver::start() {
+	ResolverSettings settings;
+	settings.threads = resolverSetting("ResolverThreads", RESOLVER_THREADS);
+	settings.queueLength = resolverSetting("ResolverQueueLength", RESOLVER_QUEUE_LENGTH);
+	settings.cacheSize = resolverSetting("ResolverCacheSize", RESOLVER_CACHE_SIZE);
+	settings.positiveTtl = resolverSetting("ResolverCacheTTL", RESOLVER_CACHE_TTL);
+	settings.negativeTtl = resolverSetting("ResolverNegativeTTL", RESOLVER_NEGATIVE_TTL);
+	settings.timeout = resolverSetting("ResolverTimeout", RESOLVER_TIMEOUT);
+
+	std::string hostsFile = glob.Config.getStringValue("ResolverHostsFile");
+
+	if(hostsFile.empty()) {
+		return start(new SystemResolverBackend, settings);
+	}
+
+	HostsFileResolverBackend *backend = new HostsFileResolverBackend(hostsFile);
+
+	if(!backend->load()) {
+		glob.log.error(boost::format("Resolver::start(): Cannot read hosts file %1%") % hostsFile);
+		delete backend;
+		return false;
+	}
+
+	glob.log.info(boost::format("Resolver is answering from %1% (%2% addresses) instead of DNS") % hostsFile % backend->size());
+	return start(backend, settings);
+}
+
+/// starts the worker threads
+/** @param backend answers the lookups; the Resolver takes ownership
+	@param settings the pool, queue and cache sizes and lifetimes
+	\return true if at least one worker is running
+*/
+bool Resolver::start(ResolverBackend *backend, const ResolverSettings &settings) {
+	if(mRunning) {
+		delete backend;
+		return false;
+	}
+
+	delete mBackend;
+	mBackend = backend;
+	mSettings = settings;
+
+	if(mSettings.threads == 0) {
+		glob.log.info("Resolver::start(): ResolverThreads is 0, hostnames will not be looked up");
+		return false;
+	}
+
+	if(sem_init(&mWork, 0, 0) != 0) {
+		glob.log.error("Resolver::start(): Cannot create the work semaphore");
+		return false;
+	}
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	unsigned int started = 0;
+
+	for(unsigned int i = 0; i < mSettings.threads; ++i) {
+		pthread_t thread;
+
+		if(pthread_create(&thread, &attr, thread_resolver_func, this) == 0) {
+			++started;
+		}
+	}
+
+	pthread_attr_destroy(&attr);
+
+	if(started == 0) {
+		glob.log.error("Resolver::start(): Cannot create any resolver threads");
+		return false;
+	}
+
+	mRunning = true;
+
+	glob.log.info(boost::format("Resolver started with %1% threads, a %2% lookup queue and a %3% second timeout") % started % mSettings.queueLength % mSettings.timeout);
+	return true;
+}
+
+/// a worker thread's main loop
+/** Each worker sleeps until a lookup is queued, drops it if it waited past its
+	deadline, and otherwise asks the backend with whatever time is left. Answers are
+	cached whether or not they arrived in time, since a late name is still a good name.
+*/
+void Resolver::run() {
+	glob.trace.nameThread("resolver");
+
+	while(!glob.shutdownMUD) {
+		if(sem_wait(&mWork) != 0) {
+			if(errno != EINTR) {
+				glob.log.error("Resolver::run(): sem_wait failed, worker exiting");
+				break;
+			}
+
+			continue;
+		}
+
+		Job job;
+
+		if(!mBusy.lock()) {
+			continue;
+		}
+
+		if(mQueue.empty()) {
+			mBusy.unlock();
+			continue;
+		}
+
+		job = mQueue.front();
+		mQueue.pop_front();
+		mBusy.unlock();
+
+		time_t now = time(NULL);
+
+		if(now >= job.deadline) {
+			// it sat in the queue too long; whoever wanted it has given up
+			__sync_fetch_and_add(&mTimedOut, 1);
+			store(job.ip, Unresolvable, "", now + mSettings.negativeTtl);
+			continue;
+		}
+
+		std::string hostname;
+		bool found = mBackend->reverse(job.ip, job.deadline - now, hostname);
+
+		now = time(NULL);
+
+		if(now > job.deadline) {
+			__sync_fetch_and_add(&mTimedOut, 1);
+		}
+
+		if(found) {
+			__sync_fetch_and_add(&mResolved, 1);
+			store(job.ip, Resolved, hostname, now + mSettings.positiveTtl);
+		} else {
+			__sync_fetch_and_add(&mFailed, 1);
+			store(job.ip, Unresolvable, "", now + mSettings.negativeTtl);
+		}
+	}
+}
+
+/// asks for an address to be looked up
+/** Nothing is queued if the cache already has a current answer or the address is
+	already being looked up.
+	@param ip a dotted quad
+	\return false if the lookup was dropped, because the resolver isn't running or the
+		queue is full
+*/
+bool Resolver::request(const std::string &ip) {
+	if(!mRunning || !mBusy.lock()) {
+		return false;
+	}
+
+	time_t now = time(NULL);
+	Cache::iterator it = mCache.find(ip);
+
+	if(it != mCache.end()) {
+		if(it->second.state == Pending) {
+			mBusy.unlock();
+			return true;
+		}
+
+		if(it->second.expires > now) {
+			__sync_fetch_and_add(&mCacheHits, 1);
+			mBusy.unlock();
+			return true;
+		}
+
+		mCache.erase(it);
+	}
+
+	if(mQueue.size() >= mSettings.queueLength) {
+		mBusy.unlock();
+		__sync_fetch_and_add(&mDropped, 1);
+
+		if(glob.log.throttle("Resolver::request(): queue full")) {
+			glob.log.warn(boost::format("Resolver::request(): Lookup queue is full, not resolving %1%") % ip);
+		}
+
+		return false;
+	}
+
+	Job job;
+	job.ip = ip;
+	job.deadline = now + mSettings.timeout;
+	mQueue.push_back(job);
+
+	makeRoom(now);
+
+	Entry &entry = mCache[ip];
+	entry.state = Pending;
+	entry.hostname.clear();
+	entry.expires = job.deadline;
+
+	mBusy.unlock();
+
+	sem_post(&mWork);
+	return true;
+}
+
+/// checks the cache for an address
+/** @param ip a dotted quad
+	@param[out] hostname the name, when the answer is Resolved
+	\return what is known about the address. A lookup still running after its timeout
+		counts as Unresolvable.
+*/
+Resolver::LookupState Resolver::lookup(const std::string &ip, std::string &hostname) {
+	if(!mBusy.lock()) {
+		return NotCached;
+	}
+
+	LookupState state = NotCached;
+	Cache::const_iterator it = mCache.find(ip);
+
+	if(it != mCache.end()) {
+		if(it->second.expires > time(NULL)) {
+			state = it->second.state;
+			hostname = it->second.hostname;
+		} else if(it->second.state == Pending) {
+			state = Unresolvable;
+		}
+	}
+
+	mBusy.unlock();
+	return state;
+}
+
+/// gets how many lookups are waiting for a worker
+unsigned long Resolver::getQueueLength() {
+	unsigned long length = 0;
+
+	if(mBusy.lock()) {
+		length = mQueue.size();
+		mBusy.unlock();
+	}
+
+	return length;
+}
+
+/// gets how many addresses the cache holds, including pending lookups
+unsigned long Resolver::getCacheSize() {
+	unsigned long size = 0;
+
+	if(mBusy.lock()) {
+		size = mCache.size();
+		mBusy.unlock();
+	}
+
+	return size;
+}
+
+/// caches a worker's answer
+/** @param ip the address
+	@param state Resolved or Unresolvable
+	@param hostname the name, if Resolved
+	@param expires when the answer goes stale
+*/
+void Resolver::store(const std::string &ip, const LookupState state, const std::string &hostname, const time_t expires) {
+	if(!mBusy.lock()) {
+		return;
+	}
+
+	if(mCache.find(ip) == mCache.end()) {
+		makeRoom(time(NULL));
+	}
+
+	Entry &entry = mCache[ip];
+	entry.state = state;
+	entry.hostname = hostname;
+	entry.expires = expires;
+
+	mBusy.unlock();
+}
+
+/// makes space in a full cache for one more address
+/** Stale answers go first. If every answer is current, the one closest to going stale
+	is dropped. Pending lookups are never dropped, because a worker will store their
+	answers. The caller must hold mBusy.
+	@param now the current time
+*/
+void Resolver::makeRoom(const time_t now) {
+	if(mCache.size() < mSettings.cacheSize) {
+		return;
+	}
+
+	Cache::iterator soonest = mCache.end();
+
+	for(Cache::iterator it = mCache.begin(); it != mCache.end(); ) {
+		if(it->second.state == Pending) {
+			++it;
+		} else if(it->second.expires <= now) {
+			mCache.erase(it++);
+		} else {
+			if(soonest == mCache.end() || it->second.expires < soonest->second.expires) {
+				soonest = it;
+			}
+
+			++it;
+		}
+	}
+
+	if(mCache.size() >= mSettings.cacheSize && soonest != mCache.end()) {
+		mCache.erase(soonest);
+	}
+}
+
+/// runs a resolver worker
+/** @param arg the Resolver
+*/
+void *thread_resolver_func(void *arg) {
+	Resolver *resolver = static_cast<Resolver *>(arg);
+	resolver->run();
+	pthread_exit(0);
+}
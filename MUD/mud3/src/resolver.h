@@ -0,0 +1,155 @@
+#ifndef MUD_RESOLVER_H
+#define MUD_RESOLVER_H
+
+#include <string>
+#include <map>
+#include <deque>
+#include <ctime>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "mudconfig.h"
+#include "mutex.h"
+
+void *thread_resolver_func(void *arg);
+
+/// answers reverse lookups for the Resolver
+/** Resolver worker threads call reverse() concurrently, so implementations must be
+	thread safe.
+*/
+class ResolverBackend {
+public:
+	virtual ~ResolverBackend() {}
+
+	/// looks up the hostname for an IPv4 address
+	/** @param ip a dotted quad
+		@param timeout how long the lookup may take, in seconds
+		@param[out] hostname the name, if one was found
+		\return true if the address has a name
+	*/
+	virtual bool reverse(const std::string &ip, const unsigned int timeout, std::string &hostname) = 0;
+};
+
+/// asks the system's resolver, which normally means /etc/hosts and then DNS
+class SystemResolverBackend : public ResolverBackend {
+public:
+	bool reverse(const std::string &ip, const unsigned int timeout, std::string &hostname);
+};
+
+/// answers from a file in /etc/hosts format, for running without DNS
+/** Point the ResolverHostsFile config string at a file to use this instead of DNS.
+	Addresses that aren't in the file don't resolve.
+*/
+class HostsFileResolverBackend : public ResolverBackend {
+public:
+	explicit HostsFileResolverBackend(const std::string &path);
+
+	bool load();
+	bool reverse(const std::string &ip, const unsigned int timeout, std::string &hostname);
+
+	/// gets how many addresses the file named
+	unsigned long size() const { return mNames.size(); }
+
+private:
+	std::string mPath;	///< the hosts file
+	StringMap mNames;	///< the first name given for each address
+};
+
+/// how a Resolver is sized and how long it remembers answers
+typedef struct {
+	unsigned int threads;		///< worker threads; 0 turns lookups off
+	unsigned int queueLength;	///< the most lookups that may wait for a worker
+	unsigned int cacheSize;		///< the most addresses remembered
+	unsigned int positiveTtl;	///< seconds a hostname is remembered
+	unsigned int negativeTtl;	///< seconds an address without a name is remembered
+	unsigned int timeout;		///< seconds a lookup may take, including time in the queue
+} ResolverSettings;
+
+/// Turns connecting IP addresses into hostnames without blocking the driver
+/** A fixed pool of worker threads takes lookups from a bounded queue, and every answer
+	goes into a cache keyed by address. Names are kept for ResolverCacheTTL seconds and
+	failures for ResolverNegativeTTL, so a flood of connections from a few addresses
+	costs a few lookups, and a flood from many addresses costs a full queue rather than
+	a thread each. Lookups that find the queue full are dropped.
+
+	Nothing is pushed to connections: each Connection asks lookup() for its own address
+	until it has an answer or its timeout passes, so a connection that closes while its
+	lookup is in flight leaves nothing dangling.
+*/
+class Resolver {
+public:
+	/// what lookup() knows about an address
+	typedef enum {
+		NotCached = 0,	///< never asked, or the answer expired
+		Pending,		///< queued or being looked up
+		Resolved,		///< has a hostname
+		Unresolvable	///< has no name, or the lookup failed or timed out
+	} LookupState;
+
+	Resolver();
+	~Resolver();
+
+	bool start();
+	bool start(ResolverBackend *backend, const ResolverSettings &settings);
+
+	void run();
+
+	bool request(const std::string &ip);
+	LookupState lookup(const std::string &ip, std::string &hostname);
+
+	/// gets the lookup timeout, in seconds
+	unsigned int getTimeout() const { return mSettings.timeout; }
+
+	/// true once worker threads are running
+	bool isRunning() const { return mRunning; }
+
+	unsigned long getQueueLength();
+	unsigned long getCacheSize();
+
+	/// gets how many requests were answered from the cache
+	unsigned long getCacheHits() const { return mCacheHits; }
+	/// gets how many lookups found a name
+	unsigned long getResolved() const { return mResolved; }
+	/// gets how many lookups found no name
+	unsigned long getFailed() const { return mFailed; }
+	/// gets how many lookups ran out of time
+	unsigned long getTimedOut() const { return mTimedOut; }
+	/// gets how many requests were dropped because the queue was full
+	unsigned long getDropped() const { return mDropped; }
+
+private:
+	/// one cached answer
+	struct Entry {
+		LookupState state;		///< Pending, Resolved or Unresolvable
+		std::string hostname;	///< the name, when Resolved
+		time_t expires;			///< when the answer goes stale; for Pending, when the lookup times out
+	};
+
+	typedef std::map<std::string, Entry> Cache;
+
+	/// a lookup waiting for a worker
+	struct Job {
+		std::string ip;		///< the address to look up
+		time_t deadline;	///< when it should be finished
+	};
+
+	ResolverBackend *mBackend;		///< answers the lookups
+	ResolverSettings mSettings;		///< sizes and lifetimes
+	volatile bool mRunning;			///< true once the workers are started
+
+	Mutex mBusy;				///< guards mCache and mQueue
+	sem_t mWork;				///< counts jobs in mQueue, so idle workers sleep
+	Cache mCache;				///< every answer and pending lookup, by address
+	std::deque<Job> mQueue;		///< lookups waiting for a worker
+
+	volatile unsigned long mCacheHits;	///< see getCacheHits()
+	volatile unsigned long mResolved;	///< see getResolved()
+	volatile unsigned long mFailed;		///< see getFailed()
+	volatile unsigned long mTimedOut;	///< see getTimedOut()
+	volatile unsigned long mDropped;	///< see getDropped()
+
+	void store(const std::string &ip, const LookupState state, const std::string &hostname, const time_t expires);
+	void makeRoom(const time_t now);
+};
+
+#endif // MUD_RESOLVER_H
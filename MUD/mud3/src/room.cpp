@@ -10,17 +10,12 @@ extern Global glob;
 	threads don't fight for protected resources.
 	\todo should the capacity have a limit?
 */
-Room::Room() {
+Room::Room() : mBusy("Room") {
 	setObjectType(RoomObject);
 	containerSetCapacity(50);
 	mFileName = "Unset";
 	mZoneName = "Unset";
 
-	if(pthread_mutex_init(&mBusy, NULL) != 0) {
-		perror("Room::Room(): mutex initialization error");
-		exit(MUTEX_ERROR);
-	}
-
 	setLength(600);
 	setWidth(600);
 	setHeight(600);
@@ -34,10 +29,9 @@ Room::Room() {
 }
 
 /// Destructor
-/*** Destroys the mutex created by the constructor
+/*** Does nothing; the mutex cleans up after itself
 */
 Room::~Room() {
-	pthread_mutex_destroy(&mBusy);
 }
 
 /// sets the internal name of this file/resource
@@ -96,15 +90,7 @@ bool Room::Load() {
 			YAML::Node doc;
 			parser.GetNextDocument(doc);
 
-			if(!physicalLoad(doc["Physical"])) {
-				glob.log.error(boost::format("Room::Load(): cannot load physical node for %1%:%2%") % mZoneName % mFileName);
-			} else if(!roomLoad(doc["Room"])) {
-				glob.log.error(boost::format("Room::Load(): Cannot load room node for %1%:%2%") % mZoneName % mFileName);
-			} else if(!containerLoad(doc["Container"])) {
-				glob.log.error(boost::format("Room::Load(): Cannot load container node for %1%:%2%") % mZoneName % mFileName);
-			} else {
-				success = true;
-			}
+			success = Load(doc);
 		} catch(YAML::ParserException &e) {
 			glob.log.error(boost::format("Room::Load(%1%:%2%): Parser exception: %3%") % mZoneName % mFileName % e.what());
 			success = false;
@@ -132,24 +118,40 @@ bool Room::Load() {
 	return success;
 }
 
-/// a fake load function
-/** This function is only here to satisfy an ancestor's virtual function definition.
-	@param node A YAML::Node that will be completely ignored
-	\return false always
+/// loads a room from an already parsed document
+/** This function restores the room from a parsed save document. It does no
+	locking or file access of its own; Room::Load() wraps it for that.
+	@param node A YAML::Node holding the whole room document
+	\return true if every section loaded
 */
 bool Room::Load(const YAML::Node &node) {
-	glob.log.error("Room::Load(YAML::Node) was called instead of Room::Load()");
+	if(!physicalLoad(node["Physical"])) {
+		glob.log.error(boost::format("Room::Load(): cannot load physical node for %1%:%2%") % mZoneName % mFileName);
+	} else if(!roomLoad(node["Room"])) {
+		glob.log.error(boost::format("Room::Load(): Cannot load room node for %1%:%2%") % mZoneName % mFileName);
+	} else if(!containerLoad(node["Container"])) {
+		glob.log.error(boost::format("Room::Load(): Cannot load container node for %1%:%2%") % mZoneName % mFileName);
+	} else {
+		return true;
+	}
+
 	return false;
 }
 
-/// a fake save function
-/** This function is here to satisfy an ancestor's virtual function definition.
-	@param out A YAML::Emitter that will be ignored
-	\return false always
+/// writes the room document to an emitter
+/** This function emits the whole room, contents included, without touching
+	storage. Room::Save() wraps it to write the result to disk.
+	@param out A YAML::Emitter to write the room to
+	\return true if the emitter is still good afterwards
 */
 bool Room::Save(YAML::Emitter &out) const {
-	glob.log.error("Room::Save(YAML::Emitter) was called instead of Room::Save()");
-	return false;
+	out << YAML::BeginMap;
+	physicalSave(out);
+	roomSave(out);
+	containerSave(out);
+	out << YAML::EndMap;
+
+	return out.good();
 }
 
 /// loads the room-specific information from the retrieved save file
@@ -255,13 +257,7 @@ bool Room::Save() {
 	YAML::Emitter out;
 
 	if(lock()) {
-		out << YAML::BeginMap;
-		physicalSave(out);
-		roomSave(out);
-		containerSave(out);
-		out << YAML::EndMap;
-
-		if(!out.good()) {
+		if(!Save(out)) {
 			glob.log.error(boost::format("Room::Save(): YAML Emitter is no good: %1%") % out.GetLastError());
 		}
 
@@ -446,6 +442,33 @@ std::string Room::getExitString() const {
 	return s.str();
 }
 
+/// builds the GMCP Room.Info message for this room
+/** Rooms are numbered "zone:room", which is unique across the world and is what each
+	exit points at, so a client mapper can link rooms without knowing zone files.
+	Hidden exits are left out, as they are from getExitString().
+	\return the message body: num, name, area, coords and exits
+*/
+GmcpObject Room::getGmcpInfo() const {
+	GmcpObject info;
+	GmcpObject exits;
+
+	for(std::vector<Exit::ExitPointer>::const_iterator it = mExits.begin(); it != mExits.end(); ++it) {
+		if(!(*it)->isHidden()) {
+			exits.add((*it)->getName(), (*it)->getDestinationZone() + ":" + (*it)->getDestination());
+		}
+	}
+
+	std::stringstream coords;
+	coords << "[" << mMapX << "," << mMapY << "]";
+
+	info.add("num", mZoneName + ":" + mFileName);
+	info.add("name", getName());
+	info.add("area", mZoneName);
+	info.addJson("coords", coords.str());
+	info.addJson("exits", exits.toJson());
+	return info;
+}
+
 /// takes care of any special messages
 /** This function allows a Room to listen for a specific message and act accordingly
 	@param message a shared_ptr of the message to process
@@ -484,7 +507,7 @@ void Room::heartbeat() {
 bool Room::lock() {
 	bool success;
 
-	if(pthread_mutex_lock(&mBusy) != 0) {
+	if(!mBusy.lock()) {
 		success = false;
 		glob.log.error("Room::lock(): Could not lock mutex");
 	} else {
@@ -503,7 +526,7 @@ bool Room::lock() {
 bool Room::unlock() {
 	bool success;
 
-	if(pthread_mutex_unlock(&mBusy) != 0) {
+	if(!mBusy.unlock()) {
 		success = false;
 		glob.log.error("Room::unlock(): Could not unlock mutex");
 	} else {
@@ -6,10 +6,13 @@
 #include <boost/shared_ptr.hpp>
 
 #include "mudconfig.h"
+#include "memoryAccount.h"
+#include "mutex.h"
 #include "physical.h"
 #include "container.h"
 #include "exit.h"
 #include "message.h"
+#include "gmcp.h"
 
 /// defines what a room is and its behavior
 /** This class defines how a room behaves.
@@ -18,6 +21,8 @@
 	execute. Read only or const functions are not affected.
 */
 class Room : public Physical, public Container {
+	MEMORY_ACCOUNTED(MemoryAccount::RoomsTag)
+
 public:
 	typedef boost::shared_ptr<Room> RoomPointer;
 	typedef std::map<std::string, RoomPointer> RoomList;
@@ -41,6 +46,8 @@ public:
 	Exit::ExitPointer getExit(const std::string &direction) const;
 	std::string getExitString() const;
 
+	GmcpObject getGmcpInfo() const;
+
 	bool Save();
 	bool Load();
 	bool Save(YAML::Emitter &out) const;
@@ -70,7 +77,7 @@ private:
 	int mMapX;
 	int mMapY;
 
-	pthread_mutex_t mBusy;	///< mutex to lock so threads don't fight over this resource
+	Mutex mBusy;	///< mutex to lock so threads don't fight over this resource
 	bool lock();
 	bool unlock();
 
@@ -370,12 +370,12 @@ std::string RuntimeConfig::getStringValue(const std::string &key) const {
 }
 
 /// gets an int value
-/** This function gets an integer value
+/** This function gets an integer value. It is a plain map lookup, with no logging or
+	locking, since callers such as CommandHandler::call() read their setting every time.
 	@param the key to look for
 	\return the value of the key
 */
 int RuntimeConfig::getIntValue(const std::string &key) const {
-	glob.log.debug(boost::format("RuntimeConfig: getIntValue: Looking for %1%") % key);
 	std::map<std::string, int>::const_iterator it;
 
 	if((it = mConfigInts.find(key)) != mConfigInts.end()) {
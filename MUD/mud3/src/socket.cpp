@@ -1,5 +1,6 @@
 #include <sstream>
 #include <errno.h>
+#include <fcntl.h>
 #include <boost/cast.hpp>
 
 #include "socket.h"
@@ -140,6 +141,12 @@ bool Socket::initialize(void) {
 		return false;
 	}
 
+	int backlog = glob.Config.getIntValue("ListenBacklog");
+
+	if(backlog > 0) {
+		mBacklog = backlog;
+	}
+
 	error = listen(mSocket_fd, mBacklog);
 
 	if(error == -1) {
@@ -163,8 +170,46 @@ bool Socket::initialize(void) {
 		return false;
 	}
 
+	// accept() has to fail rather than block once the queue is drained
+	fcntl(mSocket_fd, F_SETFL, fcntl(mSocket_fd, F_GETFL) | O_NONBLOCK);
+
 	FD_SET(mSocket_fd, &mFdset);
 
+	glob.log.info(boost::format("Listening on port %1% with a backlog of %2%") % mPort % mBacklog);
+
+	return true;
+}
+
+/// listens on a socket that is already bound and listening
+/** A hot reboot hands the new program the listening socket the old one made, so
+	connections that arrive during the restart wait in its queue rather than being
+	refused.
+	@param fd the listening socket
+	\return false if \a fd isn't a listening socket
+*/
+bool Socket::adopt_listener(const int fd) {
+	int listening = 0;
+	socklen_t length = sizeof(listening);
+
+	if(getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) == -1 || !listening) {
+		glob.log.error(boost::format("Socket::adopt_listener(): Descriptor %1% is not a listening socket") % fd);
+		return false;
+	}
+
+	struct sockaddr_in address;
+	socklen_t addressLength = sizeof(address);
+
+	if(getsockname(fd, (struct sockaddr *)&address, &addressLength) == 0) {
+		mPort = ntohs(address.sin_port);
+	}
+
+	mSocket_fd = fd;
+	fcntl(mSocket_fd, F_SETFL, fcntl(mSocket_fd, F_GETFL) | O_NONBLOCK);
+
+	FD_SET(mSocket_fd, &mFdset);
+
+	glob.log.info(boost::format("Listening on port %1% again after a hot reboot") % mPort);
+
 	return true;
 }
 
@@ -175,46 +220,69 @@ bool Socket::initialize(void) {
 	\return an int representing the file descriptor just accepted
 */
 int Socket::open_connection(void) {
-	int temp_fd = 0;
-
 	struct sockaddr_in sock;
-	socklen_t socklen = sizeof(sock);
-
-	temp_fd = accept(mSocket_fd, (struct sockaddr *)&sock, &socklen);
-
-	if(temp_fd == -1) {
-		glob.log.debug("Socket: call to accept() failed");
-		return temp_fd;
-	}
-
-	FD_SET(temp_fd, &mFdset);
-
-	return temp_fd;
+	return open_connection(&sock);
 }
 
 /// Accepts an incoming connection, returns the descriptor
 /** This function accepts an incoming connection based on the passed-in \c struct
-	\c sockaddr_in pointer, and adds it to the file descriptor set
+	\c sockaddr_in pointer, and adds it to the file descriptor set. The new socket is
+	already non-blocking and closed on exec.
 	@param sock a pointer to a \c sockaddr_in struct
-	\return an int representing the file descriptor just added
+	\return an int representing the file descriptor just added, or -1 if there was
+		nothing to accept (errno is EAGAIN) or accept failed
 */
 int Socket::open_connection(struct sockaddr_in *sock) {
 	int temp_fd = 0;
 
 	socklen_t socklen = sizeof(struct sockaddr_in);
 
-	temp_fd = accept(mSocket_fd, (struct sockaddr *)sock, &socklen);
+	temp_fd = accept4(mSocket_fd, (struct sockaddr *)sock, &socklen, SOCK_NONBLOCK | SOCK_CLOEXEC);
 
 	if(temp_fd == -1) {
-		glob.log.debug("Socket: call to accept() with sock failed");
+		if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && glob.log.throttle("Socket::open_connection(): accept failed")) {
+			glob.log.error(boost::format("Socket: call to accept4() failed: %1%") % strerror(errno));
+		}
+
 		return temp_fd;
 	}
 
+	if(temp_fd >= FD_SETSIZE) {
+		// select() can't watch it, so it may as well not exist
+		glob.log.error(boost::format("Socket: descriptor %1% is past FD_SETSIZE, closing it") % temp_fd);
+		close(temp_fd);
+		errno = EMFILE;
+		return -1;
+	}
+
 	FD_SET(temp_fd, &mFdset);
 
 	return temp_fd;
 }
 
+/// takes up a client connection that is already open
+/** A hot reboot uses this for the connections the old program left open. Like an
+	accepted socket, the descriptor is made non-blocking and closed on exec, and
+	added to the file descriptor set.
+	@param fd the connection
+	\return false if \a fd isn't open or select() can't watch it
+*/
+bool Socket::adopt_connection(const int fd) {
+	int flags = fcntl(fd, F_GETFD);
+
+	if(flags == -1 || fd >= FD_SETSIZE || fd == mSocket_fd) {
+		glob.log.error(boost::format("Socket::adopt_connection(): Descriptor %1% can't be taken up") % fd);
+		return false;
+	}
+
+	fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	FD_SET(fd, &mFdset);
+
+	return true;
+}
+
 /// closes a connection based on its file descriptor
 /** This function closes an open connection based on the file descriptor provided.
 	It checks to make sure you're not trying to close the server down by mistake.
@@ -21,6 +21,7 @@ public:
 
 	bool initialize();
 	bool initialize(const unsigned short listen_port);
+	bool adopt_listener(const int fd);
 
 	/// gets the highest possible file descriptor from the operating system
 	int get_fdmax() const { return mFdmax; }
@@ -39,6 +40,7 @@ public:
 	int open_connection();
 	int open_connection(struct sockaddr_in *sock);
 
+	bool adopt_connection(const int fd);
 	void close_connection(const int fd);
 
 	std::string convert_time(time_t tSeconds) const;
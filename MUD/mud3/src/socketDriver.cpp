@@ -1,18 +1,26 @@
-#include <sys/ioctl.h>
 #include <arpa/inet.h>
+#include <unistd.h>
 #include <sstream>
 
 #include "socketDriver.h"
 #include "thread_functions.h"
+#include "timer.h"
 
 #include "global.h"
 
 extern Global glob;
 
 /// Constructor
-/** Does nothing
+/** Reads the admission limits; the config is loaded before the driver is created
 */
-SocketDriver::SocketDriver() {
+SocketDriver::SocketDriver() : mAdmission("SocketDriver") {
+	mAccepted = 0;
+
+	for(int i = 0; i < NumberOfRejections; ++i) {
+		mRejected[i] = 0;
+	}
+
+	loadLimits();
 }
 
 /// Destructor
@@ -23,72 +31,260 @@ SocketDriver::~SocketDriver() {
 	glob.playerDatabase.closeAllConnections();
 }
 
+/// reads a limit from the config
+/** @param key the config integer
+	@param fallback the value from mudconfig.h, used when the key isn't set
+	\return the limit; 0 means none
+*/
+static unsigned int admissionSetting(const std::string &key, const unsigned int fallback) {
+	int value = glob.Config.getIntValue(key);
+	return value < 0 ? fallback : static_cast<unsigned int>(value);
+}
+
+/// reads the admission limits from the config
+/** MaxConnections is kept under FD_SETSIZE, since select() can't watch anything past it.
+	\see mudconfig.h for the defaults
+*/
+void SocketDriver::loadLimits() {
+	mMaxConnections = admissionSetting("MaxConnections", MAX_CONNECTIONS);
+
+	if(mMaxConnections == 0 || mMaxConnections > FD_SETSIZE - 32) {
+		mMaxConnections = FD_SETSIZE - 32;
+	}
+
+	mMaxPerAddress = admissionSetting("MaxConnectionsPerIP", MAX_CONNECTIONS_PER_IP);
+	mArrivals.configure(admissionSetting("ConnectionRate", CONNECTION_RATE), admissionSetting("ConnectionBurst", CONNECTION_BURST));
+	mAddressRate = admissionSetting("ConnectionRatePerIP", CONNECTION_RATE_PER_IP) / 60.0;
+	mAddressBurst = admissionSetting("ConnectionBurstPerIP", CONNECTION_BURST_PER_IP);
+
+	mRejectMessage = glob.Config.getStringValue("RejectMessage");
+
+	if(mRejectMessage.empty()) {
+		mRejectMessage = REJECT_MESSAGE;
+	}
+
+	mRejectMessage += "\r\n";
+}
+
+/// gets a printable name for a RejectReason, as used in the metrics
+std::string SocketDriver::getRejectName(RejectReason reason) {
+	switch(reason) {
+		case RejectedBanned:
+			return "banned";
+		case RejectedFull:
+			return "full";
+		case RejectedAddressFull:
+			return "per_ip";
+		case RejectedRate:
+			return "rate";
+		case RejectedAddressRate:
+			return "ip_rate";
+		default:
+			return "unknown";
+	}
+}
+
 /// closes a connection by its file descriptor
 /** This function shuts down a connection based on its file descriptor
 	@param fd an int representation of the file descriptor
 */
 void SocketDriver::shutdown_connection(const int fd) {
 	glob.log.debug(boost::format("SocketDriver::shutdown_connection(): Closing connection on descriptor %1%") % fd);
+	glob.capture.close(fd);
+	release(fd);
 	close_connection(fd);
 }
 
 /// Handles new, incoming player connections
-/** This function accepts new connections and tells the PlayerDatabase to create
-	a new Player. It checks for banned IPs and responds with the ban reason, and
-	shutting down the connection if it is banned. It sets the connection to a
-	non-blocking state.  It sets the Player's IP, and determines whether or not
-	to perform a reverse-DNS lookup on the Player's hostname.
+/** This function accepts every connection waiting in the listen queue, up to
+	SOCKET_ACCEPT_BATCH per call so the players already connected still get read. Each
+	one is checked against the ban list and the admission limits; those turned away get
+	a canned line and are closed straight away. The rest get a Player.
 */
 void SocketDriver::new_connection() {
-	int argp = 1;
-	int new_fd = 0;
+	unsigned long long now = Timer::now();
 
-	ClientSocket cSocket;
+	for(int accepted = 0; accepted < SOCKET_ACCEPT_BATCH; ++accepted) {
+		struct sockaddr_in sock;
 
-	struct sockaddr_in sock;
-	socklen_t socklen;
+		int new_fd = open_connection(&sock);
 
-	// go back if our new socket fails to be created
-	new_fd = open_connection(&sock);
+		if(new_fd == -1) {
+			// the queue is drained, or accept failed and has been logged
+			return;
+		}
 
-	if(new_fd == -1) {
-		glob.log.error("Bad socket descriptor in new_connection()");
-		return;
-	}
+		std::string ip = inet_ntoa(sock.sin_addr);
+		std::string banReason;
 
-	Player::PlayerPointer player = Player::PlayerPointer(new Player());
+		if(glob.banMap.isBanned(ip, banReason)) {
+			reject(new_fd, ip, RejectedBanned, "Login not allowed: " + banReason + "\r\n");
+			continue;
+		}
 
-	player->setFd(new_fd);
-	player->setObjectType(PlayerObject);
+		RejectReason reason;
+		bool loopback = (ntohl(sock.sin_addr.s_addr) >> 24) == 127;
 
-	glob.playerDatabase.add(player);
+		if(!admit(new_fd, ip, loopback, now, reason)) {
+			reject(new_fd, ip, reason, mRejectMessage);
+			continue;
+		}
 
-	glob.log.debug(boost::format("SocketDriver::new_connection(): New incoming connection on socket descriptor %1%") % new_fd);
+		startSession(new_fd, ip);
+	}
+}
 
-	// make the socket non-blocking
-	ioctl(new_fd, FIONBIO, &argp);
+/// checks a new connection against the admission limits, and counts it if it gets in
+/** Loopback addresses are only held to MaxConnections.
+	@param fd the new descriptor
+	@param ip its address
+	@param loopback true if the address is 127/8
+	@param now the time, from Timer::now()
+	@param[out] reason why it was turned away
+	\return true if the connection may stay
+*/
+bool SocketDriver::admit(const int fd, const std::string &ip, const bool loopback, const unsigned long long now, RejectReason &reason) {
+	if(!mAdmission.lock()) {
+		reason = RejectedFull;
+		return false;
+	}
 
-	socklen = sizeof(sock);
+	bool admitted = false;
 
-	if(getpeername(new_fd, (struct sockaddr *)&sock, &socklen) < 0) {
-		glob.log.error("SocketDriver::new_connection - getpeername lookup failed");
-		player->setHostIP("0.0.0.0");
-		player->setHostname("unknown");
+	if(mFdAddresses.size() >= mMaxConnections) {
+		reason = RejectedFull;
+	} else if(loopback) {
+		admitted = true;
 	} else {
-		// use IP as temporary hostname
-		std::string ip = inet_ntoa(sock.sin_addr);
-		player->setHostIP(ip);
+		AddressMap::iterator it = mAddresses.find(ip);
 
-		if(glob.banMap.isBanned(ip)) {
-			glob.log.warn(boost::format("SocketDriver::new_connection(): Attempted login from %1% (banned)") % ip);
+		if(it == mAddresses.end()) {
+			if(mAddresses.size() >= 4 * mMaxConnections) {
+				evictAddresses(now);
+			}
 
-			player->Write(boost::format("Login not allowed: %1%") % glob.banMap.getBannedReason(ip));
-			glob.playerDatabase.remove(player);
+			AddressRecord record;
+			record.connections = 0;
+			record.arrivals.configure(mAddressRate, mAddressBurst);
+			it = mAddresses.insert(AddressMap::value_type(ip, record)).first;
+		}
 
-			return;
+		// check both buckets before taking from either, so a connection the server
+		// turns away doesn't cost its address a token
+		if(mMaxPerAddress > 0 && it->second.connections >= mMaxPerAddress) {
+			reason = RejectedAddressFull;
+		} else if(!it->second.arrivals.canTake(now)) {
+			reason = RejectedAddressRate;
+		} else if(!mArrivals.take(now)) {
+			reason = RejectedRate;
+		} else {
+			it->second.arrivals.take(now);
+			admitted = true;
 		}
 	}
 
+	if(admitted) {
+		mFdAddresses[fd] = ip;
+
+		if(!loopback) {
+			++mAddresses[ip].connections;
+		}
+	}
+
+	mAdmission.unlock();
+
+	if(admitted) {
+		__sync_fetch_and_add(&mAccepted, 1);
+	}
+
+	return admitted;
+}
+
+/// forgets a few addresses that have nothing open and have earned back every token
+/** Each call looks at ADDRESS_EVICTION_BATCH records, carrying on from where the last
+	call stopped and wrapping around, so a map full of records that can't be forgotten
+	yet costs each new address a bounded amount of work instead of a walk of the map.
+	The caller must hold mAdmission.
+	@param now the time, from Timer::now()
+*/
+void SocketDriver::evictAddresses(const unsigned long long now) {
+	AddressMap::iterator it = mAddresses.lower_bound(mEvictionCursor);
+
+	for(int checked = 0; checked < ADDRESS_EVICTION_BATCH && !mAddresses.empty(); ++checked) {
+		if(it == mAddresses.end()) {
+			it = mAddresses.begin();
+		}
+
+		if(it->second.connections == 0 && it->second.arrivals.isFull(now)) {
+			mAddresses.erase(it++);
+		} else {
+			++it;
+		}
+	}
+
+	mEvictionCursor = (it == mAddresses.end()) ? "" : it->first;
+}
+
+/// forgets an admitted connection as it closes
+/** @param fd the descriptor being closed
+*/
+void SocketDriver::release(const int fd) {
+	if(!mAdmission.lock()) {
+		return;
+	}
+
+	std::map<int, std::string>::iterator it = mFdAddresses.find(fd);
+
+	if(it != mFdAddresses.end()) {
+		AddressMap::iterator address = mAddresses.find(it->second);
+
+		if(address != mAddresses.end() && address->second.connections > 0) {
+			--address->second.connections;
+		}
+
+		mFdAddresses.erase(it);
+	}
+
+	mAdmission.unlock();
+}
+
+/// turns a new connection away
+/** The message goes out in a single non-blocking write, which a fresh socket's send
+	buffer always has room for, and the connection is closed without a Player ever
+	being created.
+	@param fd the new descriptor
+	@param ip its address, for the log
+	@param reason why it is being turned away
+	@param message what to tell the client, line ending included
+*/
+void SocketDriver::reject(const int fd, const std::string &ip, const RejectReason reason, const std::string &message) {
+	__sync_fetch_and_add(&mRejected[reason], 1);
+
+	if(glob.log.throttle("SocketDriver::reject()")) {
+		glob.log.warn(boost::format("SocketDriver::new_connection(): Turned away %1% (%2%)") % ip % getRejectName(reason));
+	}
+
+	if(write(fd, message.data(), message.size()) < 0) {
+		// nothing to be done; it is being closed anyway
+	}
+
+	close_connection(fd);
+}
+
+/// creates a Player for an admitted connection and greets it
+/** @param fd the new descriptor
+	@param ip its address
+*/
+void SocketDriver::startSession(const int fd, const std::string &ip) {
+	glob.reaper.configureSocket(fd);
+
+	Player::PlayerPointer player = createPlayer(fd, ip);
+
+	glob.log.debug(boost::format("SocketDriver::new_connection(): New incoming connection on socket descriptor %1%") % fd);
+
+	// the requests go out with the greeting, and the client answers while logging in
+	player->negotiate();
+
 	// send greeting and allow login
 	std::string greeting = glob.Config.getStringValue("Greeting");
 
@@ -106,3 +302,54 @@ void SocketDriver::new_connection() {
 
 	player->Write(loginPrompt);
 }
+
+/// takes up a connection left open by a hot reboot
+/** The connection is counted against its address like an admitted one, but isn't held
+	to the limits, since it was let in before the reboot. Its socket options carry over,
+	so only the Player is made; the caller restores the rest.
+	@param fd the open descriptor
+	@param ip its address
+	\return the new Player, or an empty pointer if the descriptor can't be used
+*/
+Player::PlayerPointer SocketDriver::adoptSession(const int fd, const std::string &ip) {
+	if(!adopt_connection(fd)) {
+		return Player::PlayerPointer();
+	}
+
+	if(mAdmission.lock()) {
+		mFdAddresses[fd] = ip;
+
+		AddressMap::iterator it = mAddresses.find(ip);
+
+		if(it == mAddresses.end()) {
+			AddressRecord record;
+			record.connections = 0;
+			record.arrivals.configure(mAddressRate, mAddressBurst);
+			it = mAddresses.insert(AddressMap::value_type(ip, record)).first;
+		}
+
+		++it->second.connections;
+		mAdmission.unlock();
+	}
+
+	return createPlayer(fd, ip);
+}
+
+/// makes the Player for a connection and adds it to the game
+/** @param fd the connection's descriptor
+	@param ip its address
+	\return the new Player
+*/
+Player::PlayerPointer SocketDriver::createPlayer(const int fd, const std::string &ip) {
+	Player::PlayerPointer player = Player::PlayerPointer(new Player());
+
+	player->setFd(fd);
+	player->setObjectType(PlayerObject);
+
+	glob.playerDatabase.add(player);
+
+	player->setHostIP(ip);
+	glob.capture.open(fd, ip);
+
+	return player;
+}
@@ -3,23 +3,80 @@
 
 #include <string>
 #include <vector>
+#include <map>
 
 #include "socket.h"
 #include "client_socket.h"
 #include "player.h"
+#include "mutex.h"
+#include "tokenBucket.h"
 
 /// Defines added socket functionality for the MUD program
-/** This class manages connections for the driver
+/** This class manages connections for the driver. It also decides which new
+	connections to let in: there are caps on connections in total and per address, and
+	token buckets on how fast new connections may arrive, overall and per address.
+	Connections that are turned away get a one-line message and are closed before a
+	Player is ever created for them.
 */
 class SocketDriver : public Socket {
 public:
+	/// why a connection was turned away
+	typedef enum {
+		RejectedBanned = 0,		///< the address is banned
+		RejectedFull,			///< MaxConnections are already open
+		RejectedAddressFull,	///< MaxConnectionsPerIP are already open from the address
+		RejectedRate,			///< too many new connections overall
+		RejectedAddressRate,	///< too many new connections from the address
+
+		NumberOfRejections
+	} RejectReason;
+
 	SocketDriver();
 	virtual ~SocketDriver();
 
+	void loadLimits();
+
 	void shutdown_connection(const int fd);
 	void new_connection();
+	Player::PlayerPointer adoptSession(const int fd, const std::string &ip);
+
+	/// gets how many connections were let in
+	unsigned long getAccepted() const { return mAccepted; }
+	/// gets how many connections were turned away for a reason
+	unsigned long getRejected(RejectReason reason) const { return reason < NumberOfRejections ? mRejected[reason] : 0; }
+
+	static std::string getRejectName(RejectReason reason);
 
 private:
+	/// what admission knows about one address
+	struct AddressRecord {
+		unsigned int connections;	///< connections open from the address
+		TokenBucket arrivals;		///< new connections the address may still make
+	};
+
+	typedef std::map<std::string, AddressRecord> AddressMap;
+
+	Mutex mAdmission;			///< guards mAddresses and mFdAddresses, which both threads change
+	AddressMap mAddresses;		///< addresses with open connections or a recent arrival
+	std::map<int, std::string> mFdAddresses;	///< the address of every admitted descriptor
+	TokenBucket mArrivals;		///< new connections the whole server may still take
+	std::string mEvictionCursor;	///< the address evictAddresses() looks at next
+
+	unsigned int mMaxConnections;	///< 0 for no limit
+	unsigned int mMaxPerAddress;	///< 0 for no limit
+	double mAddressRate;			///< new connections per second for each address
+	double mAddressBurst;			///< new connections an address may make at once
+	std::string mRejectMessage;		///< the canned answer, with its line ending
+
+	volatile unsigned long mAccepted;	///< see getAccepted()
+	volatile unsigned long mRejected[NumberOfRejections];	///< see getRejected()
+
+	bool admit(const int fd, const std::string &ip, const bool loopback, const unsigned long long now, RejectReason &reason);
+	void release(const int fd);
+	void evictAddresses(const unsigned long long now);
+	void reject(const int fd, const std::string &ip, const RejectReason reason, const std::string &message);
+	void startSession(const int fd, const std::string &ip);
+	Player::PlayerPointer createPlayer(const int fd, const std::string &ip);
 };
 
 #endif // MUD_SOCKET_DRIVER_H
@@ -0,0 +1,323 @@
+#include <string>
+#include <cstring>
+#include <arpa/telnet.h>
+
+#include "telnetParser.h"
+
+/// Constructor
+/** Starts in plain text with every option off on both sides
+*/
+TelnetParser::TelnetParser() {
+	mState = DataState;
+	mSbOption = 0;
+	mSbOverflow = false;
+	mProtocolErrors = 0;
+
+	memset(mLocal, OptionNo, sizeof(mLocal));
+	memset(mRemote, OptionNo, sizeof(mRemote));
+}
+
+/// decodes bytes read from the client
+/** Plain text is copied to \a text in runs, so input without telnet commands costs
+	little more than a copy. Commands are acted on as they complete: answers to option
+	requests are appended to \a reply, and the Handler is told about options that change
+	and subnegotiations that arrive.
+	@param data the bytes as they came off the socket
+	@param length how many bytes
+	@param[out] text the client's text is appended here
+	@param[out] reply telnet commands to send back are appended here
+	@param handler decides what to agree to
+*/
+void TelnetParser::parse(const char *data, const unsigned long length, std::string &text, std::string &reply, Handler &handler) {
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+	const unsigned char *end = p + length;
+
+	while(p < end) {
+		if(mState == DataState) {
+			// only IAC and NUL need a closer look
+			const unsigned char *run = p;
+
+			while(p < end && *p != IAC && *p != '\0') {
+				++p;
+			}
+
+			text.append(reinterpret_cast<const char *>(run), p - run);
+
+			if(p == end) {
+				break;
+			}
+
+			// NUL only ever pads a bare CR, so it is dropped
+			if(*p == IAC) {
+				mState = IacState;
+			}
+
+			++p;
+			continue;
+		}
+
+		unsigned char c = *p++;
+
+		switch(mState) {
+			case IacState:
+				switch(c) {
+					case IAC:
+						// an escaped 255 is data
+						text += static_cast<char>(IAC);
+						mState = DataState;
+						break;
+					case WILL:
+						mState = WillState;
+						break;
+					case WONT:
+						mState = WontState;
+						break;
+					case DO:
+						mState = DoState;
+						break;
+					case DONT:
+						mState = DontState;
+						break;
+					case SB:
+						mState = SbState;
+						break;
+					default:
+						// NOP, GA, AYT and the rest carry nothing we use
+						mState = DataState;
+				}
+				break;
+
+			case WillState:
+			case WontState:
+			case DoState:
+			case DontState: {
+				ParserState command = mState;
+				mState = DataState;
+				negotiate(command, c, reply, handler);
+				break;
+			}
+
+			case SbState:
+				mSbOption = c;
+				mSubnegotiation.clear();
+				mSbOverflow = false;
+				mState = SbDataState;
+				break;
+
+			case SbDataState:
+				if(c == IAC) {
+					mState = SbIacState;
+				} else if(mSubnegotiation.length() < kMaxTelnetSubnegotiationLength) {
+					mSubnegotiation += static_cast<char>(c);
+				} else {
+					mSbOverflow = true;
+				}
+				break;
+
+			case SbIacState:
+				if(c == IAC) {
+					if(mSubnegotiation.length() < kMaxTelnetSubnegotiationLength) {
+						mSubnegotiation += static_cast<char>(IAC);
+					} else {
+						mSbOverflow = true;
+					}
+					mState = SbDataState;
+				} else if(c == SE) {
+					mState = DataState;
+
+					if(mSbOverflow) {
+						++mProtocolErrors;
+					} else {
+						handler.telnetSubnegotiation(mSbOption, mSubnegotiation, reply);
+					}
+
+					mSubnegotiation.clear();
+				} else {
+					// the client never closed the subnegotiation; treat this as a new command
+					++mProtocolErrors;
+					mSubnegotiation.clear();
+					mState = IacState;
+					--p;
+				}
+				break;
+
+			default:
+				mState = DataState;
+		}
+	}
+}
+
+/// acts on WILL, WONT, DO or DONT from the client
+/** @param command which of the four arrived, as the state it put the parser in
+	@param option the option it is about
+	@param[out] reply any answer is appended here
+	@param handler decides what to agree to
+*/
+void TelnetParser::negotiate(const ParserState command, const unsigned char option, std::string &reply, Handler &handler) {
+	const bool local = (command == DoState || command == DontState);
+	const bool on = (command == WillState || command == DoState);
+
+	unsigned char &state = local ? mLocal[option] : mRemote[option];
+	const unsigned char agree = local ? WILL : DO;
+	const unsigned char refuse = local ? WONT : DONT;
+
+	// the state is always updated before the handler hears about it, so the handler
+	// may start a new negotiation for the same option
+	if(on) {
+		switch(state) {
+			case OptionNo:
+				if(local ? handler.telnetAcceptLocal(option) : handler.telnetAcceptRemote(option)) {
+					state = OptionYes;
+					appendCommand(reply, agree, option);
+					handler.telnetOptionChanged(option, local, true, reply);
+				} else {
+					appendCommand(reply, refuse, option);
+				}
+				break;
+			case OptionWantYes:
+				state = OptionYes;
+				handler.telnetOptionChanged(option, local, true, reply);
+				break;
+			case OptionWantNo:
+				// RFC 1143 calls this an error: we turned it off and the client said yes
+				++mProtocolErrors;
+				state = OptionNo;
+				break;
+			default:
+				// already on; answering again would start a loop
+				break;
+		}
+	} else {
+		switch(state) {
+			case OptionYes:
+				state = OptionNo;
+				appendCommand(reply, refuse, option);
+				handler.telnetOptionChanged(option, local, false, reply);
+				break;
+			case OptionWantNo:
+				state = OptionNo;
+				handler.telnetOptionChanged(option, local, false, reply);
+				break;
+			case OptionWantYes:
+				// the client turned our request down
+				state = OptionNo;
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+/// offers to turn on one of our options
+/** @param option the option to offer
+	@param[out] reply IAC WILL option is appended here
+	\return false if the option is already on or being negotiated
+*/
+bool TelnetParser::enableLocal(const unsigned char option, std::string &reply) {
+	if(mLocal[option] != OptionNo) {
+		return false;
+	}
+
+	mLocal[option] = OptionWantYes;
+	appendCommand(reply, WILL, option);
+	return true;
+}
+
+/// turns off one of our options
+/** @param option the option to turn off
+	@param[out] reply IAC WONT option is appended here
+	\return false if the option isn't on
+*/
+bool TelnetParser::disableLocal(const unsigned char option, std::string &reply) {
+	if(mLocal[option] != OptionYes) {
+		return false;
+	}
+
+	mLocal[option] = OptionWantNo;
+	appendCommand(reply, WONT, option);
+	return true;
+}
+
+/// asks the client to turn on one of its options
+/** @param option the option to ask for
+	@param[out] reply IAC DO option is appended here
+	\return false if the option is already on or being negotiated
+*/
+bool TelnetParser::enableRemote(const unsigned char option, std::string &reply) {
+	if(mRemote[option] != OptionNo) {
+		return false;
+	}
+
+	mRemote[option] = OptionWantYes;
+	appendCommand(reply, DO, option);
+	return true;
+}
+
+/// asks the client to turn off one of its options
+/** @param option the option to turn off
+	@param[out] reply IAC DONT option is appended here
+	\return false if the option isn't on
+*/
+bool TelnetParser::disableRemote(const unsigned char option, std::string &reply) {
+	if(mRemote[option] != OptionYes) {
+		return false;
+	}
+
+	mRemote[option] = OptionWantNo;
+	appendCommand(reply, DONT, option);
+	return true;
+}
+
+/// marks one of our options as on without negotiating it
+/** A hot reboot uses this to carry over what the client agreed to before; asking again
+	would get no answer, since RFC 1143 has a client ignore a request for what is
+	already on.
+	@param option the option that was on
+*/
+void TelnetParser::restoreLocal(const unsigned char option) {
+	mLocal[option] = OptionYes;
+}
+
+/// marks one of the client's options as on without negotiating it
+/** @param option the option that was on
+	\see restoreLocal()
+*/
+void TelnetParser::restoreRemote(const unsigned char option) {
+	mRemote[option] = OptionYes;
+}
+
+/// doubles every IAC byte so the client reads it as data
+/** @param text output on its way to the client
+*/
+void TelnetParser::escape(std::string &text) {
+	std::string::size_type pos = text.find(static_cast<char>(IAC));
+
+	while(pos != std::string::npos) {
+		text.insert(pos, 1, static_cast<char>(IAC));
+		pos = text.find(static_cast<char>(IAC), pos + 2);
+	}
+}
+
+/// builds IAC SB option data IAC SE
+/** @param[out] out the subnegotiation is appended here
+	@param option the option it is about
+	@param data the payload, which is escaped here
+*/
+void TelnetParser::appendSubnegotiation(std::string &out, const unsigned char option, const std::string &data) {
+	std::string payload = data;
+	escape(payload);
+
+	out += static_cast<char>(IAC);
+	out += static_cast<char>(SB);
+	out += static_cast<char>(option);
+	out += payload;
+	out += static_cast<char>(IAC);
+	out += static_cast<char>(SE);
+}
+
+/// appends IAC command option
+void TelnetParser::appendCommand(std::string &out, const unsigned char command, const unsigned char option) {
+	out += static_cast<char>(IAC);
+	out += static_cast<char>(command);
+	out += static_cast<char>(option);
+}
@@ -0,0 +1,100 @@
+#ifndef MUD_TELNET_PARSER_H
+#define MUD_TELNET_PARSER_H
+
+#include <string>
+
+#include "mudconfig.h"
+
+/// Decodes the telnet protocol in a client's input stream
+/** This class is a byte-at-a-time state machine (RFC 854), so commands are understood
+	wherever they fall in a read and however the reads are split; a sequence cut in half
+	is finished by the next call to parse(). IAC IAC is unescaped to a data byte, NUL
+	bytes are dropped and subnegotiations (IAC SB option ... IAC SE) are collected up to
+	kMaxTelnetSubnegotiationLength bytes, past which they are counted as errors and thrown
+	away.
+
+	It also keeps each option's negotiation state for both sides of the connection, using
+	the Q method of RFC 1143 without the queue bits, so a request is answered once and a
+	client that repeats itself can't start a negotiation loop. What to agree to is up to
+	the Handler.
+	\note A parser belongs to one connection and is not locked; only the driver thread
+		may use it.
+*/
+class TelnetParser {
+public:
+	/// decides what to agree to and hears about what the client sends
+	class Handler {
+	public:
+		virtual ~Handler() {}
+
+		/// the client asked us to turn \a option on (DO); return true to agree
+		virtual bool telnetAcceptLocal(const unsigned char option) = 0;
+		/// the client offered to turn \a option on (WILL); return true to agree
+		virtual bool telnetAcceptRemote(const unsigned char option) = 0;
+		/// \a option was turned on or off, on our side if \a local or the client's otherwise
+		/** Anything appended to \a reply is sent after the answer that turned it on */
+		virtual void telnetOptionChanged(const unsigned char option, const bool local, const bool enabled, std::string &reply) = 0;
+		/// a whole subnegotiation arrived, with IAC IAC already unescaped
+		virtual void telnetSubnegotiation(const unsigned char option, const std::string &data, std::string &reply) = 0;
+	};
+
+	TelnetParser();
+
+	void parse(const char *data, const unsigned long length, std::string &text, std::string &reply, Handler &handler);
+
+	bool enableLocal(const unsigned char option, std::string &reply);
+	bool disableLocal(const unsigned char option, std::string &reply);
+	bool enableRemote(const unsigned char option, std::string &reply);
+	bool disableRemote(const unsigned char option, std::string &reply);
+
+	void restoreLocal(const unsigned char option);
+	void restoreRemote(const unsigned char option);
+
+	/// true if we have agreed to \a option
+	bool isLocalEnabled(const unsigned char option) const { return mLocal[option] == OptionYes; }
+	/// true if the client has agreed to \a option
+	bool isRemoteEnabled(const unsigned char option) const { return mRemote[option] == OptionYes; }
+
+	/// gets how many malformed or oversized sequences have been thrown away
+	unsigned long getProtocolErrors() const { return mProtocolErrors; }
+
+	static void escape(std::string &text);
+	static void appendSubnegotiation(std::string &out, const unsigned char option, const std::string &data);
+
+private:
+	/// where in a telnet sequence the last byte left us
+	typedef enum {
+		DataState = 0,	///< plain text
+		IacState,		///< after IAC
+		WillState,		///< after IAC WILL, waiting for the option
+		WontState,		///< after IAC WONT
+		DoState,		///< after IAC DO
+		DontState,		///< after IAC DONT
+		SbState,		///< after IAC SB, waiting for the option
+		SbDataState,	///< inside a subnegotiation
+		SbIacState		///< after IAC inside a subnegotiation
+	} ParserState;
+
+	/// one side of an option, as RFC 1143 names the states
+	typedef enum {
+		OptionNo = 0,	///< off
+		OptionYes,		///< on
+		OptionWantNo,	///< we asked for off and are waiting for the answer
+		OptionWantYes	///< we asked for on and are waiting for the answer
+	} OptionState;
+
+	ParserState mState;				///< where the last byte left us
+	unsigned char mSbOption;		///< the option being subnegotiated
+	std::string mSubnegotiation;	///< the subnegotiation collected so far
+	bool mSbOverflow;				///< true if the subnegotiation outgrew kMaxTelnetSubnegotiationLength
+	unsigned long mProtocolErrors;	///< malformed or oversized sequences thrown away
+
+	unsigned char mLocal[256];		///< our side of every option, as OptionState
+	unsigned char mRemote[256];		///< the client's side of every option, as OptionState
+
+	void negotiate(const ParserState command, const unsigned char option, std::string &reply, Handler &handler);
+
+	static void appendCommand(std::string &out, const unsigned char command, const unsigned char option);
+};
+
+#endif // MUD_TELNET_PARSER_H
@@ -1,5 +1,6 @@
 #include <string>
 #include <vector>
+#include <set>
 #include <sstream>
 
 #include <assert.h>
@@ -12,6 +13,8 @@
 #include "thread_functions.h"
 #include "commandHandler.h"
 #include "player.h"
+#include "timer.h"
+#include "traceRecorder.h"
 
 #include "global.h"
 
@@ -32,20 +35,62 @@ void thread_driver_func() {
 
 	fd_set fdset;
 
+	// connections over their input rate, left out of select() until they may read again
+	std::set<int> paused;
+
 	// set a timeout?
 	tv.tv_sec = 0;
 	tv.tv_usec = SOCKET_TIME_RESOLUTION;
 
+	glob.watchdog.enter(Watchdog::DriverThread);
+	glob.trace.nameThread("driver");
+
 	while(glob.shutdownMUD == false) {
+		glob.watchdog.stamp(Watchdog::DriverThread);
+
+		// a hot reboot is handing the sockets over; leave them alone until it is done
+		if(glob.hotReboot.isDriverHeld()) {
+			glob.watchdog.setActivity(Watchdog::DriverThread, "held for a hot reboot");
+			glob.hotReboot.driverWaiting();
+			usleep(SOCKET_TIME_RESOLUTION);
+			continue;
+		}
+
+		glob.watchdog.setActivity(Watchdog::DriverThread, "waiting in select()");
+
 		glob.driver.copy_fdset(&fdset);
 
+		if(!paused.empty()) {
+			unsigned long long now = Timer::now();
+
+			for(std::set<int>::iterator it = paused.begin(); it != paused.end(); ) {
+				Player::PlayerPointer player = glob.playerDatabase.getPlayer(*it);
+
+				if(player && !player->resumeInput(now)) {
+					glob.log.warn(boost::format("Driver Thread: Player %1% on descriptor %2% flooded its command queue") % player->getName() % player->getFd());
+					glob.playerDatabase.remove(player);
+					player.reset();
+				}
+
+				if(player && player->isInputPaused(now)) {
+					FD_CLR(*it, &fdset);
+					++it;
+				} else {
+					paused.erase(it++);
+				}
+			}
+		}
+
 		result = select(glob.driver.get_fdmax(), &fdset, NULL, NULL, &tv);
 
 		// some OS's (like linux) will modify tv to reflect leftover time, so we repair it
 		tv.tv_sec = 0;
 		tv.tv_usec = SOCKET_TIME_RESOLUTION;
 
-		if(result == -1) {
+		if(result == -1 && errno == EINTR) {
+			// a signal (such as the watchdog's) interrupted us, just try again
+			continue;
+		} else if(result == -1) {
 			std::stringstream s;
 			switch(errno) {
 			case EBADF:
@@ -77,6 +122,8 @@ void thread_driver_func() {
 			// did we get a new connection?
 			if(FD_ISSET(glob.driver.get_socket_fd(), &fdset)) {
 				glob.log.debug("Driver Thread: New incoming connection");
+				glob.watchdog.setActivity(Watchdog::DriverThread, "accepting a new connection");
+				TraceSpan acceptSpan(glob.trace, "net", "SocketDriver::new_connection");
 				glob.driver.new_connection();
 				continue;
 			}
@@ -91,6 +138,8 @@ void thread_driver_func() {
 				}
 
 				if(FD_ISSET(player->getFd(), &fdset)) {
+					glob.watchdog.setActivity(Watchdog::DriverThread, "reading from a client", NULL, player->getFd());
+
 					if(!player->Read()) {
 						// can't read from the player, although we think the connection is open
 						// this happens if you escape a telnet session and issue telnet a 'quit' command
@@ -108,6 +157,8 @@ void thread_driver_func() {
 					if(!player->Flush()) {
 						glob.log.error("Player can't be flushed, removing object");
 						glob.playerDatabase.remove(player);
+					} else if(player->isInputPaused(Timer::now())) {
+						paused.insert(player->getFd());
 					}
 				} // if FD_ISSET
 			} // for() polling loop
@@ -131,7 +182,13 @@ void *thread_process_func(void *arg) {
 	unsigned long shortestProcessingTime = 999999999; // an arbitrarily large magic number
 	unsigned long longestProcessingTime = 0; // the not-arbitrary smallest unsigned long value
 
+	glob.watchdog.enter(Watchdog::ProcessThread);
+	glob.trace.nameThread("process");
+
 	while(glob.shutdownMUD == false) {
+		glob.watchdog.stamp(Watchdog::ProcessThread);
+		glob.watchdog.setActivity(Watchdog::ProcessThread, "sleeping");
+
 		gettimeofday(&currentTime, NULL);
 
 		// if we haven't waited long enough, go to sleep
@@ -157,12 +214,43 @@ void *thread_process_func(void *arg) {
 		// reset sleep counter
 		lastTime = currentTime;
 
+		Timer tickTimer;
+		bool heartbeatRan = false;
+
 		if(heartbeatCheck(&currentTime, &lastHeartbeat)) {
+			Timer heartbeatTimer;
+			TraceSpan heartbeatSpan(glob.trace, "heartbeat", "heartbeat");
 			heartbeat();
+			glob.statEngine.recordTime(StatEngine::HeartbeatTimer, heartbeatTimer.elapsed());
 			lastHeartbeat = currentTime;
+			heartbeatRan = true;
 		}
-		
+
+		Timer commandsTimer;
+		glob.watchdog.setActivity(Watchdog::ProcessThread, "processing commands");
 		glob.playerDatabase.processCommands();
+		unsigned long commandsTime = commandsTimer.elapsed();
+		glob.statEngine.recordTime(StatEngine::TickCommandsTimer, commandsTime);
+
+		if(commandsTime > 0 && glob.trace.isEnabled()) {
+			glob.trace.span("tick", "processCommands", Timer::now() - commandsTime, commandsTime);
+		}
+
+		// compressed connections hold their output until the end of the tick
+		glob.playerDatabase.flushOutput();
+
+		// a hot reboot waits for the tick's output, including the command that asked for it
+		if(glob.hotReboot.isRequested()) {
+			glob.watchdog.setActivity(Watchdog::ProcessThread, "hot reboot");
+			glob.hotReboot.execute();
+		}
+
+		unsigned long tickTime = tickTimer.elapsed();
+		glob.statEngine.recordTime(StatEngine::TickTimer, tickTime);
+
+		if(tickTime > TIME_RESOLUTION) {
+			reportTickOverrun(tickTime, heartbeatRan);
+		}
 /*
 		for(int i=0; i <= glob.playerDatabase.getHighestFd(); ++i) {
 			Player::PlayerPointer player = glob.playerDatabase.getPlayer(i);
@@ -226,9 +314,119 @@ bool heartbeatCheck(struct timeval *current, struct timeval *lastHeartbeat) {
 */
 void heartbeat() {
 	glob.log.debug("Calling heartbeat");
-	glob.eventDaemon.processEvents();
-	glob.playerDatabase.callHeartbeats();
-	glob.zoneDaemon.heartbeat();
+
+	// pick up any run-time changes to the log rate limits, and report quiet call sites
+	glob.log.setThrottle(glob.Config.getIntValue("LogThrottleBurst"), glob.Config.getIntValue("LogThrottleInterval"));
+	glob.log.flushThrottled();
+
+	if(glob.dumpTrace) {
+		glob.dumpTrace = false;
+		std::string file = glob.trace.dumpRecent(TRACE_DUMP_SECONDS);
+
+		if(file.empty()) {
+			glob.log.error("heartbeat(): Could not dump the flight recorder");
+		} else {
+			glob.log.info(boost::format("heartbeat(): Flight recorder dumped to %1%") % file);
+		}
+	}
+
+	Timer phaseTimer;
+	glob.watchdog.setActivity(Watchdog::ProcessThread, "heartbeat: events");
+	{
+		TraceSpan span(glob.trace, "heartbeat", "events");
+		glob.eventDaemon.processEvents();
+	}
+	glob.statEngine.recordTime(StatEngine::HeartbeatEventsTimer, phaseTimer.elapsed());
+
+	phaseTimer.reset();
+	glob.watchdog.setActivity(Watchdog::ProcessThread, "heartbeat: players");
+	{
+		TraceSpan span(glob.trace, "heartbeat", "players");
+		glob.playerDatabase.callHeartbeats();
+	}
+	glob.statEngine.recordTime(StatEngine::HeartbeatPlayersTimer, phaseTimer.elapsed());
+
+	phaseTimer.reset();
+	{
+		TraceSpan span(glob.trace, "heartbeat", "zones");
+		glob.zoneDaemon.heartbeat();
+	}
+	glob.statEngine.recordTime(StatEngine::HeartbeatZonesTimer, phaseTimer.elapsed());
+
+	glob.banMap.heartbeat();
+
+	glob.watchdog.setActivity(Watchdog::ProcessThread, "heartbeat: idle connections");
+	glob.reaper.heartbeat();
+
+	updateGauges();
+}
+
+/// logs where the time went in a tick that took too long
+/** This function is called when one pass of the process thread took longer than
+	TIME_RESOLUTION. It breaks the tick down into its phases, using the times just
+	recorded in the StatEngine, so the log shows which phase (and which zone) to blame.
+	@param tickTime how long the tick took, in microseconds
+	@param heartbeatRan true if heartbeat() was called during this tick
+*/
+void reportTickOverrun(const unsigned long tickTime, const bool heartbeatRan) {
+	glob.statEngine.addTickOverrun();
+
+	if(!glob.log.throttle("reportTickOverrun")) {
+		return;
+	}
+
+	std::stringstream s;
+	s << boost::format("Process Thread: tick took %1% microseconds (commands %2%") % tickTime % glob.statEngine.getLastTime(StatEngine::TickCommandsTimer);
+
+	if(heartbeatRan) {
+		s << boost::format(", heartbeat %1%: events %2%, players %3%, zones %4%, slowest zone %5% at %6%")
+			% glob.statEngine.getLastTime(StatEngine::HeartbeatTimer)
+			% glob.statEngine.getLastTime(StatEngine::HeartbeatEventsTimer)
+			% glob.statEngine.getLastTime(StatEngine::HeartbeatPlayersTimer)
+			% glob.statEngine.getLastTime(StatEngine::HeartbeatZonesTimer)
+			% glob.zoneDaemon.getSlowestZone()
+			% glob.zoneDaemon.getSlowestZoneTime();
+	}
+
+	s << ")";
+	glob.log.warn(s.str());
+}
+
+/// asks for the flight recorder to be dumped
+/** This is the SIGUSR1 handler. Writing the file isn't safe in a signal handler, so
+	it only sets a flag; the next heartbeat() does the work.
+	@param sig ignored
+*/
+void requestTraceDump(int sig) {
+	glob.dumpTrace = true;
+}
+
+/// publishes point-in-time game state to the StatEngine
+/** This function counts things that only the process thread may safely look at
+	(players, events, dirty rooms) and stores the results as StatEngine gauges, where
+	the metrics thread can read them. It also refreshes the MemoryAccount estimates.
+*/
+void updateGauges() {
+	glob.statEngine.setGauge(StatEngine::ConnectionsClosedGauge, glob.playerDatabase.getNumberOfConnections(Connection::ConnState_Closed));
+	glob.statEngine.setGauge(StatEngine::ConnectionsLoginGauge, glob.playerDatabase.getNumberOfConnections(Connection::ConnState_Login));
+	glob.statEngine.setGauge(StatEngine::ConnectionsPasswordGauge, glob.playerDatabase.getNumberOfConnections(Connection::ConnState_Password));
+	glob.statEngine.setGauge(StatEngine::ConnectionsCreateGauge, glob.playerDatabase.getNumberOfConnections(Connection::ConnState_Create));
+
+	long playing = glob.playerDatabase.getNumberOfConnections(Connection::ConnState_Play);
+	glob.statEngine.setGauge(StatEngine::ConnectionsPlayingGauge, playing);
+	glob.statEngine.setGauge(StatEngine::PlayersGauge, playing);
+
+	glob.statEngine.setGauge(StatEngine::EventQueueGauge, glob.eventDaemon.getNumberOfEvents());
+	glob.statEngine.setGauge(StatEngine::DirtyRoomsGauge, glob.zoneDaemon.getTotalNumberOfChangedRooms());
+	glob.statEngine.setGauge(StatEngine::RoomsGauge, glob.zoneDaemon.getTotalNumberOfRooms());
+	glob.statEngine.setGauge(StatEngine::CompressedConnectionsGauge, ClientSocket::getCompressors());
+	glob.statEngine.setGauge(StatEngine::CompressorMemoryGauge, ClientSocket::getCompressorMemory());
+
+	// memory that isn't counted allocation by allocation is estimated here
+	MemoryAccount::setEstimate(MemoryAccount::NetworkTag, glob.playerDatabase.getBufferedBytes(), glob.playerDatabase.getNumberOfConnections() * 2);
+	MemoryAccount::setEstimate(MemoryAccount::EventsTag, glob.eventDaemon.getMemoryUsage(), glob.eventDaemon.getNumberOfEvents());
+	MemoryAccount::setEstimate(MemoryAccount::LogTag, glob.trace.getMemoryUsage() + glob.statEngine.getMemoryUsage(), TRACE_BUFFER_EVENTS);
+	MemoryAccount::setEstimate(MemoryAccount::CachesTag, glob.zoneDaemon.getMapMemoryUsage(), glob.zoneDaemon.getNumberOfZones());
 }
 
 /// this thread saves all the rooms
@@ -239,11 +437,16 @@ void heartbeat() {
 	\return nothing
 */
 void *thread_saveRooms_func(void *arg) {
+	glob.trace.nameThread("save");
+
 	while(!glob.shutdownMUD) {
 		if(glob.saveRooms) {
 			glob.log.info("Save thread is saving rooms...");
+			Timer saveTimer;
 			glob.zoneDaemon.saveAllZones();
-			glob.log.info("Save thread is done saving rooms");
+			unsigned long elapsed = saveTimer.elapsed();
+			glob.statEngine.recordTime(StatEngine::SaveTimer, elapsed);
+			glob.log.info(boost::format("Save thread is done saving rooms (%1% microseconds)") % elapsed);
 			glob.saveRooms = false;
 		}
 
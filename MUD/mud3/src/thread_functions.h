@@ -18,6 +18,9 @@ unsigned long napTime(struct timeval *current, struct timeval *last);
 // this is for checking on heartbeat functions
 bool heartbeatCheck(struct timeval *current, struct timeval *lastHeartbeat);
 void heartbeat();
+void updateGauges();
+void reportTickOverrun(const unsigned long tickTime, const bool heartbeatRan);
+void requestTraceDump(int sig);
 
 void handleLogin(Player::PlayerPointer player, const std::string &command);
 
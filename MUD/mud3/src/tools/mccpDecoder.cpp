@@ -0,0 +1,108 @@
+#include <cstring>
+#include <arpa/telnet.h>
+
+#include "mccpDecoder.h"
+
+/// the telnet option number for MCCP2
+static const unsigned char kCompress2 = 86;
+
+/// the server's offer, IAC WILL COMPRESS2
+static const char kOffer[] = { (char)IAC, (char)WILL, (char)kCompress2 };
+
+/// the start of compression, IAC SB COMPRESS2 IAC SE
+static const char kStart[] = { (char)IAC, (char)SB, (char)kCompress2, (char)IAC, (char)SE };
+
+/// checks whether \a tail ends with the \a length bytes at \a sequence
+static bool endsWith(const std::string &tail, const char *sequence, const unsigned long length) {
+	return tail.length() >= length && tail.compare(tail.length() - length, length, sequence, length) == 0;
+}
+
+/// Constructor
+MccpDecoder::MccpDecoder() {
+	memset(&mStream, 0, sizeof(mStream));
+	mCompressing = false;
+	mOffered = false;
+}
+
+/// Destructor
+MccpDecoder::~MccpDecoder() {
+	if(mCompressing) {
+		inflateEnd(&mStream);
+	}
+}
+
+/// decodes bytes read from the server
+/** @param data the bytes as they came off the socket
+	@param length how many bytes
+	@param[out] out the decoded bytes are appended here
+	\return false if the compressed stream is corrupt
+*/
+bool MccpDecoder::decode(const char *data, unsigned long length, std::string &out) {
+	unsigned long i = 0;
+
+	while(i < length) {
+		if(!mCompressing) {
+			char c = data[i++];
+			out += c;
+
+			mTail += c;
+			if(mTail.length() > sizeof(kStart)) {
+				mTail.erase(0, 1);
+			}
+
+			if(endsWith(mTail, kOffer, sizeof(kOffer))) {
+				mOffered = true;
+			} else if(endsWith(mTail, kStart, sizeof(kStart))) {
+				memset(&mStream, 0, sizeof(mStream));
+
+				if(inflateInit(&mStream) != Z_OK) {
+					return false;
+				}
+
+				mCompressing = true;
+				mTail.clear();
+			}
+
+			continue;
+		}
+
+		char chunk[16384];
+		int result;
+
+		mStream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data + i));
+		mStream.avail_in = length - i;
+
+		// keep going while the chunk fills up, or output would be left inside zlib
+		do {
+			mStream.next_out = reinterpret_cast<Bytef *>(chunk);
+			mStream.avail_out = sizeof(chunk);
+
+			result = inflate(&mStream, Z_SYNC_FLUSH);
+
+			if(result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+				return false;
+			}
+
+			out.append(chunk, sizeof(chunk) - mStream.avail_out);
+		} while(result != Z_STREAM_END && mStream.avail_out == 0);
+
+		i = length - mStream.avail_in;
+
+		if(result == Z_STREAM_END) {
+			// the server stopped compressing; anything left is plain again
+			inflateEnd(&mStream);
+			mCompressing = false;
+		}
+	}
+
+	return true;
+}
+
+/// checks whether the server has offered compression since the last call
+/** \return true once for each IAC WILL COMPRESS2 the server sends
+*/
+bool MccpDecoder::takeOffer() {
+	bool offered = mOffered;
+	mOffered = false;
+	return offered;
+}
@@ -0,0 +1,36 @@
+#ifndef MUD_MCCPDECODER_H
+#define MUD_MCCPDECODER_H
+
+#include <string>
+#include <zlib.h>
+
+/// undoes MCCP2 compression on the client side of a connection
+/** Feed everything read from the server to decode(). Until the server sends
+	IAC SB COMPRESS2 IAC SE the bytes pass straight through; after it they are inflated,
+	until the compressed stream ends and plain bytes follow again. The start marker is
+	passed through too, so the output is exactly what the server's traffic capture hashed.
+	Both the offer and the marker are recognized even when a read splits them.
+*/
+class MccpDecoder {
+public:
+	MccpDecoder();
+	~MccpDecoder();
+
+	bool decode(const char *data, unsigned long length, std::string &out);
+
+	bool takeOffer();
+
+	/// true while the server's output is compressed
+	bool isCompressing() const { return mCompressing; }
+
+private:
+	z_stream mStream;		///< the inflate stream, valid while mCompressing
+	bool mCompressing;		///< true between the start marker and the end of the stream
+	bool mOffered;			///< set when IAC WILL COMPRESS2 arrives, cleared by takeOffer()
+	std::string mTail;		///< the last few plain bytes, for spotting split sequences
+
+	MccpDecoder(const MccpDecoder &);
+	MccpDecoder &operator=(const MccpDecoder &);
+};
+
+#endif // MUD_MCCPDECODER_H
@@ -0,0 +1,524 @@
+/** @file
+	mudbench: an end-to-end benchmark of a server and its world.
+
+	This program starts the server, times how long it takes to start accepting connections,
+	and records its resident memory. It then logs in as an admin and times a full world save
+	(<tt>save world</tt>), runs tools/mudbot against the server for a while, and reads the
+	heartbeat, tick and command timings from the metrics endpoint. Finally it shuts the server
+	down and records how long that took, including the final save.
+
+	Point it at a world written by tools/worldgen, which also creates the admin character:
+	\code
+	cp -r data /tmp/bench/data && mkdir /tmp/bench/bin
+	tools/worldgen -z 8 -r 2000 -k 10 -m /tmp/bench/data
+	tools/mudbench -x ../bin/mud -C /tmp/bench/bin -c 200 -d 60 > results.txt
+	\endcode
+	The server finds its data through \c ../data, so \c -C must be a directory next to the
+	data directory. Results are printed as \c key \c value lines; mudbot's results get a
+	\c load_ prefix. With \c -R, a traffic capture is also replayed through tools/mudreplay
+	after the bots finish, and its results get a \c replay_ prefix.
+*/
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "timer.h"
+
+/// the run's settings, filled in from the command line
+struct Options {
+	std::string server;		///< the server binary
+	std::string directory;	///< the directory to run the server in
+	std::string bot;		///< the mudbot binary
+	int port;				///< the game port
+	int metricsPort;		///< the metrics port, or 0 to skip metrics
+	std::string admin;		///< the admin character
+	std::string password;	///< the admin's password
+	int bots;				///< mudbot connections
+	int duration;			///< mudbot run time, in seconds
+	int interval;			///< mudbot command interval, in milliseconds
+	std::string mix;		///< mudbot command mix, or empty for its default
+	std::string replay;		///< the mudreplay binary
+	std::string capture;	///< capture file to replay after the bots, or empty for none
+	int bootTimeout;		///< how long to wait for the server to start, in seconds
+};
+
+/// prints usage information
+static void usage(const char *program) {
+	std::cerr << "Usage: " << program << " -x server -C directory [options]\n"
+		<< "  -x server     the server binary\n"
+		<< "  -C directory  where to run the server; its ../data is the world\n"
+		<< "  -B mudbot     the mudbot binary (mudbot next to this program)\n"
+		<< "  -p port       game port (2600)\n"
+		<< "  -M port       metrics port, 0 to skip (9100)\n"
+		<< "  -A name       admin character (benchadmin)\n"
+		<< "  -P password   admin password (benchmark)\n"
+		<< "  -c bots       mudbot connections (50)\n"
+		<< "  -d seconds    mudbot run time (30)\n"
+		<< "  -i msec       mudbot command interval (2000)\n"
+		<< "  -m mix        mudbot command mix\n"
+		<< "  -R capture    replay a traffic capture after the bots finish\n"
+		<< "  -X mudreplay  the mudreplay binary (mudreplay next to this program)\n"
+		<< "  -t seconds    how long to wait for the server to start (600)\n";
+}
+
+/// connects to a local port
+/** \return a connected socket, or -1
+*/
+static int connectTo(const int port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if(fd == -1) {
+		return -1;
+	}
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if(connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/// reads from a socket until some text arrives
+/** @param fd the socket
+	@param marker the text to wait for
+	@param timeout how long to wait, in seconds
+	@param[out] text everything read
+	\return true if the marker arrived in time
+*/
+static bool expect(const int fd, const std::string &marker, const int timeout, std::string &text) {
+	unsigned long long deadline = Timer::now() + timeout * 1000000ULL;
+	char buffer[4096];
+
+	text.clear();
+
+	while(text.find(marker) == std::string::npos) {
+		unsigned long long now = Timer::now();
+
+		if(now >= deadline) {
+			return false;
+		}
+
+		struct timeval wait;
+		wait.tv_sec = (deadline - now) / 1000000;
+		wait.tv_usec = (deadline - now) % 1000000;
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+
+		ssize_t bytes = read(fd, buffer, sizeof(buffer));
+
+		if(bytes <= 0) {
+			return false;
+		}
+
+		text.append(buffer, bytes);
+	}
+
+	return true;
+}
+
+/// sends a line to the server
+static bool sendLine(const int fd, const std::string &line) {
+	std::string data = line + "\r\n";
+	return write(fd, data.data(), data.length()) == static_cast<ssize_t>(data.length());
+}
+
+/// reads a value in kB from /proc/pid/status
+static long readStatus(const pid_t pid, const std::string &field) {
+	std::stringstream path;
+	path << "/proc/" << pid << "/status";
+
+	std::ifstream in(path.str().c_str());
+	std::string line;
+
+	while(std::getline(in, line)) {
+		if(line.compare(0, field.length() + 1, field + ":") == 0) {
+			return atol(line.substr(field.length() + 1).c_str());
+		}
+	}
+
+	return -1;
+}
+
+/// fetches the metrics page
+/** \return every sample on the page, by metric name and labels
+*/
+static std::map<std::string, double> scrapeMetrics(const int port) {
+	std::map<std::string, double> samples;
+	int fd = connectTo(port);
+
+	if(fd == -1) {
+		return samples;
+	}
+
+	std::string page;
+
+	if(sendLine(fd, "GET /metrics HTTP/1.0\r\n")) {
+		char buffer[16384];
+		ssize_t bytes;
+
+		while((bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+			page.append(buffer, bytes);
+		}
+	}
+
+	close(fd);
+
+	std::stringstream s(page);
+	std::string line;
+
+	while(std::getline(s, line)) {
+		if(line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		std::string::size_type space = line.rfind(' ');
+
+		if(space != std::string::npos) {
+			samples[line.substr(0, space)] = atof(line.substr(space + 1).c_str());
+		}
+	}
+
+	return samples;
+}
+
+/// prints a metric if the server reported it
+static void printMetric(const std::map<std::string, double> &samples, const std::string &key, const std::string &metric) {
+	std::map<std::string, double>::const_iterator pos = samples.find(metric);
+
+	if(pos != samples.end()) {
+		std::cout << key << " " << pos->second << "\n";
+	}
+}
+
+/// prints a timer's quantiles if the server reported them
+static void printTimer(const std::map<std::string, double> &samples, const std::string &key, const std::string &timer) {
+	std::string metric = "mud_" + timer + "_duration_microseconds";
+
+	printMetric(samples, key + "_us_p50", metric + "{quantile=\"0.5\"}");
+	printMetric(samples, key + "_us_p95", metric + "{quantile=\"0.95\"}");
+	printMetric(samples, key + "_us_p99", metric + "{quantile=\"0.99\"}");
+	printMetric(samples, key + "_us_max", metric + "_max");
+	printMetric(samples, key + "_count", metric + "_count");
+}
+
+/// runs a tool and prints its key/value results with a prefix
+/** @param args the program followed by its arguments
+	@param prefix put in front of every line the tool prints
+	\return true if the tool exited successfully
+*/
+static bool runTool(const std::vector<std::string> &args, const std::string &prefix) {
+	int pipeFds[2];
+
+	if(pipe(pipeFds) == -1) {
+		return false;
+	}
+
+	pid_t pid = fork();
+
+	if(pid == -1) {
+		return false;
+	}
+
+	if(pid == 0) {
+		std::vector<char *> argv;
+
+		for(std::vector<std::string>::const_iterator it = args.begin(); it != args.end(); ++it) {
+			argv.push_back(const_cast<char *>(it->c_str()));
+		}
+		argv.push_back(NULL);
+
+		dup2(pipeFds[1], STDOUT_FILENO);
+		close(pipeFds[0]);
+		close(pipeFds[1]);
+		execv(args[0].c_str(), &argv[0]);
+		std::cerr << "Cannot run " << args[0] << ": " << strerror(errno) << "\n";
+		_exit(127);
+	}
+
+	close(pipeFds[1]);
+
+	std::string output;
+	char buffer[4096];
+	ssize_t bytes;
+
+	while((bytes = read(pipeFds[0], buffer, sizeof(buffer))) > 0) {
+		output.append(buffer, bytes);
+	}
+
+	close(pipeFds[0]);
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+
+	std::stringstream lines(output);
+	std::string line;
+
+	while(std::getline(lines, line)) {
+		if(!line.empty()) {
+			std::cout << prefix << line << "\n";
+		}
+	}
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/// runs mudbot and prints its results with a load_ prefix
+static bool runBots(const Options &options) {
+	std::vector<std::string> args;
+	std::stringstream s;
+
+	args.push_back(options.bot);
+	s << options.port; args.push_back("-p"); args.push_back(s.str()); s.str("");
+	s << options.bots; args.push_back("-c"); args.push_back(s.str()); s.str("");
+	s << options.duration; args.push_back("-d"); args.push_back(s.str()); s.str("");
+	s << options.interval; args.push_back("-i"); args.push_back(s.str()); s.str("");
+
+	if(!options.mix.empty()) {
+		args.push_back("-m");
+		args.push_back(options.mix);
+	}
+
+	return runTool(args, "load_");
+}
+
+/// replays the capture in fast mode and prints the results with a replay_ prefix
+static bool runReplay(const Options &options) {
+	std::vector<std::string> args;
+	std::stringstream s;
+
+	args.push_back(options.replay);
+	args.push_back("-f");
+	s << options.port; args.push_back("-p"); args.push_back(s.str());
+	args.push_back(options.capture);
+
+	return runTool(args, "replay_");
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	options.port = 2600;
+	options.metricsPort = 9100;
+	options.admin = "benchadmin";
+	options.password = "benchmark";
+	options.bots = 50;
+	options.duration = 30;
+	options.interval = 2000;
+	options.bootTimeout = 600;
+
+	std::string self = argv[0];
+	std::string::size_type slash = self.rfind('/');
+	std::string toolDirectory = (slash == std::string::npos ? std::string(".") : self.substr(0, slash));
+	options.bot = toolDirectory + "/mudbot";
+	options.replay = toolDirectory + "/mudreplay";
+
+	int c;
+
+	while((c = getopt(argc, argv, "x:C:B:p:M:A:P:c:d:i:m:R:X:t:?")) != -1) {
+		switch(c) {
+			case 'x': options.server = optarg; break;
+			case 'C': options.directory = optarg; break;
+			case 'B': options.bot = optarg; break;
+			case 'p': options.port = atoi(optarg); break;
+			case 'M': options.metricsPort = atoi(optarg); break;
+			case 'A': options.admin = optarg; break;
+			case 'P': options.password = optarg; break;
+			case 'c': options.bots = atoi(optarg); break;
+			case 'd': options.duration = atoi(optarg); break;
+			case 'i': options.interval = atoi(optarg); break;
+			case 'm': options.mix = optarg; break;
+			case 'R': options.capture = optarg; break;
+			case 'X': options.replay = optarg; break;
+			case 't': options.bootTimeout = atoi(optarg); break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(options.server.empty() || options.directory.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// the server is started relative to its own directory
+	char cwd[4096];
+	if(options.server[0] != '/' && getcwd(cwd, sizeof(cwd)) != NULL) {
+		options.server = std::string(cwd) + "/" + options.server;
+	}
+	if(options.bot[0] != '/' && getcwd(cwd, sizeof(cwd)) != NULL) {
+		options.bot = std::string(cwd) + "/" + options.bot;
+	}
+	if(options.replay[0] != '/' && getcwd(cwd, sizeof(cwd)) != NULL) {
+		options.replay = std::string(cwd) + "/" + options.replay;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	if(connectTo(options.port) != -1) {
+		std::cerr << "Something is already listening on port " << options.port << "\n";
+		return 1;
+	}
+
+	unsigned long long start = Timer::now();
+	pid_t server = fork();
+
+	if(server == -1) {
+		std::cerr << "fork failed: " << strerror(errno) << "\n";
+		return 1;
+	}
+
+	if(server == 0) {
+		if(chdir(options.directory.c_str()) == -1) {
+			std::cerr << "Cannot change to " << options.directory << ": " << strerror(errno) << "\n";
+			_exit(127);
+		}
+
+		int null = open("/dev/null", O_RDWR);
+		dup2(null, STDIN_FILENO);
+		dup2(null, STDOUT_FILENO);
+
+		execl(options.server.c_str(), options.server.c_str(), (char *)NULL);
+		std::cerr << "Cannot run " << options.server << ": " << strerror(errno) << "\n";
+		_exit(127);
+	}
+
+	// wait for the game port to open
+	int fd = -1;
+
+	while(fd == -1) {
+		int status;
+
+		if(waitpid(server, &status, WNOHANG) == server) {
+			std::cerr << "The server exited during startup\n";
+			return 1;
+		}
+
+		if(Timer::now() - start > options.bootTimeout * 1000000ULL) {
+			std::cerr << "The server did not start in " << options.bootTimeout << " seconds\n";
+			kill(server, SIGKILL);
+			return 1;
+		}
+
+		fd = connectTo(options.port);
+
+		if(fd == -1) {
+			usleep(20000);
+		}
+	}
+
+	double bootSeconds = (Timer::now() - start) / 1000000.0;
+
+	std::cout << "boot_seconds " << bootSeconds << "\n";
+	std::cout << "rss_boot_kb " << readStatus(server, "VmRSS") << "\n";
+
+	// log in as the admin
+	std::string text;
+
+	if(!expect(fd, "name? ", 30, text) || !sendLine(fd, options.admin)
+			|| !expect(fd, "Password", 30, text) || !sendLine(fd, options.password)
+			|| !expect(fd, ":>", 30, text)) {
+		std::cerr << "Cannot log in as " << options.admin << "; was the world made with worldgen?\n";
+		kill(server, SIGTERM);
+		return 1;
+	}
+
+	// a full save, timed by the server
+	Timer saveTimer;
+
+	if(sendLine(fd, "save world") && expect(fd, ":>", 600, text)) {
+		std::cout << "save_world_seconds " << saveTimer.elapsed() / 1000000.0 << "\n";
+
+		std::string::size_type pos = text.find("Saved ");
+
+		if(pos != std::string::npos) {
+			std::stringstream s(text.substr(pos + 6));
+			unsigned long rooms = 0;
+			std::string word;
+			unsigned long microseconds = 0;
+			s >> rooms >> word >> word >> microseconds;
+			std::cout << "save_world_rooms " << rooms << "\n";
+			std::cout << "save_world_us " << microseconds << "\n";
+		}
+	} else {
+		std::cerr << "save world did not finish\n";
+	}
+
+	std::cout << "rss_after_save_kb " << readStatus(server, "VmRSS") << "\n";
+
+	// the load test
+	if(!runBots(options)) {
+		std::cerr << "mudbot failed\n";
+	}
+
+	if(!options.capture.empty() && !runReplay(options)) {
+		std::cerr << "mudreplay failed\n";
+	}
+
+	std::cout << "rss_after_load_kb " << readStatus(server, "VmRSS") << "\n";
+	std::cout << "rss_peak_kb " << readStatus(server, "VmHWM") << "\n";
+
+	if(options.metricsPort > 0) {
+		std::map<std::string, double> samples = scrapeMetrics(options.metricsPort);
+
+		if(samples.empty()) {
+			std::cerr << "No metrics on port " << options.metricsPort << "; is MetricsPort set?\n";
+		}
+
+		printMetric(samples, "world_load_us", "mud_world_load_microseconds");
+		printMetric(samples, "rooms", "mud_rooms");
+		printMetric(samples, "tick_overruns", "mud_tick_overruns_total");
+		printTimer(samples, "tick", "tick");
+		printTimer(samples, "heartbeat", "heartbeat");
+		printTimer(samples, "heartbeat_zones", "heartbeat_zones");
+		printTimer(samples, "heartbeat_players", "heartbeat_players");
+		printTimer(samples, "command", "command");
+		printTimer(samples, "save", "save");
+	}
+
+	// shut down, which saves everything once more
+	Timer shutdownTimer;
+	sendLine(fd, "shutdown");
+
+	int status = 0;
+	bool exited = false;
+
+	while(shutdownTimer.elapsed() < 600000000UL) {
+		if(waitpid(server, &status, WNOHANG) == server) {
+			exited = true;
+			break;
+		}
+		usleep(20000);
+	}
+
+	close(fd);
+
+	if(exited) {
+		std::cout << "shutdown_seconds " << shutdownTimer.elapsed() / 1000000.0 << "\n";
+	} else {
+		std::cerr << "The server did not shut down; killing it\n";
+		kill(server, SIGKILL);
+		waitpid(server, &status, 0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,624 @@
+/** @file
+	mudbot: a headless load generator for ForeverMUD.
+
+	This program opens many telnet connections to a running server, logs each one in
+	(creating the character the first time), and then has every bot send a random mix
+	of commands. It measures the round trip from sending a command to receiving the
+	next prompt, and reports latency percentiles, throughput and disconnects when it
+	finishes. Everything runs in one thread around epoll, so a single process can
+	drive thousands of connections.
+
+	With \c -z the bots accept the server's MCCP2 offer, and the report shows both the
+	bytes on the wire and the bytes after decompression.
+
+	Run <tt>mudbot -?</tt> for options. The summary is printed as \c key \c value lines
+	so scripts can collect it.
+	\note The server's select() loop cannot handle descriptors above FD_SETSIZE (1024),
+		so stay below about a thousand bots per server.
+*/
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <cmath>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <arpa/telnet.h>
+
+#include "histogram.h"
+#include "timer.h"
+#include "mccpDecoder.h"
+
+/// what a bot is waiting for
+typedef enum {
+	BotConnecting = 0,	///< the TCP connection is in progress
+	BotAwaitingLogin,	///< waiting for the login prompt
+	BotAwaitingReply,	///< sent the name; waiting for "create?" or "Password:"
+	BotAwaitingCreate,	///< said yes to creating the character; waiting for "Password:"
+	BotAwaitingPlay,	///< sent the password; waiting for the first game prompt
+	BotPlaying,			///< logged in and sending commands
+	BotClosed			///< disconnected
+} BotState;
+
+/// the kinds of command a bot can send
+typedef enum {
+	LookCommand = 0,
+	SayCommand,
+	MoveCommand,
+	GetCommand,
+	WhoCommand,
+	ChatCommand,
+
+	NumberOfCommandTypes
+} CommandType;
+
+/// one simulated player
+struct Bot {
+	int fd;							///< the bot's socket, or -1
+	BotState state;					///< what the bot is waiting for
+	std::string name;				///< the character name
+	std::string input;				///< text received since the last thing we matched
+	unsigned long long startedAt;	///< when the current connection or command started, in microseconds
+	unsigned long long nextCommandAt;	///< when to send the next command, in microseconds
+	bool waiting;					///< true while a command is outstanding
+	MccpDecoder *decoder;			///< undoes compression, if -z was given
+};
+
+/// the run's settings, filled in from the command line
+struct Options {
+	std::string host;		///< the server address
+	int port;				///< the server port
+	int bots;				///< how many connections to open
+	int rampRate;			///< new connections per second
+	int duration;			///< how long to run once the ramp is done, in seconds
+	int interval;			///< mean time between a bot's commands, in milliseconds
+	unsigned int seed;		///< random seed for the command mix
+	std::string prefix;		///< character name prefix
+	std::string password;	///< character password
+	std::string loginMarker;	///< text that ends the login prompt
+	std::string promptMarker;	///< text that ends the game prompt
+	bool compress;			///< accept MCCP2 compression
+	int weights[NumberOfCommandTypes];	///< relative frequency of each command type
+};
+
+/// counters for the final report
+struct Results {
+	unsigned long connectAttempts;	///< connections started
+	unsigned long connectFailures;	///< connections refused or timed out
+	unsigned long connected;		///< connections established
+	unsigned long loggedIn;			///< bots that reached the game
+	unsigned long disconnects;		///< connections the server closed on us
+	unsigned long commandsSent;		///< commands written
+	unsigned long commandsCompleted;	///< commands answered with a prompt
+	unsigned long long bytesIn;		///< bytes read
+	unsigned long long bytesDecoded;	///< bytes read, after decompression
+	unsigned long long bytesOut;	///< bytes written
+	Histogram commandLatency;		///< send-to-prompt time, in microseconds
+	Histogram loginLatency;			///< connect-to-first-prompt time, in microseconds
+};
+
+static volatile sig_atomic_t sInterrupted = 0;	///< set by SIGINT to stop early
+
+static const char *kDirections[] = { "north", "south", "east", "west", "northeast", "northwest", "southeast", "southwest", "up", "down" };
+static const char *kPhrases[] = { "hello", "anyone around?", "nice weather today", "where is the temple?", "lag check", "brb" };
+
+/// SIGINT handler
+static void interrupt(int) {
+	sInterrupted = 1;
+}
+
+/// prints usage information
+static void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]\n"
+		<< "  -h host       server address (127.0.0.1)\n"
+		<< "  -p port       server port (2600)\n"
+		<< "  -c bots       number of connections (100)\n"
+		<< "  -r rate       new connections per second (50)\n"
+		<< "  -d seconds    how long to run after all bots connect (60)\n"
+		<< "  -i msec       mean time between each bot's commands (2000)\n"
+		<< "  -m mix        command weights, eg. look:30,say:20,move:20,get:10,who:10,chat:10\n"
+		<< "  -n prefix     character name prefix, letters only (bot)\n"
+		<< "  -P password   character password (loadtest)\n"
+		<< "  -s seed       random seed (1)\n"
+		<< "  -L text       end of the login prompt (\"name? \")\n"
+		<< "  -M text       end of the game prompt (\":>\")\n"
+		<< "  -z            accept MCCP2 compression\n";
+}
+
+/// parses a command mix like look:30,say:20
+/** @param mix the text from the command line
+	@param[out] weights the weight for each CommandType
+	\return false if the mix could not be parsed
+*/
+static bool parseMix(const std::string &mix, int *weights) {
+	const char *names[NumberOfCommandTypes] = { "look", "say", "move", "get", "who", "chat" };
+
+	for(int i = 0; i < NumberOfCommandTypes; ++i) {
+		weights[i] = 0;
+	}
+
+	std::stringstream s(mix);
+	std::string item;
+
+	while(std::getline(s, item, ',')) {
+		std::string::size_type colon = item.find(':');
+
+		if(colon == std::string::npos) {
+			return false;
+		}
+
+		std::string name = item.substr(0, colon);
+		int weight = atoi(item.substr(colon + 1).c_str());
+		bool found = false;
+
+		for(int i = 0; i < NumberOfCommandTypes; ++i) {
+			if(name == names[i]) {
+				weights[i] = weight;
+				found = true;
+			}
+		}
+
+		if(!found || weight < 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// turns a bot number into a name made only of letters, since names can't contain digits
+static std::string botName(const std::string &prefix, int index) {
+	std::string suffix;
+
+	do {
+		suffix = static_cast<char>('a' + index % 26) + suffix;
+		index /= 26;
+	} while(index > 0);
+
+	return prefix + suffix;
+}
+
+/// picks the next command for a bot
+static std::string nextCommand(const Options &options) {
+	int total = 0;
+
+	for(int i = 0; i < NumberOfCommandTypes; ++i) {
+		total += options.weights[i];
+	}
+
+	int pick = total > 0 ? rand() % total : 0;
+	int type = 0;
+
+	while(type < NumberOfCommandTypes - 1 && pick >= options.weights[type]) {
+		pick -= options.weights[type];
+		++type;
+	}
+
+	const int directions = sizeof(kDirections) / sizeof(kDirections[0]);
+	const int phrases = sizeof(kPhrases) / sizeof(kPhrases[0]);
+
+	switch(type) {
+		case SayCommand:
+			return std::string("say ") + kPhrases[rand() % phrases];
+		case MoveCommand:
+			return kDirections[rand() % directions];
+		case GetCommand:
+			return "get coin";
+		case WhoCommand:
+			return "who";
+		case ChatCommand:
+			return std::string("channel chat ") + kPhrases[rand() % phrases];
+		case LookCommand:
+		default:
+			return "look";
+	}
+}
+
+/// picks an exponentially distributed delay with the given mean, so bots don't move in lockstep
+static unsigned long long thinkTime(const int meanMsec) {
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return static_cast<unsigned long long>(-log(u) * meanMsec * 1000.0);
+}
+
+/// sends a line to the server
+static bool sendLine(Bot &bot, const std::string &line, Results &results) {
+	std::string data = line + "\r\n";
+	ssize_t written = write(bot.fd, data.data(), data.length());
+
+	if(written != static_cast<ssize_t>(data.length())) {
+		return false;
+	}
+
+	results.bytesOut += written;
+	return true;
+}
+
+/// closes a bot's connection
+static void closeBot(Bot &bot, int epoll) {
+	if(bot.fd != -1) {
+		epoll_ctl(epoll, EPOLL_CTL_DEL, bot.fd, NULL);
+		close(bot.fd);
+		bot.fd = -1;
+	}
+
+	delete bot.decoder;
+	bot.decoder = NULL;
+	bot.state = BotClosed;
+}
+
+/// starts a non-blocking connection for a bot
+static bool startConnection(Bot &bot, const struct sockaddr_in &address, int epoll, const Options &options, Results &results) {
+	++results.connectAttempts;
+
+	if(options.compress) {
+		bot.decoder = new MccpDecoder;
+	}
+
+	bot.fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if(bot.fd == -1) {
+		++results.connectFailures;
+		bot.state = BotClosed;
+		return false;
+	}
+
+	fcntl(bot.fd, F_SETFL, fcntl(bot.fd, F_GETFL) | O_NONBLOCK);
+
+	int one = 1;
+	setsockopt(bot.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	bot.startedAt = Timer::now();
+	bot.state = BotConnecting;
+
+	if(connect(bot.fd, (const struct sockaddr *)&address, sizeof(address)) == -1 && errno != EINPROGRESS) {
+		++results.connectFailures;
+		closeBot(bot, epoll);
+		return false;
+	}
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+	event.data.ptr = &bot;
+	epoll_ctl(epoll, EPOLL_CTL_ADD, bot.fd, &event);
+
+	return true;
+}
+
+/// moves a bot through the login states as text arrives
+static void handleInput(Bot &bot, const Options &options, Results &results, int epoll) {
+	unsigned long long now = Timer::now();
+
+	switch(bot.state) {
+		case BotAwaitingLogin:
+			if(bot.input.find(options.loginMarker) != std::string::npos) {
+				bot.input.clear();
+				bot.state = BotAwaitingReply;
+				sendLine(bot, bot.name, results);
+			}
+			break;
+
+		case BotAwaitingReply:
+			if(bot.input.find("(y/n)") != std::string::npos) {
+				bot.input.clear();
+				bot.state = BotAwaitingCreate;
+				sendLine(bot, "y", results);
+			} else if(bot.input.find("Password") != std::string::npos) {
+				bot.input.clear();
+				bot.state = BotAwaitingPlay;
+				sendLine(bot, options.password, results);
+			} else if(bot.input.find("already logged in") != std::string::npos) {
+				closeBot(bot, epoll);
+			}
+			break;
+
+		case BotAwaitingCreate:
+			if(bot.input.find("Password") != std::string::npos) {
+				bot.input.clear();
+				bot.state = BotAwaitingPlay;
+				sendLine(bot, options.password, results);
+			}
+			break;
+
+		case BotAwaitingPlay:
+			if(bot.input.find(options.promptMarker) != std::string::npos) {
+				bot.input.clear();
+				bot.state = BotPlaying;
+				++results.loggedIn;
+				results.loginLatency.record(static_cast<unsigned long>(now - bot.startedAt));
+				bot.nextCommandAt = now + thinkTime(options.interval);
+			}
+			break;
+
+		case BotPlaying:
+			if(bot.waiting && bot.input.find(options.promptMarker) != std::string::npos) {
+				bot.waiting = false;
+				++results.commandsCompleted;
+				results.commandLatency.record(static_cast<unsigned long>(now - bot.startedAt));
+				bot.nextCommandAt = now + thinkTime(options.interval);
+			}
+			if(!bot.waiting) {
+				bot.input.clear();
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	// don't let chatter from other bots pile up while we wait for a marker
+	if(bot.input.length() > 65536) {
+		bot.input.erase(0, bot.input.length() - 4096);
+	}
+}
+
+/// prints one latency histogram as key/value lines
+static void printHistogram(const std::string &name, const Histogram &h) {
+	std::cout << name << "_count " << h.getCount() << "\n";
+	std::cout << name << "_us_mean " << h.getMean() << "\n";
+	std::cout << name << "_us_p50 " << h.getPercentile(50.0) << "\n";
+	std::cout << name << "_us_p95 " << h.getPercentile(95.0) << "\n";
+	std::cout << name << "_us_p99 " << h.getPercentile(99.0) << "\n";
+	std::cout << name << "_us_max " << h.getMax() << "\n";
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	options.host = "127.0.0.1";
+	options.port = 2600;
+	options.bots = 100;
+	options.rampRate = 50;
+	options.duration = 60;
+	options.interval = 2000;
+	options.seed = 1;
+	options.prefix = "bot";
+	options.password = "loadtest";
+	options.loginMarker = "name? ";
+	options.promptMarker = ":>";
+	options.compress = false;
+	parseMix("look:30,say:20,move:20,get:10,who:10,chat:10", options.weights);
+
+	int c;
+
+	while((c = getopt(argc, argv, "h:p:c:r:d:i:m:n:P:s:L:M:z?")) != -1) {
+		switch(c) {
+			case 'h': options.host = optarg; break;
+			case 'p': options.port = atoi(optarg); break;
+			case 'c': options.bots = atoi(optarg); break;
+			case 'r': options.rampRate = atoi(optarg); break;
+			case 'd': options.duration = atoi(optarg); break;
+			case 'i': options.interval = atoi(optarg); break;
+			case 'n': options.prefix = optarg; break;
+			case 'P': options.password = optarg; break;
+			case 's': options.seed = strtoul(optarg, NULL, 10); break;
+			case 'L': options.loginMarker = optarg; break;
+			case 'M': options.promptMarker = optarg; break;
+			case 'z': options.compress = true; break;
+			case 'm':
+				if(!parseMix(optarg, options.weights)) {
+					std::cerr << "Cannot parse command mix " << optarg << "\n";
+					return 1;
+				}
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(options.bots < 1 || options.rampRate < 1 || options.interval < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	srand(options.seed);
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(options.port);
+
+	if(inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+		std::cerr << "Host must be an IPv4 address: " << options.host << "\n";
+		return 1;
+	}
+
+	// thousands of sockets need more than the default descriptor limit
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < static_cast<rlim_t>(options.bots + 16)) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, interrupt);
+
+	int epoll = epoll_create(options.bots + 1);
+
+	if(epoll == -1) {
+		std::cerr << "epoll_create failed: " << strerror(errno) << "\n";
+		return 1;
+	}
+
+	std::vector<Bot> bots(options.bots);
+
+	for(int i = 0; i < options.bots; ++i) {
+		bots[i].fd = -1;
+		bots[i].state = BotClosed;
+		bots[i].name = botName(options.prefix, i);
+		bots[i].waiting = false;
+		bots[i].startedAt = 0;
+		bots[i].nextCommandAt = 0;
+		bots[i].decoder = NULL;
+	}
+
+	Results results;
+	results.connectAttempts = results.connectFailures = results.connected = 0;
+	results.loggedIn = results.disconnects = 0;
+	results.commandsSent = results.commandsCompleted = 0;
+	results.bytesIn = results.bytesDecoded = results.bytesOut = 0;
+
+	unsigned long long start = Timer::now();
+	unsigned long long rampEnd = start + 1000000ULL * options.bots / options.rampRate;
+	unsigned long long end = rampEnd + 1000000ULL * options.duration;
+	unsigned long long nextReport = start + 5000000ULL;
+	unsigned long long measureStart = 0;
+	unsigned long completedAtMeasureStart = 0;
+	int started = 0;
+
+	std::vector<struct epoll_event> events(256);
+	char buffer[16384];
+
+	while(!sInterrupted) {
+		unsigned long long now = Timer::now();
+
+		if(now >= end) {
+			break;
+		}
+
+		// start connections at the ramp rate
+		int due = static_cast<int>((now - start) * options.rampRate / 1000000ULL) + 1;
+
+		while(started < options.bots && started < due) {
+			startConnection(bots[started], address, epoll, options, results);
+			++started;
+		}
+
+		if(measureStart == 0 && now >= rampEnd) {
+			measureStart = now;
+			completedAtMeasureStart = results.commandsCompleted;
+		}
+
+		int ready = epoll_wait(epoll, &events[0], events.size(), 10);
+
+		for(int i = 0; i < ready; ++i) {
+			Bot &bot = *static_cast<Bot *>(events[i].data.ptr);
+
+			if(bot.state == BotConnecting) {
+				int error = 0;
+				socklen_t length = sizeof(error);
+				getsockopt(bot.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+
+				if(error != 0) {
+					++results.connectFailures;
+					closeBot(bot, epoll);
+					continue;
+				}
+
+				++results.connected;
+				bot.state = BotAwaitingLogin;
+
+				struct epoll_event event;
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLIN | EPOLLRDHUP;
+				event.data.ptr = &bot;
+				epoll_ctl(epoll, EPOLL_CTL_MOD, bot.fd, &event);
+			}
+
+			if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+				ssize_t bytes;
+
+				bool corrupt = false;
+
+				while((bytes = read(bot.fd, buffer, sizeof(buffer))) > 0) {
+					std::string::size_type before = bot.input.length();
+					results.bytesIn += bytes;
+
+					if(!bot.decoder) {
+						bot.input.append(buffer, bytes);
+					} else if(!bot.decoder->decode(buffer, bytes, bot.input)) {
+						corrupt = true;
+						break;
+					}
+
+					results.bytesDecoded += bot.input.length() - before;
+				}
+
+				if(bot.decoder && !corrupt && bot.decoder->takeOffer()) {
+					static const char accept[] = { (char)IAC, (char)DO, (char)86 };	// 86 is COMPRESS2
+
+					if(write(bot.fd, accept, sizeof(accept)) == sizeof(accept)) {
+						results.bytesOut += sizeof(accept);
+					}
+				}
+
+				if(corrupt || bytes == 0 || (bytes == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+					++results.disconnects;
+					closeBot(bot, epoll);
+					continue;
+				}
+
+				handleInput(bot, options, results, epoll);
+			}
+		}
+
+		// send commands for bots whose think time is up
+		now = Timer::now();
+
+		for(int i = 0; i < started; ++i) {
+			Bot &bot = bots[i];
+
+			if(bot.state != BotPlaying || bot.waiting || now < bot.nextCommandAt) {
+				continue;
+			}
+
+			bot.input.clear();
+			bot.startedAt = now;
+			bot.waiting = true;
+
+			if(sendLine(bot, nextCommand(options), results)) {
+				++results.commandsSent;
+			} else {
+				++results.disconnects;
+				closeBot(bot, epoll);
+			}
+		}
+
+		if(now >= nextReport) {
+			nextReport += 5000000ULL;
+			std::cerr << "[" << (now - start) / 1000000ULL << "s] connected " << results.connected
+				<< ", playing " << results.loggedIn << ", commands " << results.commandsCompleted
+				<< ", p99 " << results.commandLatency.getPercentile(99.0) << "us, disconnects "
+				<< results.disconnects << "\n";
+		}
+	}
+
+	unsigned long long finished = Timer::now();
+
+	for(int i = 0; i < started; ++i) {
+		closeBot(bots[i], epoll);
+	}
+	close(epoll);
+
+	double measured = measureStart ? (finished - measureStart) / 1000000.0 : 0.0;
+	double throughput = measured > 0.0 ? (results.commandsCompleted - completedAtMeasureStart) / measured : 0.0;
+
+	std::cout << "bots " << options.bots << "\n";
+	std::cout << "elapsed_seconds " << (finished - start) / 1000000.0 << "\n";
+	std::cout << "connect_attempts " << results.connectAttempts << "\n";
+	std::cout << "connect_failures " << results.connectFailures << "\n";
+	std::cout << "connected " << results.connected << "\n";
+	std::cout << "logged_in " << results.loggedIn << "\n";
+	std::cout << "disconnects " << results.disconnects << "\n";
+	std::cout << "commands_sent " << results.commandsSent << "\n";
+	std::cout << "commands_completed " << results.commandsCompleted << "\n";
+	std::cout << "commands_per_second " << throughput << "\n";
+	std::cout << "bytes_in " << results.bytesIn << "\n";
+	std::cout << "bytes_in_decoded " << results.bytesDecoded << "\n";
+	std::cout << "bytes_out " << results.bytesOut << "\n";
+	printHistogram("command_latency", results.commandLatency);
+	printHistogram("login_latency", results.loginLatency);
+
+	return 0;
+}
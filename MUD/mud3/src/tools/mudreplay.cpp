@@ -0,0 +1,631 @@
+/** @file
+	mudreplay: plays a traffic capture back into a server.
+
+	The server records a capture when the \c CaptureFile config string is set (see
+	TrafficCapture). This program opens one connection for every connection in the capture
+	and sends what each client sent. There are two modes:
+	- timed (the default), which keeps the recorded gaps, optionally sped up with \c -x
+	- fast (\c -f), which sends the next recorded input as soon as the server has finished
+	  answering the previous one, one input at a time across all connections
+
+	Fast mode is the more repeatable of the two, because the order in which the server sees
+	input never depends on timing. Start the server from a copy of the data directory taken
+	when the capture began, with \c RandomSeed set to the seed the capture recorded.
+
+	When the run finishes, the output each connection received is hashed the same way the
+	server hashed it during capture. The report gives response latency percentiles (input
+	sent to first byte back) and throughput as \c key \c value lines, and compares the hashes
+	with the capture. Use \c -o to save the results and \c -b to compare a later run against
+	them. This is the usual way to check that an optimization didn't change what players
+	see. The exit status is 1 if any hash differs from the baseline.
+
+	Connections that accepted MCCP2 compression during capture accept it again here, since
+	the recorded input contains the client's IAC DO COMPRESS2. Output is always decompressed
+	before hashing, because the server hashes what it sends before compressing it.
+*/
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "histogram.h"
+#include "timer.h"
+#include "trafficCapture.h"
+#include "mccpDecoder.h"
+
+/// the kinds of record in a capture
+typedef enum {
+	OpenRecord = 0,	///< a client connected
+	InputRecord,	///< a client sent something
+	CloseRecord		///< a connection closed
+} RecordType;
+
+/// one line of a capture
+struct Record {
+	unsigned long long time;	///< when it happened, in microseconds since the capture started
+	unsigned long id;			///< which connection
+	RecordType type;			///< what happened
+	std::string data;			///< the decoded input, for InputRecord
+};
+
+/// one replayed connection
+struct Replay {
+	unsigned long id;				///< the connection's id in the capture
+	int fd;							///< our socket, or -1
+	bool connecting;				///< true until the TCP connection is established
+	bool closing;					///< true once the capture says the connection closed
+	bool finished;					///< true once the connection is closed
+	unsigned long long closingAt;	///< when closing was set, in microseconds
+	unsigned long long sentAt;		///< when the last input went out, in microseconds
+	unsigned long long lastOutput;	///< when the last output arrived, in microseconds
+	bool awaitingResponse;			///< true from sending input until the first byte comes back
+	unsigned long long bytesOut;	///< bytes received from the server
+	unsigned long long outputHash;	///< hash of those bytes
+	unsigned long long expectedBytes;	///< bytes the capture says the client received
+	unsigned long long expectedHash;	///< the capture's hash of them
+	MccpDecoder *decoder;			///< undoes compression on this connection
+	bool expected;					///< true if the capture has a close record for this connection
+};
+
+/// a previous run's results, read back with -b
+struct Baseline {
+	std::map<unsigned long, std::pair<unsigned long long, unsigned long long> > connections;	///< id to (bytes, hash)
+	std::map<std::string, double> values;	///< the summary key/value lines
+};
+
+static volatile sig_atomic_t sInterrupted = 0;	///< set by SIGINT to stop early
+
+/// SIGINT handler
+static void interrupt(int) {
+	sInterrupted = 1;
+}
+
+/// prints usage information
+static void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options] capture-file\n"
+		<< "  -h host       server address (127.0.0.1)\n"
+		<< "  -p port       server port (2600)\n"
+		<< "  -f            fast mode: send each input once the previous one is answered\n"
+		<< "  -x factor     timed mode speed-up (1.0)\n"
+		<< "  -q msec       fast mode: how long output must pause to count as answered (50)\n"
+		<< "  -t msec       fast mode: the longest to wait for an answer (2000)\n"
+		<< "  -g msec       how long to wait for the server to close a finished connection (1000)\n"
+		<< "  -o file       write the results to a file\n"
+		<< "  -b file       compare with results written by an earlier -o\n";
+}
+
+/// decodes the hex data of an input record
+static bool decodeHex(const std::string &hex, std::string &data) {
+	if(hex.length() % 2 != 0) {
+		return false;
+	}
+
+	data.resize(hex.length() / 2);
+
+	for(std::string::size_type i = 0; i < hex.length(); i += 2) {
+		data[i / 2] = static_cast<char>(strtoul(hex.substr(i, 2).c_str(), NULL, 16));
+	}
+
+	return true;
+}
+
+/// reads a capture file
+/** @param file the capture to read
+	@param[out] records the open and input records, in order
+	@param[out] replays one entry per connection, with the expected output filled in
+	@param[out] seed the random seed the server was using
+	\return false if the file can't be read
+*/
+static bool readCapture(const std::string &file, std::vector<Record> &records, std::map<unsigned long, Replay> &replays, std::string &seed) {
+	std::ifstream in(file.c_str());
+
+	if(!in) {
+		std::cerr << "Cannot open capture " << file << "\n";
+		return false;
+	}
+
+	std::string line;
+	unsigned long lineNumber = 0;
+
+	while(std::getline(in, line)) {
+		++lineNumber;
+
+		if(line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		std::stringstream s(line);
+
+		if(line.compare(0, 5, "seed ") == 0) {
+			s >> seed >> seed;
+			continue;
+		}
+
+		Record record;
+		std::string kind;
+
+		s >> record.time >> record.id >> kind;
+
+		if(!s) {
+			std::cerr << file << ":" << lineNumber << ": cannot parse record\n";
+			return false;
+		}
+
+		if(kind == "open") {
+			record.type = OpenRecord;
+
+			Replay replay;
+			memset(&replay, 0, sizeof(replay));
+			replay.id = record.id;
+			replay.fd = -1;
+			replay.outputHash = TrafficCapture::kHashBasis;
+			replays[record.id] = replay;
+		} else if(kind == "in") {
+			std::string hex;
+			s >> hex;
+
+			if(!decodeHex(hex, record.data)) {
+				std::cerr << file << ":" << lineNumber << ": bad input data\n";
+				return false;
+			}
+
+			record.type = InputRecord;
+		} else if(kind == "close") {
+			std::map<unsigned long, Replay>::iterator pos = replays.find(record.id);
+
+			if(pos != replays.end()) {
+				std::string hash;
+				s >> pos->second.expectedBytes >> hash;
+				pos->second.expectedHash = strtoull(hash.c_str(), NULL, 16);
+				pos->second.expected = true;
+			}
+
+			record.type = CloseRecord;
+		} else {
+			std::cerr << file << ":" << lineNumber << ": unknown record " << kind << "\n";
+			return false;
+		}
+
+		if(replays.find(record.id) != replays.end()) {
+			records.push_back(record);
+		}
+	}
+
+	return true;
+}
+
+/// reads the results of an earlier run
+/** @param file a file written with -o
+	@param[out] baseline the results
+	\return false if the file can't be read
+*/
+static bool readBaseline(const std::string &file, Baseline &baseline) {
+	std::ifstream in(file.c_str());
+
+	if(!in) {
+		std::cerr << "Cannot open baseline " << file << "\n";
+		return false;
+	}
+
+	std::string line;
+
+	while(std::getline(in, line)) {
+		std::stringstream s(line);
+		std::string key;
+		s >> key;
+
+		if(key == "connection") {
+			unsigned long id;
+			unsigned long long bytes;
+			std::string hash;
+			s >> id >> bytes >> hash;
+			baseline.connections[id] = std::make_pair(bytes, strtoull(hash.c_str(), NULL, 16));
+		} else if(!key.empty()) {
+			double value;
+			s >> value;
+			baseline.values[key] = value;
+		}
+	}
+
+	return true;
+}
+
+/// closes a replayed connection
+static void finish(Replay &replay, int epoll) {
+	if(replay.fd != -1) {
+		epoll_ctl(epoll, EPOLL_CTL_DEL, replay.fd, NULL);
+		close(replay.fd);
+		replay.fd = -1;
+	}
+
+	delete replay.decoder;
+	replay.decoder = NULL;
+	replay.finished = true;
+}
+
+/// starts a non-blocking connection
+static bool connectReplay(Replay &replay, const struct sockaddr_in &address, int epoll) {
+	replay.fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if(replay.fd == -1) {
+		replay.finished = true;
+		return false;
+	}
+
+	fcntl(replay.fd, F_SETFL, fcntl(replay.fd, F_GETFL) | O_NONBLOCK);
+
+	int one = 1;
+	setsockopt(replay.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	if(connect(replay.fd, (const struct sockaddr *)&address, sizeof(address)) == -1 && errno != EINPROGRESS) {
+		close(replay.fd);
+		replay.fd = -1;
+		replay.finished = true;
+		return false;
+	}
+
+	replay.decoder = new MccpDecoder;
+	replay.connecting = true;
+	replay.sentAt = Timer::now();
+	replay.awaitingResponse = true;
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+	event.data.ptr = &replay;
+	epoll_ctl(epoll, EPOLL_CTL_ADD, replay.fd, &event);
+
+	return true;
+}
+
+/// writes all of a string to a non-blocking socket
+/** Recorded inputs are small, so a full socket buffer just means waiting a moment.
+*/
+static bool sendAll(int fd, const std::string &data) {
+	std::string::size_type sent = 0;
+
+	while(sent < data.length()) {
+		ssize_t written = write(fd, data.data() + sent, data.length() - sent);
+
+		if(written > 0) {
+			sent += written;
+		} else if(written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			usleep(1000);
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// prints a latency histogram as key/value lines
+static void printHistogram(std::ostream &out, const std::string &name, const Histogram &h) {
+	out << name << "_count " << h.getCount() << "\n";
+	out << name << "_us_mean " << h.getMean() << "\n";
+	out << name << "_us_p50 " << h.getPercentile(50.0) << "\n";
+	out << name << "_us_p95 " << h.getPercentile(95.0) << "\n";
+	out << name << "_us_p99 " << h.getPercentile(99.0) << "\n";
+	out << name << "_us_max " << h.getMax() << "\n";
+}
+
+/// prints how a summary value changed since the baseline
+static void compareValue(const Baseline &baseline, const std::string &key, const double value) {
+	std::map<std::string, double>::const_iterator pos = baseline.values.find(key);
+
+	if(pos == baseline.values.end() || pos->second == 0.0) {
+		return;
+	}
+
+	std::cout << "baseline_" << key << " " << pos->second << "\n";
+	std::cout << "ratio_" << key << " " << value / pos->second << "\n";
+}
+
+int main(int argc, char *argv[]) {
+	std::string host = "127.0.0.1";
+	int port = 2600;
+	bool fast = false;
+	double speed = 1.0;
+	unsigned long quiet = 50000;
+	unsigned long responseTimeout = 2000000;
+	unsigned long grace = 1000000;
+	std::string resultsFile;
+	std::string baselineFile;
+
+	int c;
+
+	while((c = getopt(argc, argv, "h:p:fx:q:t:g:o:b:?")) != -1) {
+		switch(c) {
+			case 'h': host = optarg; break;
+			case 'p': port = atoi(optarg); break;
+			case 'f': fast = true; break;
+			case 'x': speed = atof(optarg); break;
+			case 'q': quiet = strtoul(optarg, NULL, 10) * 1000; break;
+			case 't': responseTimeout = strtoul(optarg, NULL, 10) * 1000; break;
+			case 'g': grace = strtoul(optarg, NULL, 10) * 1000; break;
+			case 'o': resultsFile = optarg; break;
+			case 'b': baselineFile = optarg; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(optind != argc - 1 || speed <= 0.0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<Record> records;
+	std::map<unsigned long, Replay> replays;
+	std::string seed = "unknown";
+
+	if(!readCapture(argv[optind], records, replays, seed)) {
+		return 1;
+	}
+
+	Baseline baseline;
+
+	if(!baselineFile.empty() && !readBaseline(baselineFile, baseline)) {
+		return 1;
+	}
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+
+	if(inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+		std::cerr << "Host must be an IPv4 address: " << host << "\n";
+		return 1;
+	}
+
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, interrupt);
+
+	std::cerr << "Replaying " << replays.size() << " connections and " << records.size()
+		<< " records; start the server with RandomSeed " << seed << "\n";
+
+	int epoll = epoll_create(replays.size() + 1);
+
+	if(epoll == -1) {
+		std::cerr << "epoll_create failed: " << strerror(errno) << "\n";
+		return 1;
+	}
+
+	Histogram responseLatency;
+	unsigned long inputsSent = 0;
+	unsigned long sendFailures = 0;
+	unsigned long connectFailures = 0;
+	unsigned long unexpectedCloses = 0;
+	unsigned long long wireBytes = 0;
+	std::string decoded;
+
+	std::vector<struct epoll_event> events(256);
+	char buffer[16384];
+
+	std::vector<Record>::size_type next = 0;
+	Replay *previous = NULL;	// fast mode: the connection the last record went to
+	unsigned long long start = Timer::now();
+
+	while(!sInterrupted) {
+		unsigned long long now = Timer::now();
+
+		// send every record that is due
+		while(next < records.size()) {
+			const Record &record = records[next];
+			Replay &replay = replays[record.id];
+
+			if(fast) {
+				if(previous != NULL && !previous->finished) {
+					bool answered = !previous->awaitingResponse && now - previous->lastOutput >= quiet;
+					bool timedOut = now - previous->sentAt >= responseTimeout;
+
+					if(!answered && !timedOut) {
+						break;
+					}
+				}
+			} else if(now - start < static_cast<unsigned long long>(record.time / speed)) {
+				break;
+			}
+
+			// input can't go out until the connection is up
+			if(record.type == InputRecord && replay.connecting && !replay.finished) {
+				break;
+			}
+
+			if(record.type == OpenRecord) {
+				if(!connectReplay(replay, address, epoll)) {
+					++connectFailures;
+				}
+			} else if(record.type == InputRecord && !replay.finished && !replay.closing) {
+				replay.sentAt = now;
+				replay.awaitingResponse = true;
+
+				if(sendAll(replay.fd, record.data)) {
+					++inputsSent;
+				} else {
+					++sendFailures;
+					finish(replay, epoll);
+				}
+			}
+
+			if(record.type == CloseRecord) {
+				// nothing will answer a close, so don't make the next record wait for it
+				replay.closing = true;
+				replay.closingAt = now;
+				previous = NULL;
+			} else {
+				previous = &replay;
+			}
+
+			++next;
+		}
+
+		int ready = epoll_wait(epoll, &events[0], events.size(), 1);
+		now = Timer::now();
+
+		for(int i = 0; i < ready; ++i) {
+			Replay &replay = *static_cast<Replay *>(events[i].data.ptr);
+
+			if(replay.connecting) {
+				int error = 0;
+				socklen_t length = sizeof(error);
+				getsockopt(replay.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+
+				if(error != 0) {
+					++connectFailures;
+					finish(replay, epoll);
+					continue;
+				}
+
+				replay.connecting = false;
+
+				struct epoll_event event;
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLIN | EPOLLRDHUP;
+				event.data.ptr = &replay;
+				epoll_ctl(epoll, EPOLL_CTL_MOD, replay.fd, &event);
+			}
+
+			ssize_t bytes;
+
+			while((bytes = read(replay.fd, buffer, sizeof(buffer))) > 0) {
+				if(replay.awaitingResponse) {
+					replay.awaitingResponse = false;
+					responseLatency.record(static_cast<unsigned long>(now - replay.sentAt));
+				}
+
+				replay.lastOutput = now;
+				wireBytes += bytes;
+
+				decoded.clear();
+				if(!replay.decoder->decode(buffer, bytes, decoded)) {
+					std::cerr << "Connection " << replay.id << ": corrupt compressed output\n";
+					bytes = 0;
+					break;
+				}
+
+				replay.bytesOut += decoded.length();
+				replay.outputHash = TrafficCapture::hash(replay.outputHash, decoded.data(), decoded.length());
+			}
+
+			if(bytes == 0 || (bytes == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+				if(!replay.closing) {
+					++unexpectedCloses;
+				}
+				finish(replay, epoll);
+			}
+		}
+
+		// give up on connections the server should have closed by now
+		bool done = next >= records.size();
+
+		for(std::map<unsigned long, Replay>::iterator pos = replays.begin(); pos != replays.end(); ++pos) {
+			Replay &replay = pos->second;
+
+			if(replay.finished) {
+				continue;
+			}
+
+			if(replay.closing && now - replay.closingAt >= grace) {
+				finish(replay, epoll);
+			} else {
+				done = false;
+			}
+		}
+
+		if(done) {
+			break;
+		}
+	}
+
+	unsigned long long elapsed = Timer::now() - start;
+
+	unsigned long matched = 0;
+	unsigned long mismatched = 0;
+	unsigned long baselineMismatched = 0;
+	std::stringstream connections;
+
+	for(std::map<unsigned long, Replay>::iterator pos = replays.begin(); pos != replays.end(); ++pos) {
+		Replay &replay = pos->second;
+
+		finish(replay, epoll);
+
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", replay.outputHash);
+		connections << "connection " << replay.id << " " << replay.bytesOut << " " << hash << "\n";
+
+		if(replay.expected) {
+			if(replay.expectedHash == replay.outputHash && replay.expectedBytes == replay.bytesOut) {
+				++matched;
+			} else {
+				++mismatched;
+			}
+		}
+
+		if(!baseline.connections.empty()) {
+			std::map<unsigned long, std::pair<unsigned long long, unsigned long long> >::const_iterator b = baseline.connections.find(replay.id);
+
+			if(b == baseline.connections.end() || b->second.first != replay.bytesOut || b->second.second != replay.outputHash) {
+				++baselineMismatched;
+				std::cerr << "connection " << replay.id << " differs from the baseline\n";
+			}
+		}
+	}
+
+	close(epoll);
+
+	double seconds = elapsed / 1000000.0;
+
+	std::stringstream summary;
+	summary << "connections " << replays.size() << "\n";
+	summary << "elapsed_seconds " << seconds << "\n";
+	summary << "inputs_sent " << inputsSent << "\n";
+	summary << "inputs_per_second " << (seconds > 0.0 ? inputsSent / seconds : 0.0) << "\n";
+	summary << "connect_failures " << connectFailures << "\n";
+	summary << "send_failures " << sendFailures << "\n";
+	summary << "unexpected_closes " << unexpectedCloses << "\n";
+	summary << "wire_bytes " << wireBytes << "\n";
+	summary << "capture_hash_matches " << matched << "\n";
+	summary << "capture_hash_mismatches " << mismatched << "\n";
+	printHistogram(summary, "response_latency", responseLatency);
+
+	std::cout << summary.str();
+
+	if(!baselineFile.empty()) {
+		std::cout << "baseline_hash_mismatches " << baselineMismatched << "\n";
+		compareValue(baseline, "elapsed_seconds", seconds);
+		compareValue(baseline, "response_latency_us_p50", responseLatency.getPercentile(50.0));
+		compareValue(baseline, "response_latency_us_p95", responseLatency.getPercentile(95.0));
+		compareValue(baseline, "response_latency_us_p99", responseLatency.getPercentile(99.0));
+	}
+
+	if(!resultsFile.empty()) {
+		std::ofstream out(resultsFile.c_str(), std::ios::out | std::ios::trunc);
+		out << summary.str() << connections.str();
+	}
+
+	return baselineMismatched > 0 ? 1 : 0;
+}
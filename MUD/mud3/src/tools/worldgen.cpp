@@ -0,0 +1,549 @@
+/** @file
+	worldgen: writes synthetic worlds for benchmarking.
+
+	The shipped data directory has almost no world in it, so nothing exercises zone
+	loading, the zone maps, room contents or saves at scale. This program writes zones
+	full of rooms in the same YAML layout Room::Save() produces, so the server loads them
+	like any other world.
+
+	Each zone's rooms sit on a square grid. Each grid neighbour (the eight compass points)
+	is linked with probability \c -e, and a two-way exit always joins the previous room so
+	every room can be reached. The first room of each zone also links to the next zone.
+	Each room holds \c -k objects, mixed between books (\c -p pages each), coin piles
+	(\c -a alloys each) and milestones. With \c -m every zone also gets a map, a weather map
+	and their keys, at least \c -W by \c -H characters.
+
+	The world goes into \c dir/zones. If \c dir/config.yaml exists, its starting and
+	lost-and-found rooms are pointed at the first generated room. An admin character
+	(\c -A, password \c -P) is written to \c dir/players for tools/mudbench.
+
+	\note No loadable object type is itself a container, so the only nesting in a
+		generated world is room, then objects.
+*/
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/// the generator's settings, filled in from the command line
+struct Options {
+	std::string directory;	///< the data directory to write into
+	int zones;				///< how many zones
+	int rooms;				///< rooms per zone
+	double exitDensity;		///< chance that two neighbouring rooms are linked
+	int objects;			///< objects per room
+	int pages;				///< pages in each book
+	int pageLength;			///< characters per page
+	int alloys;				///< alloys in each coin
+	bool maps;				///< whether to write zone maps
+	int mapWidth;			///< minimum map width
+	int mapHeight;			///< minimum map height
+	unsigned int seed;		///< random seed
+	std::string admin;		///< name of the admin character, or empty for none
+	std::string password;	///< the admin's password
+};
+
+/// exit names, offsets and opposites for the eight compass directions
+static const char *kDirections[] = { "north", "northeast", "east", "southeast", "south", "southwest", "west", "northwest" };
+static const int kDeltaX[] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int kDeltaY[] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+static const int kOpposite[] = { 4, 5, 6, 7, 0, 1, 2, 3 };
+static const int kNumberOfDirections = 8;
+
+static const char *kWords[] = { "the", "old", "road", "winds", "past", "a", "quiet", "stone", "wall", "and",
+	"into", "dark", "pines", "where", "wind", "moves", "over", "grey", "hills", "toward", "river" };
+
+/// prints usage information
+static void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options] data-directory\n"
+		<< "  -z zones      number of zones (4)\n"
+		<< "  -r rooms      rooms per zone (1000)\n"
+		<< "  -e density    chance of linking each pair of neighbouring rooms, 0-1 (0.5)\n"
+		<< "  -k objects    objects per room (5)\n"
+		<< "  -p pages      pages per book (4)\n"
+		<< "  -l length     characters per book page (400)\n"
+		<< "  -a alloys     alloys per coin pile, up to 100 (3)\n"
+		<< "  -m            write zone and weather maps\n"
+		<< "  -W width      minimum map width (0)\n"
+		<< "  -H height     minimum map height (0)\n"
+		<< "  -s seed       random seed (1)\n"
+		<< "  -A name       admin character to create, letters only (benchadmin; empty for none)\n"
+		<< "  -P password   admin password (benchmark)\n";
+}
+
+/// creates a directory if it isn't there
+static bool makeDirectory(const std::string &path) {
+	if(mkdir(path.c_str(), 0755) == 0 || errno == EEXIST) {
+		return true;
+	}
+
+	std::cerr << "Cannot create " << path << ": " << strerror(errno) << "\n";
+	return false;
+}
+
+/// names the nth zone
+static std::string zoneName(const int zone) {
+	std::stringstream s;
+	s << "zone" << std::setw(4) << std::setfill('0') << zone;
+	return s.str();
+}
+
+/// names the nth room in a zone
+static std::string roomName(const int room) {
+	std::stringstream s;
+	s << "room" << std::setw(6) << std::setfill('0') << room;
+	return s.str();
+}
+
+/// makes a random version 4 style guid
+static std::string makeGuid() {
+	std::stringstream s;
+	s << std::hex << std::setfill('0');
+
+	for(int i = 0; i < 16; ++i) {
+		if(i == 4 || i == 6 || i == 8 || i == 10) {
+			s << "-";
+		}
+		s << std::setw(2) << (rand() & 0xff);
+	}
+
+	return s.str();
+}
+
+/// makes some text about the given length
+static std::string makeText(const int length) {
+	const int words = sizeof(kWords) / sizeof(kWords[0]);
+	std::string text;
+
+	while(static_cast<int>(text.length()) < length) {
+		if(!text.empty()) {
+			text += " ";
+		}
+		text += kWords[rand() % words];
+	}
+
+	return text;
+}
+
+/// writes the Physical node every saved object starts with
+static void writePhysical(std::ostream &out, const std::string &indent, const std::string &name, const std::string &type,
+		const std::string &locationType, const std::string &location, const std::string &zone) {
+	out << indent << "Physical:\n";
+	out << indent << "  name: " << name << "\n";
+	out << indent << "  object-type: " << type << "\n";
+	out << indent << "  guid: " << makeGuid() << "\n";
+	out << indent << "  length: " << (rand() % 10) << "\n";
+	out << indent << "  width: " << (rand() % 10) << "\n";
+	out << indent << "  height: " << (rand() % 10) << "\n";
+	out << indent << "  weight: " << (rand() % 100) << "\n";
+	out << indent << "  temperature: 65\n";
+	out << indent << "  insulation: 0\n";
+	out << indent << "  location:\n";
+	out << indent << "    type: " << locationType << "\n";
+	out << indent << "    name: " << location << "\n";
+	out << indent << "    zone: " << (zone.empty() ? "~" : zone) << "\n";
+	out << indent << "  matter-state: solid\n";
+	out << indent << "  solid-to-liquid-temp: 400\n";
+	out << indent << "  liquid-to-gas-temp: 600\n";
+	out << indent << "  gas-to-plasma-temp: 1000\n";
+	out << indent << "  destroyed-if-not-solid: false\n";
+	out << indent << "  magnetic-strength: 0\n";
+	out << indent << "  nicknames:\n";
+	out << indent << "    - ~\n";
+	out << indent << "  conditions:\n";
+	out << indent << "    - ~\n";
+}
+
+/// writes the Readable node of books and milestones
+static void writeReadable(std::ostream &out, const std::string &indent, const int pages, const int pageLength) {
+	out << indent << "Readable:\n";
+	out << indent << "  language: common\n";
+	out << indent << "  writable: false\n";
+	out << indent << "  pages:" << (pages == 0 ? " ~" : "") << "\n";
+
+	for(int i = 0; i < pages; ++i) {
+		out << indent << "    - \"" << makeText(pageLength) << "\"\n";
+	}
+}
+
+/// writes one object in a room's contents
+static void writeObject(std::ostream &out, const Options &options, const int index, const std::string &room, const std::string &zone) {
+	const std::string item = "    - ";
+	const std::string indent = "      ";
+	std::stringstream name;
+
+	switch(index % 3) {
+		case 0:
+			name << "book";
+			out << item << "\n";
+			writePhysical(out, indent, name.str(), "BookObject", "RoomObject", room, zone);
+			writeReadable(out, indent, options.pages, options.pageLength);
+			out << indent << "Book:\n";
+			out << indent << "  title: \"" << makeText(20) << "\"\n";
+			out << indent << "  author: \"" << makeText(10) << "\"\n";
+			break;
+
+		case 1:
+			name << "coin";
+			out << item << "\n";
+			writePhysical(out, indent, name.str(), "CoinObject", "RoomObject", room, zone);
+			out << indent << "Collection:\n";
+			out << indent << "  quantity: " << (1 + rand() % 500) << "\n";
+			out << indent << "Coin:\n";
+			out << indent << "  alloys:";
+
+			if(options.alloys == 0) {
+				out << " ~\n";
+			} else {
+				out << "\n";
+				for(int i = 0; i < options.alloys; ++i) {
+					out << indent << "    metal" << i << ": " << (100 / options.alloys) << "\n";
+				}
+			}
+			break;
+
+		default:
+			name << "milestone";
+			out << item << "\n";
+			writePhysical(out, indent, name.str(), "MilestoneObject", "RoomObject", room, zone);
+			writeReadable(out, indent, 1, 80);
+			break;
+	}
+}
+
+/// writes one room file
+/** @param options the generator settings
+	@param path the file to write
+	@param zone the room's zone
+	@param room the room's number
+	@param x the room's map x coordinate
+	@param y the room's map y coordinate
+	@param exits the room's exits as (direction, destination zone, destination room)
+*/
+static bool writeRoom(const Options &options, const std::string &path, const std::string &zone, const int room,
+		const int x, const int y, const std::vector<std::pair<std::string, std::pair<std::string, std::string> > > &exits) {
+	std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+
+	if(!out) {
+		std::cerr << "Cannot write " << path << "\n";
+		return false;
+	}
+
+	std::string name = roomName(room);
+
+	out << "---\n";
+	writePhysical(out, "", name, "RoomObject", "ZoneObject", zone, "");
+
+	out << "Room:\n";
+	out << "  x-coordinate: " << x << "\n";
+	out << "  y-coordinate: " << y << "\n";
+	out << "  brief-description: \"" << makeText(40) << "\"\n";
+	out << "  verbose-description: \"" << makeText(300) << "\"\n";
+	out << "  items-of-interest:\n";
+	out << "    wall: \"" << makeText(60) << "\"\n";
+	out << "    road: \"" << makeText(60) << "\"\n";
+	out << "  exits:";
+
+	if(exits.empty()) {
+		out << " ~\n";
+	} else {
+		out << "\n";
+
+		for(std::vector<std::pair<std::string, std::pair<std::string, std::string> > >::const_iterator it = exits.begin(); it != exits.end(); ++it) {
+			out << "    - name: " << it->first << "\n";
+			out << "      destination-zone: " << it->second.first << "\n";
+			out << "      destination: " << it->second.second << "\n";
+			out << "      key: ~\n";
+			out << "      lockable: false\n";
+			out << "      has-door: false\n";
+			out << "      closed: false\n";
+			out << "      hidden: false\n";
+		}
+	}
+
+	out << "Container:\n";
+	out << "  capacity: " << (options.objects + 50) << "\n";
+	out << "  contents:\n";
+
+	if(options.objects == 0) {
+		out << "    - ~\n";
+	}
+
+	for(int i = 0; i < options.objects; ++i) {
+		writeObject(out, options, i, name, zone);
+	}
+
+	return out.good();
+}
+
+/// writes a zone's map, weather map and keys
+static bool writeMaps(const std::string &path, const int width, const int height, const std::vector<std::pair<int, int> > &rooms) {
+	std::vector<std::string> map(height, std::string(width, '^'));
+
+	for(std::vector<std::pair<int, int> >::const_iterator it = rooms.begin(); it != rooms.end(); ++it) {
+		map[it->second][it->first] = '.';
+	}
+
+	std::ofstream out((path + "/map.txt").c_str(), std::ios::out | std::ios::trunc);
+
+	for(int y = 0; y < height; ++y) {
+		out << map[y] << "\n";
+	}
+
+	std::ofstream key((path + "/map.key").c_str(), std::ios::out | std::ios::trunc);
+	key << "# symbol, description, color\n";
+	key << ".,Road\n";
+	key << "^,Wilderness,~ny0\n";
+
+	std::ofstream weather((path + "/weather.txt").c_str(), std::ios::out | std::ios::trunc);
+	const char kWeather[] = "cccccrrs";
+
+	for(int y = 0; y < height; ++y) {
+		for(int x = 0; x < width; ++x) {
+			weather << kWeather[rand() % (sizeof(kWeather) - 1)];
+		}
+		weather << "\n";
+	}
+
+	std::ofstream weatherKey((path + "/weather.key").c_str(), std::ios::out | std::ios::trunc);
+	weatherKey << "# symbol, description, color\n";
+	weatherKey << "c,Clear skies\n";
+	weatherKey << "r,Rain,~bb0\n";
+	weatherKey << "s,Snow\n";
+
+	return out.good() && key.good() && weather.good() && weatherKey.good();
+}
+
+/// writes one zone
+static bool writeZone(const Options &options, const int zone) {
+	std::string name = zoneName(zone);
+	std::string path = options.directory + "/zones/" + name;
+
+	if(!makeDirectory(path) || !makeDirectory(path + "/rooms")) {
+		return false;
+	}
+
+	int side = 1;
+	while(side * side < options.rooms) {
+		++side;
+	}
+
+	// every room's exits, filled in both directions as links are made
+	std::vector<std::vector<std::pair<std::string, std::pair<std::string, std::string> > > > exits(options.rooms);
+	std::vector<std::pair<int, int> > coordinates(options.rooms);
+
+	for(int room = 0; room < options.rooms; ++room) {
+		int column = room % side;
+		int row = room / side;
+		coordinates[room] = std::make_pair(column * 2 + 1, row * 2 + 1);
+
+		for(int d = 0; d < kNumberOfDirections; ++d) {
+			int otherColumn = column + kDeltaX[d];
+			int otherRow = row + kDeltaY[d];
+			int other = otherRow * side + otherColumn;
+
+			// consider each pair once, from the higher-numbered room
+			if(otherColumn < 0 || otherColumn >= side || otherRow < 0 || other < 0 || other >= room) {
+				continue;
+			}
+
+			// the previous room is always linked so the whole zone can be reached
+			bool linked = (other == room - 1 && d == 6) || (column == 0 && other == room - side && d == 0);
+
+			if(linked || rand() < options.exitDensity * RAND_MAX) {
+				exits[room].push_back(std::make_pair(kDirections[d], std::make_pair(name, roomName(other))));
+				exits[other].push_back(std::make_pair(kDirections[kOpposite[d]], std::make_pair(name, roomName(room))));
+			}
+		}
+	}
+
+	// chain the zones together through their first rooms
+	if(options.zones > 1) {
+		exits[0].push_back(std::make_pair("up", std::make_pair(zoneName((zone + 1) % options.zones), roomName(0))));
+		exits[0].push_back(std::make_pair("down", std::make_pair(zoneName((zone + options.zones - 1) % options.zones), roomName(0))));
+	}
+
+	for(int room = 0; room < options.rooms; ++room) {
+		if(!writeRoom(options, path + "/rooms/" + roomName(room), name, room, coordinates[room].first, coordinates[room].second, exits[room])) {
+			return false;
+		}
+	}
+
+	if(options.maps) {
+		int width = side * 2 + 1;
+		int height = side * 2 + 1;
+
+		if(width < options.mapWidth) {
+			width = options.mapWidth;
+		}
+		if(height < options.mapHeight) {
+			height = options.mapHeight;
+		}
+
+		if(!writeMaps(path, width, height, coordinates)) {
+			std::cerr << "Cannot write maps for " << name << "\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// writes the admin character the benchmark logs in with
+static bool writeAdmin(const Options &options) {
+	if(!makeDirectory(options.directory + "/players")) {
+		return false;
+	}
+
+	std::string path = options.directory + "/players/" + options.admin;
+	std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+
+	out << "---\n";
+	writePhysical(out, "", options.admin, "PlayerObject", "RoomObject", roomName(0), zoneName(0));
+	out << "Player:\n";
+	out << "  password: " << options.password << "\n";
+	out << "  prompt: \"[%m]:>\"\n";
+	out << "  permission-level: 1\n";
+	out << "  aliases: ~\n";
+	out << "Living:\n";
+	out << "  life: 90\n";
+	out << "  max-life: 90\n";
+	out << "  sex: 0\n";
+	out << "  temp-damage-low: 50\n";
+	out << "  temp-comfort-low: 65\n";
+	out << "  temp-comfort-high: 75\n";
+	out << "  temp-damage-high: 110\n";
+	out << "Connection:\n";
+	out << "  x-resolution: 80\n";
+	out << "  y-resolution: 24\n";
+	out << "  colorblind: true\n";
+	out << "Sentient:\n";
+	out << "  strength: 1\n";
+	out << "  intelligence: 1\n";
+	out << "  wisdom: 1\n";
+	out << "  dexterity: 1\n";
+	out << "  constitution: 1\n";
+	out << "  charisma: 1\n";
+	out << "  languages: ~\n";
+	out << "Container:\n";
+	out << "  capacity: 5\n";
+	out << "  contents:\n";
+	out << "    - ~\n";
+
+	return out.good();
+}
+
+/// points the config's starting and lost-and-found rooms at the generated world
+static bool updateConfig(const Options &options) {
+	std::string path = options.directory + "/config.yaml";
+	std::ifstream in(path.c_str());
+
+	if(!in) {
+		return true;
+	}
+
+	std::stringstream updated;
+	std::string line;
+
+	while(std::getline(in, line)) {
+		std::string key = line.substr(0, line.find(':'));
+
+		if(key == "  StartingZone" || key == "  LostAndFoundZone") {
+			line = key + ": " + zoneName(0);
+		} else if(key == "  StartingRoom" || key == "  LostAndFoundRoom") {
+			line = key + ": " + roomName(0);
+		}
+
+		updated << line << "\n";
+	}
+
+	in.close();
+
+	std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+	out << updated.str();
+
+	return out.good();
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	options.zones = 4;
+	options.rooms = 1000;
+	options.exitDensity = 0.5;
+	options.objects = 5;
+	options.pages = 4;
+	options.pageLength = 400;
+	options.alloys = 3;
+	options.maps = false;
+	options.mapWidth = 0;
+	options.mapHeight = 0;
+	options.seed = 1;
+	options.admin = "benchadmin";
+	options.password = "benchmark";
+
+	int c;
+
+	while((c = getopt(argc, argv, "z:r:e:k:p:l:a:mW:H:s:A:P:?")) != -1) {
+		switch(c) {
+			case 'z': options.zones = atoi(optarg); break;
+			case 'r': options.rooms = atoi(optarg); break;
+			case 'e': options.exitDensity = atof(optarg); break;
+			case 'k': options.objects = atoi(optarg); break;
+			case 'p': options.pages = atoi(optarg); break;
+			case 'l': options.pageLength = atoi(optarg); break;
+			case 'a': options.alloys = atoi(optarg); break;
+			case 'm': options.maps = true; break;
+			case 'W': options.mapWidth = atoi(optarg); break;
+			case 'H': options.mapHeight = atoi(optarg); break;
+			case 's': options.seed = strtoul(optarg, NULL, 10); break;
+			case 'A': options.admin = optarg; break;
+			case 'P': options.password = optarg; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if(optind != argc - 1 || options.zones < 1 || options.rooms < 1 || options.objects < 0
+			|| options.pages < 0 || options.alloys < 0 || options.alloys > 100) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	options.directory = argv[optind];
+	srand(options.seed);
+
+	if(!makeDirectory(options.directory) || !makeDirectory(options.directory + "/zones")) {
+		return 1;
+	}
+
+	for(int zone = 0; zone < options.zones; ++zone) {
+		if(!writeZone(options, zone)) {
+			return 1;
+		}
+		std::cerr << "Wrote " << zoneName(zone) << "\n";
+	}
+
+	if(!options.admin.empty() && !writeAdmin(options)) {
+		std::cerr << "Cannot write the admin character\n";
+		return 1;
+	}
+
+	if(!updateConfig(options)) {
+		std::cerr << "Cannot update " << options.directory << "/config.yaml\n";
+		return 1;
+	}
+
+	std::cout << "zones " << options.zones << "\n";
+	std::cout << "rooms " << options.zones * options.rooms << "\n";
+	std::cout << "objects " << static_cast<long>(options.zones) * options.rooms * options.objects << "\n";
+
+	return 0;
+}
@@ -0,0 +1,177 @@
+#include <iomanip>
+
+#include "trafficCapture.h"
+#include "timer.h"
+
+#include "global.h"
+extern Global glob;
+
+/// Constructor
+/** Does nothing; nothing is recorded until start() is called
+*/
+TrafficCapture::TrafficCapture() : mLock("TrafficCapture") {
+	mEnabled = false;
+	mNextId = 1;
+	mStart = 0;
+}
+
+/// Destructor
+/** Closes the capture file, recording every connection that is still open
+*/
+TrafficCapture::~TrafficCapture() {
+	stop();
+}
+
+/// opens the capture file if one is configured
+/** @param seed the random seed the server is using, recorded so a replay can match it
+	\return true if traffic is being captured
+*/
+bool TrafficCapture::start(const unsigned int seed) {
+	std::string file = glob.Config.getStringValue("CaptureFile");
+
+	if(file.empty()) {
+		return false;
+	}
+
+	if(!mLock.lock()) {
+		return false;
+	}
+
+	mFile.open(file.c_str(), std::ios::out | std::ios::trunc);
+
+	if(!mFile) {
+		mLock.unlock();
+		glob.log.error(boost::format("TrafficCapture::start(): Cannot open capture file %1%") % file);
+		return false;
+	}
+
+	mFile << "# ForeverMUD traffic capture\n";
+	mFile << "seed " << seed << "\n";
+	mFile.flush();
+
+	mStart = Timer::now();
+	mEnabled = true;
+
+	mLock.unlock();
+
+	glob.log.warn(boost::format("Capturing client traffic to %1%; the file will contain passwords") % file);
+
+	return true;
+}
+
+/// stops capturing and closes the file
+/** Connections that are still open get a close record, so their output hashes are kept.
+*/
+void TrafficCapture::stop() {
+	if(!mEnabled || !mLock.lock()) {
+		return;
+	}
+
+	for(ConnectionMap::const_iterator pos = mConnections.begin(); pos != mConnections.end(); ++pos) {
+		writeClose(pos->second);
+	}
+
+	mConnections.clear();
+	mEnabled = false;
+	mFile.close();
+
+	mLock.unlock();
+}
+
+/// records a new connection
+/** @param fd the connection's descriptor
+	@param ip the client's address
+*/
+void TrafficCapture::open(const int fd, const std::string &ip) {
+	if(!mEnabled || !mLock.lock()) {
+		return;
+	}
+
+	CapturedConnection connection;
+	connection.id = mNextId++;
+	connection.bytesOut = 0;
+	connection.outputHash = kHashBasis;
+
+	mConnections[fd] = connection;
+
+	mFile << (Timer::now() - mStart) << " " << connection.id << " open " << ip << "\n";
+
+	mLock.unlock();
+}
+
+/// records bytes read from a client
+/** @param fd the connection's descriptor
+	@param data the bytes read
+	@param length how many bytes were read
+*/
+void TrafficCapture::input(const int fd, const char *data, const int length) {
+	if(!mEnabled || length <= 0 || !mLock.lock()) {
+		return;
+	}
+
+	ConnectionMap::const_iterator pos = mConnections.find(fd);
+
+	if(pos != mConnections.end()) {
+		static const char hex[] = "0123456789abcdef";
+		std::string encoded(length * 2, '0');
+
+		for(int i = 0; i < length; ++i) {
+			encoded[i * 2] = hex[static_cast<unsigned char>(data[i]) >> 4];
+			encoded[i * 2 + 1] = hex[static_cast<unsigned char>(data[i]) & 0xf];
+		}
+
+		mFile << (Timer::now() - mStart) << " " << pos->second.id << " in " << encoded << "\n";
+	}
+
+	mLock.unlock();
+}
+
+/// adds bytes written to a client to that connection's output hash
+/** @param fd the connection's descriptor
+	@param data the bytes written
+	@param length how many bytes were written
+*/
+void TrafficCapture::output(const int fd, const char *data, const int length) {
+	if(!mEnabled || length <= 0 || !mLock.lock()) {
+		return;
+	}
+
+	ConnectionMap::iterator pos = mConnections.find(fd);
+
+	if(pos != mConnections.end()) {
+		pos->second.bytesOut += length;
+		pos->second.outputHash = hash(pos->second.outputHash, data, length);
+	}
+
+	mLock.unlock();
+}
+
+/// records a disconnect
+/** @param fd the connection's descriptor
+*/
+void TrafficCapture::close(const int fd) {
+	if(!mEnabled || !mLock.lock()) {
+		return;
+	}
+
+	ConnectionMap::iterator pos = mConnections.find(fd);
+
+	if(pos != mConnections.end()) {
+		writeClose(pos->second);
+		mConnections.erase(pos);
+	}
+
+	// a capture is only useful if it survives a crash, so flush at every disconnect
+	mFile.flush();
+
+	mLock.unlock();
+}
+
+/// writes a connection's close record
+/** \note The caller must hold mLock
+	@param connection the connection that closed
+*/
+void TrafficCapture::writeClose(const CapturedConnection &connection) {
+	mFile << (Timer::now() - mStart) << " " << connection.id << " close " << connection.bytesOut << " "
+		<< std::hex << std::setw(16) << std::setfill('0') << connection.outputHash << std::dec << "\n";
+}
@@ -0,0 +1,81 @@
+#ifndef MUD_TRAFFIC_CAPTURE_H
+#define MUD_TRAFFIC_CAPTURE_H
+
+#include <string>
+#include <map>
+#include <fstream>
+
+#include "mutex.h"
+
+/// Records client traffic so real sessions can be replayed
+/** When the \c CaptureFile config string is set, this class writes every new connection,
+	every read from a client and every disconnect to that file with a timestamp, and keeps
+	a running hash of the text sent back to each client. The capture starts with the random
+	seed the server is using, so tools/mudreplay can feed it back into a fresh server
+	started with that \c RandomSeed and check that it answers the same way.
+
+	Each line is <tt>microseconds id kind [data]</tt>, where \c id numbers connections
+	in the order they were accepted (descriptors get reused, so they can't be the key) and
+	\c kind is one of:
+	- \c open, followed by the client's IP address
+	- \c in, followed by the bytes read, hex encoded
+	- \c close, followed by the number of bytes sent to the client and their FNV-1a hash
+	\warning A capture contains everything players typed, passwords included. Treat it
+		like the player files.
+*/
+class TrafficCapture {
+public:
+	TrafficCapture();
+	~TrafficCapture();
+
+	bool start(const unsigned int seed);
+	void stop();
+
+	/// whether traffic is being recorded
+	bool isEnabled() const { return mEnabled; }
+
+	void open(const int fd, const std::string &ip);
+	void input(const int fd, const char *data, const int length);
+	void output(const int fd, const char *data, const int length);
+	void close(const int fd);
+
+	/// extends an FNV-1a hash with more bytes
+	/** Hashing a stream in pieces gives the same result as hashing it all at once, so
+		tools/mudreplay can hash whatever it reads, however the reads are split.
+		@param hash the hash so far (kHashBasis to start)
+		@param data the bytes to add
+		@param length how many bytes to add
+		\return the new hash
+	*/
+	static unsigned long long hash(unsigned long long hash, const char *data, const int length) {
+		for(int i = 0; i < length; ++i) {
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ULL;
+		}
+
+		return hash;
+	}
+
+	static const unsigned long long kHashBasis = 14695981039346656037ULL;	///< FNV-1a 64-bit offset basis
+
+private:
+	/// what we keep about each captured connection
+	struct CapturedConnection {
+		unsigned long id;				///< the connection's number in the capture
+		unsigned long long bytesOut;	///< bytes sent to the client
+		unsigned long long outputHash;	///< FNV-1a hash of those bytes
+	};
+
+	typedef std::map<int, CapturedConnection> ConnectionMap;
+
+	volatile bool mEnabled;			///< checked without the lock so a disabled capture costs nothing
+	std::ofstream mFile;			///< the capture file
+	ConnectionMap mConnections;		///< captured connections by descriptor
+	unsigned long mNextId;			///< the id for the next connection
+	unsigned long long mStart;		///< when the capture started, in monotonic microseconds
+	Mutex mLock;					///< guards everything above
+
+	void writeClose(const CapturedConnection &connection);
+};
+
+#endif // MUD_TRAFFIC_CAPTURE_H
@@ -0,0 +1,270 @@
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <csignal>
+#include <execinfo.h>	// for backtrace()
+#include <unistd.h>
+
+#include "watchdog.h"
+#include "timer.h"
+
+#include "global.h"
+extern Global glob;
+
+/// the most frames we will capture from a stalled thread
+static const int kMaxBacktraceFrames = 64;
+
+/// frames captured by Watchdog::backtraceHandler()
+static void *sBacktraceFrames[kMaxBacktraceFrames];
+/// how many frames are in sBacktraceFrames
+static volatile int sBacktraceFrameCount = 0;
+/// set by the signal handler once sBacktraceFrames is filled in
+static volatile sig_atomic_t sBacktraceCaptured = 0;
+
+/// Constructor
+/** Does nothing; the watchdog is not started until start() is called
+*/
+Watchdog::Watchdog() {
+	mDeadline = 0;
+
+	for(int i = 0; i < NumberOfWatchedThreads; ++i) {
+		mThreads[i].registered = 0;
+		mThreads[i].lastLoop = 0;
+		mThreads[i].stalled = false;
+		mThreads[i].activity = NULL;
+		mThreads[i].detail[0] = '\0';
+		mThreads[i].descriptor = -1;
+	}
+}
+
+/// Destructor
+Watchdog::~Watchdog() {
+}
+
+/// starts the watchdog thread
+/** This function reads the deadline from the config, installs the SIGUSR2 handler
+	used to capture backtraces and spawns a detached watchdog thread.
+	\return true if the watchdog is running
+*/
+bool Watchdog::start() {
+	int timeout = glob.Config.getIntValue("WatchdogTimeout");
+
+	if(timeout < 0) {
+		timeout = WATCHDOG_TIMEOUT;
+	}
+
+	if(timeout == 0) {
+		glob.log.info("Watchdog::start(): WatchdogTimeout is 0, watchdog disabled");
+		return false;
+	}
+
+	mDeadline = static_cast<unsigned long>(timeout) * 1000;
+
+	// backtrace() loads libgcc the first time it is called, which is not safe in a
+	// signal handler, so get that out of the way now
+	void *frame[1];
+	backtrace(frame, 1);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &Watchdog::backtraceHandler;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+
+	if(sigaction(SIGUSR2, &action, NULL) != 0) {
+		glob.log.error("Watchdog::start(): Cannot install the SIGUSR2 handler");
+		return false;
+	}
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	if(pthread_create(&mThread, &attr, thread_watchdog_func, this) != 0) {
+		glob.log.error("Watchdog::start(): Cannot create watchdog thread");
+		return false;
+	}
+
+	glob.log.info(boost::format("Watchdog started with a %1% millisecond deadline") % timeout);
+
+	return true;
+}
+
+/// registers the calling thread with the watchdog
+/** A watched thread calls this once, before its main loop.
+	@param thread which thread is calling
+*/
+void Watchdog::enter(WatchedThread thread) {
+	if(thread >= NumberOfWatchedThreads) {
+		return;
+	}
+
+	mThreads[thread].thread = pthread_self();
+	mThreads[thread].lastLoop = Timer::now();
+	__sync_synchronize();
+	mThreads[thread].registered = 1;
+}
+
+/// tells the watchdog that a thread has completed a loop
+/** @param thread which thread is calling
+*/
+void Watchdog::stamp(WatchedThread thread) {
+	if(thread < NumberOfWatchedThreads) {
+		__sync_lock_test_and_set(&mThreads[thread].lastLoop, Timer::now());
+	}
+}
+
+/// gets a printable name for a watched thread
+/** @param thread which thread to name
+	\return the thread's name
+*/
+std::string Watchdog::getThreadName(WatchedThread thread) const {
+	switch(thread) {
+		case DriverThread:
+			return "driver";
+		case ProcessThread:
+			return "process";
+		default:
+			return "unknown";
+	}
+}
+
+/// the watchdog thread's main loop
+/** This function wakes up four times per deadline and checks every registered
+	thread. A stall is reported once; when the thread starts looping again, the
+	recovery is logged too.
+*/
+void Watchdog::run() {
+	glob.trace.nameThread("watchdog");
+
+	unsigned long interval = mDeadline / 4;
+
+	if(interval < 10000) {
+		interval = 10000;
+	}
+
+	while(!glob.shutdownMUD) {
+		usleep(interval);
+
+		unsigned long long now = Timer::now();
+
+		for(int i = 0; i < NumberOfWatchedThreads; ++i) {
+			WatchedState &state = mThreads[i];
+
+			if(!state.registered) {
+				continue;
+			}
+
+			unsigned long long lastLoop = state.lastLoop;
+			unsigned long long stalled = now > lastLoop ? now - lastLoop : 0;
+
+			if(stalled > mDeadline) {
+				if(!state.stalled) {
+					state.stalled = true;
+					reportStall(static_cast<WatchedThread>(i), stalled);
+				}
+			} else if(state.stalled) {
+				state.stalled = false;
+				glob.log.warn(boost::format("Watchdog: the %1% thread is looping again") % getThreadName(static_cast<WatchedThread>(i)));
+			}
+		}
+	}
+
+	glob.log.debug("Watchdog thread shutting down");
+}
+
+/// logs everything we know about a stalled thread
+/** @param thread the stalled thread
+	@param stalled how long since it last completed a loop, in microseconds
+*/
+void Watchdog::reportStall(WatchedThread thread, const unsigned long long stalled) {
+	// the thread is stuck, so what it last recorded holds still while we read it
+	const WatchedState &state = mThreads[thread];
+	std::string activity = state.activity ? state.activity : "unknown";
+
+	if(state.detail[0] != '\0') {
+		activity += std::string(" ") + state.detail;
+	}
+
+	if(state.descriptor >= 0) {
+		activity += boost::str(boost::format(" (descriptor %1%)") % state.descriptor);
+	}
+
+	glob.log.error(boost::format("Watchdog: the %1% thread has not completed a loop in %2% milliseconds, last activity: %3%")
+		% getThreadName(thread) % (stalled / 1000) % activity);
+
+	logBacktrace(thread);
+
+	if(glob.trace.isEnabled()) {
+		std::string file = glob.trace.dumpRecent(TRACE_DUMP_SECONDS);
+
+		if(!file.empty()) {
+			glob.log.error(boost::format("Watchdog: flight recorder dumped to %1%") % file);
+		}
+	}
+
+	if(glob.Config.getBoolValue("WatchdogAbort")) {
+		glob.log.error("Watchdog: WatchdogAbort is set, aborting for a core dump");
+		glob.log.close();
+		abort();
+	}
+}
+
+/// captures and logs the backtrace of a stalled thread
+/** This function signals the thread with SIGUSR2; the handler records the thread's
+	stack in a static buffer, which is then symbolized and logged from here. If the
+	thread cannot take the signal within a second (eg. it is blocked in the kernel
+	with signals masked), only that fact is logged.
+	@param thread the stalled thread
+*/
+void Watchdog::logBacktrace(WatchedThread thread) {
+	sBacktraceCaptured = 0;
+	sBacktraceFrameCount = 0;
+
+	if(pthread_kill(mThreads[thread].thread, SIGUSR2) != 0) {
+		glob.log.error("Watchdog: cannot signal the stalled thread for a backtrace");
+		return;
+	}
+
+	for(int waited = 0; !sBacktraceCaptured && waited < 100; ++waited) {
+		usleep(10000);
+	}
+
+	if(!sBacktraceCaptured) {
+		glob.log.error("Watchdog: the stalled thread did not respond with a backtrace");
+		return;
+	}
+
+	char **symbols = backtrace_symbols(sBacktraceFrames, sBacktraceFrameCount);
+
+	if(symbols == NULL) {
+		glob.log.error("Watchdog: cannot symbolize the backtrace");
+		return;
+	}
+
+	glob.log.error(boost::format("Watchdog: backtrace of the %1% thread:") % getThreadName(thread));
+
+	// skip the frames for the signal handler itself
+	for(int i = 2; i < sBacktraceFrameCount; ++i) {
+		glob.log.error(boost::format("  #%1% %2%") % (i - 2) % symbols[i]);
+	}
+
+	free(symbols);
+}
+
+/// SIGUSR2 handler that records the interrupted thread's stack
+void Watchdog::backtraceHandler(int) {
+	sBacktraceFrameCount = backtrace(sBacktraceFrames, kMaxBacktraceFrames);
+	sBacktraceCaptured = 1;
+}
+
+/// entry point for the watchdog thread
+/** @param arg a pointer to the Watchdog to run
+	\return nothing
+*/
+void *thread_watchdog_func(void *arg) {
+	Watchdog *watchdog = static_cast<Watchdog *>(arg);
+	watchdog->run();
+	pthread_exit(0);
+}
@@ -0,0 +1,95 @@
+#ifndef MUD_WATCHDOG_H
+#define MUD_WATCHDOG_H
+
+#include <string>
+#include <cstddef>
+#include <pthread.h>
+
+#include "mudconfig.h"
+
+void *thread_watchdog_func(void *arg);
+
+/// Notices when an engine thread stops looping
+/** This class runs its own thread that checks, several times per deadline, that the
+	driver and process threads are still completing loops. Each watched thread calls
+	stamp() once per loop and setActivity() as it moves between phases. When a thread
+	misses the deadline the watchdog logs what it was doing and a backtrace of where
+	it is stuck (captured by signalling the thread with SIGUSR2), dumps the flight
+	recorder, and can abort the process so the core dump shows the rest.
+	\note The deadline is the \c WatchdogTimeout config integer, in milliseconds
+		(WATCHDOG_TIMEOUT if unset, 0 to disable). Set the \c WatchdogAbort config
+		boolean to abort on a stall.
+*/
+class Watchdog {
+public:
+	/// the threads the watchdog keeps an eye on
+	typedef enum {
+		DriverThread = 0,	///< thread_driver_func(), the socket thread
+		ProcessThread,		///< thread_process_func(), the command and heartbeat thread
+
+		NumberOfWatchedThreads
+	} WatchedThread;
+
+	Watchdog();
+	~Watchdog();
+
+	bool start();
+
+	void run();
+
+	void enter(WatchedThread thread);
+	void stamp(WatchedThread thread);
+
+	/// records what a thread is doing
+	/** This is called in the driver's and process thread's hot loops, so nothing is
+		formatted or locked unless the thread stalls. \a activity must be a literal;
+		\a detail is copied, cut to WATCHDOG_DETAIL_LENGTH - 1 characters, so it may be
+		a temporary.
+		@param thread which thread is calling
+		@param activity a short description of the work, a string literal
+		@param detail the command or zone being worked on, or NULL
+		@param descriptor the connection being worked on, or -1
+	*/
+	void setActivity(WatchedThread thread, const char *activity, const char *detail = NULL, const int descriptor = -1) {
+		if(thread < NumberOfWatchedThreads) {
+			WatchedState &state = mThreads[thread];
+			int length = 0;
+
+			if(detail) {
+				while(length < WATCHDOG_DETAIL_LENGTH - 1 && detail[length] != '\0') {
+					state.detail[length] = detail[length];
+					++length;
+				}
+			}
+
+			state.detail[length] = '\0';
+			state.activity = activity;
+			state.descriptor = descriptor;
+		}
+	}
+
+	std::string getThreadName(WatchedThread thread) const;
+
+private:
+	/// what the watchdog knows about one watched thread
+	struct WatchedState {
+		pthread_t thread;					///< the thread's id, for pthread_kill()
+		volatile int registered;			///< non-zero once the thread has called enter()
+		volatile unsigned long long lastLoop;	///< monotonic time of the last stamp(), in microseconds
+		bool stalled;						///< true while a stall is being reported
+		const char * volatile activity;		///< what the thread said it was doing, or NULL
+		char detail[WATCHDOG_DETAIL_LENGTH];	///< a truncated copy of the command or zone it named
+		volatile int descriptor;			///< the connection it named, or -1
+	};
+
+	WatchedState mThreads[NumberOfWatchedThreads];	///< indexed by WatchedThread
+	pthread_t mThread;				///< the watchdog thread
+	unsigned long mDeadline;		///< how long a loop may take, in microseconds
+
+	void reportStall(WatchedThread thread, const unsigned long long stalled);
+	void logBacktrace(WatchedThread thread);
+
+	static void backtraceHandler(int sig);
+};
+
+#endif // MUD_WATCHDOG_H
@@ -271,6 +271,14 @@ Room::RoomPointer Zone::getRoom(const std::string &roomName) const {
 */
 void Zone::saveAll(bool force) {
 	for(Room::RoomList::iterator pos = mRoomList.begin(); pos != mRoomList.end(); ++pos) {
+		std::string detail;
+		TraceSpan span(glob.trace, "io", "Room::Save");
+
+		if(span.isActive()) {
+			detail = mZoneName + "/" + pos->second->getName();
+			span.setDetail(detail.c_str());
+		}
+
 		if(force) {
 			if(!pos->second->Save()) {
 				glob.log.error(boost::format("Zone::saveAll(): Not able to save room %1%") % pos->second->getName());
@@ -285,6 +293,22 @@ void Zone::saveAll(bool force) {
 	}
 }
 
+/// counts rooms waiting to be saved
+/** This function counts the rooms in this zone that have changed since they were last saved
+	\return the number of changed rooms
+*/
+unsigned int Zone::getNumberOfChangedRooms() const {
+	unsigned int changed = 0;
+
+	for(Room::RoomList::const_iterator it = mRoomList.begin(); it != mRoomList.end(); ++it) {
+		if(it->second->hasChanged()) {
+			++changed;
+		}
+	}
+
+	return changed;
+}
+
 /// gets a localized map for a specified area
 /** This function calls the ZoneMap object's getRadiusMap() function if a map is available and passes it back to
 	the caller.
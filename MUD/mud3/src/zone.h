@@ -5,6 +5,7 @@
 #include <string>
 
 #include "mudconfig.h"
+#include "memoryAccount.h"
 #include "zoneMap.h"
 #include "room.h"
 
@@ -12,6 +13,8 @@
 /** This class keeps all data and functions together for a single zone in the game.
 */
 class Zone {
+	MEMORY_ACCOUNTED(MemoryAccount::RoomsTag)
+
 public:
 	typedef boost::shared_ptr<Zone> ZonePointer;			///< a boost::shared_ptr shortened to make it easier to instantiate
 	typedef std::map<std::string, ZonePointer> ZoneList;	///< a map of zone name to zone shared_ptrs
@@ -39,9 +42,14 @@ public:
 	/// how many rooms are in this zone?
 	unsigned int getNumberOfRooms() const { return mRoomList.size(); }
 
+	unsigned int getNumberOfChangedRooms() const;
+
 	/// whether or not this zone has a map associated with it
 	bool hasMap() const { return mHasMap; }
 
+	/// roughly how much memory this zone's terrain and weather maps hold, in bytes
+	unsigned long getMapMemoryUsage() const { return mZoneMap.getMemoryUsage(); }
+
 	std::string getRadiusMap(const unsigned int x, const unsigned int y, const unsigned int radius, bool showLegend) const;
 
 	/// pass-through function for getting the weather in a room
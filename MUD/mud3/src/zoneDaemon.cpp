@@ -1,5 +1,6 @@
 #include "zoneDaemon.h"
 #include "zone.h"
+#include "timer.h"
 
 #include "global.h"
 extern Global glob;
@@ -8,8 +9,10 @@ extern Global glob;
 /** The constructor loads all the zones in the zone directory and sets
 	the autosave timer.
 */
-ZoneDaemon::ZoneDaemon() {
+ZoneDaemon::ZoneDaemon() : mSaveLock("ZoneDaemon") {
+	Timer loadTimer;
 	loadAllZones();
+	mLoadTime = loadTimer.elapsed();
 
 	int autosaveTimer = glob.Config.getIntValue("AutosaveTimer");
 
@@ -18,6 +21,7 @@ ZoneDaemon::ZoneDaemon() {
 	}
 
 	mHeartbeatsToNextSave = autosaveTimer;
+	mSlowestZoneTime = 0;
 }
 
 /// destructor
@@ -30,10 +34,29 @@ ZoneDaemon::~ZoneDaemon() {
 /// checks settings regularly
 /** This function is called on every heartbeat (default 3 seconds). It passes the heartbeat
 	call to each zone, and checks to see if the timer is done and should trigger an autosave.
+	Each zone's heartbeat is timed and reported to the StatEngine.
 */
 void ZoneDaemon::heartbeat() {
+	mSlowestZone.clear();
+	mSlowestZoneTime = 0;
+
 	for(Zone::ZoneList::iterator it = mZoneList.begin(); it != mZoneList.end(); ++it) {
+		glob.watchdog.setActivity(Watchdog::ProcessThread, "heartbeat: zone", it->first.c_str());
+
+		Timer zoneTimer;
 		it->second->heartbeat();
+		unsigned long elapsed = zoneTimer.elapsed();
+
+		if(glob.trace.isEnabled()) {
+			glob.trace.span("heartbeat", "Zone::heartbeat", Timer::now() - elapsed, elapsed, it->first.c_str());
+		}
+
+		glob.statEngine.recordZone(it->first, elapsed);
+
+		if(elapsed >= mSlowestZoneTime) {
+			mSlowestZone = it->first;
+			mSlowestZoneTime = elapsed;
+		}
 	}
 
 	if(mHeartbeatsToNextSave == 0) {
@@ -109,9 +132,42 @@ void ZoneDaemon::validateAllExits() {
 }
 
 /// saves all zones
-/** This function loops through all zones and tells them to save their rooms.
+/** This function loops through all zones and tells them to save their rooms. If
+	another thread is already saving, it waits for that save to finish first.
 */
 void ZoneDaemon::saveAllZones() {
+	if(!mSaveLock.lock()) {
+		glob.log.error("ZoneDaemon::saveAllZones(): Could not lock the zones for saving");
+		return;
+	}
+
+	writeAllZones();
+	mSaveLock.unlock();
+}
+
+/// saves all zones and keeps any other save from starting until releaseSaves()
+/** A hot reboot calls this before exec(), which would cut a save on the save thread
+	short and leave the new program half-written zone files. It waits for a save
+	already running.
+	\return false if the zones couldn't be locked, in which case nothing was saved
+*/
+bool ZoneDaemon::saveAllZonesAndHold() {
+	if(!mSaveLock.lock()) {
+		glob.log.error("ZoneDaemon::saveAllZonesAndHold(): Could not lock the zones for saving");
+		return false;
+	}
+
+	writeAllZones();
+	return true;
+}
+
+/// lets saves run again after saveAllZonesAndHold()
+void ZoneDaemon::releaseSaves() {
+	mSaveLock.unlock();
+}
+
+/// tells every zone to save its rooms; the caller holds mSaveLock
+void ZoneDaemon::writeAllZones() {
 	for(Zone::ZoneList::iterator it = mZoneList.begin(); it != mZoneList.end(); ++it) {
 		it->second->saveAll();
 	}
@@ -131,3 +187,29 @@ unsigned int ZoneDaemon::getTotalNumberOfRooms() {
 	return numRooms;
 }
 
+
+/// shows how many rooms are waiting to be saved
+/** This function adds up the changed (dirty) rooms in every zone.
+	\return the number of rooms changed since their last save
+*/
+unsigned int ZoneDaemon::getTotalNumberOfChangedRooms() {
+	unsigned int numRooms = 0;
+
+	for(Zone::ZoneList::iterator it = mZoneList.begin(); it != mZoneList.end(); ++it) {
+		numRooms += it->second->getNumberOfChangedRooms();
+	}
+	return numRooms;
+}
+
+/// adds up the memory held by every zone's maps
+/** \return about how many bytes all the zone maps use
+*/
+unsigned long ZoneDaemon::getMapMemoryUsage() {
+	unsigned long bytes = 0;
+
+	for(Zone::ZoneList::iterator it = mZoneList.begin(); it != mZoneList.end(); ++it) {
+		bytes += it->second->getMapMemoryUsage();
+	}
+
+	return bytes;
+}
@@ -2,6 +2,7 @@
 #define ZONE_DAEMON
 
 #include "zone.h"
+#include "mutex.h"
 
 /// manages all the zones in the game
 /** This class organizes the zones for the game.
@@ -18,18 +19,37 @@ public:
 	unsigned int getNumberOfZones()	{ return mZoneList.size(); }
 
 	unsigned int getTotalNumberOfRooms();
+	unsigned int getTotalNumberOfChangedRooms();
+	unsigned long getMapMemoryUsage();
 
 	void saveAllZones();
+	bool saveAllZonesAndHold();
+	void releaseSaves();
+
+	/// get how long loading every zone took at startup, in microseconds
+	unsigned long getLoadTime() const { return mLoadTime; }
+
+	/// get the name of the zone whose last heartbeat took the longest
+	std::string getSlowestZone() const { return mSlowestZone; }
+	/// get how long the slowest zone's last heartbeat took, in microseconds
+	unsigned long getSlowestZoneTime() const { return mSlowestZoneTime; }
 
 private:
 	Zone::ZoneList mZoneList;	///< holds all the zone objects
 
+	Mutex mSaveLock;			///< held while zones are saved, so two saves never write the same files
+
 	void loadAllZones();
+	void writeAllZones();
 
 	void validateAllExits();
 
 	int mHeartbeatsToNextSave;	///< how long until the autosave goes off?
 
+	std::string mSlowestZone;			///< the most expensive zone in the last heartbeat
+	unsigned long mSlowestZoneTime;	///< how long mSlowestZone's heartbeat took
+	unsigned long mLoadTime;		///< how long loadAllZones() took, in microseconds
+
 };
 
 #endif // ZONE_DAEMON
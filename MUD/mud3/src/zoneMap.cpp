@@ -55,7 +55,9 @@ void ZoneMap::setMap(const StringVector &zone) {
 */
 std::string ZoneMap::getLocation(const unsigned int x, const unsigned int y) const {
 	if(x >= getMaxX() || y >= getMaxY()) {
-		glob.log.error(boost::format("ZoneMap::getLocation(): Zone '%3%' x (%1%) or y (%2%) value out of range") % x % y % mName);
+		if(glob.log.throttle("ZoneMap::getLocation(): out of range")) {
+			glob.log.error(boost::format("ZoneMap::getLocation(): Zone '%3%' x (%1%) or y (%2%) value out of range") % x % y % mName);
+		}
 		return "";
 	}
 
@@ -74,7 +76,10 @@ std::string ZoneMap::getLocation(const unsigned int x, const unsigned int y) con
 	if(pos != mMapKeyColor.end()) {
 		s << pos->second;
 	} else {
-		glob.log.warn(boost::format("ZoneMap::getLocation(): No key color defined for %1% in zone %2%") % c % mName);
+		// called once per map cell, so a bad key would otherwise flood the log
+		if(glob.log.throttle("ZoneMap::getLocation(): no key color")) {
+			glob.log.warn(boost::format("ZoneMap::getLocation(): No key color defined for %1% in zone %2%") % c % mName);
+		}
 		s << c;
 	}
 
@@ -152,7 +157,9 @@ std::string ZoneMap::getRadiusMap(const unsigned int _x, const unsigned int _y,
 			if(pos != mMapKeyColor.end()) {
 				s << pos->second << "  ";
 			} else {
-				glob.log.warn(boost::format("ZoneMap::getRadiusMap(): Zone %1%'s map symbol %2% has no color text") % mName % *it);
+				if(glob.log.throttle("ZoneMap::getRadiusMap(): no color text")) {
+					glob.log.warn(boost::format("ZoneMap::getRadiusMap(): Zone %1%'s map symbol %2% has no color text") % mName % *it);
+				}
 				s << *it << "  ";
 			}
 
@@ -161,7 +168,9 @@ std::string ZoneMap::getRadiusMap(const unsigned int _x, const unsigned int _y,
 			if(pos != mMapKeyText.end()) {
 				s << pos->second;
 			} else {
-				glob.log.warn(boost::format("ZoneMap::getRadiusMap(): Zone %1%'s map symbol %2% has no legend text") % mName % *it);
+				if(glob.log.throttle("ZoneMap::getRadiusMap(): no legend text")) {
+					glob.log.warn(boost::format("ZoneMap::getRadiusMap(): Zone %1%'s map symbol %2% has no legend text") % mName % *it);
+				}
 				s << "Unspecified";
 			}
 
@@ -723,3 +732,29 @@ char ZoneMap::getWeatherChar(const int x, const int y) const {
 		return 0;
 	}
 }
+
+/// estimates the memory held by this map
+/** This function adds up the terrain and weather grids and the key text.
+	\return about how many bytes the map uses
+*/
+unsigned long ZoneMap::getMemoryUsage() const {
+	unsigned long bytes = 0;
+
+	for(std::vector<std::vector<char> >::const_iterator it = mMap.begin(); it != mMap.end(); ++it) {
+		bytes += it->capacity();
+	}
+
+	for(std::deque<std::deque<char> >::const_iterator it = mWeather.begin(); it != mWeather.end(); ++it) {
+		bytes += it->size();
+	}
+
+	const std::map<char, std::string> *keys[] = { &mMapKeyText, &mMapKeyColor, &mWeatherKeyText, &mWeatherKeyColor };
+
+	for(unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+		for(std::map<char, std::string>::const_iterator it = keys[i]->begin(); it != keys[i]->end(); ++it) {
+			bytes += it->second.capacity();
+		}
+	}
+
+	return bytes;
+}
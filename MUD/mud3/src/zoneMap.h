@@ -32,6 +32,8 @@ public:
 	/// tells whether or not this zone has weather associated with it
 	bool hasWeather() const	{ return mHasWeather; }
 
+	unsigned long getMemoryUsage() const;
+
 	/// returns the direction in which the wind blows
 	Direction getWindDirection() const { return mWindDirection; }
 